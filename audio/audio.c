@@ -22,5 +22,44 @@ hnd_t x264_audio_open_from_file( char *preferred_filter_name, char *path, int tr
         return NULL;
     }
     free( init_arg );
+    /* shared by the whole chain, a failure just means unpooled buffers */
+    ((audio_hnd_t*)h)->pool = x264_af_pool_new();
     return h;
 }
+
+int x264_audio_add_filter( hnd_t *chain, const char *name, const char *opts )
+{
+    audio_filter_t *filter = x264_af_get_filter( (char*)name );
+    if( !filter )
+    {
+        x264_cli_log( "audio", X264_LOG_ERROR, "invalid audio filter '%s'\n", name );
+        return -1;
+    }
+    if( filter->init( chain, opts ) < 0 )
+    {
+        x264_cli_log( "audio", X264_LOG_ERROR, "error initializing audio filter '%s'\n", name );
+        return -1;
+    }
+    return 0;
+}
+
+int x264_audio_add_filters( hnd_t *chain, const char *sequence )
+{
+    char *seq = strdup( sequence );
+    if( !seq )
+        return -1;
+    int ret = 0;
+    for( char *p = seq; *p && !ret; )
+    {
+        int tok_len = strcspn( p, "/" );
+        int p_len = strlen( p );
+        p[tok_len] = 0;
+        int name_len = strcspn( p, ":" );
+        p[name_len] = 0;
+        name_len += name_len != tok_len;
+        ret = x264_audio_add_filter( chain, p, p + name_len );
+        p += X264_MIN( tok_len+1, p_len );
+    }
+    free( seq );
+    return ret;
+}
@@ -12,5 +12,8 @@ enum AudioTrack
 };
 
 hnd_t x264_audio_open_from_file( char *preferred_filter_name, char *path, int trackno );
+/* append filters to a chain, the latter from "name:options/name:options..." like --vf */
+int x264_audio_add_filter( hnd_t *chain, const char *name, const char *opts );
+int x264_audio_add_filters( hnd_t *chain, const char *sequence );
 
 #endif /* AUDIO_AUDIO_H_ */
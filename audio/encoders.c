@@ -61,13 +61,131 @@ const audio_encoder_entry_t registered_audio_encoders[] = {
     { NULL, },
 };
 
+/* Packets are encoded in batches, by a single call to encoders that can fill
+ * several at once.  With workers, while the muxer consumes one batch a worker
+ * encodes the next one: packets the muxer is done with are handed back to the
+ * worker for freeing, so only the thread running a batch touches the chain. */
+#define AUDIO_BATCH 16
+
+typedef struct
+{
+    audio_packet_t **packet;
+    int count, size;
+} audio_packet_list_t;
+
 struct aenc_t
 {
     const audio_encoder_t *enc;
     hnd_t handle;
     hnd_t filters;
+
+    x264_threadpool_t *pool;    // NULL when encoding inline
+    audio_packet_t *batch[2][AUDIO_BATCH]; // [0] served to the muxer, [1] filled by the worker
+    int count[2];
+    int pos;
+    int running;                // batch[1] is being filled
+    int eof;
+    audio_packet_list_t used[2]; // [0] freed by the muxer, [1] being released by the worker
+};
+
+struct audio_workers_t
+{
+    x264_threadpool_t *pool;
 };
 
+static int list_append( audio_packet_list_t *list, audio_packet_t *pkt )
+{
+    if( list->count == list->size )
+    {
+        int size = X264_MAX( list->size * 2, AUDIO_BATCH );
+        audio_packet_t **p = realloc( list->packet, size * sizeof(audio_packet_t*) );
+        if( !p )
+            return -1;
+        list->packet = p;
+        list->size = size;
+    }
+    list->packet[list->count++] = pkt;
+    return 0;
+}
+
+static void list_release( struct aenc_t *enc, audio_packet_list_t *list )
+{
+    for( int i = 0; i < list->count; i++ )
+        enc->enc->free_packet( enc->handle, list->packet[i] );
+    list->count = 0;
+}
+
+static void *encode_batch( struct aenc_t *enc )
+{
+    list_release( enc, &enc->used[1] );
+    while( enc->count[1] < AUDIO_BATCH )
+    {
+        audio_packet_t **frames = &enc->batch[1][enc->count[1]];
+        int count;
+        if( enc->enc->encode_frames )
+            count = enc->enc->encode_frames( enc->handle, frames, AUDIO_BATCH - enc->count[1] );
+        else
+            count = !!(*frames = enc->enc->get_next_packet( enc->handle ));
+        if( count <= 0 )
+        {
+            enc->eof = 1;
+            break;
+        }
+        enc->count[1] += count;
+    }
+    return NULL;
+}
+
+static void start_batch( struct aenc_t *enc )
+{
+    XCHG( audio_packet_list_t, enc->used[0], enc->used[1] );
+    enc->running = 1;
+    if( enc->pool )
+        x264_threadpool_run( enc->pool, (void*)encode_batch, enc );
+    else
+        encode_batch( enc );
+}
+
+static void wait_batch( struct aenc_t *enc )
+{
+    if( enc->pool )
+        x264_threadpool_wait( enc->pool, enc );
+    enc->running = 0;
+}
+
+/* Returns the next packet encoded ahead, scheduling the following batch if
+ * schedule is set.  NULL means that nothing is queued and no batch is pending. */
+static audio_packet_t *next_batched( struct aenc_t *enc, int schedule )
+{
+    if( enc->pos == enc->count[0] )
+    {
+        if( schedule && !enc->running && !enc->eof )
+            start_batch( enc );
+        if( !enc->running )
+            return NULL;
+        wait_batch( enc );
+        memcpy( enc->batch[0], enc->batch[1], enc->count[1] * sizeof(audio_packet_t*) );
+        enc->count[0] = enc->count[1];
+        enc->count[1] = 0;
+        enc->pos = 0;
+        /* encoding ahead only pays off when it runs concurrently */
+        if( schedule && !enc->eof && enc->pool )
+            start_batch( enc );
+        if( !enc->count[0] )
+            return NULL;
+    }
+    return enc->batch[0][enc->pos++];
+}
+
+/* Stops encoding ahead: afterwards the caller's thread owns the chain again. */
+static void stop_batches( struct aenc_t *enc )
+{
+    if( enc->running )
+        wait_batch( enc );
+    list_release( enc, &enc->used[1] );
+    list_release( enc, &enc->used[0] );
+}
+
 hnd_t x264_audio_encoder_open( const audio_encoder_t *encoder, hnd_t filter_chain, const char *opts )
 {
     assert( encoder && filter_chain );
@@ -92,13 +210,14 @@ audio_packet_t *x264_audio_encode_frame( hnd_t encoder )
     assert( encoder );
     struct aenc_t *enc = encoder;
 
-    return enc->enc->get_next_packet( enc->handle );
+    return next_batched( enc, 1 );
 }
 
 void x264_audio_encoder_skip_samples( hnd_t encoder, uint64_t samplecount )
 {
     assert( encoder );
     struct aenc_t *enc = encoder;
+    assert( !enc->running && !enc->count[0] );
 
     return enc->enc->skip_samples( enc->handle, samplecount );
 }
@@ -108,6 +227,15 @@ audio_packet_t *x264_audio_encoder_finish( hnd_t encoder )
     assert( encoder );
     struct aenc_t *enc = encoder;
 
+    /* hand out what was encoded ahead before flushing the encoder itself */
+    audio_packet_t *pkt = next_batched( enc, 0 );
+    if( pkt )
+        return pkt;
+    if( enc->pool )
+    {
+        stop_batches( enc );
+        enc->pool = NULL;
+    }
     return enc->enc->finish( enc->handle );
 }
 
@@ -116,6 +244,10 @@ void x264_audio_free_frame( hnd_t encoder, audio_packet_t *frame )
     assert( encoder );
     struct aenc_t *enc = encoder;
 
+    if( enc->pool && !list_append( &enc->used[0], frame ) )
+        return;
+    if( enc->pool )
+        stop_batches( enc );    // out of memory: freeing directly needs the chain back
     return enc->enc->free_packet( enc->handle, frame );
 }
 
@@ -125,11 +257,44 @@ void x264_audio_encoder_close( hnd_t encoder )
         return;
     struct aenc_t *enc = encoder;
 
+    stop_batches( enc );
+    for( int i = enc->pos; i < enc->count[0]; i++ )
+        enc->enc->free_packet( enc->handle, enc->batch[0][i] );
+    for( int i = 0; i < enc->count[1]; i++ )
+        enc->enc->free_packet( enc->handle, enc->batch[1][i] );
+    free( enc->used[0].packet );
+    free( enc->used[1].packet );
     enc->enc->close( enc->handle );
     x264_af_close( enc->filters );
     free( enc );
 }
 
+hnd_t x264_audio_workers_open( hnd_t *encoders, int count )
+{
+    struct audio_workers_t *workers = calloc( 1, sizeof(struct audio_workers_t) );
+    if( !workers )
+        return NULL;
+    /* every encoder keeps at most one batch in flight, and a job can only be queued
+     * while the pool has a free slot, so each needs a thread of its own */
+    if( count <= 0 || x264_threadpool_init( &workers->pool, count, NULL, NULL ) )
+    {
+        free( workers );
+        return NULL;
+    }
+    for( int i = 0; i < count; i++ )
+        ((struct aenc_t*)encoders[i])->pool = workers->pool;
+    return workers;
+}
+
+void x264_audio_workers_close( hnd_t handle )
+{
+    struct audio_workers_t *workers = handle;
+    if( !workers )
+        return;
+    x264_threadpool_delete( workers->pool );
+    free( workers );
+}
+
 const audio_encoder_t *x264_audio_encoder_by_name( const char *name, int mode, const char **used_enc )
 {
     const audio_encoder_entry_t *cur = NULL;
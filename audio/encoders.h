@@ -9,6 +9,9 @@ typedef struct audio_encoder_t
     hnd_t (*init)( hnd_t filter_chain, const char *opts );
     audio_info_t *(*get_info)( hnd_t handle );
     audio_packet_t *(*get_next_packet)( hnd_t handle );
+    /* Optional: encodes up to max packets out of a single request to the filter chain.
+     * Returns how many were put in frames, 0 once the stream has ended (or on errors). */
+    int (*encode_frames)( hnd_t handle, audio_packet_t **frames, int max );
     void (*skip_samples)( hnd_t handle, uint64_t samplecount );
     audio_packet_t *(*finish)( hnd_t handle );
     void (*free_packet)( hnd_t handle, audio_packet_t *samples );
@@ -65,6 +68,12 @@ audio_packet_t *x264_audio_encoder_finish( hnd_t encoder );
 void x264_audio_free_frame( hnd_t encoder, audio_packet_t *frame );
 
 void x264_audio_encoder_close( hnd_t encoder );
+
+/* Makes the encoders encode ahead of their caller, concurrently on a thread each.
+ * Must be called before their first packet is requested and closed after them.
+ * Returns NULL if threads are unavailable, in which case encoding stays inline. */
+hnd_t x264_audio_workers_open( hnd_t *encoders, int count );
+void x264_audio_workers_close( hnd_t workers );
 void x264_audio_encoder_show_help( int longhelp );
 void x264_audio_encoder_list_codecs( int longhelp );
 void x264_audio_encoder_list_encoders( int longhelp );
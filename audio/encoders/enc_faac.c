@@ -16,7 +16,6 @@ typedef struct enc_faac_t
     int64_t last_dts;
     void *samplebuffer;
     size_t bufsize;
-    audio_packet_t *in;
 } enc_faac_t;
 
 static const int faac_channel_map[][8] = {
@@ -131,7 +130,9 @@ static hnd_t init( hnd_t filter_chain, const char *opt_str )
     h->info.priming    = 1024;
 
     h->last_dts = INVALID_DTS;
-    h->samplebuffer = NULL;
+    h->samplebuffer = malloc( h->info.framelen * h->info.samplesize );
+    if( !h->samplebuffer )
+        goto error;
 
     x264_cli_log( "audio", X264_LOG_INFO, "opened faac encoder (%s: %g%s, samplerate: %dhz, %d priming samples)\n",
                   ( !is_vbr ? "bitrate" : "VBR" ), brval,
@@ -161,61 +162,69 @@ static void free_packet( hnd_t handle, audio_packet_t *packet )
     x264_af_free_packet( packet );
 }
 
-static audio_packet_t *get_next_packet( hnd_t handle )
+/* The samples of all the frames are requested at once, and fed to faac a
+ * frame at a time from a view into them. */
+static int encode_frames( hnd_t handle, audio_packet_t **frames, int max )
 {
     enc_faac_t *h = handle;
-    int ret;
-
-    if( h->finishing )
-        return NULL;
+    audio_packet_t *in = NULL, *out = NULL;
+    int count = 0;
 
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
-    out->info = h->info;
-    out->data = malloc( h->bufsize );
-
-    do
+    while( !count && !h->finishing )
     {
-        if( h->in && h->in->flags & AUDIO_FLAG_EOF )
-        {
-            h->finishing = 1;
-            goto error; // Not an error here but it'd do the same handling
-        }
-        x264_af_free_packet( h->in );
-
-        if( !( h->in = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + h->info.framelen ) ) )
+        if( !( in = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + (int64_t)max * h->info.framelen ) ) )
             goto error;
+        if( in->flags & AUDIO_FLAG_EOF )
+            h->finishing = 1;
         if( h->last_dts == INVALID_DTS )
             h->last_dts = h->last_sample;
-        h->last_sample += h->in->samplecount;
-
-        if( h->samplebuffer )
-            free( h->samplebuffer );
-        h->samplebuffer = x264_af_interleave2( SMPFMT_FLT, h->in->samples, h->info.channels, h->in->samplecount );
-        for( int i=0; i<h->in->samplecount*h->info.channels; i++ )
-            ((float *)h->samplebuffer)[i] *= 32768.0f;
 
-        ret = faacEncEncode( h->faac, h->samplebuffer, h->in->samplecount*h->info.channels, out->data, h->bufsize );
-        if( ret < 0 )
+        float *view[in->channels];
+        for( int done = 0, len; done < in->samplecount; done += len )
         {
-            x264_cli_log( "faac", X264_LOG_ERROR, "failed to encode audio\n" );
-            goto error;
+            len = X264_MIN( in->samplecount - done, h->info.framelen );
+            x264_af_slice_buffer( view, in->samples, in->channels, done );
+            x264_af_interleave_to( h->samplebuffer, SMPFMT_FLT, view, h->info.channels, len );
+            for( int i=0; i<len*h->info.channels; i++ )
+                ((float *)h->samplebuffer)[i] *= 32768.0f;
+            h->last_sample += len;
+
+            if( !out && !(out = x264_af_alloc_packet( h->bufsize )) )
+                goto error;
+            int ret = faacEncEncode( h->faac, h->samplebuffer, len*h->info.channels, out->data, h->bufsize );
+            if( ret < 0 )
+            {
+                x264_cli_log( "faac", X264_LOG_ERROR, "failed to encode audio\n" );
+                goto error;
+            }
+            if( !ret )
+                continue;
+
+            out->info = h->info;
+            out->size = ret;
+            out->dts = h->last_dts;
+            h->last_dts += h->info.framelen;
+            frames[count++] = out;
+            out = NULL;
         }
-        out->size = ret;
-
-    } while( ret <= 0 );
+        x264_af_free_packet( in );
+        in = NULL;
+    }
 
-    out->dts = h->last_dts;
-    h->last_dts += h->info.framelen;
-    return out;
+    x264_af_free_packet( out );
+    return count;
 
 error:
-    if( h->in )
-    {
-        x264_af_free_packet( h->in );
-        h->in = NULL;
-    }
+    h->finishing = 1;
+    x264_af_free_packet( in );
     x264_af_free_packet( out );
-    return NULL;
+    return count;
+}
+
+static audio_packet_t *get_next_packet( hnd_t handle )
+{
+    audio_packet_t *out;
+    return encode_frames( handle, &out, 1 ) > 0 ? out : NULL;
 }
 
 static void skip_samples( hnd_t handle, uint64_t samplecount )
@@ -250,8 +259,6 @@ static void faac_close( hnd_t handle )
     enc_faac_t *h = handle;
 
     faacEncClose( h->faac );
-    if( h->in )
-        x264_af_free_packet( h->in );
     if( h->samplebuffer )
         free( h->samplebuffer );
     if( h->info.extradata )
@@ -281,6 +288,7 @@ const audio_encoder_t audio_encoder_faac =
     .init            = init,
     .get_info        = get_info,
     .get_next_packet = get_next_packet,
+    .encode_frames   = encode_frames,
     .skip_samples    = skip_samples,
     .finish          = finish,
     .free_packet     = free_packet,
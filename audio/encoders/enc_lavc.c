@@ -357,32 +357,27 @@ static audio_info_t *get_info( hnd_t handle )
     return &h->info;
 }
 
-static audio_packet_t *get_next_packet( hnd_t handle )
+/* The samples of all the frames are requested at once, and each frame gets
+ * encoded from a view into them. */
+static int encode_frames( hnd_t handle, audio_packet_t **frames, int max )
 {
     enc_lavc_t *h = handle;
-    if( h->finishing )
-        return NULL;
     assert( h->ctx );
 
-    audio_packet_t *smp = NULL;
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
-    out->info = h->info;
-    out->data = malloc( h->buf_size );
-
-    while( out->size == 0 )
+    audio_packet_t *smp = NULL, *out = NULL;
+    int count = 0;
+    while( !count && !h->finishing )
     {
-        smp = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + h->info.framelen );
+        int64_t want = (int64_t)max * h->info.framelen;
+        smp = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + want );
         if( !smp )
             goto error; // not an error but need same handling
 
-        out->samplecount = smp->samplecount;
-        out->channels    = smp->channels;
-
         /* x264_af_interleave2 allocates only samplecount * channels * bytes per sample per single channel, */
         /* but lavc expects sample buffer contains h->ctx->frame_size samples (at least, alac encoder does). */
         /* If codec has capabilitiy to accept samples < default frame length, need to modify frame_size to */
         /* specify real sample counts in sample buffer, and if not, need to padding buffer. */
-        if( smp->samplecount < h->info.framelen )
+        if( smp->samplecount < want )
         {
             h->finishing = 1;
             if( !(smp->flags & AUDIO_FLAG_EOF) )
@@ -391,55 +386,79 @@ static audio_packet_t *get_next_packet( hnd_t handle )
                 goto error;
             }
 
-            if( h->ctx->codec->capabilities & CODEC_CAP_SMALL_LAST_FRAME )
-                h->ctx->frame_size = h->info.last_delta = smp->samplecount;
-            else
+            int tail = smp->samplecount % h->info.framelen;
+            if( tail && !(h->ctx->codec->capabilities & CODEC_CAP_SMALL_LAST_FRAME) )
             {
-                if( x264_af_resize_fill_buffer( smp->samples, h->info.framelen, h->info.channels, smp->samplecount, 0.0f ) )
+                int padded = smp->samplecount - tail + h->info.framelen;
+                if( x264_af_resize_fill_buffer( smp->samples, padded, h->info.channels, smp->samplecount, 0.0f ) )
                 {
                     x264_cli_log( "lavc", X264_LOG_ERROR, "failed to expand buffer.\n" );
                     goto error;
                 }
-                smp->samplecount = h->info.last_delta = h->info.framelen;
+                smp->samplecount   = padded;
+                h->info.last_delta = h->info.framelen;
             }
         }
 
         if( h->last_dts == INVALID_DTS )
             h->last_dts = h->last_sample;
-        h->last_sample += smp->samplecount;
 
-        h->frame->nb_samples  = smp->samplecount;
-
-        if( resample_audio( h->avr, h->frame, smp ) < 0 )
+        float *view[smp->channels];
+        audio_packet_t frame = *smp;
+        frame.samples = view;
+        for( int done = 0; done < smp->samplecount; done += frame.samplecount )
         {
-            x264_cli_log( "lavc", X264_LOG_ERROR, "error resampling audio!\n" );
-            goto error;
-        }
+            frame.samplecount = X264_MIN( smp->samplecount - done, h->info.framelen );
+            if( frame.samplecount < h->info.framelen )
+                h->ctx->frame_size = h->info.last_delta = frame.samplecount;
+            x264_af_slice_buffer( view, smp->samples, smp->channels, done );
+            h->last_sample += frame.samplecount;
 
-        if( encode_audio( h->ctx, out, h->frame ) < 0 )
-        {
-            x264_cli_log( "lavc", X264_LOG_ERROR, "error encoding audio! (%s)\n", strerror( -out->size ) );
-            goto error;
+            h->frame->nb_samples = frame.samplecount;
+
+            if( resample_audio( h->avr, h->frame, &frame ) < 0 )
+            {
+                x264_cli_log( "lavc", X264_LOG_ERROR, "error resampling audio!\n" );
+                goto error;
+            }
+
+            if( !out && !(out = x264_af_alloc_packet( h->buf_size )) )
+                goto error;
+            if( encode_audio( h->ctx, out, h->frame ) < 0 )
+            {
+                x264_cli_log( "lavc", X264_LOG_ERROR, "error encoding audio!\n" );
+                goto error;
+            }
+            if( !out->size )
+                continue;
+
+            out->info        = h->info;
+            out->channels    = smp->channels;
+            out->samplecount = frame.samplecount;
+            out->dts         = h->last_dts;
+            h->last_dts     += h->info.framelen;
+            frames[count++]  = out;
+            out = NULL;
         }
 
         x264_af_free_packet( smp );
+        smp = NULL;
     }
 
-    if( out->size < 0 )
-    {
-        x264_cli_log( "lavc", X264_LOG_ERROR, "error encoding audio! (%s)\n", strerror( -out->size ) );
-        goto error;
-    }
-
-    out->dts     = h->last_dts;
-    h->last_dts += h->info.framelen;
-    return out;
+    x264_af_free_packet( out );
+    return count;
 
 error:
-    if( smp )
-        x264_af_free_packet( smp );
+    h->finishing = 1;
+    x264_af_free_packet( smp );
     x264_af_free_packet( out );
-    return NULL;
+    return count;
+}
+
+static audio_packet_t *get_next_packet( hnd_t handle )
+{
+    audio_packet_t *out;
+    return encode_frames( handle, &out, 1 ) > 0 ? out : NULL;
 }
 
 static void skip_samples( hnd_t handle, uint64_t samplecount )
@@ -554,6 +573,7 @@ const audio_encoder_t audio_encoder_lavc =
     .init            = init,
     .get_info        = get_info,
     .get_next_packet = get_next_packet,
+    .encode_frames   = encode_frames,
     .skip_samples    = skip_samples,
     .finish          = finish,
     .free_packet     = free_packet,
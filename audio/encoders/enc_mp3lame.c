@@ -21,7 +21,6 @@ typedef struct enc_lame_t
     uint8_t *buffer;
     size_t buf_index;
     size_t bufsize;
-    audio_packet_t *in;
 } enc_lame_t;
 
 static hnd_t init( hnd_t filter_chain, const char *opt_str )
@@ -190,56 +189,66 @@ static int get_next_mp3frame( hnd_t handle, uint8_t *data )
     return outlen;
 }
 
-static audio_packet_t *get_next_packet( hnd_t handle )
+/* The samples of all the frames are requested at once, and fed to lame a
+ * frame at a time from a view into them. */
+static int encode_frames( hnd_t handle, audio_packet_t **frames, int max )
 {
     enc_lame_t *h = handle;
-    int len;
-
-    if( h->finishing )
-        return NULL;
-
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
-    out->info = h->info;
-    out->data = malloc( h->bufsize );
+    audio_packet_t *in = NULL, *out = NULL;
+    int count = 0;
 
-    do
+    while( !count && !h->finishing )
     {
-        if( h->in && h->in->flags & AUDIO_FLAG_EOF )
-        {
-            h->finishing = 1;
-            goto error; // Not an error here but it'd do the same handling
-        }
-        x264_af_free_packet( h->in );
-
-        if( !( h->in = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + h->info.framelen ) ) )
+        if( !( in = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + (int64_t)max * h->info.framelen ) ) )
             goto error;
+        if( in->flags & AUDIO_FLAG_EOF )
+            h->finishing = 1;
         if( h->last_dts == INVALID_DTS )
             h->last_dts = h->last_sample;
-        h->last_sample += h->in->samplecount;
-
-        len = lame_encode_buffer_float( h->lame, h->in->samples[0], h->in->samples[1],
-                                              h->in->samplecount, h->buffer + h->buf_index, h->bufsize - h->buf_index );
-
-        if( len < 0 )
-            goto error;
 
-        h->buf_index += len;
-
-        out->size = get_next_mp3frame( h, out->data );
-    } while( !out->size );
+        float *view[in->channels];
+        for( int done = 0, len; done < in->samplecount; done += len )
+        {
+            len = X264_MIN( in->samplecount - done, h->info.framelen );
+            x264_af_slice_buffer( view, in->samples, in->channels, done );
+            h->last_sample += len;
+
+            int ret = lame_encode_buffer_float( h->lame, view[0], view[in->channels > 1], len,
+                                                h->buffer + h->buf_index, h->bufsize - h->buf_index );
+            if( ret < 0 )
+                goto error;
+            h->buf_index += ret;
+
+            if( !out && !(out = x264_af_alloc_packet( h->bufsize )) )
+                goto error;
+            out->size = get_next_mp3frame( h, out->data );
+            if( !out->size )
+                continue;
+
+            out->info = h->info;
+            out->dts = h->last_dts;
+            h->last_dts += h->info.framelen;
+            frames[count++] = out;
+            out = NULL;
+        }
+        x264_af_free_packet( in );
+        in = NULL;
+    }
 
-    out->dts = h->last_dts;
-    h->last_dts += h->info.framelen;
-    return out;
+    x264_af_free_packet( out );
+    return count;
 
 error:
-    if( h->in )
-    {
-        x264_af_free_packet( h->in );
-        h->in = NULL;
-    }
+    h->finishing = 1;
+    x264_af_free_packet( in );
     x264_af_free_packet( out );
-    return NULL;
+    return count;
+}
+
+static audio_packet_t *get_next_packet( hnd_t handle )
+{
+    audio_packet_t *out;
+    return encode_frames( handle, &out, 1 ) > 0 ? out : NULL;
 }
 
 static void skip_samples( hnd_t handle, uint64_t samplecount )
@@ -282,8 +291,6 @@ static void mp3_close( hnd_t handle )
     enc_lame_t *h = handle;
 
     lame_close( h->lame );
-    if( h->in )
-        x264_af_free_packet( h->in );
     if( h->buffer )
         free( h->buffer );
     free( h );
@@ -313,6 +320,7 @@ const audio_encoder_t audio_encoder_lame =
     .init            = init,
     .get_info        = get_info,
     .get_next_packet = get_next_packet,
+    .encode_frames   = encode_frames,
     .skip_samples    = skip_samples,
     .finish          = finish,
     .free_packet     = free_packet,
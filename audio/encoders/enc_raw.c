@@ -41,29 +41,51 @@ static audio_info_t *get_info( hnd_t handle )
     return &h->info;
 }
 
-static audio_packet_t *get_next_packet( hnd_t handle )
+/* The samples of all the frames are requested at once and converted straight
+ * into packets carrying their data inline. */
+static int encode_frames( hnd_t handle, audio_packet_t **frames, int max )
 {
     enc_raw_t *h = handle;
     if( h->finishing )
-        return NULL;
+        return 0;
 
-    audio_packet_t *smp = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + h->info.framelen );
+    audio_packet_t *smp = x264_af_get_samples( h->filter_chain, h->last_sample, h->last_sample + (int64_t)max * h->info.framelen );
     if( !smp )
-        return NULL;
-
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
-    memcpy( out, smp, sizeof( audio_packet_t ) );
-    out->info        = h->info;
-    out->samples     = NULL;
-    out->samplecount = smp->samplecount;
-    out->data        = x264_af_interleave2( SMPFMT_S16, smp->samples, smp->channels, smp->samplecount );
-    out->size        = smp->samplecount * h->info.samplesize;
-    out->dts         = h->last_sample;
-    out->info.last_delta = smp->samplecount;
-    h->last_sample  += smp->samplecount;
+        return 0;
+    if( smp->flags & AUDIO_FLAG_EOF )
+        h->finishing = 1;
+
+    float *view[smp->channels];
+    int count = 0;
+    for( int done = 0, len; done < smp->samplecount && count < max; done += len )
+    {
+        len = X264_MIN( smp->samplecount - done, h->info.framelen );
+        audio_packet_t *out = x264_af_alloc_packet( len * h->info.samplesize );
+        if( !out )
+        {
+            x264_cli_log( "audio", X264_LOG_ERROR, "malloc failed\n" );
+            h->finishing = 1;
+            break;
+        }
+        out->info            = h->info;
+        out->channels        = smp->channels;
+        out->samplecount     = len;
+        out->dts             = h->last_sample;
+        out->info.last_delta = len;
+        x264_af_slice_buffer( view, smp->samples, smp->channels, done );
+        x264_af_interleave_to( out->data, SMPFMT_S16, view, smp->channels, len );
+        h->last_sample += len;
+        frames[count++] = out;
+    }
     x264_af_free_packet( smp );
 
-    return out;
+    return count;
+}
+
+static audio_packet_t *get_next_packet( hnd_t handle )
+{
+    audio_packet_t *out;
+    return encode_frames( handle, &out, 1 ) > 0 ? out : NULL;
 }
 
 static void skip_samples( hnd_t handle, uint64_t samplecount )
@@ -100,6 +122,7 @@ const audio_encoder_t audio_encoder_raw =
     .init            = init,
     .get_info        = get_info,
     .get_next_packet = get_next_packet,
+    .encode_frames   = encode_frames,
     .skip_samples    = skip_samples,
     .finish          = finish,
     .free_packet     = free_packet,
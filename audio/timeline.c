@@ -0,0 +1,73 @@
+#include "audio/timeline.h"
+
+#include <assert.h>
+#include <string.h>
+
+void x264_audio_timeline_init( audio_timeline_t *tl, hnd_t encoder, timebase_t timebase )
+{
+    memset( tl, 0, sizeof( audio_timeline_t ) );
+    tl->encoder  = encoder;
+    tl->info     = x264_audio_encoder_info( encoder );
+    tl->timebase = timebase;
+}
+
+int64_t x264_audio_timeline_peek( audio_timeline_t *tl, int64_t video_ts )
+{
+    if( !tl->started )
+    {
+        /* the video starts late with --seek, the audio is cut to start along with it */
+        if( video_ts > 0 )
+            x264_audio_encoder_skip_samples( tl->encoder, x264_convert_timebase( video_ts, tl->timebase, (timebase_t){ 1, tl->info->samplerate } ) );
+        tl->started = 1;
+    }
+
+    if( !tl->pending && !tl->eof )
+    {
+        audio_packet_t *frame = x264_audio_encode_frame( tl->encoder );
+        if( !frame )
+            frame = x264_audio_encoder_finish( tl->encoder );
+        if( frame )
+        {
+            assert( frame->dts >= 0 ); // Guard against encoders that don't give proper DTS
+            tl->pending    = frame;
+            tl->pending_ts = x264_convert_timebase( frame->dts, frame->info.timebase, tl->timebase );
+        }
+        else
+            tl->eof = 1;
+    }
+
+    if( !tl->pending || ( video_ts >= 0 && tl->pending_ts > video_ts ) )
+        return INVALID_DTS;
+    return tl->pending_ts;
+}
+
+audio_packet_t *x264_audio_timeline_next( audio_timeline_t *tl, int64_t video_ts, int64_t *ts )
+{
+    if( x264_audio_timeline_peek( tl, video_ts ) == INVALID_DTS )
+        return NULL;
+
+    audio_packet_t *frame = tl->pending;
+    tl->pending = NULL;
+    if( !tl->count++ )
+        tl->first_dts = frame->dts;
+    tl->last_dts = frame->dts;
+    *ts = tl->pending_ts;
+    return frame;
+}
+
+int64_t x264_audio_timeline_duration( audio_timeline_t *tl, timebase_t timebase )
+{
+    if( !tl->count )
+        return 0;
+    timebase_t track = tl->info->timebase;
+    int64_t priming  = x264_convert_timebase( tl->info->priming, (timebase_t){ 1, tl->info->samplerate }, track );
+    int64_t duration = tl->last_dts - tl->first_dts + tl->info->last_delta - priming;
+    return x264_convert_timebase( X264_MAX( duration, 0 ), track, timebase );
+}
+
+void x264_audio_timeline_close( audio_timeline_t *tl )
+{
+    if( tl->pending )
+        x264_audio_free_frame( tl->encoder, tl->pending );
+    tl->pending = NULL;
+}
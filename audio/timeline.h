@@ -0,0 +1,41 @@
+#ifndef AUDIO_TIMELINE_H_
+#define AUDIO_TIMELINE_H_
+
+#include "audio/encoders.h"
+
+/* Lays the packets of an audio encoder out against the video of a muxer, on the muxer's
+ * timebase.  The start alignment and the presented duration are worked out here once for
+ * all muxers, and every timestamp is converted exactly in integers so nothing drifts. */
+typedef struct audio_timeline_t
+{
+    hnd_t           encoder;
+    audio_info_t   *info;
+    timebase_t      timebase;   // the muxer's
+    int             started;
+    int             eof;
+    audio_packet_t *pending;    // encoded ahead of the video
+    int64_t         pending_ts; // its dts on the muxer's timebase
+    int64_t         first_dts;  // of the first packet handed out, on the track's timebase
+    int64_t         last_dts;   // of the last one
+    int             count;      // packets handed out
+} audio_timeline_t;
+
+void x264_audio_timeline_init( audio_timeline_t *tl, hnd_t encoder, timebase_t timebase );
+
+/* Returns the dts on the muxer's timebase of the next packet if it is due by video_ts, or
+ * INVALID_DTS if it isn't or there is none left.  Everything is due when video_ts < 0.
+ * The first call drops the audio before video_ts, the start of the video when --seek is used. */
+int64_t x264_audio_timeline_peek( audio_timeline_t *tl, int64_t video_ts );
+
+/* Takes the next packet due by video_ts, putting its dts on the muxer's timebase in ts.
+ * Returns NULL when none is.  The packet is freed with x264_audio_free_frame. */
+audio_packet_t *x264_audio_timeline_next( audio_timeline_t *tl, int64_t video_ts, int64_t *ts );
+
+/* Presented duration of the packets handed out so far on the given timebase: from the
+ * first to the end of the last one, without the encoder's priming. */
+int64_t x264_audio_timeline_duration( audio_timeline_t *tl, timebase_t timebase );
+
+/* Frees what was encoded but not taken; call before closing the encoder */
+void x264_audio_timeline_close( audio_timeline_t *tl );
+
+#endif
@@ -32,6 +32,20 @@ static uint8_t *x264_nal_escape_c( uint8_t *dst, uint8_t *src, uint8_t *end )
     if( src < end ) *dst++ = *src++;
     while( src < end )
     {
+        /* An escape is only ever inserted before a byte <= 3, so runs of 8 bytes
+         * without one can be copied as is. */
+        while( end - src >= 8 )
+        {
+            uint64_t v;
+            memcpy( &v, src, 8 );
+            if( (v - 0x0404040404040404ULL) & ~v & 0x8080808080808080ULL )
+                break;
+            memcpy( dst, &v, 8 );
+            dst += 8;
+            src += 8;
+        }
+        if( src >= end )
+            break;
         if( src[0] <= 0x03 && !dst[-2] && !dst[-1] )
             *dst++ = 0x03;
         *dst++ = *src++;
@@ -642,6 +642,10 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
     }
     OPT("sliced-threads")
         p->b_sliced_threads = atobool(value);
+    OPT("thread-affinity")
+        b_error |= parse_enum( value, x264_affinity_names, &p->i_thread_affinity );
+    OPT("cpuset")
+        p->psz_cpuset = strdup(value);
     OPT("sync-lookahead")
     {
         if( !strcmp(value, "auto") )
@@ -1061,6 +1065,12 @@ void x264_log( x264_t *h, int i_level, const char *psz_fmt, ... )
     }
 }
 
+void x264_trace( x264_t *h, int i_stage, int b_end, int i_frame, int i_row, int i_thread )
+{
+    x264_trace_event_t event = { i_stage, b_end, i_frame, i_row, i_thread, x264_mdate() };
+    h->param.pf_trace( h->param.p_trace_private, &event );
+}
+
 static void x264_log_default( void *p_unused, int i_level, const char *psz_fmt, va_list arg )
 {
     char *psz_prefix;
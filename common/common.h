@@ -234,6 +234,14 @@ char *x264_param2string( x264_param_t *p, int b_res );
 
 /* log */
 void x264_log( x264_t *h, int i_level, const char *psz_fmt, ... );
+void x264_trace( x264_t *h, int i_stage, int b_end, int i_frame, int i_row, int i_thread );
+
+/* costs a single test when tracing is disabled */
+#define X264_TRACE( h, stage, b_end, frame, row, thread )\
+do {\
+    if( (h)->param.pf_trace )\
+        x264_trace( h, stage, b_end, frame, row, thread );\
+} while( 0 )
 
 void x264_reduce_fraction( uint32_t *n, uint32_t *d );
 void x264_reduce_fraction64( uint64_t *n, uint64_t *d );
@@ -479,6 +487,10 @@ struct x264_t
     int             i_threadslice_pass; /* which pass of encoding we are on */
     x264_threadpool_t *threadpool;
     x264_threadpool_t *lookaheadpool;
+    x264_cpuset_t   cpuset;         /* cpus the encoder's threads are pinned to */
+    int             b_affinity;     /* whether to pin them at all */
+    int             i_affinity_cpus; /* number of cpus in cpuset, 0 if unrestricted */
+    int             i_numa_node;    /* node frames are placed on, -1 for none */
     x264_pthread_mutex_t mutex;
     x264_pthread_cond_t cv;
 
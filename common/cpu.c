@@ -31,6 +31,9 @@
 
 #if HAVE_POSIXTHREAD && SYS_LINUX
 #include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #endif
 #if SYS_BEOS
 #include <kernel/OS.h>
@@ -442,3 +445,145 @@ int x264_cpu_num_processors( void )
     return 1;
 #endif
 }
+
+int x264_cpuset_parse( x264_cpuset_t *set, const char *str )
+{
+    memset( set, 0, sizeof(x264_cpuset_t) );
+    while( *str && *str != '\n' )
+    {
+        char *end;
+        long first = strtol( str, &end, 10 );
+        long last = first;
+        if( end == str || first < 0 )
+            return -1;
+        str = end;
+        if( *str == '-' )
+        {
+            last = strtol( ++str, &end, 10 );
+            if( end == str || last < first )
+                return -1;
+            str = end;
+        }
+        if( last >= X264_CPUSET_MAX )
+            return -1;
+        for( long i = first; i <= last; i++ )
+            set->mask[i>>6] |= 1ULL << (i&63);
+        if( *str == ',' )
+            str++;
+        else if( *str && *str != '\n' )
+            return -1;
+    }
+    return 0;
+}
+
+int x264_cpuset_count( const x264_cpuset_t *set )
+{
+    int count = 0;
+    for( int i = 0; i < X264_CPUSET_MAX; i++ )
+        count += (set->mask[i>>6] >> (i&63)) & 1;
+    return count;
+}
+
+void x264_cpuset_and( x264_cpuset_t *dst, const x264_cpuset_t *src )
+{
+    for( int i = 0; i < X264_CPUSET_MAX/64; i++ )
+        dst->mask[i] &= src->mask[i];
+}
+
+void x264_cpu_get_affinity( x264_cpuset_t *set )
+{
+    memset( set, 0, sizeof(x264_cpuset_t) );
+#if HAVE_POSIXTHREAD && SYS_LINUX
+    cpu_set_t p_aff;
+    CPU_ZERO( &p_aff );
+    if( !sched_getaffinity( 0, sizeof(p_aff), &p_aff ) )
+    {
+        for( int i = 0; i < X264_MIN( CPU_SETSIZE, X264_CPUSET_MAX ); i++ )
+            if( CPU_ISSET( i, &p_aff ) )
+                set->mask[i>>6] |= 1ULL << (i&63);
+        return;
+    }
+#endif
+    int ncpu = X264_MIN( x264_cpu_num_processors(), X264_CPUSET_MAX );
+    for( int i = 0; i < ncpu; i++ )
+        set->mask[i>>6] |= 1ULL << (i&63);
+}
+
+int x264_cpu_numa_node( x264_cpuset_t *set )
+{
+#if HAVE_POSIXTHREAD && SYS_LINUX
+    DIR *dir = opendir( "/sys/devices/system/node" );
+    if( !dir )
+        return -1;
+    int nodes = 0, best_node = -1, best_count = 0;
+    x264_cpuset_t best_set;
+    struct dirent *entry;
+    while( (entry = readdir( dir )) )
+    {
+        char name[300], list[4096];
+        int node;
+        if( sscanf( entry->d_name, "node%d", &node ) != 1 )
+            continue;
+        snprintf( name, sizeof(name), "/sys/devices/system/node/%s/cpulist", entry->d_name );
+        FILE *fh = fopen( name, "r" );
+        if( !fh )
+            continue;
+        x264_cpuset_t node_set;
+        int ok = fgets( list, sizeof(list), fh ) && !x264_cpuset_parse( &node_set, list );
+        fclose( fh );
+        if( !ok )
+            continue;
+        nodes++;
+        x264_cpuset_and( &node_set, set );
+        int count = x264_cpuset_count( &node_set );
+        if( count > best_count || (count == best_count && count && node < best_node) )
+        {
+            best_node = node;
+            best_count = count;
+            best_set = node_set;
+        }
+    }
+    closedir( dir );
+    if( nodes < 2 || best_node < 0 )
+        return -1;
+    *set = best_set;
+    return best_node;
+#else
+    return -1;
+#endif
+}
+
+int x264_cpu_set_thread_affinity( const x264_cpuset_t *set )
+{
+#if HAVE_POSIXTHREAD && SYS_LINUX
+    cpu_set_t p_aff;
+    CPU_ZERO( &p_aff );
+    for( int i = 0; i < X264_MIN( CPU_SETSIZE, X264_CPUSET_MAX ); i++ )
+        if( (set->mask[i>>6] >> (i&63)) & 1 )
+            CPU_SET( i, &p_aff );
+    return sched_setaffinity( 0, sizeof(p_aff), &p_aff ) ? -1 : 0;
+#else
+    return -1;
+#endif
+}
+
+void x264_cpu_numa_bind( void *p, size_t size, int node )
+{
+#if HAVE_POSIXTHREAD && SYS_LINUX && defined(SYS_mbind)
+    /* from linux/mempolicy.h, which isn't always installed */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_MF_MOVE (1<<1)
+#endif
+    unsigned long nodemask[X264_CPUSET_MAX/(8*sizeof(long))] = {0};
+    uintptr_t page = sysconf( _SC_PAGESIZE );
+    uintptr_t start = ((uintptr_t)p + page-1) & ~(page-1);
+    uintptr_t end = ((uintptr_t)p + size) & ~(page-1);
+    /* the kernel only looks at maxnode-1 bits */
+    if( node < 0 || node >= X264_CPUSET_MAX-1 || end <= start )
+        return;
+    nodemask[node / (8*sizeof(long))] = 1UL << (node % (8*sizeof(long)));
+    /* MPOL_MF_MOVE also covers pages the allocator reused, failures only cost speed */
+    syscall( SYS_mbind, start, end - start, MPOL_PREFERRED, nodemask, (unsigned long)X264_CPUSET_MAX, MPOL_MF_MOVE );
+#endif
+}
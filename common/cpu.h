@@ -46,6 +46,27 @@ void     x264_cpu_sfence( void );
 #endif
 #define x264_sfence x264_cpu_sfence
 void     x264_cpu_mask_misalign_sse( void );
+
+/* Thread and memory placement.  Cpu lists use the "0-7,16-23" syntax of
+ * --cpuset and of Linux's sysfs. */
+#define X264_CPUSET_MAX 1024
+typedef struct
+{
+    uint64_t mask[X264_CPUSET_MAX/64];
+} x264_cpuset_t;
+
+int  x264_cpuset_parse( x264_cpuset_t *set, const char *str );
+int  x264_cpuset_count( const x264_cpuset_t *set );
+void x264_cpuset_and( x264_cpuset_t *dst, const x264_cpuset_t *src );
+/* cpus the process may run on */
+void x264_cpu_get_affinity( x264_cpuset_t *set );
+/* restricts set to the NUMA node holding most of its cpus and returns that node,
+ * or -1 if there is a single node or the topology is unknown */
+int  x264_cpu_numa_node( x264_cpuset_t *set );
+/* pins the calling thread, -1 if unsupported */
+int  x264_cpu_set_thread_affinity( const x264_cpuset_t *set );
+/* places the pages of a buffer on node, or wherever they're first touched if unsupported */
+void x264_cpu_numa_bind( void *p, size_t size, int node );
 void     x264_safe_intel_cpu_indicator_init( void );
 
 /* kluge:
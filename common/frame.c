@@ -65,6 +65,14 @@ static int x264_frame_internal_csp( int external_csp )
     }
 }
 
+/* In node mode, frame planes are placed next to the encoder's threads before
+ * anything touches them. */
+static void x264_frame_numa_bind( x264_t *h, void *p, int size )
+{
+    if( h->i_numa_node >= 0 )
+        x264_cpu_numa_bind( p, size, h->i_numa_node );
+}
+
 static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
 {
     x264_frame_t *frame;
@@ -140,10 +148,12 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         int chroma_padv = i_padv >> (i_csp == X264_CSP_NV12);
         int chroma_plane_size = (frame->i_stride[1] * (frame->i_lines[1] + 2*chroma_padv));
         CHECKED_MALLOC( frame->buffer[1], chroma_plane_size * sizeof(pixel) );
+        x264_frame_numa_bind( h, frame->buffer[1], chroma_plane_size * sizeof(pixel) );
         frame->plane[1] = frame->buffer[1] + frame->i_stride[1] * chroma_padv + PADH;
         if( PARAM_INTERLACED )
         {
             CHECKED_MALLOC( frame->buffer_fld[1], chroma_plane_size * sizeof(pixel) );
+            x264_frame_numa_bind( h, frame->buffer_fld[1], chroma_plane_size * sizeof(pixel) );
             frame->plane_fld[1] = frame->buffer_fld[1] + frame->i_stride[1] * chroma_padv + PADH;
         }
     }
@@ -158,8 +168,12 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         {
             /* FIXME: Don't allocate both buffers in non-adaptive MBAFF. */
             CHECKED_MALLOC( frame->buffer[p], 4*luma_plane_size * sizeof(pixel) );
+            x264_frame_numa_bind( h, frame->buffer[p], 4*luma_plane_size * sizeof(pixel) );
             if( PARAM_INTERLACED )
+            {
                 CHECKED_MALLOC( frame->buffer_fld[p], 4*luma_plane_size * sizeof(pixel) );
+                x264_frame_numa_bind( h, frame->buffer_fld[p], 4*luma_plane_size * sizeof(pixel) );
+            }
             for( int i = 0; i < 4; i++ )
             {
                 frame->filtered[p][i] = frame->buffer[p] + i*luma_plane_size + frame->i_stride[p] * i_padv + PADH;
@@ -171,8 +185,12 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         else
         {
             CHECKED_MALLOC( frame->buffer[p], luma_plane_size * sizeof(pixel) );
+            x264_frame_numa_bind( h, frame->buffer[p], luma_plane_size * sizeof(pixel) );
             if( PARAM_INTERLACED )
+            {
                 CHECKED_MALLOC( frame->buffer_fld[p], luma_plane_size * sizeof(pixel) );
+                x264_frame_numa_bind( h, frame->buffer_fld[p], luma_plane_size * sizeof(pixel) );
+            }
             frame->filtered[p][0] = frame->plane[p] = frame->buffer[p] + frame->i_stride[p] * i_padv + PADH;
             frame->filtered_fld[p][0] = frame->plane_fld[p] = frame->buffer_fld[p] + frame->i_stride[p] * i_padv + PADH;
         }
@@ -220,6 +238,7 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
             int luma_plane_size = align_plane_size( frame->i_stride_lowres * (frame->i_lines[0]/2 + 2*PADV), disalign );
 
             CHECKED_MALLOC( frame->buffer_lowres[0], 4 * luma_plane_size * sizeof(pixel) );
+            x264_frame_numa_bind( h, frame->buffer_lowres[0], 4 * luma_plane_size * sizeof(pixel) );
             for( int i = 0; i < 4; i++ )
                 frame->lowres[i] = frame->buffer_lowres[0] + (frame->i_stride_lowres * PADV + PADH) + i * luma_plane_size;
 
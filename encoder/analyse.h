@@ -36,6 +36,10 @@ void x264_slicetype_decide( x264_t *h );
 
 void x264_slicetype_analyse( x264_t *h, int keyframe );
 
+/* used by checkasm --bench only */
+int  x264_slicetype_bench_frame_cost( x264_t *h, x264_frame_t **frames, int p0, int p1, int b );
+void x264_slicetype_bench_propagate( x264_t *h, x264_frame_t **frames, int p0, int p1, int b );
+
 int x264_weighted_reference_duplicate( x264_t *h, int i_ref, const x264_weight_t *w );
 
 int  x264_lookahead_init( x264_t *h, int i_slicetype_length );
@@ -383,11 +383,49 @@ fail:
     return -1;
 }
 
+/* Works out the cpus the encoder's threads may run on from --cpuset and, in
+ * node mode, the NUMA node which both threads and frames are kept on. */
+static int x264_encoder_affinity_init( x264_t *h )
+{
+    h->i_numa_node = -1;
+    if( !h->param.psz_cpuset && h->param.i_thread_affinity == X264_AFFINITY_NONE )
+        return 0;
+
+    x264_cpu_get_affinity( &h->cpuset );
+    if( h->param.psz_cpuset )
+    {
+        x264_cpuset_t set;
+        if( x264_cpuset_parse( &set, h->param.psz_cpuset ) < 0 )
+        {
+            x264_log( h, X264_LOG_ERROR, "invalid cpuset: %s\n", h->param.psz_cpuset );
+            return -1;
+        }
+        x264_cpuset_and( &h->cpuset, &set );
+    }
+    if( h->param.i_thread_affinity == X264_AFFINITY_NODE )
+        h->i_numa_node = x264_cpu_numa_node( &h->cpuset );
+    h->i_affinity_cpus = x264_cpuset_count( &h->cpuset );
+    if( !h->i_affinity_cpus )
+    {
+        x264_log( h, X264_LOG_ERROR, "cpuset contains none of the cpus this process may run on\n" );
+        return -1;
+    }
+    /* the calling thread is left alone, it belongs to the application */
+    h->b_affinity = HAVE_THREAD;
+    if( h->i_numa_node >= 0 )
+        x264_log( h, X264_LOG_DEBUG, "threads and frames placed on numa node %d, %d cpus\n", h->i_numa_node, h->i_affinity_cpus );
+    else
+        x264_log( h, X264_LOG_DEBUG, "threads placed on %d cpus\n", h->i_affinity_cpus );
+    return 0;
+}
+
 #if HAVE_THREAD
 static void x264_encoder_thread_init( x264_t *h )
 {
     if( h->param.i_sync_lookahead )
         x264_lower_thread_priority( 10 );
+    if( h->b_affinity )
+        x264_cpu_set_thread_affinity( &h->cpuset );
 
 #if HAVE_MMX
     /* Misalign mask has to be set separately for each thread. */
@@ -398,6 +436,8 @@ static void x264_encoder_thread_init( x264_t *h )
 
 static void x264_lookahead_thread_init( x264_t *h )
 {
+    if( h->b_affinity )
+        x264_cpu_set_thread_affinity( &h->cpuset );
 #if HAVE_MMX
     /* Misalign mask has to be set separately for each thread. */
     if( h->param.cpu&X264_CPU_SSE_MISALIGN )
@@ -502,7 +542,7 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     }
 
     if( h->param.i_threads == X264_THREADS_AUTO )
-        h->param.i_threads = x264_cpu_num_processors() * (h->param.b_sliced_threads?2:3)/2;
+        h->param.i_threads = (h->i_affinity_cpus ? h->i_affinity_cpus : x264_cpu_num_processors()) * (h->param.b_sliced_threads?2:3)/2;
     if( h->param.i_lookahead_threads == X264_THREADS_AUTO )
     {
         if( h->param.b_sliced_threads )
@@ -994,6 +1034,10 @@ static int x264_validate_parameters( x264_t *h, int b_open )
         h->param.i_nal_hrd = X264_NAL_HRD_VBR;
     }
 
+    /* CBR filler is encapsulated after the frame and would not be contiguous with it */
+    if( h->param.i_nal_hrd == X264_NAL_HRD_CBR || h->param.nalu_process )
+        h->param.nal_buffer_get = NULL;
+
     /* ensure the booleans are 0 or 1 so they can be used in math */
 #define BOOLIFY(x) h->param.x = !!h->param.x
     BOOLIFY( b_cabac );
@@ -1148,6 +1192,9 @@ x264_t *x264_encoder_open( x264_param_t *param )
         goto fail;
     }
 
+    if( x264_encoder_affinity_init( h ) < 0 )
+        goto fail;
+
     if( x264_validate_parameters( h, 1 ) < 0 )
         goto fail;
 
@@ -1346,6 +1393,7 @@ x264_t *x264_encoder_open( x264_param_t *param )
         int allocate_threadlocal_data = !h->param.b_sliced_threads || !i;
         if( i > 0 )
             *h->thread[i] = *h;
+        h->thread[i]->i_thread_idx = i;
 
         if( x264_pthread_mutex_init( &h->thread[i]->mutex, NULL ) )
             goto fail;
@@ -1571,7 +1619,7 @@ static int x264_nal_end( x264_t *h )
     return x264_nal_check_buffer( h );
 }
 
-static int x264_encoder_encapsulate_nals( x264_t *h, int start )
+static int x264_encoder_encapsulate_nals( x264_t *h, int start, void *opaque )
 {
     int nal_size = 0, previous_nal_size = 0;
 
@@ -1582,27 +1630,37 @@ static int x264_encoder_encapsulate_nals( x264_t *h, int start )
         return nal_size;
     }
 
-    for( int i = 0; i < start; i++ )
-        previous_nal_size += h->out.nal[i].i_payload;
-
     for( int i = start; i < h->out.i_nal; i++ )
         nal_size += h->out.nal[i].i_payload;
 
-    /* Worst-case NAL unit escaping: reallocate the buffer if it's too small. */
-    int necessary_size = nal_size * 3/2 + h->out.i_nal * 4;
-    if( h->nal_buffer_size < necessary_size )
+    /* Encapsulate straight into the caller's buffer if it provides one, so the
+     * escaped NAL data is written only once. */
+    uint8_t *nal_start = NULL;
+    if( h->param.nal_buffer_get && nal_size )
+        nal_start = h->param.nal_buffer_get( h, nal_size * 3/2 + (h->out.i_nal - start) * 5 + 16, opaque );
+
+    if( !nal_start )
     {
-        h->nal_buffer_size = necessary_size * 2;
-        uint8_t *buf = x264_malloc( h->nal_buffer_size );
-        if( !buf )
-            return -1;
-        if( previous_nal_size )
-            memcpy( buf, h->nal_buffer, previous_nal_size );
-        x264_free( h->nal_buffer );
-        h->nal_buffer = buf;
+        for( int i = 0; i < start; i++ )
+            previous_nal_size += h->out.nal[i].i_payload;
+
+        /* Worst-case NAL unit escaping: reallocate the buffer if it's too small. */
+        int necessary_size = nal_size * 3/2 + h->out.i_nal * 4;
+        if( h->nal_buffer_size < necessary_size )
+        {
+            h->nal_buffer_size = necessary_size * 2;
+            uint8_t *buf = x264_malloc( h->nal_buffer_size );
+            if( !buf )
+                return -1;
+            if( previous_nal_size )
+                memcpy( buf, h->nal_buffer, previous_nal_size );
+            x264_free( h->nal_buffer );
+            h->nal_buffer = buf;
+        }
+        nal_start = h->nal_buffer + previous_nal_size;
     }
 
-    uint8_t *nal_buffer = h->nal_buffer + previous_nal_size;
+    uint8_t *nal_buffer = nal_start;
 
     for( int i = start; i < h->out.i_nal; i++ )
     {
@@ -1613,7 +1671,7 @@ static int x264_encoder_encapsulate_nals( x264_t *h, int start )
 
     x264_emms();
 
-    return nal_buffer - (h->nal_buffer + previous_nal_size);
+    return nal_buffer - nal_start;
 }
 
 /****************************************************************************
@@ -1647,7 +1705,7 @@ int x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
     if( x264_nal_end( h ) )
         return -1;
 
-    frame_size = x264_encoder_encapsulate_nals( h, 0 );
+    frame_size = x264_encoder_encapsulate_nals( h, 0, NULL );
     if( frame_size < 0 )
         return -1;
 
@@ -1962,6 +2020,8 @@ static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
     if( min_y < h->i_threadslice_start )
         return;
 
+    X264_TRACE( h, X264_TRACE_FILTER, 0, h->fenc->i_frame, min_y, h->i_thread_idx );
+
     if( b_deblock )
         for( int y = min_y; y < mb_y; y += (1 << SLICE_MBAFF) )
             x264_frame_deblock_row( h, y );
@@ -2037,6 +2097,8 @@ static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
             h->stat.frame.i_ssim_cnt += ssim_cnt;
         }
     }
+
+    X264_TRACE( h, X264_TRACE_FILTER, 1, h->fenc->i_frame, min_y, h->i_thread_idx );
 }
 
 static inline int x264_reference_update( x264_t *h )
@@ -2258,6 +2320,7 @@ static int x264_slice_write( x264_t *h )
     int orig_last_mb = h->sh.i_last_mb;
     uint8_t *last_emu_check;
     x264_bs_bak_t bs_bak[2];
+    int trace_row = -1;
     b_deblock &= b_hpel || h->param.b_full_recon || h->param.psz_dump_yuv;
     bs_realign( &h->out.bs );
 
@@ -2310,6 +2373,12 @@ static int x264_slice_write( x264_t *h )
                 x264_fdec_filter_row( h, i_mb_y, 0 );
         }
 
+        if( h->param.pf_trace && trace_row < 0 )
+        {
+            trace_row = i_mb_y & ~SLICE_MBAFF;
+            x264_trace( h, X264_TRACE_ROW, 0, h->fenc->i_frame, trace_row, h->i_thread_idx );
+        }
+
         if( !(i_mb_y & SLICE_MBAFF) && back_up_bitstream )
             x264_bitstream_backup( h, &bs_bak[0], i_skip, 0 );
 
@@ -2528,8 +2597,15 @@ reencode:
         {
             i_mb_y++;
             i_mb_x = 0;
+            if( trace_row >= 0 )
+            {
+                x264_trace( h, X264_TRACE_ROW, 1, h->fenc->i_frame, trace_row, h->i_thread_idx );
+                trace_row = -1;
+            }
         }
     }
+    if( trace_row >= 0 )
+        x264_trace( h, X264_TRACE_ROW, 1, h->fenc->i_frame, trace_row, h->i_thread_idx );
     h->out.nal[h->out.i_nal].i_last_mb = h->sh.i_last_mb;
 
     if( h->param.b_cabac )
@@ -2622,6 +2698,8 @@ static void *x264_slices_write( x264_t *h )
             goto fail;
 #endif
 
+    X264_TRACE( h, X264_TRACE_FRAME, 0, h->fenc->i_frame, -1, h->i_thread_idx );
+
     /* init stats */
     memset( &h->stat.frame, 0, sizeof(h->stat.frame) );
     h->mb.b_reencode_mb = 0;
@@ -2667,6 +2745,7 @@ static void *x264_slices_write( x264_t *h )
     }
 #endif
 
+    X264_TRACE( h, X264_TRACE_FRAME, 1, h->fenc->i_frame, -1, h->i_thread_idx );
     return (void *)0;
 
 fail:
@@ -2820,12 +2899,14 @@ int     x264_encoder_encode( x264_t *h,
         if( !fenc )
             return -1;
 
+        X264_TRACE( h, X264_TRACE_INPUT, 0, h->frames.i_input, -1, X264_TRACE_THREAD_API );
         if( x264_frame_copy_picture( h, fenc, pic_in ) < 0 )
             return -1;
 
         if( h->param.i_width != 16 * h->mb.i_mb_width ||
             h->param.i_height != 16 * h->mb.i_mb_height )
             x264_frame_expand_border_mod16( h, fenc );
+        X264_TRACE( h, X264_TRACE_INPUT, 1, h->frames.i_input, -1, X264_TRACE_THREAD_API );
 
         fenc->i_frame = h->frames.i_input++;
 
@@ -3302,7 +3383,9 @@ static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
         h->out.nal[idx] = nal_tmp;
     }
 
-    int frame_size = x264_encoder_encapsulate_nals( h, 0 );
+    X264_TRACE( h, X264_TRACE_ENCAPSULATE, 0, h->fenc->i_frame, -1, X264_TRACE_THREAD_API );
+    int frame_size = x264_encoder_encapsulate_nals( h, 0, h->fenc->opaque );
+    X264_TRACE( h, X264_TRACE_ENCAPSULATE, 1, h->fenc->i_frame, -1, X264_TRACE_THREAD_API );
     if( frame_size < 0 )
         return -1;
 
@@ -3362,7 +3445,7 @@ static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
         x264_filler_write( h, &h->out.bs, f );
         if( x264_nal_end( h ) )
             return -1;
-        int total_size = x264_encoder_encapsulate_nals( h, h->out.i_nal-1 );
+        int total_size = x264_encoder_encapsulate_nals( h, h->out.i_nal-1, NULL );
         if( total_size < 0 )
             return -1;
         frame_size += total_size;
@@ -67,7 +67,10 @@ static void x264_lookahead_update_last_nonb( x264_t *h, x264_frame_t *new_nonb )
 #if HAVE_THREAD
 static void x264_lookahead_slicetype_decide( x264_t *h )
 {
+    int i_frame = h->lookahead->next.list[0]->i_frame;
+    X264_TRACE( h, X264_TRACE_SLICETYPE, 0, i_frame, -1, X264_TRACE_THREAD_LOOKAHEAD );
     x264_stack_align( x264_slicetype_decide, h );
+    X264_TRACE( h, X264_TRACE_SLICETYPE, 1, i_frame, -1, X264_TRACE_THREAD_LOOKAHEAD );
 
     x264_lookahead_update_last_nonb( h, h->lookahead->next.list[0] );
 
@@ -89,6 +92,8 @@ static void x264_lookahead_slicetype_decide( x264_t *h )
 static void *x264_lookahead_thread( x264_t *h )
 {
     int shift;
+    if( h->b_affinity )
+        x264_cpu_set_thread_affinity( &h->cpuset );
 #if HAVE_MMX
     if( h->param.cpu&X264_CPU_SSE_MISALIGN )
         x264_cpu_mask_misalign_sse();
@@ -234,7 +239,10 @@ void x264_lookahead_get_frames( x264_t *h )
         if( h->frames.current[0] || !h->lookahead->next.i_size )
             return;
 
+        int i_frame = h->lookahead->next.list[0]->i_frame;
+        X264_TRACE( h, X264_TRACE_SLICETYPE, 0, i_frame, -1, X264_TRACE_THREAD_API );
         x264_stack_align( x264_slicetype_decide, h );
+        X264_TRACE( h, X264_TRACE_SLICETYPE, 1, i_frame, -1, X264_TRACE_THREAD_API );
         x264_lookahead_update_last_nonb( h, h->lookahead->next.list[0] );
         x264_lookahead_shift( &h->lookahead->ofbuf, &h->lookahead->next, h->lookahead->next.list[0]->i_bframes + 1 );
 
@@ -1442,10 +1442,16 @@ void x264_slicetype_analyse( x264_t *h, int keyframe )
 
     x264_lowres_context_init( h, &a );
 
+    int trace_thread = h->param.i_sync_lookahead ? X264_TRACE_THREAD_LOOKAHEAD : X264_TRACE_THREAD_API;
+
     if( !framecnt )
     {
         if( h->param.rc.b_mb_tree )
+        {
+            X264_TRACE( h, X264_TRACE_MBTREE, 0, frames[0]->i_frame, -1, trace_thread );
             x264_macroblock_tree( h, &a, frames, 0, keyframe );
+            X264_TRACE( h, X264_TRACE_MBTREE, 1, frames[0]->i_frame, -1, trace_thread );
+        }
         return;
     }
 
@@ -1680,7 +1686,11 @@ void x264_slicetype_analyse( x264_t *h, int keyframe )
     /* Perform the actual macroblock tree analysis.
      * Don't go farther than the maximum keyframe interval; this helps in short GOPs. */
     if( h->param.rc.b_mb_tree )
+    {
+        X264_TRACE( h, X264_TRACE_MBTREE, 0, frames[1]->i_frame, -1, trace_thread );
         x264_macroblock_tree( h, &a, frames, X264_MIN(num_frames, h->param.i_keyint_max), keyframe );
+        X264_TRACE( h, X264_TRACE_MBTREE, 1, frames[1]->i_frame, -1, trace_thread );
+    }
 
     if( vbv_lookahead )
         x264_vbv_lookahead( h, &a, frames, num_frames, keyframe );
@@ -1987,3 +1997,26 @@ int x264_rc_analyse_slice( x264_t *h )
 
     return cost >> (BIT_DEPTH - 8);
 }
+
+/* Entry points for checkasm's stage benchmarks: run one lookahead cost pass or
+ * one MB-tree propagation over frames already prepared with x264_frame_init_lowres. */
+int x264_slicetype_bench_frame_cost( x264_t *h, x264_frame_t **frames, int p0, int p1, int b )
+{
+    x264_mb_analysis_t a;
+    x264_lowres_context_init( h, &a );
+    /* forget any earlier result so that the full search is redone */
+    frames[b]->i_cost_est[b-p0][p1-b] = -1;
+    if( b != p0 )
+        frames[b]->lowres_mvs[0][b-p0-1][0][0] = 0x7FFF;
+    if( b != p1 )
+        frames[b]->lowres_mvs[1][p1-b-1][0][0] = 0x7FFF;
+    frames[b]->b_intra_calculated = 0;
+    return x264_slicetype_frame_cost( h, &a, frames, p0, p1, b, 0 );
+}
+
+void x264_slicetype_bench_propagate( x264_t *h, x264_frame_t **frames, int p0, int p1, int b )
+{
+    memset( frames[p0]->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+    memset( frames[b]->i_propagate_cost, 0, h->mb.i_mb_count * sizeof(uint16_t) );
+    x264_macroblock_tree_propagate( h, frames, frames[b]->f_duration, p0, p1, b, 1 );
+}
@@ -23,6 +23,9 @@ audio_filter_t *x264_af_get_filter( char *name )
 #if HAVE_LSMASH
     CHECK( lsmash );
 #endif
+    CHECK( resample );
+    CHECK( mix );
+    CHECK( gain );
 #undef CHECKFLT
 #undef CHECK
 #endif /* HAVE_AUDIO */
@@ -36,11 +39,25 @@ audio_packet_t *x264_af_get_samples( hnd_t handle, int64_t first_sample, int64_t
     if( out )
     {
         out->owner = h;
+        if( !h->prev && h->pool )
+            h->pool->samples += out->samplecount;
         return out;
     }
     return 0;
 }
 
+audio_packet_t *x264_af_alloc_packet( int size )
+{
+    audio_packet_t *pkt = malloc( sizeof( audio_packet_t ) + size );
+    if( !pkt )
+        return NULL;
+    memset( pkt, 0, sizeof( audio_packet_t ) );
+    pkt->data  = (uint8_t*)(pkt + 1);
+    pkt->size  = size;
+    pkt->flags = AUDIO_FLAG_INLINE;
+    return pkt;
+}
+
 void x264_af_free_packet( audio_packet_t *pkt )
 {
     if( !pkt )
@@ -52,7 +69,7 @@ void x264_af_free_packet( audio_packet_t *pkt )
     {
         if( pkt->priv )
             free( pkt->priv );
-        if( pkt->data )
+        if( pkt->data && !(pkt->flags & AUDIO_FLAG_INLINE) )
             free( pkt->data );
         if( pkt->samples && pkt->channels )
             x264_af_free_buffer( pkt->samples, pkt->channels );
@@ -65,5 +82,16 @@ void x264_af_close( hnd_t chain )
     audio_hnd_t *h = chain;
     if( h->prev )
         x264_af_close( h->prev );
+    else if( h->pool )
+    {
+        audio_pool_t *pool = h->pool;
+        if( pool->requests && pool->samples && h->info.samplerate > 0 )
+        {
+            double seconds = (double)pool->samples / h->info.samplerate;
+            AF_LOG( h, X264_LOG_DEBUG, "%"PRIu64" sample buffers requested, %"PRIu64" allocated (%.2f per second of audio)\n",
+                    pool->requests, pool->allocs, pool->allocs / seconds );
+        }
+        x264_af_pool_close( pool );
+    }
     h->self->close( h );
 }
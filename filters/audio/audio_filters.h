@@ -34,7 +34,8 @@
 enum AudioFlags
 {
     AUDIO_FLAG_NONE = 0,
-    AUDIO_FLAG_EOF = 1
+    AUDIO_FLAG_EOF = 1,
+    AUDIO_FLAG_INLINE = 2   // data lives in the packet's own allocation, see x264_af_alloc_packet
 };
 
 #define INVALID_DTS (INT64_MIN)
@@ -108,10 +109,19 @@ static inline int64_t x264_convert_timebase( int64_t i, timebase_t from, timebas
 {
     if( !from.den || !to.num )
         return 0;
-    double j = i;
-    if( from.den > to.num )
-        return (int64_t)( j * from.num * to.den / to.num / from.den );
-    return (int64_t)( j * from.num * to.den / from.den / to.num );
+    /* i * b / c, truncated, without going through doubles */
+    int64_t b = from.num * to.den, c = from.den * to.num;
+    int64_t div = (int64_t)gcd( b < 0 ? -b : b, c < 0 ? -c : c );
+    b /= div;
+    c /= div;
+#ifdef __SIZEOF_INT128__
+    return (int64_t)((__int128)i * b / c);
+#else
+    /* i = q*c + r and b = bq*c + br: only r * br, below c * c, is left to divide,
+     * so this is exact as long as c is below 2^31 */
+    int64_t r = i % c;
+    return i / c * b + r * (b / c) + r * (b % c) / c;
+#endif
 }
 
 static inline int64_t x264_to_timebase( int64_t i, int64_t scale, timebase_t to )
@@ -126,9 +136,13 @@ static inline int64_t x264_from_timebase( int64_t i, timebase_t from, int64_t sc
 
 #include "audio/audio.h"
 
+/* picks the sample conversion kernels for the cpu flags, before any audio is opened */
+void x264_af_set_cpu( int cpu );
 audio_info_t *x264_af_get_info( hnd_t handle );
 audio_filter_t *x264_af_get_filter( char *name );
 audio_packet_t *x264_af_get_samples( hnd_t handle, int64_t first_sample, int64_t last_sample );
+/* allocates a packet together with room for size bytes of data, freed along with it */
+audio_packet_t *x264_af_alloc_packet( int size );
 void x264_af_free_packet( audio_packet_t *pkt );
 void x264_af_close( hnd_t chain );
 
@@ -0,0 +1,587 @@
+#include "filters/audio/internal.h"
+#include <math.h>
+
+#if (ARCH_X86 || ARCH_X86_64) && defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_AF_SSE2 1
+#else
+#define HAVE_AF_SSE2 0
+#endif
+
+#define CLIPFUN( num, type, min, max )                                  \
+    static inline type clip##num( int64_t i ) {                         \
+        return (type)( ( i > max ) ? max : ( ( i < min ) ? min : i ) ); \
+    }
+CLIPFUN( 8,  uint8_t, 0,         UINT8_MAX )
+CLIPFUN( 16, int16_t, INT16_MIN, INT16_MAX )
+CLIPFUN( 32, int32_t, INT32_MIN, INT32_MAX )
+#undef CLIPFUN
+
+/* Float to integer conversions saturate before rounding, so that values far
+ * out of range (and infinities) don't wrap around in lrintf. */
+#define CONVERT( iname, itype, oname, otype, expr )                             \
+static void convert_##iname##_##oname##_c( void *dst, const void *src, int n )  \
+{                                                                               \
+    const itype *in = src;                                                      \
+    otype *out = dst;                                                           \
+    for( int i = 0; i < n; i++ )                                                \
+        out[i] = (otype)(expr);                                                 \
+}
+#define INPUT in[i]
+#define SAT( min, max ) x264_clip3f( INPUT * (max + 1.0), min, max )
+
+CONVERT( u8,  uint8_t, s16, int16_t, (INPUT - 0x80) << 8 )
+CONVERT( u8,  uint8_t, s32, int32_t, (INPUT - 0x80) << 24 )
+CONVERT( u8,  uint8_t, flt, float,   (INPUT - 0x80) * (1.0 / (1<<7)) )
+CONVERT( u8,  uint8_t, dbl, double,  (INPUT - 0x80) * (1.0 / (1<<7)) )
+CONVERT( s16, int16_t, u8,  uint8_t, (INPUT >> 8) + 0x80 )
+CONVERT( s16, int16_t, s32, int32_t,  INPUT << 16 )
+CONVERT( s16, int16_t, flt, float,    INPUT * (1.0 / (1<<15)) )
+CONVERT( s16, int16_t, dbl, double,   INPUT * (1.0 / (1<<15)) )
+CONVERT( s32, int32_t, u8,  uint8_t, (INPUT >> 24) + 0x80 )
+CONVERT( s32, int32_t, s16, int16_t,  INPUT >> 16 )
+CONVERT( s32, int32_t, flt, float,    INPUT * (1.0 / (1U<<31)) )
+CONVERT( s32, int32_t, dbl, double,   INPUT * (1.0 / (1U<<31)) )
+CONVERT( flt, float,   u8,  uint8_t,  clip8( lrintf(  SAT( INT8_MIN,  INT8_MAX ) ) + 0x80 ) )
+CONVERT( flt, float,   s16, int16_t, clip16( lrintf(  SAT( INT16_MIN, INT16_MAX ) ) ) )
+CONVERT( flt, float,   s32, int32_t, clip32( llrintf( SAT( INT32_MIN, INT32_MAX ) ) ) )
+CONVERT( flt, float,   dbl, double,   INPUT )
+CONVERT( dbl, double,  u8,  uint8_t,  clip8( lrintf(  SAT( INT8_MIN,  INT8_MAX ) ) + 0x80 ) )
+CONVERT( dbl, double,  s16, int16_t, clip16( lrintf(  SAT( INT16_MIN, INT16_MAX ) ) ) )
+CONVERT( dbl, double,  s32, int32_t, clip32( llrintf( SAT( INT32_MIN, INT32_MAX ) ) ) )
+CONVERT( dbl, double,  flt, float,    INPUT )
+#undef SAT
+#undef INPUT
+#undef CONVERT
+
+static void interleave_c( float *dst, float **src, unsigned channels, unsigned samplecount )
+{
+    for( int c = 0; c < channels; c++ )
+        for( int s = 0; s < samplecount; s++ )
+            dst[s*channels + c] = src[c][s];
+}
+
+static void deinterleave_c( float **dst, const float *src, unsigned channels, unsigned samplecount )
+{
+    for( int c = 0; c < channels; c++ )
+        for( int s = 0; s < samplecount; s++ )
+            dst[c][s] = src[s*channels + c];
+}
+
+static float dot_c( const float *a, const float *b, int n )
+{
+    float sum = 0;
+    for( int i = 0; i < n; i++ )
+        sum += a[i] * b[i];
+    return sum;
+}
+
+static void scale_c( float *dst, const float *src, float gain, int n )
+{
+    for( int i = 0; i < n; i++ )
+        dst[i] = src[i] * gain;
+}
+
+static void mac_c( float *dst, const float *src, float gain, int n )
+{
+    for( int i = 0; i < n; i++ )
+        dst[i] += src[i] * gain;
+}
+
+#if HAVE_AF_SSE2
+/* The kernels work and leave the remaining samples to the C
+ * versions.  Nothing here assumes aligned buffers, as callers hand out slices. */
+#define TAIL( iname, itype, oname, otype ) \
+    convert_##iname##_##oname##_c( (otype*)dst + i, (const itype*)src + i, n - i )
+
+#define LOADU( p )      _mm_loadu_si128( (const __m128i*)(p) )
+#define STOREU( p, v )  _mm_storeu_si128( (__m128i*)(p), v )
+
+/* the first or last 4 of the 8 low bytes of v as signed int32 lanes, shifted up by 24 */
+static inline __m128i u8_to_s32( __m128i v, int hi )
+{
+    const __m128i zero = _mm_setzero_si128();
+    v = _mm_unpacklo_epi8( zero, _mm_xor_si128( v, _mm_set1_epi8( 0x80 ) ) );
+    return hi ? _mm_unpackhi_epi16( zero, v ) : _mm_unpacklo_epi16( zero, v );
+}
+
+static inline __m128i s16_to_s32( __m128i v, int hi )
+{
+    v = hi ? _mm_unpackhi_epi16( v, v ) : _mm_unpacklo_epi16( v, v );
+    return _mm_srai_epi32( v, 16 );
+}
+
+static inline __m128i pack_s32_u8( __m128i a, __m128i b )
+{
+    a = _mm_packs_epi32( a, b );
+    return _mm_xor_si128( _mm_packs_epi16( a, a ), _mm_set1_epi8( 0x80 ) );
+}
+
+/* saturated and rounded to nearest like lrintf, max+1 is the scale */
+static inline __m128i flt_to_s32( __m128 v, float min, float max )
+{
+    v = _mm_mul_ps( v, _mm_set1_ps( max + 1.0f ) );
+    v = _mm_min_ps( _mm_max_ps( v, _mm_set1_ps( min ) ), _mm_set1_ps( max ) );
+    return _mm_cvtps_epi32( v );
+}
+
+/* INT32_MAX isn't representable as a float: cvtps2dq returns 0x80000000 for
+ * anything from 2^31 up, which gets flipped to 0x7fffffff */
+static inline __m128i flt_to_s32_full( __m128 v )
+{
+    v = _mm_mul_ps( v, _mm_set1_ps( 2147483648.0f ) );
+    __m128i over = _mm_castps_si128( _mm_cmpge_ps( v, _mm_set1_ps( 2147483648.0f ) ) );
+    return _mm_xor_si128( _mm_cvtps_epi32( v ), over );
+}
+
+static inline __m128 dbl_to_flt( const double *p )
+{
+    return _mm_movelh_ps( _mm_cvtpd_ps( _mm_loadu_pd( p ) ), _mm_cvtpd_ps( _mm_loadu_pd( p + 2 ) ) );
+}
+
+static inline void s32_to_dbl( double *p, __m128i v, double scale )
+{
+    __m128d s = _mm_set1_pd( scale );
+    _mm_storeu_pd( p,     _mm_mul_pd( _mm_cvtepi32_pd( v ), s ) );
+    _mm_storeu_pd( p + 2, _mm_mul_pd( _mm_cvtepi32_pd( _mm_shuffle_epi32( v, 0xee ) ), s ) );
+}
+
+static void convert_u8_s16_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = _mm_xor_si128( _mm_loadl_epi64( (const __m128i*)((const uint8_t*)src + i) ), _mm_set1_epi8( 0x80 ) );
+        STOREU( (int16_t*)dst + i, _mm_unpacklo_epi8( _mm_setzero_si128(), v ) );
+    }
+    TAIL( u8, uint8_t, s16, int16_t );
+}
+
+static void convert_u8_s32_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = _mm_loadl_epi64( (const __m128i*)((const uint8_t*)src + i) );
+        STOREU( (int32_t*)dst + i,     u8_to_s32( v, 0 ) );
+        STOREU( (int32_t*)dst + i + 4, u8_to_s32( v, 1 ) );
+    }
+    TAIL( u8, uint8_t, s32, int32_t );
+}
+
+static void convert_u8_flt_sse2( void *dst, const void *src, int n )
+{
+    const __m128 scale = _mm_set1_ps( 1.0f / (1U<<31) );
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = _mm_loadl_epi64( (const __m128i*)((const uint8_t*)src + i) );
+        _mm_storeu_ps( (float*)dst + i,     _mm_mul_ps( _mm_cvtepi32_ps( u8_to_s32( v, 0 ) ), scale ) );
+        _mm_storeu_ps( (float*)dst + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( u8_to_s32( v, 1 ) ), scale ) );
+    }
+    TAIL( u8, uint8_t, flt, float );
+}
+
+static void convert_u8_dbl_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = _mm_loadl_epi64( (const __m128i*)((const uint8_t*)src + i) );
+        s32_to_dbl( (double*)dst + i,     u8_to_s32( v, 0 ), 1.0 / (1U<<31) );
+        s32_to_dbl( (double*)dst + i + 4, u8_to_s32( v, 1 ), 1.0 / (1U<<31) );
+    }
+    TAIL( u8, uint8_t, dbl, double );
+}
+
+static void convert_s16_u8_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = _mm_srai_epi16( LOADU( (const int16_t*)src + i ), 8 );
+        v = _mm_xor_si128( _mm_packs_epi16( v, v ), _mm_set1_epi8( 0x80 ) );
+        _mm_storel_epi64( (__m128i*)((uint8_t*)dst + i), v );
+    }
+    TAIL( s16, int16_t, u8, uint8_t );
+}
+
+static void convert_s16_s32_sse2( void *dst, const void *src, int n )
+{
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = LOADU( (const int16_t*)src + i );
+        STOREU( (int32_t*)dst + i,     _mm_unpacklo_epi16( zero, v ) );
+        STOREU( (int32_t*)dst + i + 4, _mm_unpackhi_epi16( zero, v ) );
+    }
+    TAIL( s16, int16_t, s32, int32_t );
+}
+
+static void convert_s16_flt_sse2( void *dst, const void *src, int n )
+{
+    const __m128 scale = _mm_set1_ps( 1.0f / (1<<15) );
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = LOADU( (const int16_t*)src + i );
+        _mm_storeu_ps( (float*)dst + i,     _mm_mul_ps( _mm_cvtepi32_ps( s16_to_s32( v, 0 ) ), scale ) );
+        _mm_storeu_ps( (float*)dst + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( s16_to_s32( v, 1 ) ), scale ) );
+    }
+    TAIL( s16, int16_t, flt, float );
+}
+
+static void convert_s16_dbl_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i v = LOADU( (const int16_t*)src + i );
+        s32_to_dbl( (double*)dst + i,     s16_to_s32( v, 0 ), 1.0 / (1<<15) );
+        s32_to_dbl( (double*)dst + i + 4, s16_to_s32( v, 1 ), 1.0 / (1<<15) );
+    }
+    TAIL( s16, int16_t, dbl, double );
+}
+
+static void convert_s32_u8_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i a = _mm_srai_epi32( LOADU( (const int32_t*)src + i ), 24 );
+        __m128i b = _mm_srai_epi32( LOADU( (const int32_t*)src + i + 4 ), 24 );
+        _mm_storel_epi64( (__m128i*)((uint8_t*)dst + i), pack_s32_u8( a, b ) );
+    }
+    TAIL( s32, int32_t, u8, uint8_t );
+}
+
+static void convert_s32_s16_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m128i a = _mm_srai_epi32( LOADU( (const int32_t*)src + i ), 16 );
+        __m128i b = _mm_srai_epi32( LOADU( (const int32_t*)src + i + 4 ), 16 );
+        STOREU( (int16_t*)dst + i, _mm_packs_epi32( a, b ) );
+    }
+    TAIL( s32, int32_t, s16, int16_t );
+}
+
+static void convert_s32_flt_sse2( void *dst, const void *src, int n )
+{
+    const __m128 scale = _mm_set1_ps( 1.0f / (1U<<31) );
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( (float*)dst + i, _mm_mul_ps( _mm_cvtepi32_ps( LOADU( (const int32_t*)src + i ) ), scale ) );
+    TAIL( s32, int32_t, flt, float );
+}
+
+static void convert_s32_dbl_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        s32_to_dbl( (double*)dst + i, LOADU( (const int32_t*)src + i ), 1.0 / (1U<<31) );
+    TAIL( s32, int32_t, dbl, double );
+}
+
+#define FLT_KERNELS( iname, itype, LOAD )                                           \
+static void convert_##iname##_u8_sse2( void *dst, const void *src, int n )          \
+{                                                                                   \
+    int i = 0;                                                                      \
+    for( ; i + 8 <= n; i += 8 )                                                     \
+    {                                                                               \
+        __m128i a = flt_to_s32( LOAD( (const itype*)src + i ), INT8_MIN, INT8_MAX );     \
+        __m128i b = flt_to_s32( LOAD( (const itype*)src + i + 4 ), INT8_MIN, INT8_MAX ); \
+        _mm_storel_epi64( (__m128i*)((uint8_t*)dst + i), pack_s32_u8( a, b ) );     \
+    }                                                                               \
+    TAIL( iname, itype, u8, uint8_t );                                              \
+}                                                                                   \
+static void convert_##iname##_s16_sse2( void *dst, const void *src, int n )         \
+{                                                                                   \
+    int i = 0;                                                                      \
+    for( ; i + 8 <= n; i += 8 )                                                     \
+    {                                                                               \
+        __m128i a = flt_to_s32( LOAD( (const itype*)src + i ), INT16_MIN, INT16_MAX );     \
+        __m128i b = flt_to_s32( LOAD( (const itype*)src + i + 4 ), INT16_MIN, INT16_MAX ); \
+        STOREU( (int16_t*)dst + i, _mm_packs_epi32( a, b ) );                       \
+    }                                                                               \
+    TAIL( iname, itype, s16, int16_t );                                             \
+}                                                                                   \
+static void convert_##iname##_s32_sse2( void *dst, const void *src, int n )         \
+{                                                                                   \
+    int i = 0;                                                                      \
+    for( ; i + 4 <= n; i += 4 )                                                     \
+        STOREU( (int32_t*)dst + i, flt_to_s32_full( LOAD( (const itype*)src + i ) ) ); \
+    TAIL( iname, itype, s32, int32_t );                                             \
+}
+
+FLT_KERNELS( flt, float, _mm_loadu_ps )
+FLT_KERNELS( dbl, double, dbl_to_flt )
+#undef FLT_KERNELS
+
+static void convert_flt_dbl_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        __m128 v = _mm_loadu_ps( (const float*)src + i );
+        _mm_storeu_pd( (double*)dst + i,     _mm_cvtps_pd( v ) );
+        _mm_storeu_pd( (double*)dst + i + 2, _mm_cvtps_pd( _mm_movehl_ps( v, v ) ) );
+    }
+    TAIL( flt, float, dbl, double );
+}
+
+static void convert_dbl_flt_sse2( void *dst, const void *src, int n )
+{
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( (float*)dst + i, dbl_to_flt( (const double*)src + i ) );
+    TAIL( dbl, double, flt, float );
+}
+#undef TAIL
+#undef LOADU
+#undef STOREU
+
+/* The channel count of the dedicated layouts is implied, 4 sample frames are
+ * transposed at a time. */
+static void interleave_2ch_sse2( float *dst, float **src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, dst += 8 )
+    {
+        __m128 l = _mm_loadu_ps( src[0] + s );
+        __m128 r = _mm_loadu_ps( src[1] + s );
+        _mm_storeu_ps( dst,     _mm_unpacklo_ps( l, r ) );
+        _mm_storeu_ps( dst + 4, _mm_unpackhi_ps( l, r ) );
+    }
+    float *tail[2] = { src[0] + s, src[1] + s };
+    interleave_c( dst, tail, 2, samplecount - s );
+}
+
+static void interleave_6ch_sse2( float *dst, float **src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, dst += 24 )
+    {
+        __m128 c0 = _mm_loadu_ps( src[0] + s );
+        __m128 c1 = _mm_loadu_ps( src[1] + s );
+        __m128 c2 = _mm_loadu_ps( src[2] + s );
+        __m128 c3 = _mm_loadu_ps( src[3] + s );
+        __m128 c4 = _mm_loadu_ps( src[4] + s );
+        __m128 c5 = _mm_loadu_ps( src[5] + s );
+        _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+        __m128 lo = _mm_unpacklo_ps( c4, c5 );
+        __m128 hi = _mm_unpackhi_ps( c4, c5 );
+        _mm_storeu_ps( dst,      c0 );
+        _mm_storel_pi( (__m64*)(dst + 4),  lo );
+        _mm_storeu_ps( dst + 6,  c1 );
+        _mm_storeh_pi( (__m64*)(dst + 10), lo );
+        _mm_storeu_ps( dst + 12, c2 );
+        _mm_storel_pi( (__m64*)(dst + 16), hi );
+        _mm_storeu_ps( dst + 18, c3 );
+        _mm_storeh_pi( (__m64*)(dst + 22), hi );
+    }
+    float *tail[6];
+    x264_af_slice_buffer( tail, src, 6, s );
+    interleave_c( dst, tail, 6, samplecount - s );
+}
+
+static void interleave_8ch_sse2( float *dst, float **src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, dst += 32 )
+    {
+        __m128 c0 = _mm_loadu_ps( src[0] + s );
+        __m128 c1 = _mm_loadu_ps( src[1] + s );
+        __m128 c2 = _mm_loadu_ps( src[2] + s );
+        __m128 c3 = _mm_loadu_ps( src[3] + s );
+        __m128 c4 = _mm_loadu_ps( src[4] + s );
+        __m128 c5 = _mm_loadu_ps( src[5] + s );
+        __m128 c6 = _mm_loadu_ps( src[6] + s );
+        __m128 c7 = _mm_loadu_ps( src[7] + s );
+        _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+        _MM_TRANSPOSE4_PS( c4, c5, c6, c7 );
+        _mm_storeu_ps( dst,      c0 );
+        _mm_storeu_ps( dst + 4,  c4 );
+        _mm_storeu_ps( dst + 8,  c1 );
+        _mm_storeu_ps( dst + 12, c5 );
+        _mm_storeu_ps( dst + 16, c2 );
+        _mm_storeu_ps( dst + 20, c6 );
+        _mm_storeu_ps( dst + 24, c3 );
+        _mm_storeu_ps( dst + 28, c7 );
+    }
+    float *tail[8];
+    x264_af_slice_buffer( tail, src, 8, s );
+    interleave_c( dst, tail, 8, samplecount - s );
+}
+
+static void deinterleave_2ch_sse2( float **dst, const float *src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, src += 8 )
+    {
+        __m128 a = _mm_loadu_ps( src );
+        __m128 b = _mm_loadu_ps( src + 4 );
+        _mm_storeu_ps( dst[0] + s, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        _mm_storeu_ps( dst[1] + s, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+    }
+    float *tail[2] = { dst[0] + s, dst[1] + s };
+    deinterleave_c( tail, src, 2, samplecount - s );
+}
+
+static void deinterleave_6ch_sse2( float **dst, const float *src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, src += 24 )
+    {
+        __m128 c0 = _mm_loadu_ps( src );
+        __m128 c1 = _mm_loadu_ps( src + 6 );
+        __m128 c2 = _mm_loadu_ps( src + 12 );
+        __m128 c3 = _mm_loadu_ps( src + 18 );
+        __m128 lo = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), (const __m64*)(src + 4) ), (const __m64*)(src + 10) );
+        __m128 hi = _mm_loadh_pi( _mm_loadl_pi( _mm_setzero_ps(), (const __m64*)(src + 16) ), (const __m64*)(src + 22) );
+        _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+        _mm_storeu_ps( dst[0] + s, c0 );
+        _mm_storeu_ps( dst[1] + s, c1 );
+        _mm_storeu_ps( dst[2] + s, c2 );
+        _mm_storeu_ps( dst[3] + s, c3 );
+        _mm_storeu_ps( dst[4] + s, _mm_shuffle_ps( lo, hi, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        _mm_storeu_ps( dst[5] + s, _mm_shuffle_ps( lo, hi, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+    }
+    float *tail[6];
+    x264_af_slice_buffer( tail, dst, 6, s );
+    deinterleave_c( tail, src, 6, samplecount - s );
+}
+
+static void deinterleave_8ch_sse2( float **dst, const float *src, unsigned channels, unsigned samplecount )
+{
+    int s = 0;
+    for( ; s + 4 <= samplecount; s += 4, src += 32 )
+    {
+        __m128 c0 = _mm_loadu_ps( src );
+        __m128 c4 = _mm_loadu_ps( src + 4 );
+        __m128 c1 = _mm_loadu_ps( src + 8 );
+        __m128 c5 = _mm_loadu_ps( src + 12 );
+        __m128 c2 = _mm_loadu_ps( src + 16 );
+        __m128 c6 = _mm_loadu_ps( src + 20 );
+        __m128 c3 = _mm_loadu_ps( src + 24 );
+        __m128 c7 = _mm_loadu_ps( src + 28 );
+        _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+        _MM_TRANSPOSE4_PS( c4, c5, c6, c7 );
+        _mm_storeu_ps( dst[0] + s, c0 );
+        _mm_storeu_ps( dst[1] + s, c1 );
+        _mm_storeu_ps( dst[2] + s, c2 );
+        _mm_storeu_ps( dst[3] + s, c3 );
+        _mm_storeu_ps( dst[4] + s, c4 );
+        _mm_storeu_ps( dst[5] + s, c5 );
+        _mm_storeu_ps( dst[6] + s, c6 );
+        _mm_storeu_ps( dst[7] + s, c7 );
+    }
+    float *tail[8];
+    x264_af_slice_buffer( tail, dst, 8, s );
+    deinterleave_c( tail, src, 8, samplecount - s );
+}
+
+static float dot_sse2( const float *a, const float *b, int n )
+{
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    int i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        s0 = _mm_add_ps( s0, _mm_mul_ps( _mm_loadu_ps( a + i ),     _mm_loadu_ps( b + i ) ) );
+        s1 = _mm_add_ps( s1, _mm_mul_ps( _mm_loadu_ps( a + i + 4 ), _mm_loadu_ps( b + i + 4 ) ) );
+    }
+    if( i + 4 <= n )
+    {
+        s0 = _mm_add_ps( s0, _mm_mul_ps( _mm_loadu_ps( a + i ), _mm_loadu_ps( b + i ) ) );
+        i += 4;
+    }
+    s0 = _mm_add_ps( s0, s1 );
+    s0 = _mm_add_ps( s0, _mm_movehl_ps( s0, s0 ) );
+    s0 = _mm_add_ss( s0, _mm_shuffle_ps( s0, s0, 1 ) );
+    return _mm_cvtss_f32( s0 ) + dot_c( a + i, b + i, n - i );
+}
+
+static void scale_sse2( float *dst, const float *src, float gain, int n )
+{
+    __m128 g = _mm_set1_ps( gain );
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_loadu_ps( src + i ), g ) );
+    scale_c( dst + i, src + i, gain, n - i );
+}
+
+static void mac_sse2( float *dst, const float *src, float gain, int n )
+{
+    __m128 g = _mm_set1_ps( gain );
+    int i = 0;
+    for( ; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( dst + i, _mm_add_ps( _mm_loadu_ps( dst + i ), _mm_mul_ps( _mm_loadu_ps( src + i ), g ) ) );
+    mac_c( dst + i, src + i, gain, n - i );
+}
+#endif /* HAVE_AF_SSE2 */
+
+x264_af_dsp_t x264_af_dsp;
+
+#define INIT_CONVERT( iname, ifmt, oname, ofmt, cpu ) \
+    dsp->convert[SMPFMT_##ifmt][SMPFMT_##ofmt] = convert_##iname##_##oname##_##cpu;
+#define INIT_CONVERT_ALL( cpu )                     \
+    INIT_CONVERT( u8,  U8,  s16, S16, cpu )         \
+    INIT_CONVERT( u8,  U8,  s32, S32, cpu )         \
+    INIT_CONVERT( u8,  U8,  flt, FLT, cpu )         \
+    INIT_CONVERT( u8,  U8,  dbl, DBL, cpu )         \
+    INIT_CONVERT( s16, S16, u8,  U8,  cpu )         \
+    INIT_CONVERT( s16, S16, s32, S32, cpu )         \
+    INIT_CONVERT( s16, S16, flt, FLT, cpu )         \
+    INIT_CONVERT( s16, S16, dbl, DBL, cpu )         \
+    INIT_CONVERT( s32, S32, u8,  U8,  cpu )         \
+    INIT_CONVERT( s32, S32, s16, S16, cpu )         \
+    INIT_CONVERT( s32, S32, flt, FLT, cpu )         \
+    INIT_CONVERT( s32, S32, dbl, DBL, cpu )         \
+    INIT_CONVERT( flt, FLT, u8,  U8,  cpu )         \
+    INIT_CONVERT( flt, FLT, s16, S16, cpu )         \
+    INIT_CONVERT( flt, FLT, s32, S32, cpu )         \
+    INIT_CONVERT( flt, FLT, dbl, DBL, cpu )         \
+    INIT_CONVERT( dbl, DBL, u8,  U8,  cpu )         \
+    INIT_CONVERT( dbl, DBL, s16, S16, cpu )         \
+    INIT_CONVERT( dbl, DBL, s32, S32, cpu )         \
+    INIT_CONVERT( dbl, DBL, flt, FLT, cpu )
+
+void x264_af_dsp_init( int cpu, x264_af_dsp_t *dsp )
+{
+    memset( dsp, 0, sizeof(x264_af_dsp_t) );
+    INIT_CONVERT_ALL( c )
+    for( int c = 0; c <= X264_AF_DSP_CHANNELS; c++ )
+    {
+        dsp->interleave[c] = interleave_c;
+        dsp->deinterleave[c] = deinterleave_c;
+    }
+    dsp->dot   = dot_c;
+    dsp->scale = scale_c;
+    dsp->mac   = mac_c;
+
+#if HAVE_AF_SSE2
+    if( cpu&X264_CPU_SSE2 )
+    {
+        INIT_CONVERT_ALL( sse2 )
+        dsp->interleave[2] = interleave_2ch_sse2;
+        dsp->interleave[6] = interleave_6ch_sse2;
+        dsp->interleave[8] = interleave_8ch_sse2;
+        dsp->deinterleave[2] = deinterleave_2ch_sse2;
+        dsp->deinterleave[6] = deinterleave_6ch_sse2;
+        dsp->deinterleave[8] = deinterleave_8ch_sse2;
+        dsp->dot   = dot_sse2;
+        dsp->scale = scale_sse2;
+        dsp->mac   = mac_sse2;
+    }
+#endif
+}
+#undef INIT_CONVERT_ALL
+#undef INIT_CONVERT
+
+void x264_af_set_cpu( int cpu )
+{
+    x264_af_dsp_init( cpu, &x264_af_dsp );
+}
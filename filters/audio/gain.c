@@ -0,0 +1,64 @@
+#include "filters/audio/internal.h"
+#include <assert.h>
+#include <math.h>
+
+typedef struct gain_filter_t
+{
+    AUDIO_FILTER_COMMON
+    float gain;
+} gain_filter_t;
+
+const audio_filter_t audio_filter_gain;
+
+static int init( hnd_t *handle, const char *opt_str )
+{
+    assert( *handle ); // There must be a source before
+    char **opts = x264_split_options( opt_str ? opt_str : "", (const char*[]){ "db", NULL } );
+    if( !opts )
+        return -1;
+    double db = x264_otof( x264_get_option( "db", opts ), 0 );
+    x264_free_string_array( opts );
+
+    INIT_FILTER_STRUCT( audio_filter_gain, gain_filter_t );
+    h->gain = pow( 10, db / 20 );
+    AF_LOG( h, X264_LOG_INFO, "%+.2fdB (x%.4f)\n", db, h->gain );
+    return 0;
+
+fail:
+    return -1;
+}
+
+/* The source's packet is scaled in place and handed on. */
+static struct audio_packet_t *get_samples( hnd_t handle, int64_t first_sample, int64_t last_sample )
+{
+    gain_filter_t *h = handle;
+    audio_packet_t *pkt = x264_af_get_samples( h->prev, first_sample, last_sample );
+    if( !pkt )
+        return NULL;
+    if( h->gain != 1.0f )
+        for( int c = 0; c < pkt->channels; c++ )
+            x264_af_dsp.scale( pkt->samples[c], pkt->samples[c], h->gain, pkt->samplecount );
+    return pkt;
+}
+
+static void free_packet( hnd_t handle, audio_packet_t *pkt )
+{
+    pkt->owner = NULL;
+    x264_af_free_packet( pkt );
+}
+
+static void gain_close( hnd_t handle )
+{
+    free( handle );
+}
+
+const audio_filter_t audio_filter_gain =
+{
+    .name        = "gain",
+    .description = "Changes the volume",
+    .help        = "Arguments: db",
+    .init        = init,
+    .get_samples = get_samples,
+    .free_packet = free_packet,
+    .close       = gain_close
+};
@@ -1,24 +1,155 @@
 #include "filters/audio/internal.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
 
-float **x264_af_get_buffer( unsigned channels, unsigned samplecount )
+#define BUFFER_ALIGN 32
+#define POOL_MAX_FREE 16
+
+typedef struct audio_buffer_t
+{
+    audio_pool_t *pool;
+    struct audio_buffer_t *next;
+    unsigned channels;
+    unsigned capacity;      // samples per channel, a multiple of the alignment
+    float   *data;          // inline, unless the buffer had to grow
+    void    *data_alloc;    // allocation behind data when it isn't inline
+    float   *planes[];      // what users see as float**
+} audio_buffer_t;
+
+static inline audio_buffer_t *buffer_header( float **buffer )
+{
+    return (audio_buffer_t*)((uint8_t*)buffer - offsetof( audio_buffer_t, planes ));
+}
+
+static inline unsigned buffer_stride( unsigned samplecount )
+{
+    const unsigned align = BUFFER_ALIGN / sizeof(float);
+    return (samplecount + align - 1) & ~(align - 1);
+}
+
+static inline float *buffer_align( void *p )
+{
+    return (float*)(((uintptr_t)p + BUFFER_ALIGN - 1) & ~(uintptr_t)(BUFFER_ALIGN - 1));
+}
+
+static void buffer_set_planes( audio_buffer_t *b )
+{
+    for( int c = 0; c < b->channels; c++ )
+        b->planes[c] = b->data + (size_t)c * b->capacity;
+}
+
+static audio_buffer_t *buffer_new( unsigned channels, unsigned samplecount )
+{
+    unsigned stride = buffer_stride( samplecount );
+    audio_buffer_t *b = malloc( sizeof(audio_buffer_t) + channels * sizeof(float*) + BUFFER_ALIGN - 1
+                                + (size_t)channels * stride * sizeof(float) );
+    if( !b )
+        return NULL;
+    b->pool       = NULL;
+    b->next       = NULL;
+    b->channels   = channels;
+    b->capacity   = stride;
+    b->data       = buffer_align( &b->planes[channels] );
+    b->data_alloc = NULL;
+    buffer_set_planes( b );
+    return b;
+}
+
+static void buffer_delete( audio_buffer_t *b )
+{
+    free( b->data_alloc );
+    free( b );
+}
+
+/* moves the samples to a larger allocation, keeping the contents of every channel */
+static int buffer_grow( audio_buffer_t *b, unsigned samplecount )
+{
+    unsigned stride = buffer_stride( samplecount );
+    void *alloc = malloc( (size_t)b->channels * stride * sizeof(float) + BUFFER_ALIGN - 1 );
+    if( !alloc )
+        return -1;
+    float *data = buffer_align( alloc );
+    for( int c = 0; c < b->channels; c++ )
+        memcpy( data + (size_t)c * stride, b->data + (size_t)c * b->capacity, b->capacity * sizeof(float) );
+    free( b->data_alloc );
+    b->data_alloc = alloc;
+    b->data       = data;
+    b->capacity   = stride;
+    buffer_set_planes( b );
+    return 0;
+}
+
+audio_pool_t *x264_af_pool_new( void )
 {
-    float **samples = malloc( sizeof( float* ) * channels );
-    for( int i = 0; i < channels; i++ ) {
-        samples[i] = malloc( sizeof( float ) * samplecount );
+    return calloc( 1, sizeof( audio_pool_t ) );
+}
+
+void x264_af_pool_close( audio_pool_t *pool )
+{
+    if( !pool )
+        return;
+    pool->closed = 1;
+    while( pool->free )
+    {
+        audio_buffer_t *b = pool->free;
+        pool->free = b->next;
+        buffer_delete( b );
     }
-    return samples;
+    pool->free_count = 0;
+    if( !pool->outstanding )
+        free( pool );
 }
 
-int x264_af_resize_buffer( float **buffer, unsigned channels, unsigned samplecount )
+float **x264_af_get_buffer( audio_pool_t *pool, unsigned channels, unsigned samplecount )
 {
-    for( int c = 0; c < channels; c++ )
+    audio_buffer_t *b;
+    if( !pool )
+        b = buffer_new( channels, samplecount );
+    else
     {
-        if( !(buffer[c] = realloc( buffer[c], sizeof( float ) * samplecount )) )
-            return -1;
+        pool->requests++;
+        /* the first free buffer that is large enough, else the largest one */
+        audio_buffer_t **best = NULL;
+        for( audio_buffer_t **p = &pool->free; *p; p = &(*p)->next )
+            if( (*p)->channels == channels && (!best || ((*best)->capacity < samplecount && (*p)->capacity > (*best)->capacity)) )
+                best = p;
+        if( best )
+        {
+            b = *best;
+            *best = b->next;
+            pool->free_count--;
+            if( b->capacity < samplecount )
+            {
+                pool->allocs++;
+                if( buffer_grow( b, samplecount ) < 0 )
+                {
+                    buffer_delete( b );
+                    return NULL;
+                }
+            }
+        }
+        else
+        {
+            pool->allocs++;
+            b = buffer_new( channels, samplecount );
+        }
+        if( !b )
+            return NULL;
+        b->pool = pool;
+        pool->outstanding++;
     }
-    return 0;
+    return b ? b->planes : NULL;
+}
+
+int x264_af_resize_buffer( float **buffer, unsigned channels, unsigned samplecount )
+{
+    audio_buffer_t *b = buffer_header( buffer );
+    if( samplecount <= b->capacity )
+        return 0;
+    if( b->pool )
+        b->pool->allocs++;
+    return buffer_grow( b, samplecount );
 }
 
 int x264_af_resize_fill_buffer( float **buffer, unsigned out_samplecount, unsigned channels, unsigned in_samplecount, float value )
@@ -33,9 +164,11 @@ int x264_af_resize_fill_buffer( float **buffer, unsigned out_samplecount, unsign
 
 float **x264_af_dup_buffer( float **buffer, unsigned channels, unsigned samplecount )
 {
-    float **buf = x264_af_get_buffer( channels, samplecount );
+    float **buf = x264_af_get_buffer( buffer_header( buffer )->pool, channels, samplecount );
+    if( !buf )
+        return NULL;
     for( int c = 0; c < channels; c++ )
-        memcpy( buf[c], buffer[c], samplecount );
+        memcpy( buf[c], buffer[c], samplecount * sizeof( float ) );
     return buf;
 }
 
@@ -43,9 +176,24 @@ void x264_af_free_buffer( float **buffer, unsigned channels )
 {
     if( !buffer )
         return;
-    for( int c = 0; c < channels; c++ )
-        free( buffer[c] );
-    free( buffer );
+    audio_buffer_t *b = buffer_header( buffer );
+    audio_pool_t *pool = b->pool;
+    if( !pool )
+    {
+        buffer_delete( b );
+        return;
+    }
+    pool->outstanding--;
+    if( !pool->closed && pool->free_count < POOL_MAX_FREE )
+    {
+        b->next = pool->free;
+        pool->free = b;
+        pool->free_count++;
+    }
+    else
+        buffer_delete( b );
+    if( pool->closed && !pool->outstanding )
+        free( pool );
 }
 
 int x264_af_cat_buffer( float **buf, unsigned bufsamples, float **in, unsigned insamples, unsigned channels )
@@ -53,80 +201,86 @@ int x264_af_cat_buffer( float **buf, unsigned bufsamples, float **in, unsigned i
     if( x264_af_resize_buffer( buf, channels, bufsamples + insamples ) < 0 )
         return -1;
     for( int c = 0; c < channels; c++ )
-        for( int s = 0; s < insamples; s++ )
-            buf[c][bufsamples+s] = in[c][s];
+        memcpy( buf[c] + bufsamples, in[c], insamples * sizeof( float ) );
     return 0;
 }
 
-static inline int x264_is_interleaved_format(int fmt)
+#define MAX_CHANNEL_WORKERS 8
+
+typedef struct
 {
-    return fmt <= SMPFMT_DBL;
-}
+    audio_channel_func_t func;
+    void *arg;
+    int first, last;
+} channel_job_t;
 
-static inline int x264_interleaved_format(int fmt)
+struct audio_channel_workers_t
 {
-    if (fmt >= SMPFMT_U8P && fmt <= SMPFMT_DBLP)
-        fmt -= (SMPFMT_U8P - SMPFMT_U8);
-    return fmt;
-}
+    x264_threadpool_t *pool;
+    int threads;            // those of the pool and the caller's
+    channel_job_t job[MAX_CHANNEL_WORKERS];
+};
 
-float **x264_af_deinterleave ( float *samples, unsigned channels, unsigned samplecount )
+audio_channel_workers_t *x264_af_workers_open( unsigned channels, int threads )
 {
-    float **deint = x264_af_get_buffer( channels, samplecount );
-    for( int s = 0; s < samplecount; s++ )
-        for( int c = 0; c < channels; c++ )
-            deint[c][s] = samples[s*channels + c];
-    return deint;
+    if( threads <= 0 )
+        threads = channels >= AF_THREADED_CHANNELS ? X264_MIN( x264_cpu_num_processors(), channels / 2 ) : 1;
+    threads = X264_MIN( X264_MIN( threads, channels ), MAX_CHANNEL_WORKERS );
+    if( threads < 2 )
+        return NULL;
+    audio_channel_workers_t *w = calloc( 1, sizeof(audio_channel_workers_t) );
+    if( !w )
+        return NULL;
+    if( x264_threadpool_init( &w->pool, threads - 1, NULL, NULL ) )
+    {
+        free( w );
+        return NULL;
+    }
+    w->threads = threads;
+    return w;
 }
 
-float *x264_af_interleave ( float **in, unsigned channels, unsigned samplecount )
+static void *channel_job( channel_job_t *job )
 {
-    float *inter = malloc( sizeof( float ) * channels * samplecount );
-    for( int c = 0; c < channels; c++ )
-        for( int s = 0; s < samplecount; s++ )
-            inter[s*channels + c] = in[c][s];
-    return inter;
+    job->func( job->arg, job->first, job->last );
+    return NULL;
 }
 
-float **x264_af_deinterleave2( uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
+void x264_af_workers_run( audio_channel_workers_t *w, unsigned channels, audio_channel_func_t func, void *arg )
 {
-    float  *in  = (float*) x264_af_convert( SMPFMT_FLT, samples, fmt, channels, samplecount );
-    float **out;
-
-    if (x264_is_interleaved_format(fmt))
-        out = x264_af_deinterleave( in, channels, samplecount );
-    else {
-        unsigned i, j;
-        out = x264_af_get_buffer( channels, samplecount );
-        for (i = 0; i < channels; ++i) {
-            float *base = &in[i * samplecount];
-            for (j = 0; j < samplecount; ++j)
-                out[i][j] = base[j];
-        }
+    int n = w ? X264_MIN( w->threads, channels ) : 1;
+    if( n < 2 )
+    {
+        func( arg, 0, channels );
+        return;
     }
-    free( in );
-    return out;
+    for( int i = 0; i < n; i++ )
+        w->job[i] = (channel_job_t){ func, arg, channels * i / n, channels * (i + 1) / n };
+    for( int i = 1; i < n; i++ )
+        x264_threadpool_run( w->pool, (void*)channel_job, &w->job[i] );
+    channel_job( &w->job[0] );
+    for( int i = 1; i < n; i++ )
+        x264_threadpool_wait( w->pool, &w->job[i] );
 }
 
-uint8_t *x264_af_interleave2( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount )
+void x264_af_workers_close( audio_channel_workers_t *w )
 {
-    float   *tmp = x264_af_interleave( in, channels, samplecount );
-    uint8_t *out = x264_af_convert( outfmt, (uint8_t*) tmp, SMPFMT_FLT, channels, samplecount );
-    free( tmp );
-    return out;
+    if( !w )
+        return;
+    x264_threadpool_delete( w->pool );
+    free( w );
 }
 
-uint8_t *x264_af_interleave3( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount, int *map )
+static inline int x264_is_interleaved_format(int fmt)
 {
-    void *map_tmp[8];
-    for( int i=0; i<channels; i++ )
-        map_tmp[i] = in[i];
-    for( int i=0; i<channels; i++ )
-        in[i] = map_tmp[map[i]];
-    float   *tmp = x264_af_interleave( in, channels, samplecount );
-    uint8_t *out = x264_af_convert( outfmt, (uint8_t*) tmp, SMPFMT_FLT, channels, samplecount );
-    free( tmp );
-    return out;
+    return fmt <= SMPFMT_DBL;
+}
+
+static inline int x264_interleaved_format(int fmt)
+{
+    if (fmt >= SMPFMT_U8P && fmt <= SMPFMT_DBLP)
+        fmt -= (SMPFMT_U8P - SMPFMT_U8);
+    return fmt;
 }
 
 static inline int samplesize( enum SampleFmt fmt )
@@ -152,64 +306,165 @@ static inline int samplesize( enum SampleFmt fmt )
     }
 }
 
-#define CLIPFUN( num, type, min, max )                                  \
-    static inline type clip##num( int64_t i ) {                         \
-        return (type)( ( i > max ) ? max : ( ( i < min ) ? min : i ) ); \
+/* Interleaved samples that need a conversion on the way to or from planar
+ * float go through a small float buffer, a block of sample frames at a time. */
+#define CONVERT_BLOCK 1024
+
+static inline void interleave( float *out, float **in, unsigned channels, unsigned samplecount )
+{
+    if( channels <= X264_AF_DSP_CHANNELS )
+        x264_af_dsp.interleave[channels]( out, in, channels, samplecount );
+    else
+        x264_af_dsp.interleave[0]( out, in, channels, samplecount );
+}
+
+static inline void deinterleave( float **out, const float *in, unsigned channels, unsigned samplecount )
+{
+    if( channels <= X264_AF_DSP_CHANNELS )
+        x264_af_dsp.deinterleave[channels]( out, in, channels, samplecount );
+    else
+        x264_af_dsp.deinterleave[0]( out, in, channels, samplecount );
+}
+
+float **x264_af_deinterleave ( audio_pool_t *pool, float *samples, unsigned channels, unsigned samplecount )
+{
+    float **deint = x264_af_get_buffer( pool, channels, samplecount );
+    if( deint )
+        x264_af_deinterleave_to( deint, (uint8_t*)samples, SMPFMT_FLT, channels, samplecount );
+    return deint;
+}
+
+float *x264_af_interleave ( float **in, unsigned channels, unsigned samplecount )
+{
+    float *inter = malloc( sizeof( float ) * channels * samplecount );
+    if( inter )
+        interleave( inter, in, channels, samplecount );
+    return inter;
+}
+
+int x264_af_deinterleave_to( float **out, uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
+{
+    int planar = !x264_is_interleaved_format( fmt );
+    fmt = x264_interleaved_format( fmt );
+    int size = samplesize( fmt );
+    if( !size || !channels )
+        return -1;
+
+    /* planar input has its channels one after another */
+    if( planar )
+    {
+        for( int c = 0; c < channels; c++ )
+        {
+            const uint8_t *in = samples + (size_t)c * samplecount * size;
+            if( fmt == SMPFMT_FLT )
+                memcpy( out[c], in, samplecount * sizeof(float) );
+            else
+                x264_af_dsp.convert[fmt][SMPFMT_FLT]( out[c], in, samplecount );
+        }
+        return 0;
     }
-CLIPFUN( 8,  uint8_t, 0,         UINT8_MAX )
-CLIPFUN( 16, int16_t, INT16_MIN, INT16_MAX )
-CLIPFUN( 32, int32_t, INT32_MIN, INT32_MAX )
-#undef CLIPFUN
 
-uint8_t *x264_af_convert( enum SampleFmt outfmt, uint8_t *in, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
+    if( fmt == SMPFMT_FLT )
+    {
+        deinterleave( out, (const float*)samples, channels, samplecount );
+        return 0;
+    }
+
+    int block = CONVERT_BLOCK / channels;
+    if( !block )
+        return -1;
+    float tmp[CONVERT_BLOCK];
+    float *view[channels];
+    for( unsigned s = 0; s < samplecount; s += block )
+    {
+        int n = X264_MIN( block, samplecount - s );
+        x264_af_dsp.convert[fmt][SMPFMT_FLT]( tmp, samples + (size_t)s * channels * size, n * channels );
+        x264_af_slice_buffer( view, out, channels, s );
+        deinterleave( view, tmp, channels, n );
+    }
+    return 0;
+}
+
+float **x264_af_deinterleave2( audio_pool_t *pool, uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
 {
-    int totalsamples = channels * samplecount;
-    int sz = samplesize( outfmt ) * totalsamples;
-    uint8_t *out = malloc( sz );
-    if( !out )
+    float **out = x264_af_get_buffer( pool, channels, samplecount );
+    if( out && x264_af_deinterleave_to( out, samples, fmt, channels, samplecount ) < 0 )
+    {
+        x264_af_free_buffer( out, channels );
         return NULL;
+    }
+    return out;
+}
 
-    fmt = x264_interleaved_format(fmt);
-    outfmt = x264_interleaved_format(outfmt);
+int x264_af_interleave_to( uint8_t *out, enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount )
+{
+    outfmt = x264_interleaved_format( outfmt );
+    int size = samplesize( outfmt );
+    if( !size || !channels )
+        return -1;
 
-    if( fmt == outfmt )
+    if( outfmt == SMPFMT_FLT )
     {
-        memcpy( out, in, sz );
-        return out;
+        interleave( (float*)out, in, channels, samplecount );
+        return 0;
     }
 
-#define CONVERT( ifmt, ofmt, otype, expr )                  \
-    if( ifmt == fmt && ofmt == outfmt ) {                   \
-        for( int i = 0; i < totalsamples; i++ )             \
-        {                                                   \
-            ((otype*)out)[i] = (otype)expr;                 \
-        }                                                   \
-        return out;                                         \
+    int block = CONVERT_BLOCK / channels;
+    if( !block )
+        return -1;
+    float tmp[CONVERT_BLOCK];
+    float *view[channels];
+    for( unsigned s = 0; s < samplecount; s += block )
+    {
+        int n = X264_MIN( block, samplecount - s );
+        x264_af_slice_buffer( view, in, channels, s );
+        interleave( tmp, view, channels, n );
+        x264_af_dsp.convert[SMPFMT_FLT][outfmt]( out + (size_t)s * channels * size, tmp, n * channels );
     }
-#define INPUT( itype ) (((itype*)in)[i])
-
-    CONVERT( SMPFMT_U8,  SMPFMT_S16, int16_t, (INPUT( uint8_t ) - 0x80) << 8 );
-    CONVERT( SMPFMT_U8,  SMPFMT_S32, int32_t, (INPUT( uint8_t ) - 0x80) << 24 );
-    CONVERT( SMPFMT_U8,  SMPFMT_FLT, float,   (INPUT( uint8_t ) - 0x80) * (1.0 / (1<<7)) );
-    CONVERT( SMPFMT_U8,  SMPFMT_DBL, double,  (INPUT( uint8_t ) - 0x80) * (1.0 / (1<<7)) );
-    CONVERT( SMPFMT_S16, SMPFMT_U8,  uint8_t, (INPUT( int16_t ) >> 8) + 0x80 );
-    CONVERT( SMPFMT_S16, SMPFMT_S32, int32_t,  INPUT( int16_t ) << 16 );
-    CONVERT( SMPFMT_S16, SMPFMT_FLT, float,    INPUT( int16_t ) * (1.0 / (1<<15)) );
-    CONVERT( SMPFMT_S16, SMPFMT_DBL, double,   INPUT( int16_t ) * (1.0 / (1<<15)) );
-    CONVERT( SMPFMT_S32, SMPFMT_U8,  uint8_t, (INPUT( int32_t ) >> 24) + 0x80 );
-    CONVERT( SMPFMT_S32, SMPFMT_S16, int16_t,  INPUT( int32_t ) >> 16 );
-    CONVERT( SMPFMT_S32, SMPFMT_FLT, float,    INPUT( int32_t ) * (1.0 / (1<<31)) );
-    CONVERT( SMPFMT_S32, SMPFMT_DBL, double,   INPUT( int32_t ) * (1.0 / (1<<31)) );
-    CONVERT( SMPFMT_FLT, SMPFMT_U8,  uint8_t,  clip8( lrintf(  INPUT( float )  * (1<<7) ) + 0x80 ) );
-    CONVERT( SMPFMT_FLT, SMPFMT_S16, int16_t, clip16( lrintf(  INPUT( float )  * (1<<15) ) ) );
-    CONVERT( SMPFMT_FLT, SMPFMT_S32, int32_t, clip32( llrintf( INPUT( float )  * (1U<<31) ) ) );
-    CONVERT( SMPFMT_FLT, SMPFMT_DBL, double,   INPUT( float ) );
-    CONVERT( SMPFMT_DBL, SMPFMT_U8,  uint8_t,  clip8( lrintf(  INPUT( double ) * (1<<7) ) + 0x80 ) );
-    CONVERT( SMPFMT_DBL, SMPFMT_S16, int16_t, clip16( lrintf(  INPUT( double ) * (1<<15) ) ) );
-    CONVERT( SMPFMT_DBL, SMPFMT_S32, int32_t, clip32( llrintf( INPUT( double ) * (1U<<31) ) ) );
-    CONVERT( SMPFMT_DBL, SMPFMT_FLT, float,    INPUT( double ) );
-#undef INPUT
-#undef CONVERT
-    free( out );
-    return NULL;
+    return 0;
+}
+
+uint8_t *x264_af_interleave2( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount )
+{
+    uint8_t *out = malloc( (size_t)samplesize( outfmt ) * channels * samplecount );
+    if( out && x264_af_interleave_to( out, outfmt, in, channels, samplecount ) < 0 )
+    {
+        free( out );
+        return NULL;
+    }
+    return out;
+}
+
+uint8_t *x264_af_interleave3( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount, int *map )
+{
+    float *mapped[8];
+    for( int i=0; i<channels; i++ )
+        mapped[i] = in[map[i]];
+    return x264_af_interleave2( outfmt, mapped, channels, samplecount );
+}
+
+int x264_af_convert_to( uint8_t *out, enum SampleFmt outfmt, const uint8_t *in, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
+{
+    fmt = x264_interleaved_format( fmt );
+    outfmt = x264_interleaved_format( outfmt );
+    if( !samplesize( fmt ) || !samplesize( outfmt ) )
+        return -1;
+
+    int totalsamples = channels * samplecount;
+    if( fmt == outfmt )
+        memcpy( out, in, (size_t)samplesize( outfmt ) * totalsamples );
+    else
+        x264_af_dsp.convert[fmt][outfmt]( out, in, totalsamples );
+    return 0;
+}
+
+uint8_t *x264_af_convert( enum SampleFmt outfmt, uint8_t *in, enum SampleFmt fmt, unsigned channels, unsigned samplecount )
+{
+    uint8_t *out = malloc( (size_t)samplesize( outfmt ) * channels * samplecount );
+    if( out && x264_af_convert_to( out, outfmt, in, fmt, channels, samplecount ) < 0 )
+    {
+        free( out );
+        return NULL;
+    }
+    return out;
 }
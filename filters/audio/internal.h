@@ -6,7 +6,8 @@
 #define AUDIO_FILTER_COMMON     \
     const audio_filter_t *self; \
     audio_info_t info;          \
-    struct audio_hnd_t *prev;
+    struct audio_hnd_t *prev;   \
+    struct audio_pool_t *pool;
 
 #define INIT_FILTER_STRUCT(filterstruct, structname)            \
     structname *h;                                              \
@@ -18,7 +19,10 @@
         h->self = &filterstruct;                                \
         h->prev = *handle;                                      \
         if( h->prev )                                           \
+        {                                                       \
             h->info = h->prev->info;                            \
+            h->pool = h->prev->pool;                            \
+        }                                                       \
         *handle = h;                                            \
     } while( 0 )
 
@@ -50,19 +54,88 @@ enum SampleFmt {
     SMPFMT_DBLP
 };
 
-float  **x264_af_get_buffer   ( unsigned channels, unsigned samplecount );
+/* Sample buffers are planar float** arrays whose channel pointers and samples
+ * share a single allocation, each channel starting on a 32 byte boundary.
+ * Buffers can come from a pool, which the source filter of a chain owns and
+ * every filter appended to it shares: freeing such a buffer returns it to its
+ * pool for reuse.  A chain's buffers must be allocated and freed by the thread
+ * running that chain. */
+typedef struct audio_pool_t
+{
+    struct audio_buffer_t *free;
+    int      free_count;
+    int      outstanding;   // buffers handed out and not returned yet
+    int      closed;
+    /* statistics */
+    uint64_t requests;      // buffers asked for
+    uint64_t allocs;        // of which needed a malloc or realloc
+    uint64_t samples;       // samples delivered by the source filter
+} audio_pool_t;
+
+audio_pool_t *x264_af_pool_new( void );
+/* the pool goes away once the last of its buffers is freed */
+void     x264_af_pool_close   ( audio_pool_t *pool );
+
+/* pool may be NULL for a buffer of its own */
+float  **x264_af_get_buffer   ( audio_pool_t *pool, unsigned channels, unsigned samplecount );
 int      x264_af_resize_buffer( float **buffer, unsigned channels, unsigned samplecount );
 int      x264_af_resize_fill_buffer( float **buffer, unsigned out_samplecount, unsigned channels, unsigned in_samplecount, float value );
 void     x264_af_free_buffer  ( float **buffer, unsigned channels );
 float  **x264_af_dup_buffer   ( float **buffer, unsigned channels, unsigned samplecount );
 int      x264_af_cat_buffer   ( float **buf, unsigned bufsamples, float **in, unsigned insamples, unsigned channels );
 
-float  **x264_af_deinterleave ( float *samples, unsigned channels, unsigned samplecount );
+/* Points view at the samples of buffer starting at offset, so that a buffer
+ * can be filled in parts without intermediate copies. */
+static inline void x264_af_slice_buffer( float **view, float **buffer, unsigned channels, unsigned offset )
+{
+    for( int c = 0; c < channels; c++ )
+        view[c] = buffer[c] + offset;
+}
+
+/* Filters doing per-channel work hand it out in ranges of channels, which run
+ * concurrently when the filter has workers.  Workers are only worth their
+ * threads from AF_THREADED_CHANNELS channels up, unless asked for explicitly:
+ * threads <= 0 picks the count, and NULL is returned when work stays inline.
+ * func only gets to allocate from the pool when workers is NULL. */
+#define AF_THREADED_CHANNELS 6
+typedef struct audio_channel_workers_t audio_channel_workers_t;
+typedef void (*audio_channel_func_t)( void *arg, int first_channel, int last_channel );
+
+audio_channel_workers_t *x264_af_workers_open( unsigned channels, int threads );
+void     x264_af_workers_run  ( audio_channel_workers_t *workers, unsigned channels, audio_channel_func_t func, void *arg );
+void     x264_af_workers_close( audio_channel_workers_t *workers );
+
+/* Conversion and (de)interleaving kernels.  n counts single samples of any
+ * channel, the channel count indexes the (de)interleavers, and only a few
+ * layouts have dedicated ones. */
+#define X264_AF_DSP_CHANNELS 8
+typedef struct
+{
+    /* [in][out], interleaved formats only, NULL for in == out */
+    void (*convert[SMPFMT_DBL+1][SMPFMT_DBL+1])( void *dst, const void *src, int n );
+    void (*interleave[X264_AF_DSP_CHANNELS+1])( float *dst, float **src, unsigned channels, unsigned samplecount );
+    void (*deinterleave[X264_AF_DSP_CHANNELS+1])( float **dst, const float *src, unsigned channels, unsigned samplecount );
+    /* planar float kernels of the filters, dst may be src */
+    float (*dot)( const float *a, const float *b, int n );
+    void (*scale)( float *dst, const float *src, float gain, int n );   // dst = src * gain
+    void (*mac)( float *dst, const float *src, float gain, int n );     // dst += src * gain
+} x264_af_dsp_t;
+
+/* used by all the functions below, set up by x264_af_set_cpu */
+extern x264_af_dsp_t x264_af_dsp;
+void x264_af_dsp_init( int cpu, x264_af_dsp_t *dsp );
+
+float  **x264_af_deinterleave ( audio_pool_t *pool, float *samples, unsigned channels, unsigned samplecount );
 float   *x264_af_interleave   ( float **in, unsigned channels, unsigned samplecount );
 
-float  **x264_af_deinterleave2( uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount );
+float  **x264_af_deinterleave2( audio_pool_t *pool, uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount );
+/* the same, into existing buffers or slices of them */
+int      x264_af_deinterleave_to( float **out, uint8_t *samples, enum SampleFmt fmt, unsigned channels, unsigned samplecount );
 uint8_t *x264_af_interleave2  ( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount );
 uint8_t *x264_af_convert      ( enum SampleFmt outfmt, uint8_t *in, enum SampleFmt fmt, unsigned channels, unsigned samplecount );
+/* the same, into caller provided memory large enough for channels * samplecount samples */
+int      x264_af_interleave_to( uint8_t *out, enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount );
+int      x264_af_convert_to   ( uint8_t *out, enum SampleFmt outfmt, const uint8_t *in, enum SampleFmt fmt, unsigned channels, unsigned samplecount );
 
 uint8_t *x264_af_interleave3  ( enum SampleFmt outfmt, float **in, unsigned channels, unsigned samplecount, int *map );
 
@@ -0,0 +1,282 @@
+#include "filters/audio/internal.h"
+#include <assert.h>
+#include <math.h>
+
+#define SQRT1_2 0.70710678f
+
+typedef struct mix_filter_t
+{
+    AUDIO_FILTER_COMMON
+    int64_t inlayout;
+    int inchannels;
+    float *matrix;      // [output channel][input channel]
+    int identity;
+} mix_filter_t;
+
+const audio_filter_t audio_filter_mix;
+
+static const struct
+{
+    const char *name;
+    int64_t layout;
+} layouts[] =
+{
+    { "mono",   AV_CH_FRONT_CENTER },
+    { "stereo", AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT },
+    { "2.1",    AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_LOW_FREQUENCY },
+    { "3.0",    AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER },
+    { "quad",   AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT },
+    { "5.0",    AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT },
+    { "5.1",    AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_LOW_FREQUENCY|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT },
+    { "7.1",    AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_LOW_FREQUENCY|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT|
+                AV_CH_SIDE_LEFT|AV_CH_SIDE_RIGHT },
+    { 0 }
+};
+
+/* what libavcodec assumes for streams without a channel layout */
+static int64_t default_layout( int channels )
+{
+    static const int64_t layout[9] =
+    {
+        0,
+        AV_CH_FRONT_CENTER,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_LOW_FREQUENCY|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_LOW_FREQUENCY|AV_CH_BACK_CENTER|
+        AV_CH_SIDE_LEFT|AV_CH_SIDE_RIGHT,
+        AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT|AV_CH_FRONT_CENTER|AV_CH_LOW_FREQUENCY|AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT|
+        AV_CH_SIDE_LEFT|AV_CH_SIDE_RIGHT
+    };
+    return channels >= 0 && channels <= 8 ? layout[channels] : 0;
+}
+
+static int count_channels( int64_t layout )
+{
+    int n = 0;
+    for( ; layout; layout &= layout - 1 )
+        n++;
+    return n;
+}
+
+/* index of a channel in the planes of a layout */
+static int channel_index( int64_t layout, int64_t channel )
+{
+    return count_channels( layout & (channel - 1) );
+}
+
+/* Adds input channel in to every channel of to, if the output has all of them. */
+static int spread( mix_filter_t *h, int64_t in, int64_t to, float coef )
+{
+    if( (h->info.chanlayout & to) != to )
+        return 0;
+    for( int64_t ch = to; ch; ch &= ch - 1 )
+        h->matrix[channel_index( h->info.chanlayout, ch & -ch ) * h->inchannels + channel_index( h->inlayout, in )] += coef;
+    return 1;
+}
+
+/* Channels missing from the output go to the first of their nearest ones that
+ * it has, a bit quieter as they get spread over several; the LFE is dropped. */
+typedef struct
+{
+    int64_t to;
+    float coef;
+} target_t;
+
+#define FRONT (AV_CH_FRONT_LEFT|AV_CH_FRONT_RIGHT)
+static const struct
+{
+    int64_t ch;
+    target_t to[5];
+} routes[] =
+{
+    { AV_CH_FRONT_CENTER,          { { FRONT, SQRT1_2 } } },
+    { AV_CH_FRONT_LEFT,            { { AV_CH_FRONT_CENTER, SQRT1_2 } } },
+    { AV_CH_FRONT_RIGHT,           { { AV_CH_FRONT_CENTER, SQRT1_2 } } },
+    { AV_CH_FRONT_LEFT_OF_CENTER,  { { AV_CH_FRONT_LEFT, 1 }, { AV_CH_FRONT_CENTER, 1 } } },
+    { AV_CH_FRONT_RIGHT_OF_CENTER, { { AV_CH_FRONT_RIGHT, 1 }, { AV_CH_FRONT_CENTER, 1 } } },
+    { AV_CH_BACK_LEFT,             { { AV_CH_SIDE_LEFT, 1 }, { AV_CH_FRONT_LEFT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_SIDE_LEFT,             { { AV_CH_BACK_LEFT, 1 }, { AV_CH_FRONT_LEFT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_BACK_RIGHT,            { { AV_CH_SIDE_RIGHT, 1 }, { AV_CH_FRONT_RIGHT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_SIDE_RIGHT,            { { AV_CH_BACK_RIGHT, 1 }, { AV_CH_FRONT_RIGHT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_BACK_CENTER,           { { AV_CH_BACK_LEFT|AV_CH_BACK_RIGHT, SQRT1_2 }, { AV_CH_SIDE_LEFT|AV_CH_SIDE_RIGHT, SQRT1_2 },
+                                     { FRONT, 0.5 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_LOW_FREQUENCY,         { { 0 } } },
+    { AV_CH_TOP_FRONT_LEFT,        { { AV_CH_FRONT_LEFT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_TOP_BACK_LEFT,         { { AV_CH_FRONT_LEFT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_STEREO_LEFT,           { { AV_CH_FRONT_LEFT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_TOP_FRONT_RIGHT,       { { AV_CH_FRONT_RIGHT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_TOP_BACK_RIGHT,        { { AV_CH_FRONT_RIGHT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { AV_CH_STEREO_RIGHT,          { { AV_CH_FRONT_RIGHT, SQRT1_2 }, { AV_CH_FRONT_CENTER, 0.5 } } },
+    { 0,                           { { AV_CH_FRONT_CENTER, SQRT1_2 }, { FRONT, 0.5 } } } // anything else
+};
+#undef FRONT
+
+static void route( mix_filter_t *h, int64_t ch )
+{
+    if( spread( h, ch, ch, 1 ) )
+        return;
+    int i = 0;
+    while( routes[i].ch && routes[i].ch != ch )
+        i++;
+    for( const target_t *t = routes[i].to; t->to; t++ )
+        if( spread( h, ch, t->to, t->coef ) )
+            return;
+}
+
+static int init( hnd_t *handle, const char *opt_str )
+{
+    assert( *handle ); // There must be a source before
+    char **opts = x264_split_options( opt_str ? opt_str : "", (const char*[]){ "layout", "channels", "normalize", NULL } );
+    if( !opts )
+        return -1;
+    char *layoutstr = x264_get_option( "layout", opts );
+    int channels    = x264_otoi( x264_get_option( "channels", opts ), 0 );
+    int normalize   = x264_otob( x264_get_option( "normalize", opts ), 1 );
+
+    INIT_FILTER_STRUCT( audio_filter_mix, mix_filter_t );
+
+    int64_t layout = 0;
+    if( layoutstr )
+    {
+        for( int i = 0; layouts[i].name && !layout; i++ )
+            if( !strcasecmp( layoutstr, layouts[i].name ) )
+                layout = layouts[i].layout;
+        if( !layout )
+        {
+            AF_LOG_ERR( h, "unknown channel layout '%s'\n", layoutstr );
+            goto fail;
+        }
+    }
+    else if( !(layout = default_layout( channels )) )
+    {
+        AF_LOG_ERR( h, "no output layout given (layout, or channels up to 8)\n" );
+        goto fail;
+    }
+
+    h->inchannels = h->info.channels;
+    h->inlayout   = h->info.chanlayout;
+    if( count_channels( h->inlayout ) != h->inchannels )
+        h->inlayout = default_layout( h->inchannels );
+    if( !h->inlayout )
+    {
+        AF_LOG_ERR( h, "unknown channel layout of %d source channels\n", h->inchannels );
+        goto fail;
+    }
+
+    h->info.chanlayout = layout;
+    h->info.channels   = count_channels( layout );
+    h->info.samplesize = h->info.chansize * h->info.channels;
+    h->info.framesize  = h->info.framelen * h->info.samplesize;
+
+    h->matrix = calloc( h->info.channels * h->inchannels, sizeof(float) );
+    if( !h->matrix )
+        goto fail;
+    for( int64_t ch = h->inlayout; ch; ch &= ch - 1 )
+        route( h, ch & -ch );
+
+    float max = 0;
+    for( int o = 0; o < h->info.channels; o++ )
+    {
+        float sum = 0;
+        for( int i = 0; i < h->inchannels; i++ )
+            sum += fabsf( h->matrix[o * h->inchannels + i] );
+        max = X264_MAX( max, sum );
+    }
+    if( normalize && max > 1 )
+        for( int i = 0; i < h->info.channels * h->inchannels; i++ )
+            h->matrix[i] /= max;
+
+    h->identity = h->inlayout == layout;
+    AF_LOG( h, X264_LOG_INFO, "%d to %d channels%s\n", h->inchannels, h->info.channels,
+            h->identity ? ", nothing to do" : "" );
+    x264_free_string_array( opts );
+    return 0;
+
+fail:
+    if( h )
+    {
+        *handle = h->prev;
+        free( h->matrix );
+        free( h );
+    }
+    x264_free_string_array( opts );
+    return -1;
+}
+
+/* A few scale/mac passes per channel: too little work to be worth handing out to threads. */
+static void mix_channels( mix_filter_t *h, float **out, float **in, int samplecount )
+{
+    for( int o = 0; o < h->info.channels; o++ )
+    {
+        const float *row = &h->matrix[o * h->inchannels];
+        int mixed = 0;
+        for( int i = 0; i < h->inchannels; i++ )
+        {
+            if( !row[i] )
+                continue;
+            if( mixed++ )
+                x264_af_dsp.mac( out[o], in[i], row[i], samplecount );
+            else
+                x264_af_dsp.scale( out[o], in[i], row[i], samplecount );
+        }
+        if( !mixed )
+            memset( out[o], 0, samplecount * sizeof(float) );
+    }
+}
+
+static struct audio_packet_t *get_samples( hnd_t handle, int64_t first_sample, int64_t last_sample )
+{
+    mix_filter_t *h = handle;
+    audio_packet_t *in = x264_af_get_samples( h->prev, first_sample, last_sample );
+    if( !in || h->identity )
+        return in;
+
+    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
+    if( !out )
+        goto fail;
+    out->info        = h->info;
+    out->channels    = h->info.channels;
+    out->dts         = in->dts;
+    out->flags       = in->flags;
+    out->samplecount = in->samplecount;
+    out->size        = out->samplecount * h->info.samplesize;
+    out->samples     = x264_af_get_buffer( h->pool, out->channels, X264_MAX( out->samplecount, 1 ) );
+    if( !out->samples )
+        goto fail;
+
+    mix_channels( h, out->samples, in->samples, out->samplecount );
+    x264_af_free_packet( in );
+    return out;
+
+fail:
+    x264_af_free_packet( in );
+    x264_af_free_packet( out );
+    return NULL;
+}
+
+static void free_packet( hnd_t handle, audio_packet_t *pkt )
+{
+    pkt->owner = NULL;
+    x264_af_free_packet( pkt );
+}
+
+static void mix_close( hnd_t handle )
+{
+    mix_filter_t *h = handle;
+    free( h->matrix );
+    free( h );
+}
+
+const audio_filter_t audio_filter_mix =
+{
+    .name        = "mix",
+    .description = "Downmixes or upmixes to another channel layout",
+    .help        = "Arguments: layout,channels,normalize",
+    .init        = init,
+    .get_samples = get_samples,
+    .free_packet = free_packet,
+    .close       = mix_close
+};
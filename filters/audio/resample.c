@@ -0,0 +1,251 @@
+#include "filters/audio/internal.h"
+#include <assert.h>
+#include <math.h>
+
+/* Polyphase windowed sinc resampler.  Output sample n sits at n * down / up
+ * in input samples, and is the dot product of the input around it with the
+ * filter phase matching its fractional position.  Nothing is kept between
+ * requests but the filter bank, so any range of samples can be asked for. */
+
+#define ZERO_CROSSINGS 16   // of the sinc on either side, at the input rate when upsampling
+#define CUTOFF 0.95         // of the lower nyquist frequency
+#define KAISER_BETA 9.0
+#define MAX_PHASES 1024     // ratios needing more use the phase just before the exact position
+
+typedef struct resample_filter_t
+{
+    AUDIO_FILTER_COMMON
+    int64_t up, down;       // output and input rates, reduced
+    int phases;
+    int half;               // taps on either side of the output position
+    int taps;
+    float *bank;            // [phase][tap]
+    int64_t in_end;         // input length, -1 until the end was seen
+    audio_channel_workers_t *workers;
+} resample_filter_t;
+
+const audio_filter_t audio_filter_resample;
+
+static double bessel_i0( double x )
+{
+    double sum = 1, term = 1;
+    for( int k = 1; term > sum * 1e-12; k++ )
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static int init_bank( resample_filter_t *h )
+{
+    double scale = X264_MIN( 1.0, (double)h->up / h->down );
+    double fc = scale * CUTOFF;
+    h->half = ceil( ZERO_CROSSINGS / scale );
+    h->taps = 2 * h->half;
+    h->phases = X264_MIN( h->up, MAX_PHASES );
+    h->bank = malloc( (size_t)h->phases * h->taps * sizeof(float) );
+    if( !h->bank )
+        return -1;
+
+    double norm = bessel_i0( KAISER_BETA );
+    for( int p = 0; p < h->phases; p++ )
+    {
+        float *coef = &h->bank[p * h->taps];
+        double frac = (double)p / h->phases, sum = 0;
+        for( int k = 0; k < h->taps; k++ )
+        {
+            double d = k - h->half + 1 - frac;  // from the output position, in input samples
+            double x = d / h->half;
+            double w = fabs( x ) < 1 ? bessel_i0( KAISER_BETA * sqrt( 1 - x * x ) ) / norm : 0;
+            double s = d ? sin( M_PI * fc * d ) / (M_PI * fc * d) : 1;
+            coef[k] = fc * s * w;
+            sum += coef[k];
+        }
+        /* unity gain at dc whatever the phase */
+        for( int k = 0; k < h->taps; k++ )
+            coef[k] /= sum;
+    }
+    return 0;
+}
+
+static int init( hnd_t *handle, const char *opt_str )
+{
+    assert( *handle ); // There must be a source before
+    char **opts = x264_split_options( opt_str ? opt_str : "", (const char*[]){ "samplerate", "threads", NULL } );
+    if( !opts )
+        return -1;
+    int samplerate = x264_otoi( x264_get_option( "samplerate", opts ), 0 );
+    int threads    = x264_otoi( x264_get_option( "threads", opts ), 0 );
+    x264_free_string_array( opts );
+
+    INIT_FILTER_STRUCT( audio_filter_resample, resample_filter_t );
+    if( samplerate <= 0 || h->info.samplerate <= 0 )
+    {
+        AF_LOG_ERR( h, "invalid samplerate %d\n", samplerate );
+        goto fail;
+    }
+
+    int64_t div = gcd( samplerate, h->info.samplerate );
+    h->up     = samplerate / div;
+    h->down   = h->info.samplerate / div;
+    h->in_end = -1;
+    if( h->up != h->down )
+    {
+        if( init_bank( h ) < 0 )
+            goto fail;
+        h->workers = x264_af_workers_open( h->info.channels, threads );
+    }
+    AF_LOG( h, X264_LOG_INFO, "%dhz to %dhz%s\n", h->info.samplerate, samplerate,
+            h->up == h->down ? ", nothing to do" : "" );
+
+    h->info.framelen   = ((int64_t)h->info.framelen * h->up + h->down / 2) / h->down;
+    h->info.framesize  = h->info.framelen * h->info.samplesize;
+    h->info.last_delta = ((int64_t)h->info.last_delta * h->up + h->down / 2) / h->down;
+    h->info.samplerate = samplerate;
+    h->info.timebase   = (timebase_t){ 1, samplerate };
+    return 0;
+
+fail:
+    if( h )
+    {
+        *handle = h->prev;
+        free( h->bank );
+        free( h );
+    }
+    return -1;
+}
+
+typedef struct
+{
+    resample_filter_t *h;
+    float **in;             // starting where the kernel of the first output sample does
+    float **out;
+    int64_t first;
+    int samplecount;
+} resample_job_t;
+
+static void resample_channels( void *arg, int first, int last )
+{
+    resample_job_t *job = arg;
+    resample_filter_t *h = job->h;
+    int64_t step = h->down / h->up, step_frac = h->down % h->up;
+    for( int c = first; c < last; c++ )
+    {
+        int64_t pos  = 0;
+        int64_t frac = job->first * h->down % h->up;
+        const float *in = job->in[c];
+        float *out = job->out[c];
+        for( int i = 0; i < job->samplecount; i++ )
+        {
+            int phase = h->phases == h->up ? frac : frac * h->phases / h->up;
+            out[i] = x264_af_dsp.dot( &h->bank[phase * h->taps], in + pos, h->taps );
+            pos  += step;
+            frac += step_frac;
+            if( frac >= h->up )
+            {
+                frac -= h->up;
+                pos++;
+            }
+        }
+    }
+}
+
+static struct audio_packet_t *get_samples( hnd_t handle, int64_t first_sample, int64_t last_sample )
+{
+    resample_filter_t *h = handle;
+    if( h->up == h->down )
+        return x264_af_get_samples( h->prev, first_sample, last_sample );
+
+    int64_t in_first = first_sample * h->down / h->up - h->half + 1;
+    int64_t in_last  = (last_sample - 1) * h->down / h->up + h->half + 1;
+    int64_t fetch    = X264_MAX( in_first, 0 );
+    audio_packet_t *in = NULL;
+    float **window = NULL;
+    if( h->in_end < 0 || fetch < h->in_end )
+    {
+        in = x264_af_get_samples( h->prev, fetch, in_last );
+        if( !in )
+            return NULL;
+        if( in->flags & AUDIO_FLAG_EOF && h->in_end < 0 )
+            h->in_end = fetch + in->samplecount;
+    }
+
+    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
+    if( !out )
+        goto fail;
+    int64_t end = last_sample;
+    if( h->in_end >= 0 )
+    {
+        int64_t out_end = (h->in_end * h->up + h->down - 1) / h->down;
+        if( last_sample > out_end )
+            out->flags |= AUDIO_FLAG_EOF;
+        end = X264_MIN( end, out_end );
+    }
+    out->info        = h->info;
+    out->channels    = h->info.channels;
+    out->dts         = first_sample;
+    out->samplecount = X264_MAX( end - first_sample, 0 );
+    out->size        = out->samplecount * h->info.samplesize;
+    out->samples     = x264_af_get_buffer( h->pool, out->channels, X264_MAX( out->samplecount, 1 ) );
+    if( !out->samples )
+        goto fail;
+    if( !out->samplecount )
+    {
+        x264_af_free_packet( in );
+        return out;
+    }
+
+    /* the kernel reaches past both ends of the input, where it's silent */
+    if( in && fetch == in_first && in->samplecount == in_last - in_first )
+        window = in->samples;
+    else
+    {
+        window = x264_af_get_buffer( h->pool, out->channels, in_last - in_first );
+        if( !window )
+            goto fail;
+        for( int c = 0; c < out->channels; c++ )
+        {
+            memset( window[c], 0, (in_last - in_first) * sizeof(float) );
+            if( in )
+                memcpy( window[c] + fetch - in_first, in->samples[c], in->samplecount * sizeof(float) );
+        }
+    }
+
+    resample_job_t job = { h, window, out->samples, first_sample, out->samplecount };
+    x264_af_workers_run( h->workers, out->channels, resample_channels, &job );
+    if( !in || window != in->samples )
+        x264_af_free_buffer( window, out->channels );
+    x264_af_free_packet( in );
+    return out;
+
+fail:
+    x264_af_free_packet( in );
+    x264_af_free_packet( out );
+    return NULL;
+}
+
+static void free_packet( hnd_t handle, audio_packet_t *pkt )
+{
+    pkt->owner = NULL;
+    x264_af_free_packet( pkt );
+}
+
+static void resample_close( hnd_t handle )
+{
+    resample_filter_t *h = handle;
+    x264_af_workers_close( h->workers );
+    free( h->bank );
+    free( h );
+}
+
+const audio_filter_t audio_filter_resample =
+{
+    .name        = "resample",
+    .description = "Converts the samplerate",
+    .help        = "Arguments: samplerate,threads",
+    .init        = init,
+    .get_samples = get_samples,
+    .free_packet = free_packet,
+    .close       = resample_close
+};
@@ -35,9 +35,10 @@ typedef struct
 
     int max_size;
     int first_frame; /* first cached frame */
-    cli_pic_t **cache;
+    cli_pic_t *cache; /* frame n is cached at n % max_size, each holding a reference */
     int cur_size;
     int eof;         /* frame beyond end of the file */
+    cli_pic_pool_t *pool; /* for copies of the frames that aren't reference counted */
 } cache_hnd_t;
 
 cli_vid_filter_t cache_filter;
@@ -53,17 +54,13 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x2
         return -1;
 
     h->max_size = size;
-    h->cache = malloc( (h->max_size+1) * sizeof(cli_pic_t*) );
+    h->cache = calloc( h->max_size, sizeof(cli_pic_t) );
     if( !h->cache )
         return -1;
-
-    for( int i = 0; i < h->max_size; i++ )
-    {
-        h->cache[i] = malloc( sizeof(cli_pic_t) );
-        if( !h->cache[i] || x264_cli_pic_alloc( h->cache[i], info->csp, info->width, info->height ) )
-            return -1;
-    }
-    h->cache[h->max_size] = NULL; /* require null terminator for list methods */
+    /* pictures are only allocated when the preceding filter's frames can't be referenced */
+    h->pool = x264_cli_pic_pool_create( info->csp, info->width, info->height );
+    if( !h->pool )
+        return -1;
 
     h->prev_filter = *filter;
     h->prev_hnd = *handle;
@@ -73,6 +70,24 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x2
     return 0;
 }
 
+/* keep a reference to the frame, or a copy of it if it's not reference counted */
+static int hold_frame( cache_hnd_t *h, cli_pic_t *cache, cli_pic_t *pic )
+{
+    if( !x264_cli_pic_ref( pic ) )
+    {
+        *cache = *pic;
+        return 0;
+    }
+    if( x264_cli_pic_pool_get( h->pool, cache ) )
+        return -1;
+    if( x264_cli_pic_copy( cache, pic ) )
+    {
+        x264_cli_pic_unref( cache );
+        return -1;
+    }
+    return 0;
+}
+
 static void fill_cache( cache_hnd_t *h, int frame )
 {
     /* shift frames out of the cache as the frame request is beyond the filled cache */
@@ -88,22 +103,32 @@ static void fill_cache( cache_hnd_t *h, int frame )
     /* the new starting point is either
      * A) the current one shifted the number of frames entering/leaving the cache, or
      * B) at a new frame that has the end of the cache at the desired frame. */
-    h->first_frame = X264_MIN( h->first_frame + shift, cur_frame );
+    int first_frame = X264_MIN( h->first_frame + shift, cur_frame );
+    for( int i = h->first_frame; i <= LAST_FRAME && i < first_frame; i++ )
+        x264_cli_pic_unref( &h->cache[i % h->max_size] );
+    h->first_frame = first_frame;
     h->cur_size = X264_MAX( h->cur_size - shift, 0 );
     while( h->cur_size < h->max_size )
     {
         cli_pic_t temp;
-        /* the old front frame is going to shift off, overwrite it with the new frame */
-        cli_pic_t *cache = h->cache[0];
-        if( h->prev_filter.get_frame( h->prev_hnd, &temp, cur_frame ) ||
-            x264_cli_pic_copy( cache, &temp ) ||
-            h->prev_filter.release_frame( h->prev_hnd, &temp, cur_frame ) )
+        /* the slot of the new frame belongs to a frame that has just shifted off */
+        cli_pic_t *cache = &h->cache[cur_frame % h->max_size];
+        if( h->prev_filter.get_frame( h->prev_hnd, &temp, cur_frame ) )
+        {
+            h->eof = cur_frame;
+            return;
+        }
+        int ret = hold_frame( h, cache, &temp );
+        if( h->prev_filter.release_frame( h->prev_hnd, &temp, cur_frame ) && !ret )
+        {
+            x264_cli_pic_unref( cache );
+            ret = -1;
+        }
+        if( ret )
         {
             h->eof = cur_frame;
             return;
         }
-        /* the read was successful, shift the frame off the front to the end */
-        x264_frame_push( (void*)h->cache, x264_frame_shift( (void*)h->cache ) );
         cur_frame++;
         h->cur_size++;
     }
@@ -116,26 +141,26 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
     fill_cache( h, frame );
     if( frame > LAST_FRAME ) /* eof */
         return -1;
-    int idx = frame - (h->eof ? h->eof - h->max_size : h->first_frame);
-    *output = *h->cache[idx];
+    *output = h->cache[frame % h->max_size];
+    /* the frame stays valid until it's released even if it leaves the cache in the meantime */
+    x264_cli_pic_ref( output );
     return 0;
 }
 
 static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
 {
-    /* the parent filter's frame has already been released so do nothing here */
+    /* the parent filter's frame has already been released so only drop the reference here */
+    x264_cli_pic_unref( pic );
     return 0;
 }
 
 static void free_filter( hnd_t handle )
 {
     cache_hnd_t *h = handle;
+    for( int i = h->first_frame; i <= LAST_FRAME; i++ )
+        x264_cli_pic_unref( &h->cache[i % h->max_size] );
     h->prev_filter.free( h->prev_hnd );
-    for( int i = 0; i < h->max_size; i++ )
-    {
-        x264_cli_pic_clean( h->cache[i] );
-        free( h->cache[i] );
-    }
+    x264_cli_pic_pool_delete( h->pool );
     free( h->cache );
     free( h );
 }
@@ -27,8 +27,48 @@
 #define NAME "depth"
 #define FAIL_IF_ERROR( cond, ... ) FAIL_IF_ERR( cond, NAME, __VA_ARGS__ )
 
+/* rows are dithered in chunks of this many pixels when several threads share a plane */
+#define DITHER_CHUNK 256
+/* and handed out to the threads in bands of this many rows, which only wait on each other between bands */
+#define DITHER_BAND 32
+/* the progress of the last row of a band is signaled every this many chunks */
+#define DITHER_SIGNAL 4
+/* don't bother with threads for frames smaller than this */
+#define DITHER_THREAD_MIN_PIXELS (1280*720)
+#define DITHER_MAX_THREADS 8
+
 cli_vid_filter_t depth_filter;
 
+typedef void (*dither_row_t)( pixel *dst, uint16_t *src, int16_t *errors, int x_start, int x_end, int *err );
+
+/* Sierra-2-4A needs the errors of the row above up to one pixel to the right, so rows can be dithered
+ * by several threads at once in a skewed wavefront: each row trails the row above by at least one chunk.
+ * Each thread runs the wavefront over its own bands of rows, so the progress is only shared between
+ * the last row of a band and the first row of the next one. */
+typedef struct
+{
+    dither_row_t dither_row;
+    pixel *dst;
+    int dst_stride;
+    uint16_t *src;
+    int src_stride;
+    int width;
+    int height;
+    int16_t *errors;
+    int threads;
+#if HAVE_THREAD
+    int *progress;      /* number of pixels done in the last row of each band */
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t cv;
+#endif
+} dither_plane_t;
+
+typedef struct
+{
+    dither_plane_t *plane;
+    int first_band;
+} dither_job_t;
+
 typedef struct
 {
     hnd_t prev_hnd;
@@ -36,8 +76,11 @@ typedef struct
 
     int bit_depth;
     int dst_csp;
-    cli_pic_t buffer;
+    cli_pic_pool_t *pic_pool;
     int16_t *error_buf;
+    dither_plane_t plane;
+    x264_threadpool_t *pool;
+    dither_job_t jobs[DITHER_MAX_THREADS];
 } depth_hnd_t;
 
 static int depth_filter_csp_is_supported( int csp )
@@ -69,33 +112,124 @@ static int csp_num_interleaved( int csp, int plane )
  * written in such a way so that if the source has been upconverted using the
  * same algorithm as used in scale_image, dithering down to the source bit
  * depth again is lossless. */
-#define DITHER_PLANE( pitch ) \
-static void dither_plane_##pitch( pixel *dst, int dst_stride, uint16_t *src, int src_stride, \
-                                  int width, int height, int16_t *errors ) \
+#define DITHER_ROW( pitch ) \
+static void dither_row_##pitch( pixel *dst, uint16_t *src, int16_t *errors, int x_start, int x_end, int *err_carry ) \
 { \
     const int lshift = 16-BIT_DEPTH; \
     const int rshift = 16-BIT_DEPTH+2; \
     const int half = 1 << (16-BIT_DEPTH+1); \
     const int pixel_max = (1 << BIT_DEPTH)-1; \
-    memset( errors, 0, (width+1) * sizeof(int16_t) ); \
-    for( int y = 0; y < height; y++, src += src_stride, dst += dst_stride ) \
+    int err = *err_carry; \
+    for( int x = x_start; x < x_end; x++ ) \
     { \
-        int err = 0; \
-        for( int x = 0; x < width; x++ ) \
-        { \
-            err = err*2 + errors[x] + errors[x+1]; \
-            dst[x*pitch] = x264_clip3( ((src[x*pitch]<<2)+err+half) >> rshift, 0, pixel_max ); \
-            errors[x] = err = src[x*pitch] - (dst[x*pitch] << lshift); \
-        } \
+        err = err*2 + errors[x] + errors[x+1]; \
+        int v = ((src[x*pitch]<<2)+err+half) >> rshift; \
+        v = v < 0 ? 0 : v > pixel_max ? pixel_max : v; \
+        dst[x*pitch] = v; \
+        errors[x] = err = src[x*pitch] - (v << lshift); \
     } \
+    *err_carry = err; \
+}
+
+DITHER_ROW( 1 )
+DITHER_ROW( 2 )
+DITHER_ROW( 3 )
+DITHER_ROW( 4 )
+
+#if HAVE_THREAD
+static void dither_band( dither_plane_t *p, int band )
+{
+    int first = band * DITHER_BAND;
+    int rows = X264_MIN( DITHER_BAND, p->height - first );
+    int chunks = (p->width + DITHER_CHUNK - 1) / DITHER_CHUNK;
+    int err[DITHER_BAND] = {0};
+    int available = 0;  /* pixels of the row above the band known to be done */
+    /* at each step, row r of the band dithers chunk step - r, right after the row above did the chunk after it */
+    for( int step = 0; step < chunks + rows - 1; step++ )
+        for( int r = 0; r < rows; r++ )
+        {
+            int c = step - r;
+            if( c < 0 || c >= chunks )
+                continue;
+            int y = first + r;
+            int x = c * DITHER_CHUNK;
+            int x_end = X264_MIN( x + DITHER_CHUNK, p->width );
+            if( !r && band )
+            {
+                /* errors[x_end] of the row above is read as well */
+                int needed = X264_MIN( x_end + 1, p->width );
+                if( available < needed )
+                {
+                    x264_pthread_mutex_lock( &p->mutex );
+                    while( p->progress[band-1] < needed )
+                        x264_pthread_cond_wait( &p->cv, &p->mutex );
+                    available = p->progress[band-1];
+                    x264_pthread_mutex_unlock( &p->mutex );
+                }
+            }
+
+            p->dither_row( p->dst + y * p->dst_stride, p->src + y * p->src_stride, p->errors, x, x_end, &err[r] );
+
+            if( r == rows - 1 )
+            {
+                x264_pthread_mutex_lock( &p->mutex );
+                p->progress[band] = x_end;
+                /* waking the next band up for every chunk costs more than it gains */
+                if( !((c+1) % DITHER_SIGNAL) || x_end == p->width )
+                    x264_pthread_cond_broadcast( &p->cv );
+                x264_pthread_mutex_unlock( &p->mutex );
+            }
+        }
 }
+#endif
 
-DITHER_PLANE( 1 )
-DITHER_PLANE( 2 )
-DITHER_PLANE( 3 )
-DITHER_PLANE( 4 )
+static void *dither_rows( dither_job_t *job )
+{
+    dither_plane_t *p = job->plane;
+#if HAVE_THREAD
+    if( p->threads > 1 )
+    {
+        for( int band = job->first_band; band * DITHER_BAND < p->height; band += p->threads )
+            dither_band( p, band );
+        return NULL;
+    }
+#endif
+    for( int y = 0; y < p->height; y++ )
+    {
+        int err = 0;
+        p->dither_row( p->dst + y * p->dst_stride, p->src + y * p->src_stride, p->errors, 0, p->width, &err );
+    }
+    return NULL;
+}
 
-static void dither_image( cli_image_t *out, cli_image_t *img, int16_t *error_buf )
+static void dither_plane( depth_hnd_t *h, dither_row_t dither_row, pixel *dst, int dst_stride,
+                          uint16_t *src, int src_stride, int width, int height )
+{
+    dither_plane_t *p = &h->plane;
+    p->dither_row = dither_row;
+    p->dst = dst;
+    p->dst_stride = dst_stride;
+    p->src = src;
+    p->src_stride = src_stride;
+    p->width = width;
+    p->height = height;
+    memset( p->errors, 0, (width+1) * sizeof(int16_t) );
+#if HAVE_THREAD
+    if( p->threads > 1 )
+    {
+        memset( p->progress, 0, (height + DITHER_BAND - 1) / DITHER_BAND * sizeof(int) );
+        for( int i = 1; i < p->threads; i++ )
+            x264_threadpool_run( h->pool, (void*)dither_rows, &h->jobs[i] );
+        dither_rows( &h->jobs[0] );
+        for( int i = 1; i < p->threads; i++ )
+            x264_threadpool_wait( h->pool, &h->jobs[i] );
+        return;
+    }
+#endif
+    dither_rows( &h->jobs[0] );
+}
+
+static void dither_image( depth_hnd_t *h, cli_image_t *out, cli_image_t *img )
 {
     int csp_mask = img->csp & X264_CSP_MASK;
     for( int i = 0; i < img->planes; i++ )
@@ -105,8 +239,8 @@ static void dither_image( cli_image_t *out, cli_image_t *img, int16_t *error_buf
         int width = x264_cli_csps[csp_mask].width[i] * img->width / num_interleaved;
 
 #define CALL_DITHER_PLANE( pitch, off ) \
-        dither_plane_##pitch( ((pixel*)out->plane[i])+off, out->stride[i]/sizeof(pixel), \
-                ((uint16_t*)img->plane[i])+off, img->stride[i]/2, width, height, error_buf )
+        dither_plane( h, dither_row_##pitch, ((pixel*)out->plane[i])+off, out->stride[i]/sizeof(pixel), \
+                      ((uint16_t*)img->plane[i])+off, img->stride[i]/2, width, height )
 
         if( num_interleaved == 4 )
         {
@@ -133,10 +267,30 @@ static void dither_image( cli_image_t *out, cli_image_t *img, int16_t *error_buf
     }
 }
 
+/* Widens 4 pixels at a time within a 64-bit register (the build disables tree vectorization).
+ * Spreading the bytes of a native 32-bit load to every other byte keeps them in memory order on either endianness,
+ * and shifting can't carry across the 16-bit lanes as the results fit in 16 bits. */
+static void scale_row( uint16_t *dst, const uint8_t *src, int width )
+{
+    const int shift = BIT_DEPTH - 8;
+    int k = 0;
+    for( ; k <= width - 4; k += 4 )
+    {
+        uint32_t v;
+        memcpy( &v, src + k, 4 );
+        uint64_t x = v;
+        x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+        x = (x | (x <<  8)) & 0x00ff00ff00ff00ffULL;
+        x <<= shift;
+        memcpy( dst + k, &x, 8 );
+    }
+    for( ; k < width; k++ )
+        dst[k] = src[k] << shift;
+}
+
 static void scale_image( cli_image_t *output, cli_image_t *img )
 {
     int csp_mask = img->csp & X264_CSP_MASK;
-    const int shift = BIT_DEPTH - 8;
     for( int i = 0; i < img->planes; i++ )
     {
         uint8_t *src = img->plane[i];
@@ -144,11 +298,15 @@ static void scale_image( cli_image_t *output, cli_image_t *img )
         int height = x264_cli_csps[csp_mask].height[i] * img->height;
         int width = x264_cli_csps[csp_mask].width[i] * img->width;
 
+        /* do whole planes at once when there's no padding */
+        if( img->stride[i] == width && output->stride[i] == width*2 )
+        {
+            width *= height;
+            height = 1;
+        }
         for( int j = 0; j < height; j++ )
         {
-            for( int k = 0; k < width; k++ )
-                dst[k] = src[k] << shift;
-
+            scale_row( dst, src, width );
             src += img->stride[i];
             dst += output->stride[i]/2;
         }
@@ -158,26 +316,42 @@ static void scale_image( cli_image_t *output, cli_image_t *img )
 static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
 {
     depth_hnd_t *h = handle;
+    cli_pic_t in;
 
-    if( h->prev_filter.get_frame( h->prev_hnd, output, frame ) )
+    if( h->prev_filter.get_frame( h->prev_hnd, &in, frame ) )
         return -1;
 
-    if( h->bit_depth < 16 && output->img.csp & X264_CSP_HIGH_DEPTH )
+    int dither = h->bit_depth < 16 && in.img.csp & X264_CSP_HIGH_DEPTH;
+    int scale = h->bit_depth > 8 && !(in.img.csp & X264_CSP_HIGH_DEPTH);
+    if( !dither && !scale )
     {
-        dither_image( &h->buffer.img, &output->img, h->error_buf );
-        output->img = h->buffer.img;
+        *output = in;
+        return 0;
     }
-    else if( h->bit_depth > 8 && !(output->img.csp & X264_CSP_HIGH_DEPTH) )
+
+    /* the converted frame doesn't refer to the input one, which is released right away */
+    if( x264_cli_pic_pool_get( h->pic_pool, output ) )
     {
-        scale_image( &h->buffer.img, &output->img );
-        output->img = h->buffer.img;
+        h->prev_filter.release_frame( h->prev_hnd, &in, frame );
+        return -1;
     }
-    return 0;
+    if( dither )
+        dither_image( h, &output->img, &in.img );
+    else
+        scale_image( &output->img, &in.img );
+    output->pts = in.pts;
+    output->duration = in.duration;
+    return h->prev_filter.release_frame( h->prev_hnd, &in, frame );
 }
 
 static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
 {
     depth_hnd_t *h = handle;
+    if( x264_cli_pic_is_from_pool( pic, h->pic_pool ) )
+    {
+        x264_cli_pic_unref( pic );
+        return 0;
+    }
     return h->prev_filter.release_frame( h->prev_hnd, pic, frame );
 }
 
@@ -185,7 +359,16 @@ static void free_filter( hnd_t handle )
 {
     depth_hnd_t *h = handle;
     h->prev_filter.free( h->prev_hnd );
-    x264_cli_pic_clean( &h->buffer );
+    x264_cli_pic_pool_delete( h->pic_pool );
+#if HAVE_THREAD
+    if( h->plane.threads > 1 )
+    {
+        x264_threadpool_delete( h->pool );
+        x264_pthread_mutex_destroy( &h->plane.mutex );
+        x264_pthread_cond_destroy( &h->plane.cv );
+        free( h->plane.progress );
+    }
+#endif
     x264_free( h );
 }
 
@@ -196,16 +379,18 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info,
     int change_fmt = (info->csp ^ param->i_csp) & X264_CSP_HIGH_DEPTH;
     int csp = ~(~info->csp ^ change_fmt);
     int bit_depth = 8*x264_cli_csp_depth_factor( csp );
+    int threads = -1;
 
     if( opt_string )
     {
-        static const char *optlist[] = { "bit_depth", NULL };
+        static const char *optlist[] = { "bit_depth", "threads", NULL };
         char **opts = x264_split_options( opt_string, optlist );
 
         if( opts )
         {
             char *str_bit_depth = x264_get_option( "bit_depth", opts );
             bit_depth = x264_otoi( str_bit_depth, -1 );
+            threads = x264_otoi( x264_get_option( "threads", opts ), -1 );
 
             ret = bit_depth < 8 || bit_depth > 16;
             csp = bit_depth > 8 ? csp | X264_CSP_HIGH_DEPTH : csp & ~X264_CSP_HIGH_DEPTH;
@@ -229,20 +414,66 @@ static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info,
             return -1;
 
         h->error_buf = (int16_t*)(h + 1);
+        h->plane.errors = h->error_buf;
+        h->plane.threads = 1;
+        for( int i = 0; i < DITHER_MAX_THREADS; i++ )
+        {
+            h->jobs[i].plane = &h->plane;
+            h->jobs[i].first_band = i;
+        }
         h->dst_csp = csp;
         h->bit_depth = bit_depth;
         h->prev_hnd = *handle;
         h->prev_filter = *filter;
 
-        if( x264_cli_pic_alloc( &h->buffer, h->dst_csp, info->width, info->height ) )
+        h->pic_pool = x264_cli_pic_pool_create( h->dst_csp, info->width, info->height );
+        if( !h->pic_pool )
         {
             x264_free( h );
             return -1;
         }
 
+#if HAVE_THREAD
+        /* only dithering is worth to be split, and by default only for large frames */
+        if( threads < 0 && info->width * info->height >= DITHER_THREAD_MIN_PIXELS )
+            threads = param->i_threads == X264_THREADS_AUTO ? x264_cpu_num_processors() : param->i_threads;
+        threads = X264_MIN( threads, DITHER_MAX_THREADS );
+        int sync = 0;   /* number of the mutex and condvar set up, undone in reverse order on failure */
+        if( threads > 1 && bit_depth < 16 && info->csp & X264_CSP_HIGH_DEPTH )
+        {
+            h->plane.progress = malloc( (info->height + DITHER_BAND - 1) / DITHER_BAND * sizeof(int) );
+            if( !h->plane.progress )
+                goto fail;
+            if( x264_pthread_mutex_init( &h->plane.mutex, NULL ) )
+                goto fail;
+            sync++;
+            if( x264_pthread_cond_init( &h->plane.cv, NULL ) )
+                goto fail;
+            sync++;
+            /* last, since a pool that failed to start can't be deleted */
+            if( x264_threadpool_init( &h->pool, threads-1, NULL, NULL ) )
+                goto fail;
+            h->plane.threads = threads;
+            x264_cli_log( NAME, X264_LOG_INFO, "dithering with %d threads\n", threads );
+        }
+#endif
+
         *handle = h;
         *filter = depth_filter;
         info->csp = h->dst_csp;
+        return 0;
+
+#if HAVE_THREAD
+fail:
+        if( sync > 1 )
+            x264_pthread_cond_destroy( &h->plane.cv );
+        if( sync > 0 )
+            x264_pthread_mutex_destroy( &h->plane.mutex );
+        free( h->plane.progress );
+        x264_cli_pic_pool_delete( h->pic_pool );
+        x264_free( h );
+        return -1;
+#endif
     }
 
     return 0;
@@ -0,0 +1,288 @@
+/*****************************************************************************
+ * pipeline.c: pipelined video filter stage
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "video.h"
+#include "internal.h"
+#define NAME "pipeline"
+#define FAIL_IF_ERROR( cond, ... ) FAIL_IF_ERR( cond, NAME, __VA_ARGS__ )
+
+/* This filter runs all of the preceding filters on a worker thread, which fills a bounded queue of frames
+ * ahead of the requests. Reference counted frames are queued as they are, others are copied.
+ * Only the worker thread touches the preceding filters once the stage is running,
+ * so they only need to be able to run off the main thread (see video_info_t.thread_safe).
+ * Frames are requested in increasing order as with the source filter;
+ * the consumer may hold at most 'depth' frames at a time. */
+
+#define DEFAULT_DEPTH 4
+#define MAX_DEPTH 64
+
+cli_vid_filter_t pipeline_filter;
+
+#if HAVE_THREAD
+enum
+{
+    SLOT_QUEUED = 0,    /* filled or being filled by the worker, not handed out yet */
+    SLOT_HELD,          /* handed out to the consumer */
+    SLOT_RELEASED       /* released by the consumer, recycled once all preceding frames are */
+};
+
+typedef struct
+{
+    hnd_t prev_hnd;
+    cli_vid_filter_t prev_filter;
+
+    x264_pthread_t thread;
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t cv_fill;   /* signaled by the worker when a frame is ready or the input ended */
+    x264_pthread_cond_t cv_empty;  /* signaled by the consumer when a slot can be refilled */
+
+    int depth;
+    cli_pic_t *pic;     /* slot of frame n is n % depth, each holding a reference */
+    cli_pic_pool_t *pool;
+    int *state;
+    int first_frame;    /* oldest frame not yet recycled, -1 until the first request */
+    int next_frame;     /* next frame to be filled by the worker */
+    int eof;            /* first frame not delivered by the preceding filters, INT_MAX if unknown */
+    int exit;
+} pipeline_hnd_t;
+
+static void help( int longhelp )
+{
+    printf( "      "NAME":[depth]\n" );
+    if( !longhelp )
+        return;
+    printf( "            runs the preceding filters on a separate thread\n"
+            "            depth: the number of frames filtered ahead [%d]\n", DEFAULT_DEPTH );
+}
+
+static void *pipeline_thread( pipeline_hnd_t *h )
+{
+    x264_pthread_mutex_lock( &h->mutex );
+    while( !h->exit )
+    {
+        if( h->first_frame < 0 || h->next_frame >= h->eof || h->next_frame - h->first_frame >= h->depth )
+        {
+            x264_pthread_cond_wait( &h->cv_empty, &h->mutex );
+            continue;
+        }
+        int frame = h->next_frame;
+        x264_pthread_mutex_unlock( &h->mutex );
+
+        /* the slot of 'frame' is not in use by the consumer as it is at least 'depth' frames after any held one */
+        cli_pic_t temp;
+        cli_pic_t *pic = &h->pic[frame % h->depth];
+        int ret = h->prev_filter.get_frame( h->prev_hnd, &temp, frame );
+        if( !ret )
+        {
+            if( !x264_cli_pic_ref( &temp ) )
+                *pic = temp;
+            else if( !(ret = x264_cli_pic_pool_get( h->pool, pic )) )
+            {
+                ret = x264_cli_pic_copy( pic, &temp );
+                if( ret )
+                    x264_cli_pic_unref( pic );
+            }
+            if( h->prev_filter.release_frame( h->prev_hnd, &temp, frame ) && !ret )
+            {
+                x264_cli_pic_unref( pic );
+                ret = -1;
+            }
+        }
+
+        x264_pthread_mutex_lock( &h->mutex );
+        if( ret )
+            h->eof = frame;
+        else
+            h->next_frame++;
+        x264_pthread_cond_broadcast( &h->cv_fill );
+    }
+    x264_pthread_mutex_unlock( &h->mutex );
+    return NULL;
+}
+
+static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
+{
+    if( !info->thread_safe )
+    {
+        x264_cli_log( NAME, X264_LOG_WARNING, "preceding filters can't run on a separate thread, ignored\n" );
+        return 0;
+    }
+    int depth = DEFAULT_DEPTH;
+    if( opt_string && *opt_string )
+    {
+        depth = x264_otoi( opt_string, -1 );
+        FAIL_IF_ERROR( depth <= 0 || depth > MAX_DEPTH, "invalid depth `%s'\n", opt_string )
+    }
+
+    pipeline_hnd_t *h = calloc( 1, sizeof(pipeline_hnd_t) );
+    int sync = 0;       /* number of the mutex and condvars initialized, undone in reverse order on failure */
+    if( !h )
+        return -1;
+    h->depth = depth;
+    h->pic = calloc( depth, sizeof(cli_pic_t) );
+    h->state = calloc( depth, sizeof(int) );
+    h->pool = x264_cli_pic_pool_create( info->csp, info->width, info->height );
+    if( !h->pic || !h->state || !h->pool )
+        goto fail;
+    h->first_frame = -1;
+    h->eof = INT_MAX;
+
+    h->prev_filter = *filter;
+    h->prev_hnd = *handle;
+
+    if( x264_pthread_mutex_init( &h->mutex, NULL ) )
+        goto fail;
+    sync++;
+    if( x264_pthread_cond_init( &h->cv_fill, NULL ) )
+        goto fail;
+    sync++;
+    if( x264_pthread_cond_init( &h->cv_empty, NULL ) )
+        goto fail;
+    sync++;
+    if( x264_pthread_create( &h->thread, NULL, (void*)pipeline_thread, h ) )
+        goto fail;
+
+    *handle = h;
+    *filter = pipeline_filter;
+
+    return 0;
+
+fail:
+    if( sync > 2 )
+        x264_pthread_cond_destroy( &h->cv_empty );
+    if( sync > 1 )
+        x264_pthread_cond_destroy( &h->cv_fill );
+    if( sync > 0 )
+        x264_pthread_mutex_destroy( &h->mutex );
+    x264_cli_pic_pool_delete( h->pool );
+    free( h->pic );
+    free( h->state );
+    free( h );
+    return -1;
+}
+
+static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
+{
+    pipeline_hnd_t *h = handle;
+    int ret = 0;
+    x264_pthread_mutex_lock( &h->mutex );
+    if( h->first_frame < 0 )
+    {
+        h->first_frame = h->next_frame = frame;
+        x264_pthread_cond_broadcast( &h->cv_empty );
+    }
+    if( frame < h->first_frame )
+    {
+        x264_cli_log( NAME, X264_LOG_ERROR, "frame %d is before first queued frame %d\n", frame, h->first_frame );
+        ret = -1;
+    }
+    /* drop the skipped frames that are in the way of the requested one */
+    while( !ret && frame - h->first_frame >= h->depth )
+    {
+        if( h->first_frame >= h->eof )
+            ret = -1;
+        else if( h->state[h->first_frame % h->depth] == SLOT_HELD )
+        {
+            x264_cli_log( NAME, X264_LOG_ERROR, "more than %d frames are held\n", h->depth );
+            ret = -1;
+        }
+        else if( h->first_frame < h->next_frame )
+        {
+            x264_cli_pic_unref( &h->pic[h->first_frame % h->depth] );
+            h->state[h->first_frame++ % h->depth] = SLOT_QUEUED;
+            x264_pthread_cond_broadcast( &h->cv_empty );
+        }
+        else
+            x264_pthread_cond_wait( &h->cv_fill, &h->mutex );
+    }
+    while( !ret && frame >= h->next_frame && frame < h->eof )
+        x264_pthread_cond_wait( &h->cv_fill, &h->mutex );
+    if( !ret && frame >= h->eof )
+        ret = -1;
+    if( !ret )
+    {
+        h->state[frame % h->depth] = SLOT_HELD;
+        *output = h->pic[frame % h->depth];
+    }
+    x264_pthread_mutex_unlock( &h->mutex );
+    return ret;
+}
+
+static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
+{
+    pipeline_hnd_t *h = handle;
+    x264_pthread_mutex_lock( &h->mutex );
+    if( frame >= h->first_frame && frame < h->next_frame )
+    {
+        h->state[frame % h->depth] = SLOT_RELEASED;
+        /* recycle the slots in order so that the worker never overwrites a held frame */
+        while( h->first_frame < h->next_frame && h->state[h->first_frame % h->depth] == SLOT_RELEASED )
+        {
+            x264_cli_pic_unref( &h->pic[h->first_frame % h->depth] );
+            h->state[h->first_frame++ % h->depth] = SLOT_QUEUED;
+        }
+        x264_pthread_cond_broadcast( &h->cv_empty );
+    }
+    x264_pthread_mutex_unlock( &h->mutex );
+    return 0;
+}
+
+static void free_filter( hnd_t handle )
+{
+    pipeline_hnd_t *h = handle;
+    x264_pthread_mutex_lock( &h->mutex );
+    h->exit = 1;
+    x264_pthread_cond_broadcast( &h->cv_empty );
+    x264_pthread_mutex_unlock( &h->mutex );
+    x264_pthread_join( h->thread, NULL );
+    x264_pthread_mutex_destroy( &h->mutex );
+    x264_pthread_cond_destroy( &h->cv_fill );
+    x264_pthread_cond_destroy( &h->cv_empty );
+
+    for( int i = X264_MAX( h->first_frame, 0 ); i < h->next_frame; i++ )
+        x264_cli_pic_unref( &h->pic[i % h->depth] );
+    h->prev_filter.free( h->prev_hnd );
+    x264_cli_pic_pool_delete( h->pool );
+    free( h->pic );
+    free( h->state );
+    free( h );
+}
+
+cli_vid_filter_t pipeline_filter = { NAME, help, init, get_frame, release_frame, free_filter, NULL };
+#else
+static void help( int longhelp )
+{
+    printf( "      "NAME":[depth]\n" );
+    if( !longhelp )
+        return;
+    printf( "            runs the preceding filters on a separate thread (not compiled in)\n" );
+}
+
+static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
+{
+    /* without threads this is a no-op */
+    return 0;
+}
+
+cli_vid_filter_t pipeline_filter = { NAME, help, init, NULL, NULL, NULL, NULL };
+#endif
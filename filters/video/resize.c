@@ -62,8 +62,7 @@ typedef struct
     hnd_t prev_hnd;
     cli_vid_filter_t prev_filter;
 
-    cli_pic_t buffer;
-    int buffer_allocated;
+    cli_pic_pool_t *pool;
     int dst_csp;
     int input_range;
     struct SwsContext *ctx;
@@ -77,6 +76,32 @@ typedef struct
     frame_prop_t scale; /* properties of the SwsContext input */
 } resizer_hnd_t;
 
+#else
+#include "scale.h"
+
+/* don't bother with threads for frames smaller than this */
+#define SCALE_THREAD_MIN_PIXELS (1280*720)
+
+typedef struct
+{
+    int width;
+    int height;
+    int range;
+} frame_prop_t;
+
+typedef struct
+{
+    hnd_t prev_hnd;
+    cli_vid_filter_t prev_filter;
+
+    cli_pic_pool_t *pool;
+    int dst_csp;
+    int method;
+    cli_scaler_t *scaler;
+    frame_prop_t dst;   /* desired output properties */
+} resizer_hnd_t;
+#endif
+
 static void help( int longhelp )
 {
     printf( "      "NAME":[width,height][,sar][,fittobox][,csp][,method]\n" );
@@ -104,110 +129,9 @@ static void help( int longhelp )
             "            - method: use resizer method [\"bicubic\"]\n"
             "               - fastbilinear, bilinear, bicubic, experimental, point,\n"
             "               - area, bicublin, gauss, sinc, lanczos, spline\n" );
-}
-
-static uint32_t convert_method_to_flag( const char *name )
-{
-    uint32_t flag = 0;
-    if( !strcasecmp( name, "fastbilinear" ) )
-        flag = SWS_FAST_BILINEAR;
-    else if( !strcasecmp( name, "bilinear" ) )
-        flag = SWS_BILINEAR;
-    else if( !strcasecmp( name, "bicubic" ) )
-        flag = SWS_BICUBIC;
-    else if( !strcasecmp( name, "experimental" ) )
-        flag = SWS_X;
-    else if( !strcasecmp( name, "point" ) )
-        flag = SWS_POINT;
-    else if( !strcasecmp( name, "area" ) )
-        flag = SWS_AREA;
-    else if( !strcasecmp( name, "bicublin" ) )
-        flag = SWS_BICUBLIN;
-    else if( !strcasecmp( name, "guass" ) )
-        flag = SWS_GAUSS;
-    else if( !strcasecmp( name, "sinc" ) )
-        flag = SWS_SINC;
-    else if( !strcasecmp( name, "lanczos" ) )
-        flag = SWS_LANCZOS;
-    else if( !strcasecmp( name, "spline" ) )
-        flag = SWS_SPLINE;
-    else // default
-        flag = SWS_BICUBIC;
-    return flag;
-}
-
-static int convert_csp_to_pix_fmt( int csp )
-{
-    if( csp&X264_CSP_OTHER )
-        return csp&X264_CSP_MASK;
-    switch( csp&X264_CSP_MASK )
-    {
-        case X264_CSP_YV12: /* specially handled via swapping chroma */
-        case X264_CSP_I420: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV420P16 : PIX_FMT_YUV420P;
-        case X264_CSP_YV16: /* specially handled via swapping chroma */
-        case X264_CSP_I422: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV422P16 : PIX_FMT_YUV422P;
-        case X264_CSP_YV24: /* specially handled via swapping chroma */
-        case X264_CSP_I444: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV444P16 : PIX_FMT_YUV444P;
-        case X264_CSP_RGB:  return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_RGB48     : PIX_FMT_RGB24;
-        case X264_CSP_BGR:  return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_BGR48     : PIX_FMT_BGR24;
-        case X264_CSP_BGRA: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_BGRA64    : PIX_FMT_BGRA;
-        /* the next csp has no equivalent 16bit depth in swscale */
-        case X264_CSP_NV12: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_NONE      : PIX_FMT_NV12;
-        /* the next csp is no supported by swscale at all */
-        case X264_CSP_NV16:
-        default:            return PIX_FMT_NONE;
-    }
-}
-
-static int pix_number_of_planes( const AVPixFmtDescriptor *pix_desc )
-{
-    int num_planes = 0;
-    for( int i = 0; i < pix_desc->nb_components; i++ )
-    {
-        int plane_plus1 = pix_desc->comp[i].plane + 1;
-        num_planes = X264_MAX( plane_plus1, num_planes );
-    }
-    return num_planes;
-}
-
-static int pick_closest_supported_csp( int csp )
-{
-    int pix_fmt = convert_csp_to_pix_fmt( csp );
-    // first determine the base csp
-    int ret = X264_CSP_NONE;
-    const AVPixFmtDescriptor *pix_desc = av_pix_fmt_descriptors+pix_fmt;
-    if( (unsigned)pix_fmt >= PIX_FMT_NB || !pix_desc->name )
-        return ret;
-
-    const char *pix_fmt_name = pix_desc->name;
-    int is_rgb = pix_desc->flags & (PIX_FMT_RGB | PIX_FMT_PAL);
-    int is_bgr = !!strstr( pix_fmt_name, "bgr" );
-    if( is_bgr || is_rgb )
-    {
-        if( pix_desc->nb_components == 4 ) // has alpha
-            ret = X264_CSP_BGRA;
-        else if( is_bgr )
-            ret = X264_CSP_BGR;
-        else
-            ret = X264_CSP_RGB;
-    }
-    else
-    {
-        // yuv-based
-        if( pix_desc->nb_components == 1 || pix_desc->nb_components == 2 ) // no chroma
-            ret = X264_CSP_I420;
-        else if( pix_desc->log2_chroma_w && pix_desc->log2_chroma_h ) // reduced chroma width & height
-            ret = (pix_number_of_planes( pix_desc ) == 2) ? X264_CSP_NV12 : X264_CSP_I420;
-        else if( pix_desc->log2_chroma_w ) // reduced chroma width only
-            ret = X264_CSP_I422; // X264_CSP_NV16 is not supported by swscale so don't use it
-        else
-            ret = X264_CSP_I444;
-    }
-    // now determine high depth
-    for( int i = 0; i < pix_desc->nb_components; i++ )
-        if( pix_desc->comp[i].depth_minus1 >= 8 )
-            ret |= X264_CSP_HIGH_DEPTH;
-    return ret;
+#if !HAVE_SWSCALE
+    printf( "            without swscale, the methods map to point, bilinear, bicubic or lanczos\n" );
+#endif
 }
 
 static int handle_opts( const char **optlist, char **opts, video_info_t *info, resizer_hnd_t *h )
@@ -353,6 +277,111 @@ static int handle_opts( const char **optlist, char **opts, video_info_t *info, r
     return 0;
 }
 
+#if HAVE_SWSCALE
+static uint32_t convert_method_to_flag( const char *name )
+{
+    uint32_t flag = 0;
+    if( !strcasecmp( name, "fastbilinear" ) )
+        flag = SWS_FAST_BILINEAR;
+    else if( !strcasecmp( name, "bilinear" ) )
+        flag = SWS_BILINEAR;
+    else if( !strcasecmp( name, "bicubic" ) )
+        flag = SWS_BICUBIC;
+    else if( !strcasecmp( name, "experimental" ) )
+        flag = SWS_X;
+    else if( !strcasecmp( name, "point" ) )
+        flag = SWS_POINT;
+    else if( !strcasecmp( name, "area" ) )
+        flag = SWS_AREA;
+    else if( !strcasecmp( name, "bicublin" ) )
+        flag = SWS_BICUBLIN;
+    else if( !strcasecmp( name, "guass" ) )
+        flag = SWS_GAUSS;
+    else if( !strcasecmp( name, "sinc" ) )
+        flag = SWS_SINC;
+    else if( !strcasecmp( name, "lanczos" ) )
+        flag = SWS_LANCZOS;
+    else if( !strcasecmp( name, "spline" ) )
+        flag = SWS_SPLINE;
+    else // default
+        flag = SWS_BICUBIC;
+    return flag;
+}
+
+static int convert_csp_to_pix_fmt( int csp )
+{
+    if( csp&X264_CSP_OTHER )
+        return csp&X264_CSP_MASK;
+    switch( csp&X264_CSP_MASK )
+    {
+        case X264_CSP_YV12: /* specially handled via swapping chroma */
+        case X264_CSP_I420: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV420P16 : PIX_FMT_YUV420P;
+        case X264_CSP_YV16: /* specially handled via swapping chroma */
+        case X264_CSP_I422: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV422P16 : PIX_FMT_YUV422P;
+        case X264_CSP_YV24: /* specially handled via swapping chroma */
+        case X264_CSP_I444: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_YUV444P16 : PIX_FMT_YUV444P;
+        case X264_CSP_RGB:  return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_RGB48     : PIX_FMT_RGB24;
+        case X264_CSP_BGR:  return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_BGR48     : PIX_FMT_BGR24;
+        case X264_CSP_BGRA: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_BGRA64    : PIX_FMT_BGRA;
+        /* the next csp has no equivalent 16bit depth in swscale */
+        case X264_CSP_NV12: return csp&X264_CSP_HIGH_DEPTH ? PIX_FMT_NONE      : PIX_FMT_NV12;
+        /* the next csp is no supported by swscale at all */
+        case X264_CSP_NV16:
+        default:            return PIX_FMT_NONE;
+    }
+}
+
+static int pix_number_of_planes( const AVPixFmtDescriptor *pix_desc )
+{
+    int num_planes = 0;
+    for( int i = 0; i < pix_desc->nb_components; i++ )
+    {
+        int plane_plus1 = pix_desc->comp[i].plane + 1;
+        num_planes = X264_MAX( plane_plus1, num_planes );
+    }
+    return num_planes;
+}
+
+static int pick_closest_supported_csp( int csp )
+{
+    int pix_fmt = convert_csp_to_pix_fmt( csp );
+    // first determine the base csp
+    int ret = X264_CSP_NONE;
+    const AVPixFmtDescriptor *pix_desc = av_pix_fmt_descriptors+pix_fmt;
+    if( (unsigned)pix_fmt >= PIX_FMT_NB || !pix_desc->name )
+        return ret;
+
+    const char *pix_fmt_name = pix_desc->name;
+    int is_rgb = pix_desc->flags & (PIX_FMT_RGB | PIX_FMT_PAL);
+    int is_bgr = !!strstr( pix_fmt_name, "bgr" );
+    if( is_bgr || is_rgb )
+    {
+        if( pix_desc->nb_components == 4 ) // has alpha
+            ret = X264_CSP_BGRA;
+        else if( is_bgr )
+            ret = X264_CSP_BGR;
+        else
+            ret = X264_CSP_RGB;
+    }
+    else
+    {
+        // yuv-based
+        if( pix_desc->nb_components == 1 || pix_desc->nb_components == 2 ) // no chroma
+            ret = X264_CSP_I420;
+        else if( pix_desc->log2_chroma_w && pix_desc->log2_chroma_h ) // reduced chroma width & height
+            ret = (pix_number_of_planes( pix_desc ) == 2) ? X264_CSP_NV12 : X264_CSP_I420;
+        else if( pix_desc->log2_chroma_w ) // reduced chroma width only
+            ret = X264_CSP_I422; // X264_CSP_NV16 is not supported by swscale so don't use it
+        else
+            ret = X264_CSP_I444;
+    }
+    // now determine high depth
+    for( int i = 0; i < pix_desc->nb_components; i++ )
+        if( pix_desc->comp[i].depth_minus1 >= 8 )
+            ret |= X264_CSP_HIGH_DEPTH;
+    return ret;
+}
+
 static int x264_init_sws_context( resizer_hnd_t *h )
 {
     if( h->ctx )
@@ -390,11 +419,11 @@ static int check_resizer( resizer_hnd_t *h, cli_pic_t *in )
     if( h->ctx || h->working )
         x264_cli_log( NAME, X264_LOG_WARNING, "stream properties changed at pts %"PRId64"\n", in->pts );
     h->scale = input_prop;
-    if( !h->buffer_allocated )
+    if( !h->pool )
     {
-        if( x264_cli_pic_alloc( &h->buffer, h->dst_csp, h->dst.width, h->dst.height ) )
+        h->pool = x264_cli_pic_pool_create( h->dst_csp, h->dst.width, h->dst.height );
+        if( !h->pool )
             return -1;
-        h->buffer_allocated = 1;
     }
     FAIL_IF_ERROR( x264_init_sws_context( h ), "swscale init failed\n" )
     return 0;
@@ -521,9 +550,19 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
         XCHG( uint8_t*, output->img.plane[1], output->img.plane[2] );
     if( h->ctx )
     {
-        sws_scale( h->ctx, (const uint8_t* const*)output->img.plane, output->img.stride,
-                   0, output->img.height, h->buffer.img.plane, h->buffer.img.stride );
-        output->img = h->buffer.img; /* copy img data */
+        /* the scaled frame doesn't refer to the input one, which is released right away */
+        cli_pic_t in = *output;
+        if( x264_cli_pic_pool_get( h->pool, output ) )
+        {
+            h->prev_filter.release_frame( h->prev_hnd, &in, frame );
+            return -1;
+        }
+        sws_scale( h->ctx, (const uint8_t* const*)in.img.plane, in.img.stride,
+                   0, in.img.height, output->img.plane, output->img.stride );
+        output->pts = in.pts;
+        output->duration = in.duration;
+        if( h->prev_filter.release_frame( h->prev_hnd, &in, frame ) )
+            return -1;
     }
     else
         output->img.csp = h->dst_csp;
@@ -536,6 +575,11 @@ static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
 static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
 {
     resizer_hnd_t *h = handle;
+    if( x264_cli_pic_is_from_pool( pic, h->pool ) )
+    {
+        x264_cli_pic_unref( pic );
+        return 0;
+    }
     return h->prev_filter.release_frame( h->prev_hnd, pic, frame );
 }
 
@@ -545,37 +589,163 @@ static void free_filter( hnd_t handle )
     h->prev_filter.free( h->prev_hnd );
     if( h->ctx )
         sws_freeContext( h->ctx );
-    if( h->buffer_allocated )
-        x264_cli_pic_clean( &h->buffer );
+    x264_cli_pic_pool_delete( h->pool );
     free( h );
 }
 
 #else /* no swscale */
 static int init( hnd_t *handle, cli_vid_filter_t *filter, video_info_t *info, x264_param_t *param, char *opt_string )
 {
-    int ret = 0;
+    /* if called for normalizing the csp to known formats and the format is not unknown, exit */
+    if( opt_string && !strcmp( opt_string, "normcsp" ) && !(info->csp&X264_CSP_OTHER) )
+        return 0;
+    /* if called by x264cli and nothing needs to be done, exit */
+    if( !opt_string && !full_check( info, param ) )
+        return 0;
+    /* pixel formats only known to the demuxer need swscale */
+    FAIL_IF_ERROR( x264_cli_csp_is_invalid( info->csp ), "not compiled with swscale support\n" )
 
-    if( !opt_string )
-        ret = full_check( info, param );
+    static const char *optlist[] = { "width", "height", "sar", "fittobox", "csp", "method", NULL };
+    char **opts = x264_split_options( opt_string, optlist );
+    if( !opts && opt_string )
+        return -1;
+
+    resizer_hnd_t *h = calloc( 1, sizeof(resizer_hnd_t) );
+    if( !h )
+        return -1;
+    if( opts )
+    {
+        h->dst_csp    = info->csp;
+        h->dst.width  = info->width;
+        h->dst.height = info->height;
+        h->dst.range  = info->fullrange; // maintain input range
+        if( handle_opts( optlist, opts, info, h ) )
+        {
+            x264_free_string_array( opts );
+            goto fail;
+        }
+    }
     else
     {
-        if( !strcmp( opt_string, "normcsp" ) )
-            ret = info->csp & X264_CSP_OTHER;
-        else
-            ret = -1;
+        h->dst_csp    = param->i_csp;
+        h->dst.width  = param->i_width;
+        h->dst.height = param->i_height;
+        h->dst.range  = param->vui.b_fullrange; // change to libx264's range
     }
+    h->method = x264_cli_scaler_method( x264_otos( x264_get_option( optlist[5], opts ), "" ) );
+    x264_free_string_array( opts );
+
+    if( x264_cli_csp_is_invalid( h->dst_csp ) )
+    {
+        x264_cli_log( NAME, X264_LOG_ERROR, "invalid output colorspace %d\n", h->dst_csp );
+        goto fail;
+    }
+    if( h->dst.height != info->height && info->interlaced )
+    {
+        x264_cli_log( NAME, X264_LOG_ERROR, "the resizer is not compatible with interlaced vertical resizing\n" );
+        goto fail;
+    }
+    /* confirm that the desired resolution meets the colorspace requirements */
+    const x264_cli_csp_t *csp = x264_cli_get_csp( h->dst_csp );
+    if( h->dst.width % csp->mod_width || h->dst.height % csp->mod_height )
+    {
+        x264_cli_log( NAME, X264_LOG_ERROR, "resolution %dx%d is not compliant with colorspace %s\n",
+                      h->dst.width, h->dst.height, csp->name );
+        goto fail;
+    }
+
+    int src_csp = info->csp & (X264_CSP_MASK | X264_CSP_HIGH_DEPTH);
+    int dst_csp = h->dst_csp & (X264_CSP_MASK | X264_CSP_HIGH_DEPTH);
+    if( h->dst.width != info->width || h->dst.height != info->height )
+        x264_cli_log( NAME, X264_LOG_INFO, "resizing to %dx%d\n", h->dst.width, h->dst.height );
+    if( dst_csp != src_csp )
+        x264_cli_log( NAME, X264_LOG_WARNING, "converting from %s%s to %s%s\n",
+                      x264_cli_get_csp( src_csp )->name, src_csp & X264_CSP_HIGH_DEPTH ? ":16" : "",
+                      csp->name, dst_csp & X264_CSP_HIGH_DEPTH ? ":16" : "" );
+    else if( h->dst.range != info->fullrange )
+        x264_cli_log( NAME, X264_LOG_WARNING, "converting range from %s to %s\n",
+                      info->fullrange ? "PC" : "TV", h->dst.range ? "PC" : "TV" );
+    h->dst_csp |= info->csp & X264_CSP_VFLIP; // preserve vflip
+
+    if( dst_csp != src_csp || h->dst.width != info->width || h->dst.height != info->height ||
+        h->dst.range != info->fullrange )
+    {
+        int threads = 1;
+        if( h->dst.width * h->dst.height >= SCALE_THREAD_MIN_PIXELS )
+            threads = param->i_threads == X264_THREADS_AUTO ? x264_cpu_num_processors() : param->i_threads;
+        cli_scale_prop_t src_prop = { info->csp, info->width, info->height, info->fullrange };
+        cli_scale_prop_t dst_prop = { h->dst_csp, h->dst.width, h->dst.height, h->dst.range };
+        h->pool = x264_cli_pic_pool_create( h->dst_csp, h->dst.width, h->dst.height );
+        if( !h->pool || x264_cli_scaler_init( &h->scaler, &src_prop, &dst_prop, h->method, threads ) )
+        {
+            x264_cli_log( NAME, X264_LOG_ERROR, "scaler init failed\n" );
+            goto fail;
+        }
+    }
+
+    /* finished initing, overwrite values */
+    info->csp       = h->dst_csp;
+    info->width     = h->dst.width;
+    info->height    = h->dst.height;
+    info->fullrange = h->dst.range;
+
+    h->prev_filter = *filter;
+    h->prev_hnd = *handle;
+    *handle = h;
+    *filter = resize_filter;
 
-    /* pass if nothing needs to be done, otherwise fail */
-    FAIL_IF_ERROR( ret, "not compiled with swscale support\n" )
     return 0;
+
+fail:
+    /* the scaler may be partly set up, closing it frees whatever it got */
+    x264_cli_scaler_close( h->scaler );
+    x264_cli_pic_pool_delete( h->pool );
+    free( h );
+    return -1;
+}
+
+static int get_frame( hnd_t handle, cli_pic_t *output, int frame )
+{
+    resizer_hnd_t *h = handle;
+    if( h->prev_filter.get_frame( h->prev_hnd, output, frame ) )
+        return -1;
+    if( !h->scaler )
+    {
+        output->img.csp = h->dst_csp;
+        return 0;
+    }
+    /* the scaled frame doesn't refer to the input one, which is released right away */
+    cli_pic_t in = *output;
+    if( x264_cli_pic_pool_get( h->pool, output ) )
+    {
+        h->prev_filter.release_frame( h->prev_hnd, &in, frame );
+        return -1;
+    }
+    x264_cli_scaler_scale( h->scaler, &output->img, &in.img );
+    output->pts = in.pts;
+    output->duration = in.duration;
+    return h->prev_filter.release_frame( h->prev_hnd, &in, frame );
 }
 
-#define help NULL
-#define get_frame NULL
-#define release_frame NULL
-#define free_filter NULL
-#define convert_csp_to_pix_fmt(x) (x & X264_CSP_MASK)
+static int release_frame( hnd_t handle, cli_pic_t *pic, int frame )
+{
+    resizer_hnd_t *h = handle;
+    if( x264_cli_pic_is_from_pool( pic, h->pool ) )
+    {
+        x264_cli_pic_unref( pic );
+        return 0;
+    }
+    return h->prev_filter.release_frame( h->prev_hnd, pic, frame );
+}
 
+static void free_filter( hnd_t handle )
+{
+    resizer_hnd_t *h = handle;
+    h->prev_filter.free( h->prev_hnd );
+    x264_cli_scaler_close( h->scaler );
+    x264_cli_pic_pool_delete( h->pool );
+    free( h );
+}
 #endif
 
 cli_vid_filter_t resize_filter = { NAME, help, init, get_frame, release_frame, free_filter, NULL };
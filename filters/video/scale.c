@@ -0,0 +1,666 @@
+/*****************************************************************************
+ * scale.c: native image scaler
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "scale.h"
+
+/* Images are scaled one component plane at a time (Y/U/V or R/G/B, plus alpha for bgra to bgra)
+ * with separable fixed-point filters: source rows are filtered horizontally into a ring of
+ * rows, which are then combined vertically. Samples are handled as 16-bit values whatever
+ * the depth of the images, 8-bit samples being shifted up by 8 bits as in the depth filter.
+ * Color conversion is folded into the passes: rgb to yuv is done when reading source rows,
+ * yuv to rgb when writing destination rows and range conversion when writing planes.
+ * Each plane of a chroma subsampled image is scaled to its own size, which takes care of
+ * converting between 4:2:0, 4:2:2 and 4:4:4. Chroma samples are taken as centered.
+ * With several threads, each one scales a horizontal slice of the destination. */
+
+#define COEF_BITS 14    /* filter coefficients, summing to 1<<COEF_BITS */
+#define MAT_BITS  12    /* color conversion coefficients */
+#define MAX_PLANES 4
+#define MAX_THREADS 16
+
+enum
+{
+    CONVERT_NONE = 0,
+    CONVERT_RANGE,      /* yuv to yuv with a different range */
+    CONVERT_TO_YUV,     /* rgb to yuv, done on the whole source before scaling */
+    CONVERT_TO_RGB      /* yuv to rgb, done when writing destination rows */
+};
+
+typedef struct
+{
+    int taps;
+    int identity;       /* same size, nothing to filter */
+    int *pos;           /* first source sample of each destination sample, may be out of the image */
+    int16_t *coef;      /* taps coefficients for each destination sample */
+} scale_filter_t;
+
+/* where a component lives in an image */
+typedef struct
+{
+    int plane;
+    int offset;
+    int pitch;
+} scale_comp_t;
+
+typedef struct
+{
+    int src_width, src_height;
+    int dst_width, dst_height;
+    int pad;            /* edge samples replicated on both sides of source rows */
+    scale_filter_t h, v;
+    scale_comp_t src, dst;
+} scale_plane_t;
+
+typedef struct
+{
+    cli_scaler_t *s;
+    int index;
+    uint16_t *line;                 /* padded source row */
+    uint16_t *ring[MAX_PLANES];     /* horizontally scaled rows, row y of the source in slot y % v.taps */
+    int *ring_row[MAX_PLANES];      /* source row held by each slot, -1 if none */
+    uint16_t *row[MAX_PLANES];      /* vertically scaled rows */
+    uint16_t **window;              /* rows of the ring combined into a destination row */
+    int32_t *acc;
+} scale_slice_t;
+
+struct cli_scaler_t
+{
+    int src_depth;      /* bytes per sample */
+    int dst_depth;
+    int src_rgb;
+    int dst_rgb;
+    int dst_alpha;      /* the destination has an alpha channel not taken from the source */
+    int planes;
+    scale_plane_t plane[MAX_PLANES];
+    scale_comp_t rgb_src[3];    /* r, g and b of rgb sources converted to yuv */
+    uint16_t *yuv[3];           /* the source converted to yuv, read by the scaling instead of the source */
+    int convert;
+    int32_t matrix[3][3];
+    int32_t offset[3];
+    cli_image_t *in;
+    cli_image_t *out;
+    int threads;
+    x264_threadpool_t *pool;
+    scale_slice_t slice[MAX_THREADS];
+};
+
+int x264_cli_scaler_method( const char *name )
+{
+    if( !strcasecmp( name, "point" ) )
+        return SCALE_POINT;
+    if( !strcasecmp( name, "fastbilinear" ) || !strcasecmp( name, "bilinear" ) || !strcasecmp( name, "area" ) )
+        return SCALE_BILINEAR;
+    if( !strcasecmp( name, "lanczos" ) || !strcasecmp( name, "sinc" ) || !strcasecmp( name, "spline" ) )
+        return SCALE_LANCZOS;
+    return SCALE_BICUBIC;
+}
+
+static double kernel( int method, double x )
+{
+    x = fabs( x );
+    switch( method )
+    {
+        case SCALE_BILINEAR:
+            return x < 1 ? 1 - x : 0;
+        case SCALE_BICUBIC: /* catmull-rom */
+            if( x < 1 )
+                return (1.5*x - 2.5)*x*x + 1;
+            if( x < 2 )
+                return ((-0.5*x + 2.5)*x - 4)*x + 2;
+            return 0;
+        case SCALE_LANCZOS: /* 3 lobes */
+            if( x < 1e-8 )
+                return 1;
+            if( x < 3 )
+                return 3 * sin( M_PI*x ) * sin( M_PI*x/3 ) / (M_PI*M_PI*x*x);
+            return 0;
+        default:
+            return x < 0.5;
+    }
+}
+
+static int init_filter( scale_filter_t *f, int method, int src_size, int dst_size )
+{
+    static const double radius[] = { [SCALE_POINT] = 0.5, [SCALE_BILINEAR] = 1, [SCALE_BICUBIC] = 2, [SCALE_LANCZOS] = 3 };
+    double scale = (double)src_size / dst_size;
+    /* widen the kernel when downscaling so that it covers all the source samples */
+    double fscale = X264_MAX( scale, 1.0 );
+    f->identity = src_size == dst_size;
+    f->taps = f->identity || method == SCALE_POINT ? 1 : 2 * (int)ceil( radius[method] * fscale );
+    f->pos = malloc( dst_size * sizeof(int) );
+    f->coef = malloc( dst_size * f->taps * sizeof(int16_t) );
+    if( !f->pos || !f->coef )
+        return -1;
+
+    for( int i = 0; i < dst_size; i++ )
+    {
+        double center = (i + 0.5) * scale - 0.5;
+        int16_t *coef = f->coef + i * f->taps;
+        if( f->taps == 1 )
+        {
+            f->pos[i] = x264_clip3( f->identity ? i : (int)floor( center + 0.5 ), 0, src_size - 1 );
+            coef[0] = 1 << COEF_BITS;
+            continue;
+        }
+        int first = (int)floor( center ) - f->taps/2 + 1;
+        double weight[f->taps];
+        double sum = 0;
+        for( int k = 0; k < f->taps; k++ )
+            sum += weight[k] = kernel( method, (first + k - center) / fscale );
+        /* quantize so that the coefficients sum exactly to 1, putting the error on the largest one */
+        int total = 0, largest = 0;
+        for( int k = 0; k < f->taps; k++ )
+        {
+            coef[k] = lrint( weight[k] / sum * (1 << COEF_BITS) );
+            total += coef[k];
+            if( coef[k] > coef[largest] )
+                largest = k;
+        }
+        coef[largest] += (1 << COEF_BITS) - total;
+        f->pos[i] = first;
+    }
+    return 0;
+}
+
+static void free_filter( scale_filter_t *f )
+{
+    free( f->pos );
+    free( f->coef );
+}
+
+/* Color conversion uses the bt.601 matrix, with 8-bit values shifted up as everywhere else. */
+#define KR 0.299
+#define KB 0.114
+#define KG (1 - KR - KB)
+#define LUMA_OFFSET   (16<<8)
+#define CHROMA_OFFSET (128<<8)
+
+static void init_matrix( cli_scaler_t *s, double m[3][3], double off[3] )
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        for( int j = 0; j < 3; j++ )
+            s->matrix[i][j] = lrint( m[i][j] * (1 << MAT_BITS) );
+        s->offset[i] = lrint( off[i] * (1 << MAT_BITS) ) + (1 << (MAT_BITS-1));
+    }
+}
+
+static void init_conversion( cli_scaler_t *s, int src_fullrange, int dst_fullrange )
+{
+    /* scaling of luma and chroma to full range */
+    double src_ys = src_fullrange ? 1 : 255./219, src_cs = src_fullrange ? 1 : 255./224;
+    double dst_ys = dst_fullrange ? 1 : 219./255, dst_cs = dst_fullrange ? 1 : 224./255;
+    int src_yo = src_fullrange ? 0 : LUMA_OFFSET;
+    int dst_yo = dst_fullrange ? 0 : LUMA_OFFSET;
+    if( s->src_rgb && !s->dst_rgb )
+    {
+        double m[3][3] =
+        {
+            { dst_ys * KR, dst_ys * KG, dst_ys * KB },
+            { dst_cs * -KR / (2*(1-KB)), dst_cs * -KG / (2*(1-KB)), dst_cs * 0.5 },
+            { dst_cs * 0.5, dst_cs * -KG / (2*(1-KR)), dst_cs * -KB / (2*(1-KR)) }
+        };
+        double off[3] = { dst_yo, CHROMA_OFFSET, CHROMA_OFFSET };
+        init_matrix( s, m, off );
+        s->convert = CONVERT_TO_YUV;
+    }
+    else if( !s->src_rgb && s->dst_rgb )
+    {
+        double cr_r = 2*(1-KR) * src_cs, cb_b = 2*(1-KB) * src_cs;
+        double cb_g = -2*KB*(1-KB)/KG * src_cs, cr_g = -2*KR*(1-KR)/KG * src_cs;
+        double m[3][3] =
+        {
+            { src_ys, 0,    cr_r },
+            { src_ys, cb_g, cr_g },
+            { src_ys, cb_b, 0 }
+        };
+        double off[3] =
+        {
+            -src_yo * src_ys - CHROMA_OFFSET * cr_r,
+            -src_yo * src_ys - CHROMA_OFFSET * (cb_g + cr_g),
+            -src_yo * src_ys - CHROMA_OFFSET * cb_b
+        };
+        init_matrix( s, m, off );
+        s->convert = CONVERT_TO_RGB;
+    }
+    else if( !s->src_rgb && src_fullrange != dst_fullrange )
+    {
+        double m[3][3] = { { src_ys * dst_ys }, { 0, src_cs * dst_cs }, { 0, 0, src_cs * dst_cs } };
+        double off[3] =
+        {
+            dst_yo - src_yo * src_ys * dst_ys,
+            CHROMA_OFFSET * (1 - src_cs * dst_cs),
+            CHROMA_OFFSET * (1 - src_cs * dst_cs)
+        };
+        init_matrix( s, m, off );
+        s->convert = CONVERT_RANGE;
+    }
+}
+
+static int csp_is_rgb( int csp )
+{
+    int csp_mask = csp & X264_CSP_MASK;
+    return csp_mask == X264_CSP_BGR || csp_mask == X264_CSP_BGRA || csp_mask == X264_CSP_RGB;
+}
+
+/* location of component i (y/u/v or r/g/b/a) */
+static scale_comp_t csp_component( int csp, int i )
+{
+    int csp_mask = csp & X264_CSP_MASK;
+    scale_comp_t c = { i, 0, 1 };
+    switch( csp_mask )
+    {
+        case X264_CSP_YV12:
+        case X264_CSP_YV16:
+        case X264_CSP_YV24:
+            c.plane = i ? 3 - i : 0;
+            break;
+        case X264_CSP_NV12:
+        case X264_CSP_NV16:
+            if( i )
+                c = (scale_comp_t){ 1, i - 1, 2 };
+            break;
+        case X264_CSP_RGB:
+            c = (scale_comp_t){ 0, i, 3 };
+            break;
+        case X264_CSP_BGR:
+            c = (scale_comp_t){ 0, 2 - i, 3 };
+            break;
+        case X264_CSP_BGRA:
+            c = (scale_comp_t){ 0, i == 3 ? 3 : 2 - i, 4 };
+            break;
+    }
+    return c;
+}
+
+/* reads row y of component c as 16-bit samples */
+static void read_row( cli_scaler_t *s, uint16_t *dst, scale_comp_t *c, int y, int width )
+{
+    uint8_t *src = s->in->plane[c->plane] + (intptr_t)y * s->in->stride[c->plane];
+    if( s->src_depth == 2 )
+    {
+        uint16_t *src16 = (uint16_t*)src + c->offset;
+        if( c->pitch == 1 )
+            memcpy( dst, src16, width * sizeof(uint16_t) );
+        else
+            for( int x = 0; x < width; x++ )
+                dst[x] = src16[x*c->pitch];
+    }
+    else
+    {
+        src += c->offset;
+        for( int x = 0; x < width; x++ )
+            dst[x] = src[x*c->pitch] << 8;
+    }
+}
+
+static void write_row( cli_scaler_t *s, scale_comp_t *c, int y, uint16_t *src, int width )
+{
+    uint8_t *dst = s->out->plane[c->plane] + (intptr_t)y * s->out->stride[c->plane];
+    if( s->dst_depth == 2 )
+    {
+        uint16_t *dst16 = (uint16_t*)dst + c->offset;
+        if( c->pitch == 1 )
+            memcpy( dst16, src, width * sizeof(uint16_t) );
+        else
+            for( int x = 0; x < width; x++ )
+                dst16[x*c->pitch] = src[x];
+    }
+    else
+    {
+        dst += c->offset;
+        for( int x = 0; x < width; x++ )
+            dst[x*c->pitch] = X264_MIN( (src[x] + 128) >> 8, 255 );
+    }
+}
+
+/* converts the rgb source rows of slice b into the yuv planes, each row read once for the three of them */
+static void *convert_to_yuv( scale_slice_t *b )
+{
+    cli_scaler_t *s = b->s;
+    int height = s->plane[0].src_height;
+    int width = s->plane[0].src_width;
+    uint16_t *r = b->row[0], *g = b->row[1], *bl = b->row[2];
+    const int32_t (*m)[3] = (const int32_t (*)[3])s->matrix;
+    for( int y = height * b->index / s->threads; y < height * (b->index + 1) / s->threads; y++ )
+    {
+        read_row( s, r, &s->rgb_src[0], y, width );
+        read_row( s, g, &s->rgb_src[1], y, width );
+        read_row( s, bl, &s->rgb_src[2], y, width );
+        uint16_t *dst0 = s->yuv[0] + (intptr_t)y * width;
+        uint16_t *dst1 = s->yuv[1] + (intptr_t)y * width;
+        uint16_t *dst2 = s->yuv[2] + (intptr_t)y * width;
+        for( int x = 0; x < width; x++ )
+        {
+            dst0[x] = x264_clip3( (m[0][0]*r[x] + m[0][1]*g[x] + m[0][2]*bl[x] + s->offset[0]) >> MAT_BITS, 0, 0xffff );
+            dst1[x] = x264_clip3( (m[1][0]*r[x] + m[1][1]*g[x] + m[1][2]*bl[x] + s->offset[1]) >> MAT_BITS, 0, 0xffff );
+            dst2[x] = x264_clip3( (m[2][0]*r[x] + m[2][1]*g[x] + m[2][2]*bl[x] + s->offset[2]) >> MAT_BITS, 0, 0xffff );
+        }
+    }
+    return NULL;
+}
+
+/* reads source row y of plane p into the padded line */
+static void fetch_row( cli_scaler_t *s, scale_slice_t *b, int p, int y )
+{
+    scale_plane_t *pl = &s->plane[p];
+    uint16_t *line = b->line + pl->pad;
+    int width = pl->src_width;
+    if( s->convert == CONVERT_TO_YUV && p < 3 )
+        memcpy( line, s->yuv[p] + (intptr_t)y * width, width * sizeof(uint16_t) );
+    else
+        read_row( s, line, &pl->src, y, width );
+    for( int x = 1; x <= pl->pad; x++ )
+    {
+        line[-x] = line[0];
+        line[width-1+x] = line[width-1];
+    }
+}
+
+static void scale_h( uint16_t *dst, uint16_t *src, scale_filter_t *f, int width )
+{
+    const int16_t *coef = f->coef;
+    if( f->taps == 2 )
+        for( int x = 0; x < width; x++, coef += 2 )
+        {
+            const uint16_t *s = src + f->pos[x];
+            int sum = s[0]*coef[0] + s[1]*coef[1];
+            dst[x] = (sum + (1 << (COEF_BITS-1))) >> COEF_BITS;
+        }
+    else if( f->taps == 4 )
+        for( int x = 0; x < width; x++, coef += 4 )
+        {
+            const uint16_t *s = src + f->pos[x];
+            int sum = s[0]*coef[0] + s[1]*coef[1] + s[2]*coef[2] + s[3]*coef[3];
+            dst[x] = x264_clip3( (sum + (1 << (COEF_BITS-1))) >> COEF_BITS, 0, 0xffff );
+        }
+    else
+        for( int x = 0; x < width; x++, coef += f->taps )
+        {
+            const uint16_t *s = src + f->pos[x];
+            int sum = 1 << (COEF_BITS-1);
+            for( int k = 0; k < f->taps; k++ )
+                sum += s[k]*coef[k];
+            dst[x] = x264_clip3( sum >> COEF_BITS, 0, 0xffff );
+        }
+}
+
+static void scale_v( uint16_t *dst, uint16_t **src, const int16_t *coef, int taps, int32_t *acc, int width )
+{
+    if( taps == 2 )
+    {
+        const uint16_t *s0 = src[0], *s1 = src[1];
+        int c0 = coef[0], c1 = coef[1];
+        for( int x = 0; x < width; x++ )
+            dst[x] = (s0[x]*c0 + s1[x]*c1 + (1 << (COEF_BITS-1))) >> COEF_BITS;
+        return;
+    }
+    for( int x = 0; x < width; x++ )
+        acc[x] = src[0][x]*coef[0] + (1 << (COEF_BITS-1));
+    for( int k = 1; k < taps; k++ )
+    {
+        const uint16_t *s = src[k];
+        int c = coef[k];
+        for( int x = 0; x < width; x++ )
+            acc[x] += s[x]*c;
+    }
+    for( int x = 0; x < width; x++ )
+        dst[x] = x264_clip3( acc[x] >> COEF_BITS, 0, 0xffff );
+}
+
+/* scales destination row y of plane p into dst */
+static void scale_row( cli_scaler_t *s, scale_slice_t *b, int p, int y, uint16_t *dst )
+{
+    scale_plane_t *pl = &s->plane[p];
+    scale_filter_t *v = &pl->v;
+    for( int k = 0; k < v->taps; k++ )
+    {
+        int src_y = x264_clip3( v->pos[y] + k, 0, pl->src_height - 1 );
+        int slot = src_y % v->taps;
+        uint16_t *ring = b->ring[p] + slot * pl->dst_width;
+        if( b->ring_row[p][slot] != src_y )
+        {
+            fetch_row( s, b, p, src_y );
+            if( pl->h.identity )
+                memcpy( ring, b->line + pl->pad, pl->dst_width * sizeof(uint16_t) );
+            else
+                scale_h( ring, b->line + pl->pad, &pl->h, pl->dst_width );
+            b->ring_row[p][slot] = src_y;
+        }
+        b->window[k] = ring;
+    }
+    if( v->identity )
+        memcpy( dst, b->window[0], pl->dst_width * sizeof(uint16_t) );
+    else
+        scale_v( dst, b->window, v->coef + y * v->taps, v->taps, b->acc, pl->dst_width );
+}
+
+static void convert_range( cli_scaler_t *s, int p, uint16_t *row, int width )
+{
+    int32_t m = s->matrix[p][p], off = s->offset[p];
+    for( int x = 0; x < width; x++ )
+        row[x] = x264_clip3( (m*row[x] + off) >> MAT_BITS, 0, 0xffff );
+}
+
+static void convert_to_rgb( cli_scaler_t *s, uint16_t **row, int width )
+{
+    uint16_t *y = row[0], *u = row[1], *v = row[2];
+    const int32_t (*m)[3] = (const int32_t (*)[3])s->matrix;
+    for( int x = 0; x < width; x++ )
+    {
+        int r = (m[0][0]*y[x] + m[0][2]*v[x] + s->offset[0]) >> MAT_BITS;
+        int g = (m[1][0]*y[x] + m[1][1]*u[x] + m[1][2]*v[x] + s->offset[1]) >> MAT_BITS;
+        int b = (m[2][0]*y[x] + m[2][1]*u[x] + s->offset[2]) >> MAT_BITS;
+        /* the matrix overwrites the samples in place */
+        y[x] = x264_clip3( r, 0, 0xffff );
+        u[x] = x264_clip3( g, 0, 0xffff );
+        v[x] = x264_clip3( b, 0, 0xffff );
+    }
+}
+
+static void *scale_slice( scale_slice_t *b )
+{
+    cli_scaler_t *s = b->s;
+    if( s->dst_rgb )
+    {
+        /* all the components of a pixel are needed at once */
+        int height = s->plane[0].dst_height;
+        int width = s->plane[0].dst_width;
+        for( int y = height * b->index / s->threads; y < height * (b->index + 1) / s->threads; y++ )
+        {
+            for( int p = 0; p < s->planes; p++ )
+                scale_row( s, b, p, y, b->row[p] );
+            if( s->convert == CONVERT_TO_RGB )
+                convert_to_rgb( s, b->row, width );
+            for( int p = 0; p < s->planes; p++ )
+                write_row( s, &s->plane[p].dst, y, b->row[p], width );
+        }
+        if( s->dst_alpha )
+        {
+            scale_comp_t alpha = csp_component( X264_CSP_BGRA, 3 );
+            for( int x = 0; x < width; x++ )
+                b->row[0][x] = 0xffff;
+            for( int y = height * b->index / s->threads; y < height * (b->index + 1) / s->threads; y++ )
+                write_row( s, &alpha, y, b->row[0], width );
+        }
+        return NULL;
+    }
+    for( int p = 0; p < s->planes; p++ )
+    {
+        scale_plane_t *pl = &s->plane[p];
+        int height = pl->dst_height;
+        uint16_t *row = b->row[p];
+        for( int y = height * b->index / s->threads; y < height * (b->index + 1) / s->threads; y++ )
+        {
+            scale_row( s, b, p, y, row );
+            if( s->convert == CONVERT_RANGE )
+                convert_range( s, p, row, pl->dst_width );
+            write_row( s, &pl->dst, y, row, pl->dst_width );
+        }
+    }
+    return NULL;
+}
+
+static void run_slices( cli_scaler_t *s, void *(*func)( scale_slice_t * ) )
+{
+#if HAVE_THREAD
+    if( s->threads > 1 )
+    {
+        for( int i = 1; i < s->threads; i++ )
+            x264_threadpool_run( s->pool, (void*)func, &s->slice[i] );
+        func( &s->slice[0] );
+        for( int i = 1; i < s->threads; i++ )
+            x264_threadpool_wait( s->pool, &s->slice[i] );
+        return;
+    }
+#endif
+    func( &s->slice[0] );
+}
+
+void x264_cli_scaler_scale( cli_scaler_t *s, cli_image_t *out, cli_image_t *in )
+{
+    s->in = in;
+    s->out = out;
+    for( int i = 0; i < s->threads; i++ )
+        for( int p = 0; p < s->planes; p++ )
+            memset( s->slice[i].ring_row[p], -1, s->plane[p].v.taps * sizeof(int) );
+    /* every slice reads source rows of the others through the vertical filter */
+    if( s->convert == CONVERT_TO_YUV )
+        run_slices( s, convert_to_yuv );
+    run_slices( s, scale_slice );
+}
+
+static int init_slice( cli_scaler_t *s, scale_slice_t *b, int index )
+{
+    int max_src_width = 0, max_dst_width = 0, max_taps = 0;
+    b->s = s;
+    b->index = index;
+    for( int p = 0; p < s->planes; p++ )
+    {
+        scale_plane_t *pl = &s->plane[p];
+        max_src_width = X264_MAX( max_src_width, pl->src_width + 2 * pl->pad );
+        max_dst_width = X264_MAX( max_dst_width, pl->dst_width );
+        max_taps = X264_MAX( max_taps, pl->v.taps );
+        b->ring[p] = malloc( pl->v.taps * pl->dst_width * sizeof(uint16_t) );
+        b->ring_row[p] = malloc( pl->v.taps * sizeof(int) );
+        if( !b->ring[p] || !b->ring_row[p] )
+            return -1;
+    }
+    /* the destination rows also hold the components of rgb source rows */
+    max_dst_width = X264_MAX( max_dst_width, s->plane[0].src_width );
+    for( int p = 0; p < MAX_PLANES; p++ )
+        if( !(b->row[p] = malloc( max_dst_width * sizeof(uint16_t) )) )
+            return -1;
+    b->line = malloc( max_src_width * sizeof(uint16_t) );
+    b->window = malloc( max_taps * sizeof(uint16_t*) );
+    b->acc = malloc( max_dst_width * sizeof(int32_t) );
+    return !b->line || !b->window || !b->acc ? -1 : 0;
+}
+
+int x264_cli_scaler_init( cli_scaler_t **p_scaler, cli_scale_prop_t *src, cli_scale_prop_t *dst, int method, int threads )
+{
+    cli_scaler_t *s = calloc( 1, sizeof(cli_scaler_t) );
+    if( !s )
+        return -1;
+    *p_scaler = s;
+    s->src_depth = x264_cli_csp_depth_factor( src->csp );
+    s->dst_depth = x264_cli_csp_depth_factor( dst->csp );
+    if( !s->src_depth || !s->dst_depth )
+        return -1;
+    s->src_rgb = csp_is_rgb( src->csp );
+    s->dst_rgb = csp_is_rgb( dst->csp );
+    int alpha = (src->csp & X264_CSP_MASK) == X264_CSP_BGRA && (dst->csp & X264_CSP_MASK) == X264_CSP_BGRA;
+    s->dst_alpha = !alpha && (dst->csp & X264_CSP_MASK) == X264_CSP_BGRA;
+    s->planes = 3 + alpha;
+    init_conversion( s, src->fullrange, dst->fullrange );
+
+    const x264_cli_csp_t *src_csp = x264_cli_get_csp( src->csp );
+    const x264_cli_csp_t *dst_csp = x264_cli_get_csp( dst->csp );
+    for( int p = 0; p < s->planes; p++ )
+    {
+        scale_plane_t *pl = &s->plane[p];
+        int chroma = p == 1 || p == 2;
+        pl->src_width  = chroma && !s->src_rgb ? src->width  / src_csp->mod_width  : src->width;
+        pl->src_height = chroma && !s->src_rgb ? src->height / src_csp->mod_height : src->height;
+        pl->dst_width  = chroma && !s->dst_rgb ? dst->width  / dst_csp->mod_width  : dst->width;
+        pl->dst_height = chroma && !s->dst_rgb ? dst->height / dst_csp->mod_height : dst->height;
+        if( pl->src_width <= 0 || pl->src_height <= 0 || pl->dst_width <= 0 || pl->dst_height <= 0 ||
+            init_filter( &pl->h, method, pl->src_width, pl->dst_width ) ||
+            init_filter( &pl->v, method, pl->src_height, pl->dst_height ) )
+            return -1;
+        pl->pad = pl->h.taps / 2 + 1;
+        pl->src = csp_component( src->csp, p );
+        pl->dst = csp_component( dst->csp, p );
+    }
+    if( s->convert == CONVERT_TO_YUV )
+        for( int i = 0; i < 3; i++ )
+        {
+            s->rgb_src[i] = csp_component( src->csp, i );
+            s->yuv[i] = malloc( (size_t)src->width * src->height * sizeof(uint16_t) );
+            if( !s->yuv[i] )
+                return -1;
+        }
+
+    /* don't slice more finely than a few rows per thread */
+    threads = x264_clip3( X264_MIN( threads, dst->height / 16 ), 1, MAX_THREADS );
+#if HAVE_THREAD
+    if( threads > 1 && x264_threadpool_init( &s->pool, threads-1, NULL, NULL ) )
+        threads = 1;
+#else
+    threads = 1;
+#endif
+    s->threads = threads;
+    for( int i = 0; i < threads; i++ )
+        if( init_slice( s, &s->slice[i], i ) )
+            return -1;
+    return 0;
+}
+
+void x264_cli_scaler_close( cli_scaler_t *s )
+{
+    if( !s )
+        return;
+    if( s->pool )
+        x264_threadpool_delete( s->pool );
+    for( int i = 0; i < MAX_THREADS; i++ )
+    {
+        scale_slice_t *b = &s->slice[i];
+        for( int p = 0; p < MAX_PLANES; p++ )
+        {
+            free( b->ring[p] );
+            free( b->ring_row[p] );
+            free( b->row[p] );
+        }
+        free( b->line );
+        free( b->window );
+        free( b->acc );
+    }
+    for( int i = 0; i < 3; i++ )
+        free( s->yuv[i] );
+    for( int p = 0; p < MAX_PLANES; p++ )
+    {
+        free_filter( &s->plane[p].h );
+        free_filter( &s->plane[p].v );
+    }
+    free( s );
+}
@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * scale.h: native image scaler
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#ifndef X264_FILTER_VIDEO_SCALE_H
+#define X264_FILTER_VIDEO_SCALE_H
+#include "video.h"
+
+enum
+{
+    SCALE_POINT = 0,
+    SCALE_BILINEAR,
+    SCALE_BICUBIC,
+    SCALE_LANCZOS
+};
+
+typedef struct
+{
+    int csp;        /* any of the cli csps, with or without X264_CSP_HIGH_DEPTH */
+    int width;
+    int height;
+    int fullrange;  /* ignored for rgb, which is always full range */
+} cli_scale_prop_t;
+
+typedef struct cli_scaler_t cli_scaler_t;
+
+/* returns the SCALE_* method of a resizer method name, bicubic if unknown */
+int  x264_cli_scaler_method( const char *name );
+int  x264_cli_scaler_init( cli_scaler_t **p_scaler, cli_scale_prop_t *src, cli_scale_prop_t *dst, int method, int threads );
+void x264_cli_scaler_scale( cli_scaler_t *s, cli_image_t *out, cli_image_t *in );
+void x264_cli_scaler_close( cli_scaler_t *s );
+
+#endif
@@ -52,6 +52,7 @@ void x264_register_vid_filters( void )
     REGISTER_VFILTER( resize );
     REGISTER_VFILTER( select_every );
     REGISTER_VFILTER( depth );
+    REGISTER_VFILTER( pipeline );
 #if HAVE_GPL
 #endif
 }
@@ -341,7 +341,9 @@ static struct audio_packet_t *get_samples( hnd_t handle, int64_t first_sample, i
     if( h->func.avs_get_audio( h->clip, h->buffer, first_sample, nsamples ) )
         goto fail;
 
-    pkt->samples = x264_af_deinterleave2( h->buffer, h->sample_fmt, pkt->channels, pkt->samplecount );
+    pkt->samples = x264_af_deinterleave2( h->pool, h->buffer, h->sample_fmt, pkt->channels, pkt->samplecount );
+    if( !pkt->samples )
+        goto fail;
 
     if( h->eof )
         pkt->flags |= AUDIO_FLAG_EOF;
@@ -17,23 +17,43 @@ typedef struct lavf_source_t
 
     int samplefmt;
     unsigned track;
+
+    /* Decoded samples are kept in a ring, in the decoder's sample format:
+     * samples cache_first to cache_last - 1 are available, sample n being
+     * at n % bufsamples. */
     uint8_t *buffer;
-    intptr_t bufsize;
-    intptr_t surplus;
-    intptr_t len;
-    uint64_t bytepos;
+    int64_t bufsamples;
+    int64_t cache_first;
+    int64_t cache_last;
+    uint8_t *frame;         // decoder output, copied into the ring
+    int drained;            // decoding stopped on end of file or an error
 
     timebase_t origtb;
+    int64_t pts_offset;     // pts of the first sample, AV_NOPTS_VALUE if unknown
+    int resync;             // the next decoded frame starts at its packet's pts
     AVPacket *pkt;
+    AVPacket pkt_temp;      // what's left to decode of pkt
+    uint8_t desync_warn;
     audio_packet_t *out;
     int copy;
     int eof;
 } lavf_source_t;
 
-#define DEFAULT_BUFSIZE AVCODEC_MAX_AUDIO_FRAME_SIZE * 2
+/* In copy mode a packet carries the demuxed AVPacket its data points into,
+ * so compressed frames are passed on without being copied. */
+typedef struct
+{
+    audio_packet_t pkt;
+    AVPacket avpkt;
+    uint8_t *filtered;      // bitstream filter output, if the filter allocated one
+} lavf_packet_t;
+
+#define DEFAULT_CACHE 2.0   // seconds
+#define MIN_CACHE_BYTES (AVCODEC_MAX_AUDIO_FRAME_SIZE * 2)
 
 static int buffer_next_frame( lavf_source_t *h );
-static audio_packet_t *convert_to_audio_packet( hnd_t handle, AVPacket *pkt );
+static audio_packet_t *convert_to_audio_packet( lavf_source_t *h, lavf_packet_t *p );
+static audio_packet_t *take_first_packet( lavf_source_t *h );
 
 const audio_filter_t audio_filter_lavf;
 
@@ -41,13 +61,14 @@ static int init( hnd_t *handle, const char *opt_str )
 {
     assert( opt_str );
     assert( !(*handle) ); // This must be the first filter
-    char **opts = x264_split_options( opt_str, (const char*[]){ "filename", "track", NULL } );
+    char **opts = x264_split_options( opt_str, (const char*[]){ "filename", "track", "cache", NULL } );
 
     if( !opts )
         return -1;
 
     char *filename = x264_get_option( "filename", opts );
     char *trackstr = x264_otos( x264_get_option( "track", opts ), "any" );
+    double cache   = x264_otof( x264_get_option( "cache", opts ), DEFAULT_CACHE );
 
     if( !filename )
     {
@@ -136,13 +157,16 @@ static int init( hnd_t *handle, const char *opt_str )
     };
     h->origtb = (timebase_t) { h->lavf->streams[track]->time_base.num, h->lavf->streams[track]->time_base.den };
 
-    h->bufsize = DEFAULT_BUFSIZE;
-    h->surplus = h->info.framesize * 3 / 2;
-    assert( h->bufsize > h->surplus * 2 );
-    h->buffer  = av_malloc( h->bufsize );
+    h->bufsamples = X264_MAX( cache * h->info.samplerate, MIN_CACHE_BYTES / h->info.samplesize );
+    h->buffer     = av_malloc( h->bufsamples * h->info.samplesize );
+    h->frame      = av_malloc( AVCODEC_MAX_AUDIO_FRAME_SIZE );
+    if( !h->buffer || !h->frame )
+        goto fail;
 
     if( !buffer_next_frame( h ) )
         goto codecfail;
+    /* positions after a seek are relative to where the first frame starts */
+    h->pts_offset = h->pkt->pts != AV_NOPTS_VALUE ? h->pkt->pts : h->pkt->dts;
 
     x264_free_string_array( opts );
     return 0;
@@ -152,6 +176,11 @@ codecfail:
 codecnotfound:
     AF_LOG_ERR( h, "no decoder found for track %d\n", h->track );
 fail:
+    if( h )
+    {
+        av_free( h->buffer );
+        av_free( h->frame );
+    }
     if( h && h->lavf )
         avformat_close_input( &h->lavf );
     if( h )
@@ -170,15 +199,21 @@ static inline void free_avpacket( AVPacket *pkt )
 
 static void free_packet( hnd_t handle, audio_packet_t *pkt )
 {
+    lavf_source_t *h = handle;
+    if( h->copy )
+    {
+        lavf_packet_t *p = (lavf_packet_t*)pkt;
+        av_free( p->filtered );
+        av_free_packet( &p->avpkt );
+        free( p );
+        return;
+    }
     pkt->owner = NULL;
     x264_af_free_packet( pkt );
 }
 
-static struct AVPacket *next_packet( hnd_t handle )
+static int read_packet( lavf_source_t *h, AVPacket *pkt )
 {
-    lavf_source_t *h = handle;
-    AVPacket *pkt = calloc( 1, sizeof( AVPacket ) );
-
     int ret;
     do
     {
@@ -193,11 +228,22 @@ static struct AVPacket *next_packet( hnd_t handle )
                 AF_LOG( h, X264_LOG_INFO, "end of file reached\n" );
                 h->eof = 1;
             }
-            free_avpacket( pkt );
-            return NULL;
+            av_free_packet( pkt );
+            return -1;
         }
     } while( pkt->stream_index != h->track );
 
+    return 0;
+}
+
+static struct AVPacket *next_packet( hnd_t handle )
+{
+    AVPacket *pkt = calloc( 1, sizeof( AVPacket ) );
+    if( pkt && read_packet( handle, pkt ) )
+    {
+        free( pkt );
+        return NULL;
+    }
     return pkt;
 }
 
@@ -223,14 +269,14 @@ static hnd_t copy_init( hnd_t filter_chain, const char *opts )
                 fprintf( stderr, "lavf [error]: failed to init aac_adtstoasc bitstream filter!\n" );
                 return NULL;
             }
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
             h->info.extradata = h->ctx->extradata;
             h->info.extradata_size = h->ctx->extradata_size;
             h->info.codec_name = "aac";
         }
         else if( ( h->ctx->codec->id == AV_CODEC_ID_MP4ALS ) && !h->ctx->extradata )
         {
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
             h->info.extradata = h->ctx->extradata;
             h->info.extradata_size = h->ctx->extradata_size;
             h->info.codec_name = "als";
@@ -245,7 +291,7 @@ static hnd_t copy_init( hnd_t filter_chain, const char *opts )
                 return NULL;
             }
             memcpy( h->ctx->extradata, h->pkt->data, h->ctx->extradata_size );
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
             h->info.extradata = h->ctx->extradata;
             h->info.extradata_size = h->ctx->extradata_size;
             h->info.codec_name = h->ctx->codec->id == AV_CODEC_ID_AC3 ? "ac3" : "dca";
@@ -253,17 +299,21 @@ static hnd_t copy_init( hnd_t filter_chain, const char *opts )
         else if( ( h->ctx->codec->id == AV_CODEC_ID_AMR_NB ) )
         {
             h->info.codec_name = "amrnb";
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
         }
         else if( ( h->ctx->codec->id == AV_CODEC_ID_AMR_WB ) )
         {
             h->info.codec_name = "amrwb";
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
         }
         else
-            h->out = convert_to_audio_packet( h, h->pkt );
+            h->out = take_first_packet( h );
 
-        h->pkt = NULL;
+        if( !h->out )
+        {
+            fprintf( stderr, "lavf [error]: malloc failed!\n" );
+            return NULL;
+        }
         return chain;
     }
     fprintf( stderr, "lavf [error]: attempted to enter copy mode with a non-empty filter chain!" ); // as far as CLI users see, lavf isn't a filter
@@ -276,38 +326,56 @@ static audio_info_t *get_info( hnd_t handle )
     return &h->info;
 }
 
-static audio_packet_t *convert_to_audio_packet( hnd_t handle, AVPacket *pkt )
+/* Takes over the AVPacket read into p, whose payload the packet then points to. */
+static audio_packet_t *convert_to_audio_packet( lavf_source_t *h, lavf_packet_t *p )
 {
-    lavf_source_t *h = handle;
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
+    AVPacket *pkt = &p->avpkt;
+    audio_packet_t *out = &p->pkt;
+    /* the demuxer may only lend the data until the next read */
+    if( av_dup_packet( pkt ) < 0 )
+    {
+        av_free_packet( pkt );
+        free( p );
+        return NULL;
+    }
 
     out->dts = x264_convert_timebase( pkt->dts != AV_NOPTS_VALUE ? pkt->dts :
                                       pkt->pts != AV_NOPTS_VALUE ? pkt->pts : INVALID_DTS,
                                       h->origtb, h->info.timebase );
-    out->info        = h->info;
-    out->channels    = h->info.channels;
+    out->info     = h->info;
+    out->channels = h->info.channels;
+    out->owner    = h;
+    out->data     = pkt->data;
+    out->size     = pkt->size;
 
     if( h->bsfs )
     {
         uint8_t *buf;
         int size;
-        av_bitstream_filter_filter( h->bsfs, h->ctx, NULL, &buf, &size, pkt->data, pkt->size, 0 );
-        out->samplecount = size * h->info.samplesize;
-        out->size = size;
-        out->data = malloc( out->size );
-        memcpy( out->data, buf, size );
-    }
-    else
-    {
-        out->samplecount = pkt->size * h->info.samplesize;
-        out->size        = pkt->size;
-        out->data        = malloc( out->size );
-        memcpy( out->data, pkt->data, pkt->size );
+        int ret = av_bitstream_filter_filter( h->bsfs, h->ctx, NULL, &buf, &size, pkt->data, pkt->size, 0 );
+        if( ret > 0 )
+            p->filtered = buf;
+        if( ret >= 0 )
+        {
+            out->data = buf;
+            out->size = size;
+        }
     }
-    free_avpacket( pkt );
+    out->samplecount = out->size * h->info.samplesize;
     return out;
 }
 
+static audio_packet_t *take_first_packet( lavf_source_t *h )
+{
+    lavf_packet_t *p = calloc( 1, sizeof( lavf_packet_t ) );
+    if( !p )
+        return NULL;
+    p->avpkt = *h->pkt;
+    free( h->pkt );
+    h->pkt = NULL;
+    return convert_to_audio_packet( h, p );
+}
+
 static audio_packet_t *get_next_packet( hnd_t handle )
 {
     lavf_source_t *h = handle;
@@ -322,12 +390,18 @@ static audio_packet_t *get_next_packet( hnd_t handle )
         return out;
     }
 
-    AVPacket *pkt = next_packet( h );
-    if( !pkt )
+    lavf_packet_t *p = calloc( 1, sizeof( lavf_packet_t ) );
+    if( !p )
+        return NULL;
+    if( read_packet( h, &p->avpkt ) )
+    {
+        free( p );
         return NULL;
+    }
+    AVPacket *pkt = &p->avpkt;
     if( pkt->duration && ( h->info.framelen != x264_from_timebase( pkt->duration, h->origtb, h->info.timebase.den ) ) )
         h->info.last_delta = x264_from_timebase( pkt->duration, h->origtb, h->info.timebase.den );
-    return convert_to_audio_packet( h, pkt );
+    return convert_to_audio_packet( h, p );
 }
 
 static audio_packet_t *copy_finish( hnd_t handle )
@@ -352,26 +426,24 @@ static void skip_samples( hnd_t handle, uint64_t samplecount )
 
 static int low_decode_audio( lavf_source_t *h, uint8_t *buf, intptr_t buflen )
 {
-    static AVPacket pkt_temp;
-    static uint8_t desync_warn = 0;
-
+    AVPacket *pkt_temp = &h->pkt_temp;
     int len = 0, datalen = 0;
 
-    while( h->pkt && pkt_temp.size > 0 )
+    while( h->pkt && pkt_temp->size > 0 )
     {
         datalen = buflen;
-        len = avcodec_decode_audio3( h->ctx, (int16_t*) buf, &datalen, &pkt_temp );
+        len = avcodec_decode_audio3( h->ctx, (int16_t*) buf, &datalen, pkt_temp );
 
         if( len < 0 ) {
             // Broken frame, drop
-            if( !desync_warn++ ) // repeat the warning every 256 errors
+            if( !h->desync_warn++ ) // repeat the warning every 256 errors
                 AF_LOG_WARN( h, "Decoding errors may cause audio desync\n" );
-            pkt_temp.size = 0;
+            pkt_temp->size = 0;
             break;
         }
 
-        pkt_temp.data += len;
-        pkt_temp.size -= len;
+        pkt_temp->data += len;
+        pkt_temp->size -= len;
 
         if( datalen < 0 )
             continue;
@@ -379,169 +451,162 @@ static int low_decode_audio( lavf_source_t *h, uint8_t *buf, intptr_t buflen )
         return datalen;
     }
 
-    free_avpacket( h->pkt );
+    if( h->pkt )
+        free_avpacket( h->pkt );
     h->pkt = next_packet( h );
 
     if( !h->pkt )
         return -1;
 
-    pkt_temp.data = h->pkt->data;
-    pkt_temp.size = h->pkt->size;
+    pkt_temp->data = h->pkt->data;
+    pkt_temp->size = h->pkt->size;
 
     return 0;
 }
 
-static struct AVPacket *decode_next_frame( lavf_source_t *h )
+static inline int64_t ring_pos( lavf_source_t *h, int64_t sample )
 {
-    AVPacket *dst = calloc( 1, sizeof( AVPacket ) );
-    assert( !av_new_packet( dst, AVCODEC_MAX_AUDIO_FRAME_SIZE ) );
+    return ( sample % h->bufsamples + h->bufsamples ) % h->bufsamples;
+}
 
-    int len = 0;
-    while( ( len = low_decode_audio( h, dst->data, dst->size ) ) == 0 )
+static int buffer_next_frame( lavf_source_t *h )
+{
+    int len;
+    while( ( len = low_decode_audio( h, h->frame, AVCODEC_MAX_AUDIO_FRAME_SIZE ) ) == 0 )
     {
         // Read more
     }
     if( len < 0 ) // EOF or demuxing error
-    {
-        free_avpacket( dst );
-        return NULL;
-    }
-
-    dst->size = len;
-
-    return dst;
-}
-
-static int buffer_next_frame( lavf_source_t *h )
-{
-    AVPacket *dec = decode_next_frame( h );
-    if( !dec )
         return 0;
 
-    if( h->len + dec->size > h->bufsize )
+    if( h->resync )
     {
-        memmove( h->buffer, h->buffer + dec->size, h->bufsize - dec->size );
-        h->len     -= dec->size;
-        h->bytepos += dec->size;
+        int64_t pts = h->pkt->pts != AV_NOPTS_VALUE ? h->pkt->pts : h->pkt->dts;
+        if( pts == AV_NOPTS_VALUE )
+        {
+            AF_LOG_ERR( h, "no timestamp to resume decoding from after seeking\n" );
+            return 0;
+        }
+        h->cache_first = h->cache_last = x264_convert_timebase( pts - h->pts_offset, h->origtb, h->info.timebase );
+        h->resync = 0;
     }
-    memcpy( h->buffer + h->len, dec->data, dec->size );
-    h->len += dec->size;
 
-    free_avpacket( dec );
+    int64_t samples = len / h->info.samplesize;
+    int64_t pos     = ring_pos( h, h->cache_last );
+    int64_t part    = X264_MIN( samples, h->bufsamples - pos );
+    memcpy( h->buffer + pos * h->info.samplesize, h->frame, part * h->info.samplesize );
+    memcpy( h->buffer, h->frame + part * h->info.samplesize, ( samples - part ) * h->info.samplesize );
+    h->cache_last += samples;
+    h->cache_first = X264_MAX( h->cache_first, h->cache_last - h->bufsamples );
 
     return 1;
 }
 
-static inline int not_in_cache( lavf_source_t *h, int64_t sample )
+/* Restarts decoding from a keyframe at or before sample.  Container indexes
+ * aren't always exact, so if decoding resumes after sample the seek is
+ * retried further back, and finally from the start. */
+static int seek_to( lavf_source_t *h, int64_t sample )
 {
-    int64_t samplebyte = sample * h->info.samplesize;
-    if( samplebyte < h->bytepos )
-        return -1; // before
-    else if( samplebyte < h->bytepos + h->len )
-        return 0; // in cache
-    return 1; // after
+    if( h->pts_offset == AV_NOPTS_VALUE )
+        return -1;
+    int64_t target = sample;
+    for( int tries = 0; tries < 4; tries++ )
+    {
+        if( tries == 3 )
+            target = 0;
+        int64_t ts = h->pts_offset + x264_convert_timebase( target, h->info.timebase, h->origtb );
+        if( av_seek_frame( h->lavf, h->track, ts, AVSEEK_FLAG_BACKWARD ) < 0 )
+            return -1;
+        avcodec_flush_buffers( h->ctx );
+        if( h->pkt )
+            free_avpacket( h->pkt );
+        h->pkt = NULL;
+        h->pkt_temp.size = 0;
+        h->eof = 0;
+        h->resync = 1;
+        if( !buffer_next_frame( h ) )
+        {
+            /* what was cached is of no use anymore and decoding can't go on */
+            h->drained = 1;
+            h->cache_first = h->cache_last = sample;
+            return h->eof ? 0 : -1;
+        }
+        h->drained = 0;
+        if( h->cache_first <= sample )
+            return 0;
+        target -= h->cache_first - sample + h->info.samplerate;
+        target  = X264_MAX( target, 0 );
+    }
+    return -1;
 }
 
-static int64_t fill_buffer_until( lavf_source_t *h, int64_t lastsample )
+/* Makes sure sample is cached, unless the input ends before it.  Jumps
+ * further ahead than the cache depth seek instead of decoding everything in
+ * between, when the input is seekable. */
+static int cache_sample( lavf_source_t *h, int64_t sample )
 {
-    static int errored = 0;
-    if( errored )
-        return -1;
-    if( not_in_cache( h, lastsample ) < 0 )
+    if( sample < h->cache_first || ( sample >= h->cache_last + h->bufsamples && !h->drained ) )
     {
-        AF_LOG_ERR( h, "backwards seeking not supported yet "
-                       "(requested sample %"PRIu64", first available is %"PRIu64")\n",
-                       lastsample, h->bytepos / h->info.samplesize );
-        return -1;
+        if( seek_to( h, sample ) < 0 && sample < h->cache_first )
+        {
+            AF_LOG_ERR( h, "could not seek back to sample %"PRId64" (first available is %"PRId64")\n",
+                        sample, h->cache_first );
+            return -1;
+        }
     }
-    int ret;
-    while( ( ret = not_in_cache( h, lastsample ) ) > 0 )
+    while( sample >= h->cache_last && !h->drained )
+        h->drained = !buffer_next_frame( h );
+    return 0;
+}
+
+/* Requests of any size are copied out of the ring as it gets filled, each
+ * part deinterleaved straight into its slice of the packet. */
+static int read_samples( lavf_source_t *h, audio_packet_t *pkt, int64_t first_sample, int64_t last_sample )
+{
+    float *view[pkt->channels];
+
+    for( int64_t pos = first_sample; pos < last_sample; )
     {
-        if( !buffer_next_frame( h ) )
+        if( cache_sample( h, pos ) < 0 )
+            return -1;
+        if( pos >= h->cache_last )
         {
-            // libavcodec already warns for us
-            errored = 1;
+            pkt->flags |= AUDIO_FLAG_EOF;
             break;
         }
+        int64_t start   = ring_pos( h, pos );
+        int64_t samples = X264_MIN( last_sample, h->cache_last ) - pos;
+        samples = X264_MIN( samples, h->bufsamples - start );
+        x264_af_slice_buffer( view, pkt->samples, pkt->channels, pkt->samplecount );
+        if( x264_af_deinterleave_to( view, h->buffer + start * h->info.samplesize, h->samplefmt, pkt->channels, samples ) < 0 )
+            return -1;
+        pkt->samplecount += samples;
+        pos += samples;
     }
-    assert( ret >= 0 );
-    return h->bytepos + h->len;
+    return 0;
 }
 
-
 static struct audio_packet_t *get_samples( hnd_t handle, int64_t first_sample, int64_t last_sample )
 {
     lavf_source_t *h = handle;
     assert( !h->copy );
     assert( first_sample >= 0 && last_sample > first_sample );
 
-    if( fill_buffer_until( h, first_sample ) < 0 )
-        return NULL;
-
     audio_packet_t *pkt = calloc( 1, sizeof( audio_packet_t ) );
+    if( !pkt )
+        return NULL;
     pkt->info           = h->info;
     pkt->channels       = h->info.channels;
-    pkt->samplecount    = last_sample - first_sample;
-    pkt->size           = pkt->samplecount * h->info.samplesize;
     pkt->dts            = first_sample;
+    pkt->samples        = x264_af_get_buffer( h->pool, pkt->channels, last_sample - first_sample );
 
-    if( pkt->size + h->surplus > h->bufsize )
-    {
-        int64_t pivot = first_sample + ( h->bufsize - h->surplus * 2 ) / h->info.samplesize;
-        int64_t expected_size = ( pivot - first_sample ) * h->info.samplesize;
-
-        audio_packet_t *prev = get_samples( h, first_sample, pivot );
-        if( !prev )
-            goto fail;
-
-        if( prev->size < expected_size ) // EOF
-        {
-            x264_af_free_packet( pkt );
-            prev->flags |= AUDIO_FLAG_EOF;
-            return prev;
-        }
-        assert( prev->size == expected_size );
-
-        audio_packet_t *next = get_samples( h, pivot, last_sample );
-        if( !next )
-        {
-            x264_af_free_packet( prev );
-            goto fail;
-        }
-
-        pkt->samples = x264_af_dup_buffer( prev->samples, prev->channels, prev->samplecount );
-        x264_af_cat_buffer( pkt->samples, pkt->samplecount, next->samples, next->samplecount, pkt->channels );
-
-        pkt->samplecount = prev->samplecount + next->samplecount;
-        pkt->size        = prev->size + next->size;
-
-        x264_af_free_packet( prev );
-        x264_af_free_packet( next );
-    }
-    else
+    if( !pkt->samples || read_samples( h, pkt, first_sample, last_sample ) < 0 )
     {
-        int64_t lastreq   = last_sample * h->info.samplesize;
-        int64_t lastavail = fill_buffer_until( h, last_sample );
-        if( lastavail < 0 )
-            goto fail;
-
-        intptr_t start = first_sample * h->info.samplesize - h->bytepos;
-
-        if( lastavail < lastreq )
-        {
-            pkt->size        = lastavail - h->bytepos - start;
-            pkt->samplecount = pkt->size / h->info.samplesize;
-            pkt->flags       = AUDIO_FLAG_EOF;
-        }
-        assert( start + pkt->size <= h->bufsize );
-        pkt->samples = x264_af_deinterleave2( h->buffer + start, h->samplefmt, pkt->channels, pkt->samplecount );
+        x264_af_free_packet( pkt );
+        return NULL;
     }
-
+    pkt->size = pkt->samplecount * h->info.samplesize;
     return pkt;
-
-fail:
-    x264_af_free_packet( pkt );
-    return NULL;
 }
 
 static void lavf_close( hnd_t handle )
@@ -549,8 +614,11 @@ static void lavf_close( hnd_t handle )
     assert( handle );
     lavf_source_t *h = handle;
     av_free( h->buffer );
+    av_free( h->frame );
     if( h->pkt )
         free_avpacket( h->pkt );
+    if( h->out )
+        free_packet( h, h->out );
     avcodec_close( h->ctx );
     avformat_close_input( &h->lavf );
     if( h->bsfs )
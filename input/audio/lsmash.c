@@ -144,6 +144,9 @@ static int lsmash_init( hnd_t *handle, const char *opt_str )
 
     x264_free_string_array( opts );
 
+    /* access units get parsed ahead while the previous ones are muxed, or inline if that can't be set up */
+    mp4sys_importer_start_readahead( h->importer, 1 );
+
     x264_cli_log( "lsmash", X264_LOG_INFO, "opened L-SMASH importer for %s audio stream copy.\n", h->info.codec_name );
 
     return 0;
@@ -194,7 +197,8 @@ static audio_packet_t *get_next_au( hnd_t handle )
 {
     lsmash_source_t *h = handle;
 
-    audio_packet_t *out = calloc( 1, sizeof( audio_packet_t ) );
+    /* the importer writes the access unit straight into the packet */
+    audio_packet_t *out = x264_af_alloc_packet( h->summary->max_au_length );
     if( !out )
         return NULL;
     out->info        = h->info;
@@ -202,13 +206,11 @@ static audio_packet_t *get_next_au( hnd_t handle )
     out->samplecount = h->info.framelen;
     out->dts         = h->last_dts;
 
-    lsmash_sample_t sample = { 0 };
-    lsmash_sample_alloc( &sample, h->summary->max_au_length );
+    lsmash_sample_t sample = { .data = out->data, .length = out->size };
 
     int ret = mp4sys_importer_get_access_unit( h->importer, 1, &sample );
 
     out->size = sample.length;
-    out->data = sample.data;
 
     if( ret || !out->size )
     {
@@ -109,3 +109,138 @@ const x264_cli_csp_t *x264_cli_get_csp( int csp )
         return NULL;
     return x264_cli_csps + (csp&X264_CSP_MASK);
 }
+
+struct cli_pic_buf_t
+{
+    cli_pic_pool_t *pool;
+    int refcount;
+    cli_pic_t pic;
+    cli_pic_buf_t *next;    /* in the list of unreferenced buffers */
+};
+
+struct cli_pic_pool_t
+{
+    int csp;
+    int width;
+    int height;
+    int count;              /* number of allocated buffers */
+    int deleted;            /* the pool goes away with its last buffer */
+    cli_pic_buf_t *unused;
+    x264_pthread_mutex_t mutex;
+};
+
+cli_pic_pool_t *x264_cli_pic_pool_create( int csp, int width, int height )
+{
+    cli_pic_pool_t *pool = calloc( 1, sizeof(cli_pic_pool_t) );
+    if( !pool )
+        return NULL;
+    pool->csp = csp;
+    pool->width = width;
+    pool->height = height;
+    if( x264_pthread_mutex_init( &pool->mutex, NULL ) )
+    {
+        free( pool );
+        return NULL;
+    }
+    return pool;
+}
+
+static void pic_pool_free_unused( cli_pic_pool_t *pool )
+{
+    while( pool->unused )
+    {
+        cli_pic_buf_t *buf = pool->unused;
+        pool->unused = buf->next;
+        x264_cli_pic_clean( &buf->pic );
+        free( buf );
+        pool->count--;
+    }
+}
+
+void x264_cli_pic_pool_delete( cli_pic_pool_t *pool )
+{
+    if( !pool )
+        return;
+    x264_pthread_mutex_lock( &pool->mutex );
+    pic_pool_free_unused( pool );
+    pool->deleted = 1;
+    int count = pool->count;
+    x264_pthread_mutex_unlock( &pool->mutex );
+    if( !count )
+    {
+        x264_pthread_mutex_destroy( &pool->mutex );
+        free( pool );
+    }
+}
+
+int x264_cli_pic_pool_get( cli_pic_pool_t *pool, cli_pic_t *pic )
+{
+    x264_pthread_mutex_lock( &pool->mutex );
+    cli_pic_buf_t *buf = pool->unused;
+    if( buf )
+        pool->unused = buf->next;
+    else if( (buf = calloc( 1, sizeof(cli_pic_buf_t) )) )
+    {
+        if( x264_cli_pic_alloc( &buf->pic, pool->csp, pool->width, pool->height ) )
+        {
+            x264_cli_pic_clean( &buf->pic );
+            free( buf );
+            buf = NULL;
+        }
+        else
+        {
+            buf->pool = pool;
+            buf->pic.buf = buf;
+            pool->count++;
+        }
+    }
+    if( buf )
+        buf->refcount = 1;
+    x264_pthread_mutex_unlock( &pool->mutex );
+    if( !buf )
+        return -1;
+    *pic = buf->pic;
+    return 0;
+}
+
+int x264_cli_pic_ref( cli_pic_t *pic )
+{
+    cli_pic_buf_t *buf = pic->buf;
+    if( !buf )
+        return -1;
+    x264_pthread_mutex_lock( &buf->pool->mutex );
+    buf->refcount++;
+    x264_pthread_mutex_unlock( &buf->pool->mutex );
+    return 0;
+}
+
+int x264_cli_pic_is_from_pool( cli_pic_t *pic, cli_pic_pool_t *pool )
+{
+    return pic->buf && pic->buf->pool == pool;
+}
+
+void x264_cli_pic_unref( cli_pic_t *pic )
+{
+    cli_pic_buf_t *buf = pic->buf;
+    if( !buf )
+        return;
+    cli_pic_pool_t *pool = buf->pool;
+    x264_pthread_mutex_lock( &pool->mutex );
+    int destroy = 0;
+    if( !--buf->refcount )
+    {
+        buf->next = pool->unused;
+        pool->unused = buf;
+        if( pool->deleted )
+        {
+            pic_pool_free_unused( pool );
+            destroy = !pool->count;
+        }
+    }
+    x264_pthread_mutex_unlock( &pool->mutex );
+    if( destroy )
+    {
+        x264_pthread_mutex_destroy( &pool->mutex );
+        free( pool );
+    }
+}
@@ -60,7 +60,7 @@ typedef struct
     uint32_t sar_width;
     uint32_t sar_height;
     int tff;
-    int thread_safe; /* demuxer is thread_input safe */
+    int thread_safe; /* demuxer is thread_input safe, and so are the filters applied so far */
     uint32_t timebase_num;
     uint32_t timebase_den;
     int vfr;
@@ -77,12 +77,16 @@ typedef struct
     int     stride[4]; /* strides for each plane */
 } cli_image_t;
 
+typedef struct cli_pic_buf_t cli_pic_buf_t;
+typedef struct cli_pic_pool_t cli_pic_pool_t;
+
 typedef struct
 {
     cli_image_t img;
     int64_t pts;       /* input pts */
     int64_t duration;  /* frame duration - used for vfr */
     void    *opaque;   /* opaque handle */
+    cli_pic_buf_t *buf; /* reference counted buffer holding the planes, NULL if not counted */
 } cli_pic_t;
 
 typedef struct
@@ -130,4 +134,17 @@ uint64_t x264_cli_pic_plane_size( int csp, int width, int height, int plane );
 uint64_t x264_cli_pic_size( int csp, int width, int height );
 const x264_cli_csp_t *x264_cli_get_csp( int csp );
 
+/* Pools of reference counted pictures. A filter gets its output pictures from a pool, so a following filter
+ * can keep a frame alive past release_frame by taking a reference instead of copying the image data.
+ * The planes of a counted picture are never rewritten until its last reference is dropped.
+ * Pools may be deleted while their pictures are still referenced. */
+cli_pic_pool_t *x264_cli_pic_pool_create( int csp, int width, int height );
+void x264_cli_pic_pool_delete( cli_pic_pool_t *pool );
+/* get an unreferenced picture with a reference count of 1 */
+int  x264_cli_pic_pool_get( cli_pic_pool_t *pool, cli_pic_t *pic );
+/* returns nonzero if the picture isn't reference counted */
+int  x264_cli_pic_ref( cli_pic_t *pic );
+void x264_cli_pic_unref( cli_pic_t *pic );
+int  x264_cli_pic_is_from_pool( cli_pic_t *pic, cli_pic_pool_t *pool );
+
 #endif
@@ -26,6 +26,7 @@
 #include "output.h"
 #include "flv_bytestream.h"
 #include "audio/encoders.h"
+#include "audio/timeline.h"
 #if HAVE_AUDIO
 #include "mp4/lsmash.h"
 #endif
@@ -44,7 +45,7 @@ typedef struct
     int header;
     int codecid;
     int stereo;
-    int64_t lastdts;
+    audio_timeline_t timeline;
 } flv_audio_hnd_t;
 #endif
 
@@ -79,6 +80,7 @@ typedef struct
 
 #if HAVE_AUDIO
     flv_audio_hnd_t *a_flv;
+    hnd_t audio_workers;
 #endif
 } flv_hnd_t;
 
@@ -107,7 +109,6 @@ static int audio_init( hnd_t handle, hnd_t filters, char *audio_enc, char *audio
     FAIL_IF_ERR( !henc, "flv", "error opening audio encoder\n" );
     flv_hnd_t *p_flv = handle;
     flv_audio_hnd_t *a_flv = p_flv->a_flv = calloc( 1, sizeof( flv_audio_hnd_t ) );
-    a_flv->lastdts = INVALID_DTS;
     audio_info_t *info = a_flv->info = x264_audio_encoder_info( henc );
 
     int header = 0;
@@ -179,6 +180,7 @@ static int audio_init( hnd_t handle, hnd_t filters, char *audio_enc, char *audio
 
     a_flv->header   = header;
     a_flv->encoder  = henc;
+    x264_audio_timeline_init( &a_flv->timeline, henc, (timebase_t){ 1, 1000 } );
 
     return 1;
 
@@ -202,7 +204,7 @@ static int write_header( flv_buffer *c, int audio )
     return flv_flush_data( c );
 }
 
-static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, hnd_t audio_filters, char *audio_enc, char *audio_params )
+static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, cli_audio_track_t *audio, int audio_tracks )
 {
     flv_hnd_t *p_flv = malloc( sizeof(*p_flv) );
     *p_handle = NULL;
@@ -218,8 +220,18 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
 
     int ret = 0;
 #if HAVE_AUDIO
-    ret = audio_init( p_flv, audio_filters, audio_enc, audio_params );
-    FAIL_IF_ERR( ret < 0, "flv", "unable to init audio output\n" );
+    /* FLV carries a single audio stream */
+    if( audio_tracks > 1 )
+        x264_cli_log( "flv", X264_LOG_WARNING, "only the first of %d audio tracks is muxed\n", audio_tracks );
+    for( int i = 1; i < audio_tracks; i++ )
+        x264_af_close( audio[i].filters );
+    if( audio_tracks )
+    {
+        ret = audio_init( p_flv, audio[0].filters, audio[0].encoder, audio[0].parameters );
+        FAIL_IF_ERR( ret < 0, "flv", "unable to init audio output\n" );
+    }
+    if( p_flv->a_flv )
+        p_flv->audio_workers = x264_audio_workers_open( &p_flv->a_flv->encoder, 1 );
 #endif
     CHECK( write_header( p_flv->c, ret ) );
     *p_handle = p_flv;
@@ -447,7 +459,7 @@ static int write_headers( hnd_t handle, x264_nal_t *p_nal )
 }
 
 #if HAVE_AUDIO
-static int write_audio( flv_hnd_t *p_flv, int64_t video_dts, int finish )
+static int write_audio( flv_hnd_t *p_flv, int64_t video_dts )
 {
     flv_audio_hnd_t *a_flv = p_flv->a_flv;
     flv_buffer *c = p_flv->c;
@@ -455,34 +467,15 @@ static int write_audio( flv_hnd_t *p_flv, int64_t video_dts, int finish )
     assert( a_flv );
 
     int aac = a_flv->codecid == FLV_CODECID_AAC;
-    if( a_flv->lastdts == INVALID_DTS )
-    {
-        if( video_dts > 0 )
-            x264_audio_encoder_skip_samples( a_flv->encoder, video_dts * a_flv->info->samplerate / 1000 );
-        a_flv->lastdts = video_dts; // first frame (nonzero if --seek is used)
-    }
     audio_packet_t *frame;
+    int64_t dts;
     int frames = 0;
-    while( a_flv->lastdts <= video_dts || video_dts < 0 )
+    while( (frame = x264_audio_timeline_next( &a_flv->timeline, video_dts, &dts )) )
     {
-        if( finish )
-            frame = x264_audio_encoder_finish( a_flv->encoder );
-        else if( !(frame = x264_audio_encode_frame( a_flv->encoder )) )
-        {
-            finish = 1;
-            continue;
-        }
-
-        if( !frame )
-            break;
-
-        assert( frame->dts >= 0 ); // Guard against encoders that don't give proper DTS
-        a_flv->lastdts = x264_from_timebase( frame->dts, frame->info.timebase, 1000 );
-
         flv_put_byte( c, FLV_TAG_TYPE_AUDIO );
         flv_put_be24( c, 1 + aac + frame->size );
-        flv_put_be24( c, (int32_t) a_flv->lastdts );
-        flv_put_byte( c, (int32_t) a_flv->lastdts >> 24 );
+        flv_put_be24( c, (int32_t) dts );
+        flv_put_byte( c, (int32_t) dts >> 24 );
         flv_put_be24( c, 0 );
 
         flv_put_byte( c, a_flv->header );
@@ -574,7 +567,7 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
     CHECK( flv_flush_data( c ) );
 
 #if HAVE_AUDIO
-    FAIL_IF_ERR( p_flv->a_flv && write_audio( p_flv, dts, 0 ) < 0, "flv", "error writing audio\n" );
+    FAIL_IF_ERR( p_flv->a_flv && write_audio( p_flv, dts ) < 0, "flv", "error writing audio\n" );
 #endif
 
     p_flv->i_framenum++;
@@ -597,8 +590,10 @@ static int close_file( hnd_t handle, int64_t largest_pts, int64_t second_largest
 #if HAVE_AUDIO
     if( p_flv->a_flv )
     {
-        FAIL_IF_ERR( p_flv->a_flv && write_audio( p_flv, -1, 1 ) < 0, "flv", "error flushing audio\n" );
+        FAIL_IF_ERR( p_flv->a_flv && write_audio( p_flv, -1 ) < 0, "flv", "error flushing audio\n" );
+        x264_audio_timeline_close( &p_flv->a_flv->timeline );
         x264_audio_encoder_close( p_flv->a_flv->encoder );
+        x264_audio_workers_close( p_flv->audio_workers );
     }
 #endif
 
@@ -27,6 +27,7 @@
 #include "matroska_ebml.h"
 #if HAVE_AUDIO
 #include "audio/encoders.h"
+#include "audio/timeline.h"
 #include "mp4/lsmash.h"
 #endif
 
@@ -35,7 +36,9 @@ typedef struct
 {
     audio_info_t *info;
     hnd_t encoder;
-    int64_t lastdts;
+    char *language;
+    uint32_t i_track;
+    audio_timeline_t timeline;
 } mkv_audio_hnd_t;
 #endif
 
@@ -48,15 +51,19 @@ typedef struct
     char b_writing_frame;
     uint32_t i_timebase_num;
     uint32_t i_timebase_den;
+    unsigned i_cues_space;
 #if HAVE_AUDIO
-    mkv_audio_hnd_t *a_mkv;
-    uint32_t i_audio_track;
+    mkv_audio_hnd_t *a_mkv[MAX_AUDIO_TRACKS];
+    int i_audio_tracks;
+    hnd_t audio_workers;
 #endif
 } mkv_hnd_t;
 
 #if HAVE_AUDIO
-static int audio_init( hnd_t handle, hnd_t filters, char *audio_enc, char *audio_parameters )
+static int audio_init( hnd_t handle, cli_output_opt_t *opt, cli_audio_track_t *track )
 {
+    hnd_t filters = track->filters;
+    char *audio_enc = track->encoder;
     if( !strcmp( audio_enc, "none" ) || !filters )
         return 0;
 
@@ -71,36 +78,31 @@ static int audio_init( hnd_t handle, hnd_t filters, char *audio_enc, char *audio
         const audio_encoder_t *encoder = x264_select_audio_encoder( audio_enc, (char*[]){ "aac", "ac3", "eac3", "vorbis", "mp3", "raw", NULL }, &used_enc );
         FAIL_IF_ERR( !encoder, "mkv", "unable to select audio encoder\n" );
 
-        snprintf( audio_params, MAX_ARGS, "%s,codec=%s", audio_parameters, used_enc );
+        snprintf( audio_params, MAX_ARGS, "%s,codec=%s", track->parameters, used_enc );
         henc = x264_audio_encoder_open( encoder, filters, audio_params );
     }
     FAIL_IF_ERR( !henc, "mkv", "error opening audio encoder\n" );
 
     mkv_hnd_t *p_mkv = handle;
-    mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv = calloc( 1, sizeof( mkv_audio_hnd_t ) );
+    mkv_audio_hnd_t *a_mkv = calloc( 1, sizeof( mkv_audio_hnd_t ) );
     if( !a_mkv )
     {
         x264_cli_log( "mkv", X264_LOG_ERROR, "malloc failed!\n" );
-        goto error;
+        x264_audio_encoder_close( henc );
+        return -1;
     }
 
-    a_mkv->lastdts = INVALID_DTS;
-    a_mkv->encoder = henc;
-    a_mkv->info    = x264_audio_encoder_info( henc );
+    a_mkv->encoder  = henc;
+    a_mkv->info     = x264_audio_encoder_info( henc );
+    a_mkv->language = track->language;
+    x264_audio_timeline_init( &a_mkv->timeline, henc, (timebase_t){ 1, 1000000000 } );
+    p_mkv->a_mkv[p_mkv->i_audio_tracks++] = a_mkv;
 
     return 1;
-
-error:
-    x264_audio_encoder_close( henc );
-    if( p_mkv->a_mkv )
-        free( p_mkv->a_mkv );
-    p_mkv->a_mkv = NULL;
-
-    return -1;
 }
 #endif
 
-static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, hnd_t audio_filters, char *audio_enc, char *audio_params )
+static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, cli_audio_track_t *audio, int audio_tracks )
 {
     mkv_hnd_t *p_mkv;
 
@@ -120,8 +122,16 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
     }
 
 #if HAVE_AUDIO
-    FAIL_IF_ERR( audio_init( p_mkv, audio_filters, audio_enc, audio_params ) < 0,
-                 "mkv", "unable to init audio output\n" );
+    for( int i = 0; i < audio_tracks; i++ )
+        FAIL_IF_ERR( audio_init( p_mkv, opt, &audio[i] ) < 0,
+                     "mkv", "unable to init audio output\n" );
+    if( p_mkv->i_audio_tracks )
+    {
+        hnd_t encoders[MAX_AUDIO_TRACKS];
+        for( int i = 0; i < p_mkv->i_audio_tracks; i++ )
+            encoders[i] = p_mkv->a_mkv[i]->encoder;
+        p_mkv->audio_workers = x264_audio_workers_open( encoders, p_mkv->i_audio_tracks );
+    }
 #endif
 
     *p_handle = p_mkv;
@@ -205,16 +215,16 @@ static lsmash_codec_specific_t *get_structured_codec_specific_data( audio_info_t
     return conv;
 }
 
-static int set_audio_track( mkv_hnd_t *p_mkv, x264_param_t *p_param )
+static int set_audio_track( mkv_hnd_t *p_mkv, mkv_audio_hnd_t *a_mkv, x264_param_t *p_param )
 {
-    mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv;
     audio_info_t *info = a_mkv->info;
     mk_track_t *atrack = &p_mkv->tracks[++p_mkv->i_track_count];
     mk_audio_info_t *a = &atrack->info.a;
 
-    atrack->id = p_mkv->i_audio_track = p_mkv->i_track_count;
+    atrack->id = a_mkv->i_track = p_mkv->i_track_count;
     atrack->type = MK_TRACK_AUDIO;
     atrack->lacing = MK_LACING_NONE;
+    atrack->language = a_mkv->language;
 
     if( !strcmp( info->codec_name, "aac" ) )
         atrack->codec_id = MK_AUDIO_TAG_AAC;
@@ -358,9 +368,19 @@ static int set_param( hnd_t handle, x264_param_t *p_param )
     FAIL_IF_ERR( set_video_track( p_mkv, p_param ), "mkv", "failed to create video track\n" );
 
 #if HAVE_AUDIO
-    FAIL_IF_ERR( p_mkv->a_mkv && set_audio_track( p_mkv, p_param ), "mkv", "failed to create audio track\n" );
+    for( int i = 0; i < p_mkv->i_audio_tracks; i++ )
+        FAIL_IF_ERR( set_audio_track( p_mkv, p_mkv->a_mkv[i], p_param ), "mkv", "failed to create audio track\n" );
 #endif
 
+    /* Reserve the space for Cues near the head of the file, one CuePoint per video keyframe: at most 27 bytes,
+     * i.e. its ID and size, an 8-byte CueTime, and CueTrackPositions holding a one-byte CueTrack and an 8-byte
+     * CueClusterPosition, each with its ID and size.  Cues that don't fit in there are written at the end of the file. */
+    if( p_param->i_frame_total )
+        p_mkv->i_cues_space = 64 + 27 * (p_param->i_frame_total / X264_MAX( p_param->i_keyint_min, 1 ) + 1);
+    else
+        p_mkv->i_cues_space = 4096;
+    p_mkv->i_cues_space = X264_MIN( p_mkv->i_cues_space, 1<<20 );
+
     return 0;
 }
 
@@ -406,7 +426,7 @@ static int write_headers( hnd_t handle, x264_nal_t *p_nal )
     memcpy( avcC+11+sps_size, pps, pps_size );
 
     ret = mk_write_header( p_mkv->w, "x264" X264_VERSION, 50000,
-                           p_mkv->tracks, p_mkv->i_track_count );
+                           p_mkv->tracks, p_mkv->i_track_count, p_mkv->i_cues_space );
 
     if( ret < 0 )
         return ret;
@@ -424,36 +444,28 @@ static int write_headers( hnd_t handle, x264_nal_t *p_nal )
 }
 
 #if HAVE_AUDIO
-static int write_audio( mkv_hnd_t *p_mkv, int64_t video_dts, int finish )
+/* Writes the frames of all audio tracks up to video_dts, merged in dts order. */
+static int write_audio( mkv_hnd_t *p_mkv, int64_t video_dts )
 {
-    mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv;
-
-    assert( a_mkv );
-
-    if( a_mkv->lastdts == INVALID_DTS )
-    {
-        if( video_dts > 0 )
-            x264_audio_encoder_skip_samples( a_mkv->encoder, video_dts * a_mkv->info->samplerate / 1000000000.0 );
-        a_mkv->lastdts = video_dts; // first frame (nonzero if --seek is used)
-    }
-
-    audio_packet_t *frame;
     int frames = 0;
-    while( a_mkv->lastdts <= video_dts || video_dts < 0 )
+    for(;;)
     {
-        if( finish )
-            frame = x264_audio_encoder_finish( a_mkv->encoder );
-        else if( !(frame = x264_audio_encode_frame( a_mkv->encoder )) )
+        mkv_audio_hnd_t *next = NULL;
+        int64_t next_dts = INVALID_DTS;
+        for( int i = 0; i < p_mkv->i_audio_tracks; i++ )
         {
-            finish = 1;
-            continue;
+            mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv[i];
+            int64_t dts = x264_audio_timeline_peek( &a_mkv->timeline, video_dts );
+            if( dts != INVALID_DTS && ( !next || dts < next_dts ) )
+            {
+                next = a_mkv;
+                next_dts = dts;
+            }
         }
-
-        if( !frame )
+        if( !next )
             break;
 
-        assert( frame->dts >= 0 ); // Guard against encoders that don't give proper DTS
-        a_mkv->lastdts = x264_from_timebase( frame->dts, frame->info.timebase, 1000000000 );
+        audio_packet_t *frame = x264_audio_timeline_next( &next->timeline, video_dts, &next_dts );
 
         if( mk_start_frame( p_mkv->w ) < 0 )
             return -1;
@@ -461,13 +473,13 @@ static int write_audio( mkv_hnd_t *p_mkv, int64_t video_dts, int finish )
         if( mk_add_frame_data( p_mkv->w, frame->data, frame->size ) < 0 )
             return -1;
 
-        if( mk_set_frame_flags( p_mkv->w, a_mkv->lastdts, 1, 0, p_mkv->i_audio_track ) < 0 )
+        if( mk_set_frame_flags( p_mkv->w, next_dts, 1, 0, next->i_track ) < 0 )
             return -1;
 
-        if( mk_end_frame( p_mkv->w, p_mkv->i_audio_track ) < 0 )
+        if( mk_end_frame( p_mkv->w, next->i_track ) < 0 )
             return -1;
 
-        x264_audio_free_frame( a_mkv->encoder, frame );
+        x264_audio_free_frame( next->encoder, frame );
 
         ++frames;
     }
@@ -494,7 +506,7 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
     }
 
 #if HAVE_AUDIO
-    FAIL_IF_ERR( p_mkv->a_mkv && write_audio( p_mkv, i_stamp, 0 ) < 0, "mkv", "error writing audio\n" );
+    FAIL_IF_ERR( p_mkv->i_audio_tracks && write_audio( p_mkv, i_stamp ) < 0, "mkv", "error writing audio\n" );
 #endif
 
     if( !skip )
@@ -518,20 +530,22 @@ static int close_file( hnd_t handle, int64_t largest_pts, int64_t second_largest
     i_last_delta[p_mkv->i_video_track] = p_mkv->i_timebase_den ? (int64_t)(((largest_pts - second_largest_pts) * 1e9 * p_mkv->i_timebase_num / p_mkv->i_timebase_den) + 0.5) : 0;
 
 #if HAVE_AUDIO
-    if( p_mkv->a_mkv )
+    FAIL_IF_ERR( p_mkv->i_audio_tracks && write_audio( p_mkv, -1 ) < 0, "mkv", "error flushing audio\n" );
+    for( int i = 0; i < p_mkv->i_audio_tracks; i++ )
     {
-        mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv;
-        FAIL_IF_ERR( a_mkv && write_audio( p_mkv, -1, 1 ) < 0, "mkv", "error flushing audio\n" );
-        i_last_delta[p_mkv->i_audio_track] = x264_from_timebase( a_mkv->info->last_delta, a_mkv->info->timebase, 1000000000 );
-        x264_audio_encoder_close( p_mkv->a_mkv->encoder );
+        mkv_audio_hnd_t *a_mkv = p_mkv->a_mkv[i];
+        i_last_delta[a_mkv->i_track] = x264_from_timebase( a_mkv->info->last_delta, a_mkv->info->timebase, 1000000000 );
+        x264_audio_timeline_close( &a_mkv->timeline );
+        x264_audio_encoder_close( a_mkv->encoder );
     }
+    x264_audio_workers_close( p_mkv->audio_workers );
 #endif
 
     ret = mk_close( p_mkv->w, i_last_delta );
 
 #if HAVE_AUDIO
-    if( p_mkv->a_mkv )
-        free( p_mkv->a_mkv );
+    for( int i = 0; i < p_mkv->i_audio_tracks; i++ )
+        free( p_mkv->a_mkv[i] );
 #endif
 
     int i;
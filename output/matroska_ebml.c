@@ -27,6 +27,8 @@
 #include "matroska_ebml.h"
 
 #define CLSIZE 1048576
+#define CLDURATION 5000000000ll /* in nanoseconds */
+#define SEEKHEAD_SIZE 26        /* SeekHead holding a Seek to Cues with 8-byte SeekPosition */
 #define CHECK(x)\
 do {\
     if( (x) < 0 )\
@@ -45,11 +47,27 @@ struct mk_context
 
 typedef struct mk_context mk_context;
 
+typedef struct
+{
+    int64_t timecode;       /* scaled */
+    int64_t cluster_pos;    /* relative to the data of Segment */
+    unsigned track_id;
+} mk_cue_t;
+
 struct mk_writer
 {
     FILE *fp;
 
     unsigned duration_ptr;
+    int64_t pos;            /* total size written into fp */
+    int64_t segment_size_ptr;
+    int64_t segment_pos;
+    int64_t void_pos;
+    unsigned void_size;
+    int64_t cluster_pos;
+
+    mk_cue_t *cues;
+    unsigned cue_count, cue_max;
 
     mk_context *root, *cluster, *frame;
     mk_context *freelist;
@@ -61,8 +79,10 @@ struct mk_writer
     int64_t cluster_tc_scaled;
     int64_t frame_tc;
     int64_t max_frame_tc[MK_MAX_TRACKS];
+    mk_track_type track_type[MK_MAX_TRACKS];
 
     char wrote_header, in_frame, keyframe, skippable;
+    char live;  /* the output isn't seekable: sizes of Segment and Cluster are unknown, and no Cues */
 };
 
 static mk_context *mk_create_context( mk_writer *w, mk_context *parent, unsigned id )
@@ -185,6 +205,8 @@ static int mk_flush_context_data( mk_context *c )
         CHECK( mk_append_context_data( c->parent, c->data, c->d_cur ) );
     else if( fwrite( c->data, c->d_cur, 1, c->owner->fp ) != 1 )
         return -1;
+    else
+        c->owner->pos += c->d_cur;
 
     c->d_cur = 0;
 
@@ -265,6 +287,49 @@ static int mk_write_uint( mk_context *c, unsigned id, int64_t ui )
     return 0;
 }
 
+/* Write an unsigned integer with 8 bytes so that the size doesn't depend on the value. */
+static int mk_write_uint64( mk_context *c, unsigned id, int64_t ui )
+{
+    unsigned char c_ui[8] = { ui >> 56, ui >> 48, ui >> 40, ui >> 32, ui >> 24, ui >> 16, ui >> 8, ui };
+
+    CHECK( mk_write_id( c, id ) );
+    CHECK( mk_write_size( c, 8 ) );
+    CHECK( mk_append_context_data( c, c_ui, 8 ) );
+    return 0;
+}
+
+/* Write a Void element whose total size is 'size' bytes. */
+static int mk_write_void( mk_context *c, unsigned size )
+{
+    static const unsigned char zero[256] = { 0 };
+    unsigned char c_head[9] = { 0xec };
+    unsigned head_size;
+
+    if( size < 2 )
+        return -1;
+    if( size - 2 < 0x7f )
+    {
+        c_head[1] = 0x80 | (size - 2);
+        head_size = 2;
+    }
+    else
+    {
+        uint64_t payload = size - 9;
+        c_head[1] = 0x01;
+        for( int i = 8; i >= 2; i--, payload >>= 8 )
+            c_head[i] = payload;
+        head_size = 9;
+    }
+    CHECK( mk_append_context_data( c, c_head, head_size ) );
+    for( size -= head_size; size; )
+    {
+        unsigned n = X264_MIN( size, sizeof(zero) );
+        CHECK( mk_append_context_data( c, zero, n ) );
+        size -= n;
+    }
+    return 0;
+}
+
 static int mk_write_float_raw( mk_context *c, float f )
 {
     union
@@ -318,6 +383,7 @@ mk_writer *mk_create_writer( const char *filename )
     }
 
     w->timescale = 1000000;
+    w->live = !x264_is_regular_file( w->fp );
 
     return w;
 }
@@ -332,6 +398,8 @@ int mk_write_track( mk_writer *w, mk_context *c, mk_track_t track )
     CHECK( mk_write_uint( ti, 0x73c5, track.id ) ); // TrackUID
     CHECK( mk_write_uint( ti, 0x83, track.type ) ); // TrackType
     CHECK( mk_write_uint( ti, 0x9c, track.lacing != MK_LACING_NONE ) ); // FlagLacing
+    if( track.language )
+        CHECK( mk_write_string( ti, 0x22b59c, track.language ) ); // Language
     CHECK( mk_write_string( ti, 0x86, track.codec_id ) ); // codec_id
     if( track.codec_private_size )
         CHECK( mk_write_bin( ti, 0x63a2, track.codec_private, track.codec_private_size ) ); // codec_private
@@ -340,6 +408,7 @@ int mk_write_track( mk_writer *w, mk_context *c, mk_track_t track )
         CHECK( mk_write_uint( ti, 0x23e383, track.default_frame_duration ) ); // DefaultDuration
         w->def_duration[track.id] = track.default_frame_duration;
     }
+    w->track_type[track.id] = track.type;
 
     switch( track.type )
     {
@@ -374,7 +443,7 @@ int mk_write_track( mk_writer *w, mk_context *c, mk_track_t track )
 }
 
 int mk_write_header( mk_writer *w, const char *writing_app, int64_t timescale,
-                     mk_track_t *tracks, int track_count )
+                     mk_track_t *tracks, int track_count, unsigned cues_space )
 {
     mk_context  *c;
     int i;
@@ -400,8 +469,27 @@ int mk_write_header( mk_writer *w, const char *writing_app, int64_t timescale,
 
     if( !(c = mk_create_context( w, w->root, 0x18538067 )) ) // Segment
         return -1;
-    CHECK( mk_flush_context_id( c ) );
+    if( w->live )
+        CHECK( mk_flush_context_id( c ) ); // unknown size
+    else
+    {
+        // the size is written when closing
+        static const unsigned char size_placeholder[8] = { 0x01 };
+        CHECK( mk_write_id( w->root, c->id ) );
+        w->segment_size_ptr = w->pos + w->root->d_cur;
+        CHECK( mk_append_context_data( w->root, size_placeholder, 8 ) );
+        c->id = 0;
+    }
     CHECK( mk_close_context( c, 0 ) );
+    w->segment_pos = w->pos + w->root->d_cur;
+
+    if( !w->live )
+    {
+        // reserve the space for SeekHead and Cues, which are written when closing
+        w->void_pos = w->pos + w->root->d_cur;
+        w->void_size = SEEKHEAD_SIZE + cues_space;
+        CHECK( mk_write_void( w->root, w->void_size ) );
+    }
 
     if( !(c = mk_create_context( w, w->root, 0x1549a966 )) ) // SegmentInfo
         return -1;
@@ -437,6 +525,24 @@ static int mk_close_cluster( mk_writer *w )
     return 0;
 }
 
+static int mk_add_cue( mk_writer *w, int64_t timecode, unsigned track_id )
+{
+    if( w->cue_count == w->cue_max )
+    {
+        unsigned cue_max = w->cue_max ? w->cue_max << 1 : 256;
+        mk_cue_t *cues = realloc( w->cues, cue_max * sizeof(mk_cue_t) );
+        if( !cues )
+            return -1;
+        w->cues = cues;
+        w->cue_max = cue_max;
+    }
+    w->cues[w->cue_count].timecode = timecode;
+    w->cues[w->cue_count].cluster_pos = w->cluster_pos;
+    w->cues[w->cue_count].track_id = track_id;
+    w->cue_count++;
+    return 0;
+}
+
 static int mk_flush_frame( mk_writer *w, uint32_t track_id )
 {
     int64_t delta;
@@ -446,22 +552,32 @@ static int mk_flush_frame( mk_writer *w, uint32_t track_id )
     if( !w->in_frame )
         return 0;
 
+    /* Start a new cluster at each keyframe of video so that Cues can point the clusters directly.
+     * Clusters are also limited in duration as well as in size, which bounds the memory for buffering. */
+    int video_keyframe = w->keyframe && w->track_type[track_id] == MK_TRACK_VIDEO;
     delta = w->frame_tc/w->timescale - w->cluster_tc_scaled;
-    if( delta > 32767ll || delta < -32768ll )
+    if( delta > 32767ll || delta < -32768ll || video_keyframe
+     || w->frame_tc - w->cluster_tc_scaled * w->timescale >= CLDURATION )
         CHECK( mk_close_cluster( w ) );
 
     if( !w->cluster )
     {
         w->cluster_tc_scaled = w->frame_tc / w->timescale;
+        w->cluster_pos = w->pos + w->root->d_cur - w->segment_pos;
         w->cluster = mk_create_context( w, w->root, 0x1f43b675 ); // Cluster
         if( !w->cluster )
             return -1;
+        if( w->live )
+            CHECK( mk_flush_context_id( w->cluster ) ); // unknown size
 
         CHECK( mk_write_uint( w->cluster, 0xe7, w->cluster_tc_scaled ) ); // Timecode
 
         delta = 0;
     }
 
+    if( video_keyframe && !w->live )
+        CHECK( mk_add_cue( w, w->frame_tc / w->timescale, track_id ) );
+
     fsize = w->frame ? w->frame->d_cur : 0;
 
     CHECK( mk_write_id( w->cluster, 0xa3 ) ); // SimpleBlock
@@ -480,7 +596,15 @@ static int mk_flush_frame( mk_writer *w, uint32_t track_id )
 
     w->in_frame = 0;
 
-    if( w->cluster->d_cur > CLSIZE )
+    if( w->live )
+    {
+        /* Hand each frame over to the reader as soon as possible. */
+        CHECK( mk_flush_context_data( w->cluster ) );
+        CHECK( mk_flush_context_data( w->root ) );
+        if( fflush( w->fp ) )
+            return -1;
+    }
+    else if( w->cluster->d_cur > CLSIZE )
         CHECK( mk_close_cluster( w ) );
 
     return 0;
@@ -532,13 +656,84 @@ int mk_add_frame_data( mk_writer *w, const void *data, unsigned size )
     return mk_append_context_data( w->frame, data, size );
 }
 
+/* Write Cues into the reserved Void element with SeekHead pointing to them.
+ * If they don't fit there, append them to the end of the file and leave only SeekHead there. */
+static int mk_write_cues( mk_writer *w )
+{
+    mk_context *cues_data, *head, *c, *cp, *tp;
+
+    if( !w->cue_count )
+        return 0;
+
+    if( !(cues_data = mk_create_context( w, NULL, 0 )) )
+        return -1;
+    if( !(c = mk_create_context( w, cues_data, 0x1c53bb6b )) ) // Cues
+        return -1;
+    for( unsigned i = 0; i < w->cue_count; i++ )
+    {
+        if( !(cp = mk_create_context( w, c, 0xbb )) ) // CuePoint
+            return -1;
+        CHECK( mk_write_uint( cp, 0xb3, w->cues[i].timecode ) ); // CueTime
+        if( !(tp = mk_create_context( w, cp, 0xb7 )) ) // CueTrackPositions
+            return -1;
+        CHECK( mk_write_uint( tp, 0xf7, w->cues[i].track_id ) ); // CueTrack
+        CHECK( mk_write_uint( tp, 0xf1, w->cues[i].cluster_pos ) ); // CueClusterPosition
+        CHECK( mk_close_context( tp, 0 ) );
+        CHECK( mk_close_context( cp, 0 ) );
+    }
+    CHECK( mk_close_context( c, 0 ) );
+
+    unsigned room = w->void_size - SEEKHEAD_SIZE;
+    int in_void = cues_data->d_cur == room || cues_data->d_cur + 2 <= room;
+    int64_t cues_pos = in_void ? w->void_pos + SEEKHEAD_SIZE : w->pos;
+    if( !in_void )
+        CHECK( mk_flush_context_data( cues_data ) );
+
+    if( !(head = mk_create_context( w, NULL, 0 )) )
+        return -1;
+    if( !(c = mk_create_context( w, head, 0x114d9b74 )) ) // SeekHead
+        return -1;
+    if( !(cp = mk_create_context( w, c, 0x4dbb )) ) // Seek
+        return -1;
+    CHECK( mk_write_bin( cp, 0x53ab, (unsigned char[]){ 0x1c, 0x53, 0xbb, 0x6b }, 4 ) ); // SeekID
+    CHECK( mk_write_uint64( cp, 0x53ac, cues_pos - w->segment_pos ) ); // SeekPosition
+    CHECK( mk_close_context( cp, 0 ) );
+    CHECK( mk_close_context( c, 0 ) );
+    if( in_void )
+    {
+        CHECK( mk_append_context_data( head, cues_data->data, cues_data->d_cur ) );
+        cues_data->d_cur = 0;
+    }
+    if( head->d_cur < w->void_size )
+        CHECK( mk_write_void( head, w->void_size - head->d_cur ) );
+
+    int64_t end = w->pos;
+    if( fseek( w->fp, w->void_pos, SEEK_SET ) )
+        return -1;
+    CHECK( mk_flush_context_data( head ) );
+    w->pos = end;
+    return fseek( w->fp, end, SEEK_SET );
+}
+
+static int mk_write_segment_size( mk_writer *w )
+{
+    int64_t size = w->pos - w->segment_pos;
+    unsigned char c_size[8] = { 0x01, size >> 48, size >> 40, size >> 32, size >> 24, size >> 16, size >> 8, size };
+
+    if( fseek( w->fp, w->segment_size_ptr, SEEK_SET ) || fwrite( c_size, 8, 1, w->fp ) != 1 )
+        return -1;
+    return 0;
+}
+
 int mk_close( mk_writer *w, int64_t *last_delta )
 {
     int ret = 0;
     if( mk_close_cluster( w ) < 0 )
         ret = -1;
-    if( w->wrote_header && x264_is_regular_file( w->fp ) )
+    if( w->wrote_header && !w->live )
     {
+        if( mk_write_cues( w ) < 0 || mk_write_segment_size( w ) < 0 )
+            ret = -1;
         fseek( w->fp, w->duration_ptr, SEEK_SET );
         uint32_t i;
         int64_t total_duration = INT64_MAX;
@@ -554,6 +749,7 @@ int mk_close( mk_writer *w, int64_t *last_delta )
     }
     mk_destroy_contexts( w );
     fclose( w->fp );
+    free( w->cues );
     free( w );
     return ret;
 }
@@ -32,7 +32,7 @@
 #define	DS_INCHES        2
 #define	DS_ASPECT_RATIO  3
 
-#define MK_MAX_TRACKS 4
+#define MK_MAX_TRACKS 10   /* numbered from 1: video and up to 8 audio tracks */
 
 typedef enum {
     MK_TRACK_VIDEO = 1,
@@ -71,6 +71,7 @@ typedef struct {
     mk_lacing_type lacing;
     unsigned id;
     const char *codec_id;
+    const char *language;   /* ISO639-2 code, NULL to leave undefined */
     void *codec_private;
     unsigned codec_private_size;
     int64_t default_frame_duration;
@@ -82,7 +83,7 @@ typedef struct mk_writer mk_writer;
 mk_writer *mk_create_writer( const char *filename );
 
 int mk_write_header( mk_writer *w, const char *writing_app, int64_t timescale,
-                     mk_track_t *tracks, int track_count );
+                     mk_track_t *tracks, int track_count, unsigned cues_space );
 int mk_start_frame( mk_writer *w );
 int mk_end_frame( mk_writer *w, uint32_t track_id );
 int mk_add_frame_data( mk_writer *w, const void *data, unsigned size );
@@ -74,6 +74,7 @@ if( cond )\
 
 #if HAVE_AUDIO
 #include "audio/encoders.h"
+#include "audio/timeline.h"
 #endif
 
 typedef struct
@@ -84,9 +85,11 @@ typedef struct
     uint64_t i_video_timescale;    /* For interleaving. */
     lsmash_audio_summary_t *summary;
     lsmash_codec_type_t codec_type;
+    char *psz_language;
 #if HAVE_AUDIO
     audio_info_t *info;
     hnd_t encoder;
+    audio_timeline_t timeline;
     int has_sbr;
     int b_copy;
     int b_mdct;
@@ -118,6 +121,7 @@ typedef struct
     uint64_t i_prev_dts;
     uint32_t i_sei_size;
     uint8_t *p_sei_buffer;
+    uint8_t *p_frame_buffer;
     int i_numframe;
     int64_t i_init_delta;
     int i_delay_frames;
@@ -130,12 +134,18 @@ typedef struct
     uint32_t i_display_width;
     uint32_t i_display_height;
     int b_no_remux;
+    int b_moov_reserve;
     int b_no_pasp;
     int b_force_display_size;
     int b_fragments;
+    int i_chunk_duration;
     lsmash_scale_method scale_method;
 #if HAVE_ANY_AUDIO
-    mp4_audio_hnd_t *audio_hnd;
+    mp4_audio_hnd_t *audio_hnd[MAX_AUDIO_TRACKS];
+    int i_audio_tracks;
+#endif
+#if HAVE_AUDIO
+    hnd_t audio_workers;
 #endif
     int b_no_progress;
 } mp4_hnd_t;
@@ -292,6 +302,7 @@ static void remove_audio_hnd( mp4_audio_hnd_t *p_audio )
 #if HAVE_AUDIO
     if( p_audio->encoder )
     {
+        x264_audio_timeline_close( &p_audio->timeline );
         x264_audio_encoder_close( p_audio->encoder );
         p_audio->encoder = NULL;
     }
@@ -316,17 +327,23 @@ static void remove_mp4_hnd( hnd_t handle )
         free( p_mp4->p_sei_buffer );
         p_mp4->p_sei_buffer = NULL;
     }
+    if( p_mp4->p_frame_buffer )
+    {
+        free( p_mp4->p_frame_buffer );
+        p_mp4->p_frame_buffer = NULL;
+    }
     if( p_mp4->p_root )
     {
         lsmash_destroy_root( p_mp4->p_root );
         p_mp4->p_root = NULL;
     }
 #if HAVE_ANY_AUDIO
-    if( p_mp4->audio_hnd )
-    {
-        remove_audio_hnd( p_mp4->audio_hnd );
-        p_mp4->audio_hnd = NULL;
-    }
+    for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+        remove_audio_hnd( p_mp4->audio_hnd[i] );
+    p_mp4->i_audio_tracks = 0;
+#endif
+#if HAVE_AUDIO
+    x264_audio_workers_close( p_mp4->audio_workers );
 #endif
     free( p_mp4 );
 }
@@ -461,8 +478,10 @@ static int alac_init( mp4_audio_hnd_t *p_audio )
 }
 
 #if HAVE_AUDIO
-static int audio_init( hnd_t handle, cli_output_opt_t *opt, hnd_t filters, char *audio_enc, char *audio_parameters )
+static int audio_init( hnd_t handle, cli_output_opt_t *opt, cli_audio_track_t *track )
 {
+    hnd_t filters = track->filters;
+    char *audio_enc = track->encoder;
     if( !strcmp( audio_enc, "none" ) || !filters )
         return 0;
 
@@ -486,15 +505,16 @@ static int audio_init( hnd_t handle, cli_output_opt_t *opt, hnd_t filters, char
         const audio_encoder_t *encoder = x264_select_audio_encoder( audio_enc, codec_list, &used_enc );
         MP4_FAIL_IF_ERR( !encoder, "unable to select audio encoder.\n" );
 
-        snprintf( audio_params, MAX_ARGS, "%s,codec=%s", audio_parameters, used_enc );
+        snprintf( audio_params, MAX_ARGS, "%s,codec=%s", track->parameters, used_enc );
         henc = x264_audio_encoder_open( encoder, filters, audio_params );
     }
 
     MP4_FAIL_IF_ERR( !henc, "error opening audio encoder.\n" );
     mp4_hnd_t *p_mp4 = handle;
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd = calloc( 1, sizeof( mp4_audio_hnd_t ) );
+    mp4_audio_hnd_t *p_audio = calloc( 1, sizeof( mp4_audio_hnd_t ) );
     audio_info_t *info = p_audio->info = x264_audio_encoder_info( henc );
     p_audio->b_copy = copy;
+    p_audio->psz_language = track->language;
     if( p_audio->b_copy )
         info->priming = opt->priming;
 
@@ -740,22 +760,21 @@ static int audio_init( hnd_t handle, cli_output_opt_t *opt, hnd_t filters, char
     }
 
     p_audio->encoder = henc;
+    p_mp4->audio_hnd[p_mp4->i_audio_tracks++] = p_audio;
 
     return 1;
 
 error:
     x264_audio_encoder_close( henc );
-    free( p_mp4->audio_hnd );
-    p_mp4->audio_hnd = NULL;
+    free( p_audio );
 
     return -1;
 }
 #endif /* #if HAVE_AUDIO */
 
 #if HAVE_ANY_AUDIO
-static int set_param_audio( mp4_hnd_t* p_mp4, uint64_t i_media_timescale, lsmash_track_mode track_mode )
+static int set_param_audio( mp4_hnd_t* p_mp4, mp4_audio_hnd_t *p_audio, uint64_t i_media_timescale, lsmash_track_mode track_mode )
 {
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd;
 
     /* Create a audio track. */
     p_audio->i_track = lsmash_create_track( p_mp4->p_root, ISOM_MEDIA_HANDLER_TYPE_AUDIO_TRACK );
@@ -811,12 +830,15 @@ static int set_param_audio( mp4_hnd_t* p_mp4, uint64_t i_media_timescale, lsmash
     MP4_FAIL_IF_ERR( lsmash_set_track_parameters( p_mp4->p_root, p_audio->i_track, &track_param ),
                      "failed to set track parameters for audio.\n" );
     p_audio->i_video_timescale = i_media_timescale;
+#if HAVE_AUDIO
+    x264_audio_timeline_init( &p_audio->timeline, p_audio->encoder, (timebase_t){ 1, i_media_timescale } );
+#endif
 
     /* Set sound media parameters. */
     lsmash_media_parameters_t media_param;
     lsmash_initialize_media_parameters( &media_param );
     media_param.timescale = p_audio->summary->frequency;
-    media_param.ISO_language = lsmash_pack_iso_language( p_mp4->psz_language );
+    media_param.ISO_language = lsmash_pack_iso_language( p_audio->psz_language ? p_audio->psz_language : p_mp4->psz_language );
     media_param.media_handler_name = "L-SMASH Sound Media Handler";
     media_param.roll_grouping = !!p_audio->info->priming;
     if( p_mp4->b_brand_qt )
@@ -831,57 +853,68 @@ static int set_param_audio( mp4_hnd_t* p_mp4, uint64_t i_media_timescale, lsmash
     return 0;
 }
 
-static int write_audio_frames( mp4_hnd_t *p_mp4, double video_dts, int finish )
-{
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd;
-    assert( p_audio );
-
 #if HAVE_AUDIO
+typedef struct
+{
+    hnd_t encoder;
     audio_packet_t *frame;
+} mp4_audio_frame_t;
+
+/* Goes through the encoder, which hands the packet back to the thread that owns its chain. */
+static void release_audio_frame( void *opaque, uint8_t *data )
+{
+    mp4_audio_frame_t *ref = opaque;
+    x264_audio_free_frame( ref->encoder, ref->frame );
+    free( ref );
+}
 #endif
 
-    /* FIXME: This is just a sample implementation. */
+/* Appends the audio frames up to video_dts, on the video's media timescale, or all of them when finishing. */
+static int write_audio_frames( mp4_hnd_t *p_mp4, mp4_audio_hnd_t *p_audio, int64_t video_dts, int finish )
+{
+    assert( p_audio );
+
+    if( !video_dts && p_mp4->b_fragments && !finish )
+    {
+        lsmash_edit_t edit;
+        edit.duration   = ISOM_EDIT_DURATION_UNKNOWN32;     /* QuickTime doesn't support 64bit duration. */
+        edit.start_time = p_audio->info->priming;
+        edit.rate       = ISOM_EDIT_MODE_NORMAL;
+        MP4_LOG_IF_ERR( lsmash_create_explicit_timeline_map( p_mp4->p_root, p_audio->i_track, edit ),
+                        "failed to set timeline map for audio.\n" );
+    }
+
     for(;;)
     {
         uint64_t audio_timestamp = (uint64_t)p_audio->i_numframe * p_audio->summary->samples_in_frame;
-        /*
-         * means while( audio_dts <= video_dts )
-         * FIXME: I wonder if there's any way more effective.
-         */
-
-        if( !video_dts && p_mp4->b_fragments && !finish )
-        {
-            lsmash_edit_t edit;
-            edit.duration   = ISOM_EDIT_DURATION_UNKNOWN32;     /* QuickTime doesn't support 64bit duration. */
-            edit.start_time = p_audio->info->priming;
-            edit.rate       = ISOM_EDIT_MODE_NORMAL;
-            MP4_LOG_IF_ERR( lsmash_create_explicit_timeline_map( p_mp4->p_root, p_audio->i_track, edit ),
-                            "failed to set timeline map for audio.\n" );
-        }
-
-        if( !finish && ((audio_timestamp / (double)p_audio->summary->frequency > video_dts) || !video_dts) )
-            break;
 
         /* read a audio frame */
 #if HAVE_AUDIO
-        if( finish )
-            frame = x264_audio_encoder_finish( p_audio->encoder );
-        else if( !(frame = x264_audio_encode_frame( p_audio->encoder )) )
-        {
-            finish = 1;
-            continue;
-        }
-
+        int64_t ts;
+        audio_packet_t *frame = x264_audio_timeline_next( &p_audio->timeline, finish ? -1 : video_dts, &ts );
         if( !frame )
             break;
 
-        lsmash_sample_t *p_sample = lsmash_create_sample( frame->size );
+        /* The sample keeps the whole packet alive until its payload is written,
+         * so compressed frames reach the file without being copied. */
+        mp4_audio_frame_t *ref = malloc( sizeof(mp4_audio_frame_t) );
+        lsmash_sample_t *p_sample = ref ? lsmash_create_sample_from_buffer( frame->data, frame->size, release_audio_frame, ref ) : NULL;
+        if( p_sample )
+        {
+            ref->encoder = p_audio->encoder;
+            ref->frame   = frame;
+        }
+        else
+        {
+            free( ref );
+            x264_audio_free_frame( p_audio->encoder, frame );
+        }
         MP4_FAIL_IF_ERR( !p_sample,
                          "failed to create a audio sample data.\n" );
-        memcpy( p_sample->data, frame->data, frame->size );
-        x264_audio_free_frame( p_audio->encoder, frame );
         p_sample->prop.pre_roll.distance = p_audio->b_mdct;
 #else
+        if( !finish && audio_timestamp * p_audio->i_video_timescale > video_dts * p_audio->summary->frequency )
+            break;
         /* FIXME: mp4sys_importer_get_access_unit() returns 1 if there're any changes in stream's properties.
            If you want to support them, you have to retrieve summary again, and make some operation accordingly. */
         lsmash_sample_t *p_sample = lsmash_create_sample( p_audio->summary->max_au_length );
@@ -909,12 +942,9 @@ static int write_audio_frames( mp4_hnd_t *p_mp4, double video_dts, int finish )
     return 0;
 }
 
-static int close_file_audio( mp4_hnd_t* p_mp4, double actual_duration )
+static int close_file_audio( mp4_hnd_t* p_mp4, mp4_audio_hnd_t *p_audio )
 {
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd;
-    double media_duration = actual_duration / p_mp4->i_movie_timescale + (double)p_audio->info->priming / p_audio->summary->frequency;
-    MP4_LOG_IF_ERR( ( write_audio_frames( p_mp4, media_duration, 0 ) || // FIXME: I wonder why is this needed?
-                      write_audio_frames( p_mp4, 0, 1 ) ),
+    MP4_LOG_IF_ERR( write_audio_frames( p_mp4, p_audio, 0, 1 ),
                     "failed to flush audio frame(s).\n" );
     uint32_t last_delta;
     if( lsmash_check_codec_type_identical( p_audio->codec_type, QT_CODEC_TYPE_RAW_AUDIO )
@@ -933,9 +963,12 @@ static int close_file_audio( mp4_hnd_t* p_mp4, double actual_duration )
 #endif
     MP4_LOG_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_audio->i_track, last_delta ),
                     "failed to flush the rest of audio samples.\n" );
-    actual_duration = ((p_audio->i_numframe - 1) * p_audio->summary->samples_in_frame) + last_delta - p_audio->info->priming;
-    if( actual_duration )
-        actual_duration *= (double)p_mp4->i_movie_timescale / p_audio->summary->frequency;
+#if HAVE_AUDIO
+    uint64_t actual_duration = x264_audio_timeline_duration( &p_audio->timeline, (timebase_t){ 1, p_mp4->i_movie_timescale } );
+#else
+    uint64_t actual_duration = ((uint64_t)(p_audio->i_numframe - 1) * p_audio->summary->samples_in_frame + last_delta - p_audio->info->priming)
+                             * p_mp4->i_movie_timescale / p_audio->summary->frequency;
+#endif
     lsmash_edit_t edit;
     edit.duration   = actual_duration;
     edit.start_time = p_audio->info->priming;
@@ -1031,8 +1064,9 @@ static int close_file( hnd_t handle, int64_t largest_pts, int64_t second_largest
         }
 
 #if HAVE_ANY_AUDIO
-        MP4_LOG_IF_ERR( p_mp4->audio_hnd && p_mp4->audio_hnd->i_track && close_file_audio( p_mp4, actual_duration ),
-                        "failed to close audio.\n" );
+        for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+            MP4_LOG_IF_ERR( p_mp4->audio_hnd[i]->i_track && close_file_audio( p_mp4, p_mp4->audio_hnd[i] ),
+                            "failed to close audio.\n" );
 #endif
 
         if( p_mp4->psz_chapter && (p_mp4->major_brand != ISOM_BRAND_TYPE_QT) )
@@ -1058,7 +1092,7 @@ static int close_file( hnd_t handle, int64_t largest_pts, int64_t second_largest
     return 0;
 }
 
-static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, hnd_t audio_filters, char *audio_enc, char *audio_params )
+static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, cli_audio_track_t *audio, int audio_tracks )
 {
     mp4_hnd_t *p_mp4;
 
@@ -1109,11 +1143,13 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
     p_mp4->psz_language         = opt->language;
     p_mp4->b_no_pasp            = opt->no_sar;
     p_mp4->b_no_remux           = opt->no_remux;
+    p_mp4->b_moov_reserve       = opt->moov_reserve;
     p_mp4->i_display_width      = opt->display_width * (1<<16);
     p_mp4->i_display_height     = opt->display_height * (1<<16);
     p_mp4->b_force_display_size = p_mp4->i_display_height || p_mp4->i_display_height;
     p_mp4->scale_method         = p_mp4->b_force_display_size ? ISOM_SCALE_METHOD_FILL : ISOM_SCALE_METHOD_MEET;
     p_mp4->b_fragments          = !b_regular || opt->fragments;
+    p_mp4->i_chunk_duration     = opt->chunk_duration;
     p_mp4->b_stdout             = !strcmp( psz_filename, "-" );
 
     p_mp4->p_root = lsmash_open_movie( psz_filename, p_mp4->b_fragments ? LSMASH_FILE_MODE_WRITE_FRAGMENTED : LSMASH_FILE_MODE_WRITE );
@@ -1126,19 +1162,29 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
 
 #if HAVE_ANY_AUDIO
 #if HAVE_AUDIO
-    MP4_FAIL_IF_ERR_EX( audio_init( p_mp4, opt, audio_filters, audio_enc, audio_params ) < 0, "unable to init audio output.\n" );
+    for( int i = 0; i < audio_tracks; i++ )
+        MP4_FAIL_IF_ERR_EX( audio_init( p_mp4, opt, &audio[i] ) < 0, "unable to init audio output.\n" );
+    if( p_mp4->i_audio_tracks )
+    {
+        hnd_t encoders[MAX_AUDIO_TRACKS];
+        for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+            encoders[i] = p_mp4->audio_hnd[i]->encoder;
+        p_mp4->audio_workers = x264_audio_workers_open( encoders, p_mp4->i_audio_tracks );
+    }
 #else
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd = (mp4_audio_hnd_t *)malloc( sizeof(mp4_audio_hnd_t) );
+    mp4_audio_hnd_t *p_audio = (mp4_audio_hnd_t *)malloc( sizeof(mp4_audio_hnd_t) );
     MP4_FAIL_IF_ERR_EX( !p_audio, "failed to allocate memory for audio muxing information.\n" );
     memset( p_audio, 0, sizeof(mp4_audio_hnd_t) );
     p_audio->p_importer = mp4sys_importer_open( "x264_audio_test.adts", "auto" );
-    if( !p_audio->p_importer )
+    if( p_audio->p_importer )
     {
-        free( p_audio );
-        p_mp4->audio_hnd = NULL;
+        mp4sys_importer_start_readahead( p_audio->p_importer, 1 );
+        p_mp4->audio_hnd[p_mp4->i_audio_tracks++] = p_audio;
     }
+    else
+        free( p_audio );
 #endif
-    if( !p_mp4->audio_hnd )
+    if( !p_mp4->i_audio_tracks )
         MP4_LOG_INFO( "audio muxing feature is disabled.\n" );
 #endif
     p_mp4->b_no_progress = opt->no_progress;
@@ -1148,6 +1194,32 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
     return 0;
 }
 
+/* Estimate the size of Movie Box from the number of frames to be encoded.
+ * This is intentionally pessimistic since a shortfall costs moving all of the media data. */
+static uint64_t estimate_moov_size( mp4_hnd_t *p_mp4, x264_param_t *p_param )
+{
+    double duration = (double)p_param->i_frame_total * p_param->i_fps_den / p_param->i_fps_num;
+    /* L-SMASH cuts chunks every 500 ms unless told otherwise */
+    uint64_t i_chunk = duration * 1000 / (p_mp4->i_chunk_duration ? p_mp4->i_chunk_duration : 500) + 1;
+    /* stsz, stts, ctts, stss and sdtp per sample, and stsc and co64 per chunk */
+    uint64_t size = (uint64_t)p_param->i_frame_total * (4 + 8 + 8 + 4 + 1) + i_chunk * (12 + 8);
+    if( p_mp4->b_use_recovery )
+        size += (uint64_t)p_param->i_frame_total * 8;   /* sbgp */
+#if HAVE_ANY_AUDIO
+    for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+    {
+        mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd[i];
+        if( !p_audio->summary || !p_audio->summary->samples_in_frame )
+            continue;
+        uint64_t i_audio_frame = duration * p_audio->summary->frequency / p_audio->summary->samples_in_frame + 1;
+        size += i_audio_frame * (4 + 8) + i_chunk * (12 + 8);
+    }
+#endif
+    /* headers of boxes, sample descriptions, chapters and metadata */
+    size += 16384;
+    return size + size / 8;
+}
+
 static int set_param( hnd_t handle, x264_param_t *p_param )
 {
     mp4_hnd_t *p_mp4 = handle;
@@ -1190,10 +1262,10 @@ static int set_param( hnd_t handle, x264_param_t *p_param )
             brands[brand_count++] = ISOM_BRAND_TYPE_M4A;
         }
         brands[brand_count++] = ISOM_BRAND_TYPE_ISOM;
-        if( p_mp4->audio_hnd || p_mp4->b_use_recovery )
+        if( p_mp4->i_audio_tracks || p_mp4->b_use_recovery )
         {
             brands[brand_count++] = ISOM_BRAND_TYPE_AVC1;   /* sdtp, sgpd, sbgp and visual roll recovery grouping */
-            if( p_mp4->audio_hnd )
+            if( p_mp4->i_audio_tracks )
                 brands[brand_count++] = ISOM_BRAND_TYPE_ISO2;   /* audio roll recovery grouping */
             if( p_param->b_open_gop )
                 brands[brand_count++] = ISOM_BRAND_TYPE_ISO6;   /* cslg and visual random access grouping */
@@ -1207,6 +1279,10 @@ static int set_param( hnd_t handle, x264_param_t *p_param )
     movie_param.brands = brands;
     movie_param.number_of_brands = brand_count;
     movie_param.minor_version = minor_version;
+    /* Each track's samples are pooled until they span this long, and are then written as one
+     * chunk, so the tracks end up interleaved at this granularity. */
+    if( p_mp4->i_chunk_duration )
+        movie_param.max_chunk_duration = p_mp4->i_chunk_duration / 1000.0;
     MP4_FAIL_IF_ERR( lsmash_set_movie_parameters( p_mp4->p_root, &movie_param ),
                      "failed to set movie parameters.\n" );
     p_mp4->i_movie_timescale = lsmash_get_movie_timescale( p_mp4->p_root );
@@ -1287,10 +1363,23 @@ static int set_param( hnd_t handle, x264_param_t *p_param )
     MP4_FAIL_IF_ERR( !p_mp4->i_video_timescale, "media timescale for video is broken.\n" );
 
 #if HAVE_ANY_AUDIO
-    MP4_FAIL_IF_ERR( p_mp4->audio_hnd && set_param_audio( p_mp4, i_media_timescale, track_mode ),
-                     "failed to set audio param\n" );
+    for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+        MP4_FAIL_IF_ERR( set_param_audio( p_mp4, p_mp4->audio_hnd[i], i_media_timescale, track_mode ),
+                         "failed to set audio param\n" );
 #endif
 
+    if( p_mp4->b_moov_reserve && !p_mp4->b_fragments )
+    {
+        if( p_param->i_frame_total && p_param->i_fps_num && p_param->i_fps_den )
+        {
+            uint64_t i_reserve = estimate_moov_size( p_mp4, p_param );
+            MP4_FAIL_IF_ERR( lsmash_reserve_movie_space( p_mp4->p_root, i_reserve ),
+                             "failed to reserve space for movie header.\n" );
+        }
+        else
+            MP4_LOG_WARNING( "--moov-reserve requires the number of frames to be known, ignored.\n" );
+    }
+
     return 0;
 }
 
@@ -1375,6 +1464,16 @@ static int write_headers( hnd_t handle, x264_nal_t *p_nal )
     return sei_size + sps_size + pps_size;
 }
 
+/* The encoder writes the frame straight into this buffer, which becomes the sample data
+ * as is; room is left in front for the SEI that has to precede the first frame. */
+static uint8_t *get_buffer( hnd_t handle, int size )
+{
+    mp4_hnd_t *p_mp4 = handle;
+    free( p_mp4->p_frame_buffer );
+    p_mp4->p_frame_buffer = malloc( p_mp4->i_sei_size + size );
+    return p_mp4->p_frame_buffer ? p_mp4->p_frame_buffer + p_mp4->i_sei_size : NULL;
+}
+
 static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_t *p_picture )
 {
     mp4_hnd_t *p_mp4 = handle;
@@ -1398,9 +1497,21 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
         }
     }
 
-    lsmash_sample_t *p_sample = lsmash_create_sample( i_size + p_mp4->i_sei_size );
-    MP4_FAIL_IF_ERR( !p_sample,
-                     "failed to create a video sample data.\n" );
+    lsmash_sample_t *p_sample;
+    if( p_mp4->p_frame_buffer && p_nalu == p_mp4->p_frame_buffer + p_mp4->i_sei_size )
+    {
+        p_sample = lsmash_create_sample_from_buffer( p_mp4->p_frame_buffer, i_size + p_mp4->i_sei_size, NULL, NULL );
+        MP4_FAIL_IF_ERR( !p_sample,
+                         "failed to create a video sample data.\n" );
+        p_mp4->p_frame_buffer = NULL;
+    }
+    else
+    {
+        p_sample = lsmash_create_sample( i_size + p_mp4->i_sei_size );
+        MP4_FAIL_IF_ERR( !p_sample,
+                         "failed to create a video sample data.\n" );
+        memcpy( p_sample->data + p_mp4->i_sei_size, p_nalu, i_size );
+    }
 
     if( p_mp4->p_sei_buffer )
     {
@@ -1408,8 +1519,6 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
         free( p_mp4->p_sei_buffer );
         p_mp4->p_sei_buffer = NULL;
     }
-
-    memcpy( p_sample->data + p_mp4->i_sei_size, p_nalu, i_size );
     p_mp4->i_sei_size = 0;
 
     if( p_mp4->b_dts_compress )
@@ -1466,10 +1575,12 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
                   p_sample->prop.leading == ISOM_SAMPLE_IS_UNDECODABLE_LEADING || p_sample->prop.leading == ISOM_SAMPLE_IS_DECODABLE_LEADING ? "yes" : "no" );
 
 #if HAVE_ANY_AUDIO
-    mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd;
-    if( p_audio )
-        if( write_audio_frames( p_mp4, p_sample->dts / (double)p_audio->i_video_timescale, 0 ) )
+    for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+    {
+        mp4_audio_hnd_t *p_audio = p_mp4->audio_hnd[i];
+        if( write_audio_frames( p_mp4, p_audio, p_sample->dts, 0 ) )
             return -1;
+    }
 #endif
 
     if( p_mp4->b_fragments && p_mp4->i_numframe && p_sample->prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
@@ -1477,8 +1588,8 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
         MP4_FAIL_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_mp4->i_track, p_sample->dts - p_mp4->i_prev_dts ),
                          "failed to flush the rest of samples.\n" );
 #if HAVE_ANY_AUDIO
-        if( p_audio )
-            MP4_FAIL_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_audio->i_track, p_audio->summary->samples_in_frame ),
+        for( int i = 0; i < p_mp4->i_audio_tracks; i++ )
+            MP4_FAIL_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_mp4->audio_hnd[i]->i_track, p_mp4->audio_hnd[i]->summary->samples_in_frame ),
                              "failed to flush the rest of samples for audio.\n" );
 #endif
         MP4_FAIL_IF_ERR( lsmash_create_fragment_movie( p_mp4->p_root ),
@@ -1495,4 +1606,4 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
     return i_size;
 }
 
-const cli_output_t mp4_output = { open_file, set_param, write_headers, write_frame, close_file };
+const cli_output_t mp4_output = { open_file, set_param, write_headers, write_frame, close_file, get_buffer };
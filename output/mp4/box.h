@@ -896,7 +896,7 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;
-    lsmash_entry_list_t *list;
+    lsmash_entry_array_t *array;
 } isom_stts_t;
 
 /* Composition Time to Sample Box
@@ -914,7 +914,7 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;
-    lsmash_entry_list_t *list;
+    lsmash_entry_array_t *array;
 } isom_ctts_t;
 
 /* Composition to Decode Box (Composition Shift Least Greatest Box)
@@ -949,7 +949,7 @@ typedef struct
     ISOM_FULLBOX_COMMON;
     uint32_t sample_size;           /* If this field is set to 0, then the samples have different sizes. */
     uint32_t sample_count;          /* the number of samples in the track */
-    lsmash_entry_list_t *list;      /* available if sample_size == 0 */
+    lsmash_entry_array_t *array;    /* available if sample_size == 0 */
 } isom_stsz_t;
 
 /* Sync Sample Box
@@ -997,7 +997,7 @@ typedef struct
     ISOM_FULLBOX_COMMON;
     /* According to the specification, the size of the table, sample_count, doesn't exist in this box.
      * Instead of this, it is taken from the sample_count in the stsz or the stz2 box. */
-    lsmash_entry_list_t *list;
+    lsmash_entry_array_t *array;
 } isom_sdtp_t;
 
 /* Sample To Chunk Box
@@ -1035,7 +1035,7 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;        /* type = 'stco': 32-bit chunk offsets / type = 'co64': 64-bit chunk offsets */
-    lsmash_entry_list_t *list;
+    lsmash_entry_array_t *array;
 
         uint8_t large_presentation;     /* Set 1 to this if 64-bit chunk-offset are needed. */
 } isom_stco_t;      /* share with co64 box */
@@ -1368,10 +1368,11 @@ typedef struct
 /** Caches for handling tracks **/
 typedef struct
 {
-    uint64_t alloc;             /* total buffer size for the pool */
     uint64_t size;              /* total size of samples in the pool */
     uint32_t sample_count;      /* number of samples in the pool */
-    uint8_t *data;              /* actual data of samples in the pool */
+    uint32_t alloc;             /* number of slots for samples in the pool */
+    lsmash_sample_t **samples;  /* samples in the pool, whose data are written by reference */
+    lsmash_buffer_t  *buffers;  /* data of the samples in the pool in the form to be written at a time */
 } isom_sample_pool_t;
 
 typedef struct
@@ -1701,6 +1702,8 @@ struct lsmash_root_tag
         double max_async_tolerance;         /* max tolerance, in seconds, for amount of interleaving asynchronization between tracks */
         uint64_t max_chunk_size;            /* max size per chunk in bytes. */
         uint64_t max_read_size;             /* max size of reading from a chunk at a time. */
+        uint64_t reserved_pos;              /* position of the space reserved for Movie Box */
+        uint64_t reserved_size;             /* size of the space reserved for Movie Box */
         uint8_t file_type_written;          /* whether File Type Box was written */
         uint8_t qt_compatible;              /* compatibility with QuickTime file format */
         uint8_t isom_compatible;            /* compatibility with ISO Base Media file format */
@@ -2236,6 +2239,15 @@ void isom_remove_unknown_box( isom_unknown_box_t *unknown_box );
         return -1; \
     }
 
+#define isom_create_array_box( box_name, parent_name, box_type, entry_type ) \
+    isom_create_box( box_name, parent_name, box_type ); \
+    box_name->array = lsmash_create_entry_array( sizeof(entry_type) ); \
+    if( !box_name->array ) \
+    { \
+        free( box_name ); \
+        return -1; \
+    }
+
 #define isom_copy_fields( dst, src, box_name ) \
     lsmash_root_t *root   = dst->box_name->root; \
     isom_box_t *parent    = dst->box_name->parent; \
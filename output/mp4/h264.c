@@ -1327,18 +1327,54 @@ int h264_find_au_delimit_by_nalu_type( uint8_t nalu_type, uint8_t prev_nalu_type
         && ((prev_nalu_type >= 1 && prev_nalu_type <= 5) || prev_nalu_type == 12 || prev_nalu_type == 19);
 }
 
+/* Move to the next short start code in the buffer, or to the last two bytes if there is none,
+ * counting the skipped bytes into the EBSP and its trailing zero bytes.
+ * A short start code ends with the byte 0x01, which is far rarer than zeros in coded data,
+ * so it is looked up with memchr and the two preceding bytes are checked afterwards. */
+void h264_skip_to_next_start_code( h264_stream_buffer_t *buffer, uint64_t *ebsp_length, uint64_t *consecutive_zero_byte_count )
+{
+    uint8_t *pos  = buffer->pos;
+    uint8_t *next = buffer->end - 2;
+    if( pos >= next )
+        return;
+    for( uint8_t *p = pos + 2; p < buffer->end; p++ )
+    {
+        p = memchr( p, 0x01, buffer->end - p );
+        if( !p )
+            break;
+        if( !p[-1] && !p[-2] )
+        {
+            next = p - 2;
+            break;
+        }
+    }
+    if( next == pos )
+        return;
+    uint8_t *zero = next;
+    while( zero > pos && !zero[-1] )
+        --zero;
+    *consecutive_zero_byte_count = (zero == pos ? *consecutive_zero_byte_count : 0) + (next - zero);
+    *ebsp_length += next - pos;
+    buffer->pos = next;
+}
+
 int h264_supplement_buffer( h264_stream_buffer_t *buffer, h264_picture_info_t *picture, uint32_t size )
 {
-    uint32_t buffer_pos_offset   = buffer->pos - buffer->start;
-    uint32_t buffer_valid_length = buffer->end - buffer->start;
+    /* The stream data may be held outside of the bank, e.g. in a mapped file, and stays there. */
+    int      stream_in_bank      = buffer->start == lsmash_withdraw_buffer( buffer->bank, 1 );
+    uint64_t buffer_pos_offset   = buffer->pos - buffer->start;
+    uint64_t buffer_valid_length = buffer->end - buffer->start;
     lsmash_multiple_buffers_t *bank = lsmash_resize_multiple_buffers( buffer->bank, size );
     if( !bank )
         return -1;
     buffer->bank  = bank;
-    buffer->start = lsmash_withdraw_buffer( bank, 1 );
     buffer->rbsp  = lsmash_withdraw_buffer( bank, 2 );
-    buffer->pos = buffer->start + buffer_pos_offset;
-    buffer->end = buffer->start + buffer_valid_length;
+    if( stream_in_bank )
+    {
+        buffer->start = lsmash_withdraw_buffer( bank, 1 );
+        buffer->pos   = buffer->start + buffer_pos_offset;
+        buffer->end   = buffer->start + buffer_valid_length;
+    }
     if( picture && bank->number_of_buffers == 4 )
     {
         picture->au            = lsmash_withdraw_buffer( bank, 3 );
@@ -1915,6 +1951,7 @@ int lsmash_setup_h264_specific_parameters_from_access_unit( lsmash_h264_specific
         buffer->update( info, &stream, 2 );
         no_more_buf = buffer->pos >= buffer->end;
         int no_more = info->no_more_read && no_more_buf;
+        h264_skip_to_next_start_code( buffer, &ebsp_length, &consecutive_zero_byte_count );
         if( !h264_check_next_short_start_code( buffer->pos, buffer->end ) && !no_more )
         {
             if( *(buffer->pos ++) )
@@ -55,6 +55,8 @@ typedef struct
     mp4sys_importer_cleanup           cleanup;
 } mp4sys_importer_functions;
 
+struct mp4sys_readahead_tag;
+
 typedef struct mp4sys_importer_tag
 {
     FILE*                     stream;
@@ -62,6 +64,7 @@ typedef struct mp4sys_importer_tag
     void*                     info; /* importer internal status information. */
     mp4sys_importer_functions funcs;
     lsmash_entry_list_t*      summaries;
+    struct mp4sys_readahead_tag *readahead; /* NULL unless access units are parsed in the background. */
 } mp4sys_importer_t;
 
 typedef enum
@@ -2316,11 +2319,33 @@ const static mp4sys_importer_functions mp4sys_dts_importer =
     ISO/IEC 14496-15:2010
 ***************************************************************************/
 #include "h264.h"
+#if HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* NALUs of an access unit, referring to the mapped stream */
+typedef struct
+{
+    struct
+    {
+        uint8_t *data;
+        uint32_t length;
+    } *nalu;
+    uint32_t count;
+    uint32_t alloc;
+} h264_au_refs_t;
 
 typedef struct
 {
     mp4sys_importer_status status;
     h264_info_t            info;
+    /* When the whole stream is mapped, buffer->start is the head of the map and NALUs are
+     * gathered into access units by reference, to be copied into the samples only once. */
+    uint8_t               *map;
+    uint64_t               map_size;
+    h264_au_refs_t         au_refs;
+    h264_au_refs_t         incomplete_au_refs;
     h264_sps_t             first_sps;
     lsmash_media_ts_list_t ts_list;
     uint32_t max_au_length;
@@ -2337,6 +2362,12 @@ static void mp4sys_remove_h264_info( mp4sys_h264_info_t *info )
     h264_cleanup_parser( &info->info );
     if( info->ts_list.timestamp )
         free( info->ts_list.timestamp );
+#if HAVE_MMAP
+    if( info->map )
+        munmap( info->map, info->map_size );
+#endif
+    free( info->au_refs.nalu );
+    free( info->incomplete_au_refs.nalu );
     free( info );
 }
 
@@ -2370,6 +2401,34 @@ static uint32_t h264_update_buffer_from_stream( h264_info_t *info, void *src, ui
     return remainder_bytes;
 }
 
+/* Map regular files as a whole, the parser then never has to refill or read back its buffer. */
+static void h264_map_stream( mp4sys_h264_info_t *info, FILE *stream )
+{
+#if HAVE_MMAP
+    struct stat st;
+    if( fstat( fileno( stream ), &st ) || !S_ISREG( st.st_mode ) || st.st_size <= 0 || st.st_size != (size_t)st.st_size )
+        return;
+    void *map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno( stream ), 0 );
+    if( map == MAP_FAILED )
+        return;
+#ifdef MADV_SEQUENTIAL
+    madvise( map, st.st_size, MADV_SEQUENTIAL );
+#endif
+    info->map      = map;
+    info->map_size = st.st_size;
+#endif
+}
+
+/* Point the stream buffer at the map from the given offset. Nothing is left to read. */
+static void h264_rewind_map( mp4sys_h264_info_t *info, uint64_t offset )
+{
+    h264_stream_buffer_t *buffer = &info->info.buffer;
+    buffer->start = info->map;
+    buffer->pos   = info->map + offset;
+    buffer->end   = info->map + info->map_size;
+    info->info.no_more_read = 1;
+}
+
 static mp4sys_h264_info_t *mp4sys_create_h264_info( void )
 {
     mp4sys_h264_info_t *info = lsmash_malloc_zero( sizeof(mp4sys_h264_info_t) );
@@ -2402,21 +2461,47 @@ static int h264_process_parameter_set( h264_info_t *info, lsmash_h264_parameter_
     }
 }
 
-static inline int h264_complete_au( h264_picture_info_t *picture, int probe )
+static inline int h264_complete_au( mp4sys_h264_info_t *importer_info, h264_picture_info_t *picture, int probe )
 {
     if( !picture->incomplete_au_has_primary || picture->incomplete_au_length == 0 )
         return 0;
     if( !probe )
-        memcpy( picture->au, picture->incomplete_au, picture->incomplete_au_length );
+    {
+        if( importer_info->map )
+        {
+            h264_au_refs_t temp = importer_info->au_refs;
+            importer_info->au_refs = importer_info->incomplete_au_refs;
+            importer_info->incomplete_au_refs = temp;
+            importer_info->incomplete_au_refs.count = 0;
+        }
+        else
+            memcpy( picture->au, picture->incomplete_au, picture->incomplete_au_length );
+    }
     picture->au_length                 = picture->incomplete_au_length;
     picture->incomplete_au_length      = 0;
     picture->incomplete_au_has_primary = 0;
     return 1;
 }
 
-static void h264_append_nalu_to_au( h264_picture_info_t *picture, uint8_t *src_nalu, uint32_t nalu_length, int probe )
+static int h264_append_nalu_to_au( mp4sys_h264_info_t *importer_info, h264_picture_info_t *picture, uint8_t *src_nalu, uint32_t nalu_length, int probe )
 {
-    if( !probe )
+    if( !probe && importer_info->map )
+    {
+        h264_au_refs_t *refs = &importer_info->incomplete_au_refs;
+        if( refs->count == refs->alloc )
+        {
+            uint32_t alloc = refs->alloc ? 2 * refs->alloc : 16;
+            void *temp = realloc( refs->nalu, alloc * sizeof(*refs->nalu) );
+            if( !temp )
+                return -1;
+            refs->nalu  = temp;
+            refs->alloc = alloc;
+        }
+        refs->nalu[refs->count].data   = src_nalu;
+        refs->nalu[refs->count].length = nalu_length;
+        ++refs->count;
+    }
+    else if( !probe )
     {
         uint8_t *dst_nalu = picture->incomplete_au + picture->incomplete_au_length + H264_DEFAULT_NALU_LENGTH_SIZE;
         for( int i = H264_DEFAULT_NALU_LENGTH_SIZE; i; i-- )
@@ -2427,6 +2512,7 @@ static void h264_append_nalu_to_au( h264_picture_info_t *picture, uint8_t *src_n
      * Therefore, possible_au_length in h264_get_access_unit_internal() can't be used here
      * to avoid increasing AU length monotonously through the entire stream. */
     picture->incomplete_au_length += H264_DEFAULT_NALU_LENGTH_SIZE + nalu_length;
+    return 0;
 }
 
 static inline void h264_get_au_internal_end( mp4sys_h264_info_t *info, h264_picture_info_t *picture, h264_nalu_header_t *nalu_header, int no_more_buf )
@@ -2477,6 +2563,7 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
         buffer->update( info, importer->stream, 2 );
         no_more_buf = buffer->pos >= buffer->end;
         int no_more = info->no_more_read && no_more_buf;
+        h264_skip_to_next_start_code( buffer, &ebsp_length, &consecutive_zero_byte_count );
         if( !h264_check_next_short_start_code( buffer->pos, buffer->end ) && !no_more )
         {
             if( *(buffer->pos ++) )
@@ -2491,7 +2578,7 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
             /* For the last NALU.
              * This NALU already has been appended into the latest access unit and parsed. */
             h264_update_picture_info( picture, slice, &info->sei );
-            h264_complete_au( picture, probe );
+            h264_complete_au( importer_info, picture, probe );
             return h264_get_au_internal_succeeded( importer->info, picture, &nalu_header, no_more_buf );
         }
         uint64_t next_nalu_head_pos = info->ebsp_head_pos + ebsp_length + !no_more * H264_SHORT_START_CODE_LENGTH;
@@ -2564,12 +2651,13 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
                         /* The current NALU is the first VCL NALU of the primary coded picture of an new AU.
                          * Therefore, the previous slice belongs to the AU you want at this time. */
                         h264_update_picture_info( picture, &prev_slice, &info->sei );
-                        complete_au = h264_complete_au( picture, probe );
+                        complete_au = h264_complete_au( importer_info, picture, probe );
                     }
                     else
                         h264_update_picture_info_for_slice( picture, &prev_slice );
                 }
-                h264_append_nalu_to_au( picture, buffer->pos, nalu_length, probe );
+                if( h264_append_nalu_to_au( importer_info, picture, buffer->pos, nalu_length, probe ) )
+                    return h264_get_au_internal_failed( importer->info, picture, &nalu_header, no_more_buf, complete_au );
                 slice->present = 1;
             }
             else
@@ -2578,16 +2666,17 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
                 {
                     /* The last slice belongs to the AU you want at this time. */
                     h264_update_picture_info( picture, slice, &info->sei );
-                    complete_au = h264_complete_au( picture, probe );
+                    complete_au = h264_complete_au( importer_info, picture, probe );
                 }
                 else if( no_more )
-                    complete_au = h264_complete_au( picture, probe );
+                    complete_au = h264_complete_au( importer_info, picture, probe );
                 switch( nalu_type )
                 {
                     case 6 :    /* Supplemental Enhancement Information */
                         if( h264_parse_sei( info->bits, &info->sei, buffer->rbsp, buffer->pos + nalu_header.length, ebsp_length ) )
                             return h264_get_au_internal_failed( importer->info, picture, &nalu_header, no_more_buf, complete_au );
-                        h264_append_nalu_to_au( picture, buffer->pos, nalu_length, probe );
+                        if( h264_append_nalu_to_au( importer_info, picture, buffer->pos, nalu_length, probe ) )
+                            return h264_get_au_internal_failed( importer->info, picture, &nalu_header, no_more_buf, complete_au );
                         break;
                     case 7 :    /* Sequence Parameter Set */
                         if( h264_process_parameter_set( info, H264_PARAMETER_SET_TYPE_SPS, nalu_header.length, ebsp_length, probe ) )
@@ -2606,7 +2695,8 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
                             return h264_get_au_internal_failed( importer->info, picture, &nalu_header, no_more_buf, complete_au );
                         break;
                     default :
-                        h264_append_nalu_to_au( picture, buffer->pos, nalu_length, probe );
+                        if( h264_append_nalu_to_au( importer_info, picture, buffer->pos, nalu_length, probe ) )
+                            return h264_get_au_internal_failed( importer->info, picture, &nalu_header, no_more_buf, complete_au );
                         break;
                 }
             }
@@ -2636,7 +2726,7 @@ static int h264_get_access_unit_internal( mp4sys_importer_t *importer, int probe
         else if( picture->incomplete_au_length && picture->au_length == 0 )
         {
             h264_update_picture_info( picture, slice, &info->sei );
-            h264_complete_au( picture, probe );
+            h264_complete_au( importer_info, picture, probe );
             return h264_get_au_internal_succeeded( importer->info, picture, &nalu_header, no_more_buf );
         }
         if( complete_au )
@@ -2696,7 +2786,21 @@ static int mp4sys_h264_get_accessunit( mp4sys_importer_t *importer, uint32_t tra
             buffered_sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP | QT_SAMPLE_RANDOM_ACCESS_FLAG_PARTIAL_SYNC;
     }
     buffered_sample->length = picture->au_length;
-    memcpy( buffered_sample->data, picture->au, picture->au_length );
+    if( importer_info->map )
+    {
+        /* convert the referred NALUs into the sample straight from the map */
+        uint8_t *dst = buffered_sample->data;
+        for( uint32_t i = 0; i < importer_info->au_refs.count; i++ )
+        {
+            uint32_t nalu_length = importer_info->au_refs.nalu[i].length;
+            for( int j = H264_DEFAULT_NALU_LENGTH_SIZE; j; j-- )
+                *dst++ = (nalu_length >> ((j - 1) * 8)) & 0xff;
+            memcpy( dst, importer_info->au_refs.nalu[i].data, nalu_length );
+            dst += nalu_length;
+        }
+    }
+    else
+        memcpy( buffered_sample->data, picture->au, picture->au_length );
     return current_status;
 }
 
@@ -2748,9 +2852,16 @@ static int mp4sys_h264_probe( mp4sys_importer_t *importer )
         return -1;
     h264_info_t *info = &importer_info->info;
     h264_stream_buffer_t *buffer = &info->buffer;
-    buffer->pos = buffer->start;
-    buffer->end = buffer->start + fread( buffer->start, 1, buffer->bank->buffer_size, importer->stream );
-    info->no_more_read = buffer->start >= buffer->end ? feof( importer->stream ) : 0;
+    if( !importer->is_stdin )
+        h264_map_stream( importer_info, importer->stream );
+    if( importer_info->map )
+        h264_rewind_map( importer_info, 0 );
+    else
+    {
+        buffer->pos = buffer->start;
+        buffer->end = buffer->start + fread( buffer->start, 1, buffer->bank->buffer_size, importer->stream );
+        info->no_more_read = buffer->start >= buffer->end ? feof( importer->stream ) : 0;
+    }
     while( 1 )
     {
         /* Invalid if encountered any value of non-zero before the first start code. */
@@ -2952,13 +3063,20 @@ static int mp4sys_h264_probe( mp4sys_importer_t *importer )
     importer_info->ts_list.sample_count = num_access_units;
     importer_info->ts_list.timestamp    = timestamp;
     /* Go back to EBSP of the first NALU. */
-    lsmash_fseek( importer->stream, first_ebsp_head_pos, SEEK_SET );
     importer_info->status       = MP4SYS_IMPORTER_OK;
     info->nalu_header           = first_nalu_header;
     info->prev_nalu_type        = 0;
-    info->no_more_read          = 0;
-    buffer->pos                 = buffer->start;
-    buffer->end                 = buffer->start + fread( buffer->start, 1, buffer->bank->buffer_size, importer->stream );
+    if( importer_info->map )
+        h264_rewind_map( importer_info, first_ebsp_head_pos );
+    else
+    {
+        lsmash_fseek( importer->stream, first_ebsp_head_pos, SEEK_SET );
+        info->no_more_read = 0;
+        buffer->pos        = buffer->start;
+        buffer->end        = buffer->start + fread( buffer->start, 1, buffer->bank->buffer_size, importer->stream );
+    }
+    importer_info->au_refs.count            = 0;
+    importer_info->incomplete_au_refs.count = 0;
     info->ebsp_head_pos         = first_ebsp_head_pos;
     uint8_t *temp_au            = info->picture.au;
     uint8_t *temp_incomplete_au = info->picture.incomplete_au;
@@ -3572,12 +3690,160 @@ const static mp4sys_importer_functions* mp4sys_importer_tbl[] = {
     NULL,
 };
 
+/******** readahead ********/
+/* The stdio buffer of the stream, so that the many small reads the parsers do are served from memory. */
+#define MP4SYS_READAHEAD_BUFFER_SIZE (1 << 20)
+/* Access units parsed ahead of the caller. */
+#define MP4SYS_READAHEAD_AU_COUNT 64
+
+typedef struct
+{
+    lsmash_sample_t   sample;
+    int               ret;      /* what get_accessunit returned for it */
+    lsmash_summary_t *summary;  /* the summary it changed to, if ret > 0 */
+} mp4sys_readahead_au_t;
+
+/* A single parsing thread fills a ring of access units which the caller drains in order.
+ * The parser runs under parse_mutex since it may rewrite the summaries of the importer.
+ * As it runs ahead, the summary of the track is the one of the last access unit handed out
+ * rather than the importer's: a copy is queued along with each access unit changing it. */
+typedef struct mp4sys_readahead_tag
+{
+    x264_pthread_t        thread;
+    x264_pthread_mutex_t  mutex;        /* guards the ring and the flags */
+    x264_pthread_cond_t   cv_filled;
+    x264_pthread_cond_t   cv_drained;
+    x264_pthread_mutex_t  parse_mutex;
+    uint32_t              track_number;
+    uint32_t              au_capacity;
+    lsmash_summary_t     *summary;      /* as of the last access unit handed out, only touched by the caller */
+    mp4sys_readahead_au_t au[MP4SYS_READAHEAD_AU_COUNT];
+    int                   head;
+    int                   count;
+    int                   done;         /* the thread has parsed its last access unit */
+    int                   exit;
+} mp4sys_readahead_t;
+
+static lsmash_summary_t *mp4sys_duplicate_summary_internal( mp4sys_importer_t *importer, uint32_t track_number );
+
+#if HAVE_THREAD
+static void *mp4sys_readahead_thread( mp4sys_importer_t *importer )
+{
+    mp4sys_readahead_t *ra = importer->readahead;
+    x264_pthread_mutex_lock( &ra->mutex );
+    while( !ra->exit )
+    {
+        if( ra->count == MP4SYS_READAHEAD_AU_COUNT )
+        {
+            x264_pthread_cond_wait( &ra->cv_drained, &ra->mutex );
+            continue;
+        }
+        /* The slot past the queued ones is only touched by this thread until it is queued. */
+        mp4sys_readahead_au_t *au = &ra->au[(ra->head + ra->count) % MP4SYS_READAHEAD_AU_COUNT];
+        x264_pthread_mutex_unlock( &ra->mutex );
+        uint8_t *data = au->sample.data;
+        memset( &au->sample, 0, sizeof(lsmash_sample_t) );
+        au->sample.data   = data;
+        au->sample.length = ra->au_capacity;
+        x264_pthread_mutex_lock( &ra->parse_mutex );
+        au->ret = importer->funcs.get_accessunit( importer, ra->track_number, &au->sample );
+        if( au->ret > 0 && !(au->summary = mp4sys_duplicate_summary_internal( importer, ra->track_number )) )
+            au->ret = -1;
+        x264_pthread_mutex_unlock( &ra->parse_mutex );
+        x264_pthread_mutex_lock( &ra->mutex );
+        ++ ra->count;
+        x264_pthread_cond_broadcast( &ra->cv_filled );
+        /* Errors and the end of stream are final, so there is nothing left to parse after them. */
+        if( au->ret < 0 || au->sample.length == 0 )
+            break;
+    }
+    ra->done = 1;
+    x264_pthread_cond_broadcast( &ra->cv_filled );
+    x264_pthread_mutex_unlock( &ra->mutex );
+    return NULL;
+}
+#endif
+
+static void mp4sys_readahead_stop( mp4sys_importer_t *importer )
+{
+    mp4sys_readahead_t *ra = importer->readahead;
+    if( !ra )
+        return;
+    x264_pthread_mutex_lock( &ra->mutex );
+    ra->exit = 1;
+    x264_pthread_cond_broadcast( &ra->cv_drained );
+    x264_pthread_mutex_unlock( &ra->mutex );
+    x264_pthread_join( ra->thread, NULL );
+    x264_pthread_mutex_destroy( &ra->mutex );
+    x264_pthread_mutex_destroy( &ra->parse_mutex );
+    x264_pthread_cond_destroy( &ra->cv_filled );
+    x264_pthread_cond_destroy( &ra->cv_drained );
+    for( int i = 0; i < MP4SYS_READAHEAD_AU_COUNT; i++ )
+    {
+        free( ra->au[i].sample.data );
+        lsmash_cleanup_summary( ra->au[i].summary );
+    }
+    lsmash_cleanup_summary( ra->summary );
+    free( ra );
+    importer->readahead = NULL;
+}
+
+/* Takes the next access unit parsed ahead. Returns 1 if there was one, 0 if the thread has stopped. */
+static int mp4sys_readahead_get( mp4sys_readahead_t *ra, lsmash_sample_t *buffered_sample, int *ret )
+{
+    x264_pthread_mutex_lock( &ra->mutex );
+    while( !ra->count && !ra->done )
+        x264_pthread_cond_wait( &ra->cv_filled, &ra->mutex );
+    int available = ra->count;
+    x264_pthread_mutex_unlock( &ra->mutex );
+    if( !available )
+        return 0;
+    mp4sys_readahead_au_t *au = &ra->au[ra->head];
+    if( buffered_sample->length < au->sample.length )
+    {
+        /* Left queued: the caller may retry with a larger buffer. */
+        *ret = -1;
+        return 1;
+    }
+    uint8_t *data = buffered_sample->data;
+    *buffered_sample = au->sample;
+    buffered_sample->data = data;
+    memcpy( data, au->sample.data, au->sample.length );
+    *ret = au->ret;
+    if( au->summary )
+    {
+        lsmash_cleanup_summary( ra->summary );
+        ra->summary = au->summary;
+        au->summary = NULL;
+    }
+    x264_pthread_mutex_lock( &ra->mutex );
+    ra->head = (ra->head + 1) % MP4SYS_READAHEAD_AU_COUNT;
+    -- ra->count;
+    x264_pthread_cond_broadcast( &ra->cv_drained );
+    x264_pthread_mutex_unlock( &ra->mutex );
+    return 1;
+}
+
+/* Serializes the parser against the readers of state it may update. */
+static void mp4sys_importer_lock( mp4sys_importer_t *importer )
+{
+    if( importer->readahead )
+        x264_pthread_mutex_lock( &importer->readahead->parse_mutex );
+}
+
+static void mp4sys_importer_unlock( mp4sys_importer_t *importer )
+{
+    if( importer->readahead )
+        x264_pthread_mutex_unlock( &importer->readahead->parse_mutex );
+}
+
 /******** importer public functions ********/
 
 void mp4sys_importer_close( mp4sys_importer_t* importer )
 {
     if( !importer )
         return;
+    mp4sys_readahead_stop( importer );
     if( !importer->is_stdin && importer->stream )
         fclose( importer->stream );
     if( importer->funcs.cleanup )
@@ -3612,6 +3878,8 @@ mp4sys_importer_t *mp4sys_importer_open( const char *identifier, const char *for
         mp4sys_importer_close( importer );
         return NULL;
     }
+    else
+        setvbuf( importer->stream, NULL, _IOFBF, MP4SYS_READAHEAD_BUFFER_SIZE );
     importer->summaries = lsmash_create_entry_list();
     if( !importer->summaries )
     {
@@ -3652,11 +3920,78 @@ mp4sys_importer_t *mp4sys_importer_open( const char *identifier, const char *for
     return importer;
 }
 
+/* Return 0 if started. On failure, access units are still parsed on demand as usual. */
+int mp4sys_importer_start_readahead( mp4sys_importer_t *importer, uint32_t track_number )
+{
+#if HAVE_THREAD
+    if( !importer || !importer->funcs.get_accessunit || importer->readahead )
+        return -1;
+    lsmash_summary_t *summary = lsmash_get_entry_data( importer->summaries, track_number );
+    if( !summary || !summary->max_au_length )
+        return -1;
+    mp4sys_readahead_t *ra = lsmash_malloc_zero( sizeof(mp4sys_readahead_t) );
+    if( !ra )
+        return -1;
+    ra->track_number = track_number;
+    ra->au_capacity  = summary->max_au_length;
+    if( !(ra->summary = mp4sys_duplicate_summary_internal( importer, track_number )) )
+        goto fail;
+    for( int i = 0; i < MP4SYS_READAHEAD_AU_COUNT; i++ )
+        if( !(ra->au[i].sample.data = malloc( ra->au_capacity )) )
+            goto fail;
+    if( x264_pthread_mutex_init( &ra->mutex, NULL ) )
+        goto fail;
+    if( x264_pthread_mutex_init( &ra->parse_mutex, NULL ) )
+        goto fail_mutex;
+    if( x264_pthread_cond_init( &ra->cv_filled, NULL ) )
+        goto fail_parse_mutex;
+    if( x264_pthread_cond_init( &ra->cv_drained, NULL ) )
+        goto fail_cv_filled;
+    importer->readahead = ra;
+    if( x264_pthread_create( &ra->thread, NULL, (void *(*)(void *))mp4sys_readahead_thread, importer ) )
+    {
+        importer->readahead = NULL;
+        x264_pthread_cond_destroy( &ra->cv_drained );
+        goto fail_cv_filled;
+    }
+    return 0;
+fail_cv_filled:
+    x264_pthread_cond_destroy( &ra->cv_filled );
+fail_parse_mutex:
+    x264_pthread_mutex_destroy( &ra->parse_mutex );
+fail_mutex:
+    x264_pthread_mutex_destroy( &ra->mutex );
+fail:
+    for( int i = 0; i < MP4SYS_READAHEAD_AU_COUNT; i++ )
+        free( ra->au[i].sample.data );
+    lsmash_cleanup_summary( ra->summary );
+    free( ra );
+#endif
+    return -1;
+}
+
 /* 0 if success, positive if changed, negative if failed */
 int mp4sys_importer_get_access_unit( mp4sys_importer_t* importer, uint32_t track_number, lsmash_sample_t *buffered_sample )
 {
     if( !importer || !importer->funcs.get_accessunit || !buffered_sample->data || buffered_sample->length == 0 )
         return -1;
+    if( importer->readahead )
+    {
+        if( track_number != importer->readahead->track_number )
+            return -1;
+        int ret;
+        if( mp4sys_readahead_get( importer->readahead, buffered_sample, &ret ) )
+            return ret;
+        /* The thread has stopped, so the importer is ours again; it only has its final status left to report. */
+        ret = importer->funcs.get_accessunit( importer, track_number, buffered_sample );
+        if( ret > 0 )
+        {
+            lsmash_cleanup_summary( importer->readahead->summary );
+            if( !(importer->readahead->summary = mp4sys_duplicate_summary_internal( importer, track_number )) )
+                return -1;
+        }
+        return ret;
+    }
     return importer->funcs.get_accessunit( importer, track_number, buffered_sample );
 }
 
@@ -3665,7 +4000,10 @@ uint32_t mp4sys_importer_get_last_delta( mp4sys_importer_t *importer, uint32_t t
 {
     if( !importer || !importer->funcs.get_last_delta )
         return -1;
-    return importer->funcs.get_last_delta( importer, track_number );
+    mp4sys_importer_lock( importer );
+    uint32_t last_delta = importer->funcs.get_last_delta( importer, track_number );
+    mp4sys_importer_unlock( importer );
+    return last_delta;
 }
 
 uint32_t mp4sys_importer_get_track_count( mp4sys_importer_t *importer )
@@ -3675,11 +4013,28 @@ uint32_t mp4sys_importer_get_track_count( mp4sys_importer_t *importer )
     return importer->summaries->entry_count;
 }
 
+static lsmash_summary_t *mp4sys_copy_summary( lsmash_summary_t *src_summary );
+
 lsmash_summary_t *mp4sys_duplicate_summary( mp4sys_importer_t *importer, uint32_t track_number )
 {
     if( !importer )
         return NULL;
-    lsmash_summary_t *src_summary = lsmash_get_entry_data( importer->summaries, track_number );
+    /* The track parsed ahead has the summary of the access units handed out so far. */
+    if( importer->readahead && track_number == importer->readahead->track_number )
+        return mp4sys_copy_summary( importer->readahead->summary );
+    mp4sys_importer_lock( importer );
+    lsmash_summary_t *summary = mp4sys_duplicate_summary_internal( importer, track_number );
+    mp4sys_importer_unlock( importer );
+    return summary;
+}
+
+static lsmash_summary_t *mp4sys_duplicate_summary_internal( mp4sys_importer_t *importer, uint32_t track_number )
+{
+    return mp4sys_copy_summary( lsmash_get_entry_data( importer->summaries, track_number ) );
+}
+
+static lsmash_summary_t *mp4sys_copy_summary( lsmash_summary_t *src_summary )
+{
     if( !src_summary )
         return NULL;
     lsmash_summary_t *summary = lsmash_create_summary( src_summary->summary_type );
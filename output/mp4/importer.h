@@ -37,6 +37,9 @@ mp4sys_importer_t *mp4sys_importer_open( const char *identifier, const char *for
 void mp4sys_importer_close( mp4sys_importer_t *importer );
 int mp4sys_importer_get_access_unit( mp4sys_importer_t *importer, uint32_t track_number, lsmash_sample_t *buffered_sample );
 uint32_t mp4sys_importer_get_last_delta( mp4sys_importer_t *importer, uint32_t track_number );
+/* Parses the access units of track_number on a thread of its own, ahead of the calls to
+ * mp4sys_importer_get_access_unit(). Returns 0 if started; otherwise parsing stays on demand. */
+int mp4sys_importer_start_readahead( mp4sys_importer_t *importer, uint32_t track_number );
 uint32_t mp4sys_importer_get_track_count( mp4sys_importer_t *importer );
 lsmash_summary_t *mp4sys_duplicate_summary( mp4sys_importer_t *importer, uint32_t track_number );
 
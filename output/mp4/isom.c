@@ -458,35 +458,25 @@ int lsmash_add_sample_entry( lsmash_root_t *root, uint32_t track_ID, void *summa
 
 static int isom_add_stts_entry( isom_stbl_t *stbl, uint32_t sample_delta )
 {
-    if( !stbl || !stbl->stts || !stbl->stts->list )
+    if( !stbl || !stbl->stts || !stbl->stts->array )
         return -1;
-    isom_stts_entry_t *data = malloc( sizeof(isom_stts_entry_t) );
+    isom_stts_entry_t *data = lsmash_add_array_entry( stbl->stts->array );
     if( !data )
         return -1;
     data->sample_count = 1;
     data->sample_delta = sample_delta;
-    if( lsmash_add_entry( stbl->stts->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     return 0;
 }
 
 static int isom_add_ctts_entry( isom_stbl_t *stbl, uint32_t sample_offset )
 {
-    if( !stbl || !stbl->ctts || !stbl->ctts->list )
+    if( !stbl || !stbl->ctts || !stbl->ctts->array )
         return -1;
-    isom_ctts_entry_t *data = malloc( sizeof(isom_ctts_entry_t) );
+    isom_ctts_entry_t *data = lsmash_add_array_entry( stbl->ctts->array );
     if( !data )
         return -1;
     data->sample_count = 1;
     data->sample_offset = sample_offset;
-    if( lsmash_add_entry( stbl->ctts->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     return 0;
 }
 
@@ -517,40 +507,30 @@ static int isom_add_stsz_entry( isom_stbl_t *stbl, uint32_t entry_size )
     if( !stsz->sample_count )
         stsz->sample_size = entry_size;
     /* if it seems constant access_unit size at present, update sample_count only */
-    if( !stsz->list && stsz->sample_size == entry_size )
+    if( !stsz->array && stsz->sample_size == entry_size )
     {
         ++ stsz->sample_count;
         return 0;
     }
-    /* found sample_size varies, create sample_size list */
-    if( !stsz->list )
+    /* found sample_size varies, create sample_size table */
+    if( !stsz->array )
     {
-        stsz->list = lsmash_create_entry_list();
-        if( !stsz->list )
+        stsz->array = lsmash_create_entry_array( sizeof(isom_stsz_entry_t) );
+        if( !stsz->array )
             return -1;
         for( uint32_t i = 0; i < stsz->sample_count; i++ )
         {
-            isom_stsz_entry_t *data = malloc( sizeof(isom_stsz_entry_t) );
+            isom_stsz_entry_t *data = lsmash_add_array_entry( stsz->array );
             if( !data )
                 return -1;
             data->entry_size = stsz->sample_size;
-            if( lsmash_add_entry( stsz->list, data ) )
-            {
-                free( data );
-                return -1;
-            }
         }
         stsz->sample_size = 0;
     }
-    isom_stsz_entry_t *data = malloc( sizeof(isom_stsz_entry_t) );
+    isom_stsz_entry_t *data = lsmash_add_array_entry( stsz->array );
     if( !data )
         return -1;
     data->entry_size = entry_size;
-    if( lsmash_add_entry( stsz->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     ++ stsz->sample_count;
     return 0;
 }
@@ -598,9 +578,9 @@ static int isom_add_sdtp_entry( isom_box_t *parent, lsmash_sample_property_t *pr
         sdtp = ((isom_traf_entry_t *)parent)->sdtp;
     else
         assert( 0 );
-    if( !sdtp || !sdtp->list )
+    if( !sdtp || !sdtp->array )
         return -1;
-    isom_sdtp_entry_t *data = malloc( sizeof(isom_sdtp_entry_t) );
+    isom_sdtp_entry_t *data = lsmash_add_array_entry( sdtp->array );
     if( !data )
         return -1;
     /* isom_sdtp_entry_t is smaller than lsmash_sample_property_t. */
@@ -608,11 +588,6 @@ static int isom_add_sdtp_entry( isom_box_t *parent, lsmash_sample_property_t *pr
     data->sample_depends_on     = prop->independent & 0x03;
     data->sample_is_depended_on = prop->disposable & 0x03;
     data->sample_has_redundancy = prop->redundant & 0x03;
-    if( lsmash_add_entry( sdtp->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     return 0;
 }
 
@@ -620,7 +595,7 @@ static int isom_add_co64( isom_stbl_t *stbl )
 {
     if( !stbl || stbl->stco )
         return -1;
-    isom_create_list_box( stco, stbl, ISOM_BOX_TYPE_CO64 );
+    isom_create_array_box( stco, stbl, ISOM_BOX_TYPE_CO64, isom_co64_entry_t );
     stco->large_presentation = 1;
     stbl->stco = stco;
     return 0;
@@ -630,7 +605,7 @@ static int isom_add_stco( isom_stbl_t *stbl )
 {
     if( !stbl || stbl->stco )
         return -1;
-    isom_create_list_box( stco, stbl, ISOM_BOX_TYPE_STCO );
+    isom_create_array_box( stco, stbl, ISOM_BOX_TYPE_STCO, isom_stco_entry_t );
     stco->large_presentation = 0;
     stbl->stco = stco;
     return 0;
@@ -638,17 +613,12 @@ static int isom_add_stco( isom_stbl_t *stbl )
 
 static int isom_add_co64_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
 {
-    if( !stbl || !stbl->stco || !stbl->stco->list )
+    if( !stbl || !stbl->stco || !stbl->stco->array )
         return -1;
-    isom_co64_entry_t *data = malloc( sizeof(isom_co64_entry_t) );
+    isom_co64_entry_t *data = lsmash_add_array_entry( stbl->stco->array );
     if( !data )
         return -1;
     data->chunk_offset = chunk_offset;
-    if( lsmash_add_entry( stbl->stco->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     return 0;
 }
 
@@ -660,20 +630,41 @@ static int isom_convert_stco_to_co64( isom_stbl_t* stbl )
     if( isom_add_co64( stbl ) )
         return -1;
     /* move chunk_offset to co64 from stco */
-    for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
+    for( uint32_t i = 1; i <= stco->array->entry_count; i++ )
     {
-        isom_stco_entry_t *data = (isom_stco_entry_t*)entry->data;
+        isom_stco_entry_t *data = (isom_stco_entry_t *)lsmash_get_array_entry( stco->array, i );
         if( isom_add_co64_entry( stbl, data->chunk_offset ) )
             return -1;
     }
-    lsmash_remove_list( stco->list, NULL );
+    lsmash_remove_array( stco->array );
     free( stco );
     return 0;
 }
 
+static void isom_add_chunk_offset_shift( isom_stco_t *stco, uint64_t shift )
+{
+    lsmash_entry_array_t *array = stco->array;
+    for( uint32_t i = 0; i < array->chunk_count; i++ )
+    {
+        uint32_t length = lsmash_get_array_chunk_length( array, i );
+        if( stco->large_presentation )
+        {
+            isom_co64_entry_t *data = (isom_co64_entry_t *)array->chunk[i];
+            for( uint32_t j = 0; j < length; j++ )
+                data[j].chunk_offset += shift;
+        }
+        else
+        {
+            isom_stco_entry_t *data = (isom_stco_entry_t *)array->chunk[i];
+            for( uint32_t j = 0; j < length; j++ )
+                data[j].chunk_offset += shift;
+        }
+    }
+}
+
 static int isom_add_stco_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
 {
-    if( !stbl || !stbl->stco || !stbl->stco->list )
+    if( !stbl || !stbl->stco || !stbl->stco->array )
         return -1;
     if( stbl->stco->large_presentation )
         return isom_add_co64_entry( stbl, chunk_offset );
@@ -683,15 +674,10 @@ static int isom_add_stco_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
             return -1;
         return isom_add_co64_entry( stbl, chunk_offset );
     }
-    isom_stco_entry_t *data = malloc( sizeof(isom_stco_entry_t) );
+    isom_stco_entry_t *data = lsmash_add_array_entry( stbl->stco->array );
     if( !data )
         return -1;
     data->chunk_offset = (uint32_t)chunk_offset;
-    if( lsmash_add_entry( stbl->stco->list, data ) )
-    {
-        free( data );
-        return -1;
-    }
     return 0;
 }
 
@@ -1347,7 +1333,7 @@ static int isom_add_stts( isom_stbl_t *stbl )
 {
     if( !stbl || stbl->stts )
         return -1;
-    isom_create_list_box( stts, stbl, ISOM_BOX_TYPE_STTS );
+    isom_create_array_box( stts, stbl, ISOM_BOX_TYPE_STTS, isom_stts_entry_t );
     stbl->stts = stts;
     return 0;
 }
@@ -1356,7 +1342,7 @@ static int isom_add_ctts( isom_stbl_t *stbl )
 {
     if( !stbl || stbl->ctts )
         return -1;
-    isom_create_list_box( ctts, stbl, ISOM_BOX_TYPE_CTTS );
+    isom_create_array_box( ctts, stbl, ISOM_BOX_TYPE_CTTS, isom_ctts_entry_t );
     stbl->ctts = ctts;
     return 0;
 }
@@ -1383,7 +1369,7 @@ static int isom_add_stsz( isom_stbl_t *stbl )
 {
     if( !stbl || stbl->stsz )
         return -1;
-    isom_create_box( stsz, stbl, ISOM_BOX_TYPE_STSZ );  /* We don't create a list here. */
+    isom_create_box( stsz, stbl, ISOM_BOX_TYPE_STSZ );  /* We don't create a table here. */
     stbl->stsz = stsz;
     return 0;
 }
@@ -1415,7 +1401,7 @@ static int isom_add_sdtp( isom_box_t *parent )
         isom_stbl_t *stbl = (isom_stbl_t *)parent;
         if( stbl->sdtp )
             return -1;
-        isom_create_list_box( sdtp, stbl, ISOM_BOX_TYPE_SDTP );
+        isom_create_array_box( sdtp, stbl, ISOM_BOX_TYPE_SDTP, isom_sdtp_entry_t );
         stbl->sdtp = sdtp;
     }
     else if( lsmash_check_box_type_identical( parent->type, ISOM_BOX_TYPE_TRAF ) )
@@ -1423,7 +1409,7 @@ static int isom_add_sdtp( isom_box_t *parent )
         isom_traf_entry_t *traf = (isom_traf_entry_t *)parent;
         if( traf->sdtp )
             return -1;
-        isom_create_list_box( sdtp, traf, ISOM_BOX_TYPE_SDTP );
+        isom_create_array_box( sdtp, traf, ISOM_BOX_TYPE_SDTP, isom_sdtp_entry_t );
         traf->sdtp = sdtp;
     }
     else
@@ -2328,7 +2314,7 @@ static void isom_remove_stts( isom_stts_t *stts )
 {
     if( !stts )
         return;
-    lsmash_remove_list( stts->list, NULL );
+    lsmash_remove_array( stts->array );
     isom_remove_box( stts, isom_stbl_t );
 }
 
@@ -2336,7 +2322,7 @@ static void isom_remove_ctts( isom_ctts_t *ctts )
 {
     if( !ctts )
         return;
-    lsmash_remove_list( ctts->list, NULL );
+    lsmash_remove_array( ctts->array );
     isom_remove_box( ctts, isom_stbl_t );
 }
 
@@ -2359,7 +2345,7 @@ static void isom_remove_stsz( isom_stsz_t *stsz )
 {
     if( !stsz )
         return;
-    lsmash_remove_list( stsz->list, NULL );
+    lsmash_remove_array( stsz->array );
     isom_remove_box( stsz, isom_stbl_t );
 }
 
@@ -2383,7 +2369,7 @@ static void isom_remove_sdtp( isom_sdtp_t *sdtp )
 {
     if( !sdtp )
         return;
-    lsmash_remove_list( sdtp->list, NULL );
+    lsmash_remove_array( sdtp->array );
     if( sdtp->parent )
     {
         if( lsmash_check_box_type_identical( sdtp->parent->type, ISOM_BOX_TYPE_STBL ) )
@@ -2401,7 +2387,7 @@ static void isom_remove_stco( isom_stco_t *stco )
 {
     if( !stco )
         return;
-    lsmash_remove_list( stco->list, NULL );
+    lsmash_remove_array( stco->array );
     isom_remove_box( stco, isom_stbl_t );
 }
 
@@ -2647,6 +2633,7 @@ static void isom_remove_udta( isom_udta_t *udta )
     free( udta );
 }
 
+static void isom_empty_sample_pool( isom_sample_pool_t *pool );
 static void isom_remove_sample_pool( isom_sample_pool_t *pool );
 
 void isom_remove_trak( isom_trak_entry_t *trak )
@@ -2937,23 +2924,21 @@ static uint32_t isom_get_sample_count( isom_trak_entry_t *trak )
 
 static uint64_t isom_get_dts( isom_stts_t *stts, uint32_t sample_number )
 {
-    if( !stts || !stts->list )
+    if( !stts || !stts->array )
         return 0;
     uint64_t dts = 0;
     uint32_t i = 1;
-    lsmash_entry_t *entry;
-    isom_stts_entry_t *data;
-    for( entry = stts->list->head; entry; entry = entry->next )
+    uint32_t entry_number;
+    isom_stts_entry_t *data = NULL;
+    for( entry_number = 1; entry_number <= stts->array->entry_count; entry_number++ )
     {
-        data = (isom_stts_entry_t *)entry->data;
-        if( !data )
-            return 0;
+        data = (isom_stts_entry_t *)lsmash_get_array_entry( stts->array, entry_number );
         if( i + data->sample_count > sample_number )
             break;
         dts += (uint64_t)data->sample_delta * data->sample_count;
         i += data->sample_count;
     }
-    if( !entry )
+    if( entry_number > stts->array->entry_count )
         return 0;
     dts += (uint64_t)data->sample_delta * (sample_number - i);
     return dts;
@@ -2962,25 +2947,23 @@ static uint64_t isom_get_dts( isom_stts_t *stts, uint32_t sample_number )
 #if 0
 static uint64_t isom_get_cts( isom_stts_t *stts, isom_ctts_t *ctts, uint32_t sample_number )
 {
-    if( !stts || !stts->list )
+    if( !stts || !stts->array )
         return 0;
     if( !ctts )
         return isom_get_dts( stts, sample_number );
     uint32_t i = 1;     /* This can be 0 (and then condition below shall be changed) but I dare use same algorithm with isom_get_dts. */
-    lsmash_entry_t *entry;
-    isom_ctts_entry_t *data;
+    uint32_t entry_number;
+    isom_ctts_entry_t *data = NULL;
     if( sample_number == 0 )
         return 0;
-    for( entry = ctts->list->head; entry; entry = entry->next )
+    for( entry_number = 1; entry_number <= ctts->array->entry_count; entry_number++ )
     {
-        data = (isom_ctts_entry_t *)entry->data;
-        if( !data )
-            return 0;
+        data = (isom_ctts_entry_t *)lsmash_get_array_entry( ctts->array, entry_number );
         if( i + data->sample_count > sample_number )
             break;
         i += data->sample_count;
     }
-    if( !entry )
+    if( entry_number > ctts->array->entry_count )
         return 0;
     return isom_get_dts( stts, sample_number ) + data->sample_offset;
 }
@@ -2988,9 +2971,9 @@ static uint64_t isom_get_cts( isom_stts_t *stts, isom_ctts_t *ctts, uint32_t sam
 
 static int isom_replace_last_sample_delta( isom_stbl_t *stbl, uint32_t sample_delta )
 {
-    if( !stbl || !stbl->stts || !stbl->stts->list || !stbl->stts->list->tail || !stbl->stts->list->tail->data )
+    if( !stbl || !stbl->stts || !stbl->stts->array || !stbl->stts->array->entry_count )
         return -1;
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)stbl->stts->list->tail->data;
+    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)lsmash_get_array_tail( stbl->stts->array );
     if( sample_delta != last_stts_data->sample_delta )
     {
         if( last_stts_data->sample_count > 1 )
@@ -3008,7 +2991,7 @@ static int isom_replace_last_sample_delta( isom_stbl_t *stbl, uint32_t sample_de
 static int isom_update_mdhd_duration( isom_trak_entry_t *trak, uint32_t last_sample_delta )
 {
     if( !trak || !trak->root || !trak->cache || !trak->mdia || !trak->mdia->mdhd || !trak->mdia->minf
-     || !trak->mdia->minf->stbl || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->list )
+     || !trak->mdia->minf->stbl || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->array )
         return -1;
     lsmash_root_t *root = trak->root;
     isom_mdhd_t *mdhd = trak->mdia->mdhd;
@@ -3021,13 +3004,14 @@ static int isom_update_mdhd_duration( isom_trak_entry_t *trak, uint32_t last_sam
     if( !sample_count )
     {
         /* Return error if non-fragmented movie has no samples. */
-        if( !root->fragment && !stts->list->entry_count )
+        if( !root->fragment && !stts->array->entry_count )
             return -1;
         return 0;
     }
     /* Now we have at least 1 sample, so do stts_entry. */
-    lsmash_entry_t *last_stts = stts->list->tail;
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)last_stts->data;
+    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)lsmash_get_array_tail( stts->array );
+    if( !last_stts_data )
+        return -1;
     if( sample_count == 1 )
         mdhd->duration = last_stts_data->sample_delta;
     /* Now we have at least 2 samples,
@@ -3047,31 +3031,30 @@ static int isom_update_mdhd_duration( isom_trak_entry_t *trak, uint32_t last_sam
         else
         {
             /* Remove the last entry. */
-            if( lsmash_remove_entry( stts->list, stts->list->entry_count, NULL ) )
+            if( lsmash_remove_array_tail( stts->array ) )
                 return -1;
             /* copy the previous sample_delta. */
-            ++ ((isom_stts_entry_t *)stts->list->tail->data)->sample_count;
-            mdhd->duration += ((isom_stts_entry_t *)stts->list->tail->data)->sample_delta;
+            last_stts_data = (isom_stts_entry_t *)lsmash_get_array_tail( stts->array );
+            ++ last_stts_data->sample_count;
+            mdhd->duration += last_stts_data->sample_delta;
         }
     }
     else
     {
-        if( !ctts->list || ctts->list->entry_count == 0 )
+        if( !ctts->array || ctts->array->entry_count == 0 )
             return -1;
         uint64_t dts = 0;
         uint64_t max_cts = 0, max2_cts = 0, min_cts = UINT64_MAX;
         uint32_t max_offset = 0, min_offset = UINT32_MAX;
         int32_t  ctd_shift = trak->cache->timestamp.ctd_shift;
         uint32_t j, k;
-        lsmash_entry_t *stts_entry = stts->list->head;
-        lsmash_entry_t *ctts_entry = ctts->list->head;
+        uint32_t stts_entry_number = 1;
+        uint32_t ctts_entry_number = 1;
         j = k = 0;
         for( uint32_t i = 0; i < sample_count; i++ )
         {
-            if( !ctts_entry || !stts_entry )
-                return -1;
-            isom_stts_entry_t *stts_data = (isom_stts_entry_t *)stts_entry->data;
-            isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)ctts_entry->data;
+            isom_stts_entry_t *stts_data = (isom_stts_entry_t *)lsmash_get_array_entry( stts->array, stts_entry_number );
+            isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)lsmash_get_array_entry( ctts->array, ctts_entry_number );
             if( !stts_data || !ctts_data )
                 return -1;
             uint64_t cts;
@@ -3101,12 +3084,12 @@ static int isom_update_mdhd_duration( isom_trak_entry_t *trak, uint32_t last_sam
             /* If finished sample_count of current entry, move to next. */
             if( ++j == ctts_data->sample_count )
             {
-                ctts_entry = ctts_entry->next;
+                ++ctts_entry_number;
                 j = 0;
             }
             if( ++k == stts_data->sample_count )
             {
-                stts_entry = stts_entry->next;
+                ++stts_entry_number;
                 k = 0;
             }
         }
@@ -3240,29 +3223,24 @@ int lsmash_update_track_duration( lsmash_root_t *root, uint32_t track_ID, uint32
          : isom_update_tkhd_duration( trak );       /* Also update movie duration internally. */
 }
 
-static inline int isom_increment_sample_number_in_entry( uint32_t *sample_number_in_entry, uint32_t sample_count_in_entry, lsmash_entry_t **entry )
+static inline void isom_increment_sample_number_in_entry( uint32_t *sample_number_in_entry, uint32_t sample_count_in_entry, uint32_t *entry_number )
 {
     if( *sample_number_in_entry != sample_count_in_entry )
     {
         *sample_number_in_entry += 1;
-        return 0;
+        return;
     }
     /* Precede the next entry. */
     *sample_number_in_entry = 1;
-    if( *entry )
-    {
-        *entry = (*entry)->next;
-        if( *entry && !(*entry)->data )
-            return -1;
-    }
-    return 0;
+    *entry_number += 1;
 }
 
 static int isom_calculate_bitrate_description( isom_mdia_t *mdia, uint32_t *bufferSizeDB, uint32_t *maxBitrate, uint32_t *avgBitrate, uint32_t sample_description_index )
 {
     isom_stsz_t *stsz               = mdia->minf->stbl->stsz;
-    lsmash_entry_t *stsz_entry      = stsz->list ? stsz->list->head : NULL;
-    lsmash_entry_t *stts_entry      = mdia->minf->stbl->stts->list->head;
+    lsmash_entry_array_t *stts      = mdia->minf->stbl->stts->array;
+    uint32_t stsz_entry_number      = 1;
+    uint32_t stts_entry_number      = 1;
     lsmash_entry_t *stsc_entry      = NULL;
     lsmash_entry_t *next_stsc_entry = mdia->minf->stbl->stsc->list->head;
     isom_stts_entry_t *stts_data    = NULL;
@@ -3279,7 +3257,7 @@ static int isom_calculate_bitrate_description( isom_mdia_t *mdia, uint32_t *buff
     *bufferSizeDB = 0;
     *maxBitrate   = 0;
     *avgBitrate   = 0;
-    while( stts_entry )
+    while( stts_entry_number <= stts->entry_count )
     {
         if( !stsc_data || sample_number_in_chunk == stsc_data->samples_per_chunk )
         {
@@ -3332,18 +3310,19 @@ static int isom_calculate_bitrate_description( isom_mdia_t *mdia, uint32_t *buff
                     number_of_skips += (((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk - first_chunk) * samples_per_chunk;
                     for( uint32_t i = 0; i < number_of_skips; i++ )
                     {
-                        if( stsz->list )
+                        if( stsz->array )
                         {
-                            if( !stsz_entry )
+                            if( stsz_entry_number > stsz->array->entry_count )
                                 break;
-                            stsz_entry = stsz_entry->next;
+                            ++stsz_entry_number;
                         }
-                        if( !stts_entry )
+                        if( stts_entry_number > stts->entry_count )
                             break;
-                        if( isom_increment_sample_number_in_entry( &sample_number_in_stts, ((isom_stts_entry_t *)stts_entry->data)->sample_count, &stts_entry ) )
-                            return -1;
+                        isom_increment_sample_number_in_entry( &sample_number_in_stts,
+                                                               ((isom_stts_entry_t *)lsmash_get_array_entry( stts, stts_entry_number ))->sample_count,
+                                                               &stts_entry_number );
                     }
-                    if( (stsz->list && !stsz_entry) || !stts_entry )
+                    if( (stsz->array && stsz_entry_number > stsz->array->entry_count) || stts_entry_number > stts->entry_count )
                         break;
                     chunk_number = stsc_data->first_chunk;
                 }
@@ -3353,25 +3332,22 @@ static int isom_calculate_bitrate_description( isom_mdia_t *mdia, uint32_t *buff
             ++sample_number_in_chunk;
         /* Get current sample's size. */
         uint32_t size;
-        if( stsz->list )
+        if( stsz->array )
         {
-            if( !stsz_entry )
-                break;
-            isom_stsz_entry_t *stsz_data = (isom_stsz_entry_t *)stsz_entry->data;
+            isom_stsz_entry_t *stsz_data = (isom_stsz_entry_t *)lsmash_get_array_entry( stsz->array, stsz_entry_number++ );
             if( !stsz_data )
-                return -1;
+                break;
             size = stsz_data->entry_size;
-            stsz_entry = stsz_entry->next;
         }
         else
             size = stsz->sample_size;
         /* Get current sample's DTS. */
         if( stts_data )
             dts += stts_data->sample_delta;
-        stts_data = (isom_stts_entry_t *)stts_entry->data;
+        stts_data = (isom_stts_entry_t *)lsmash_get_array_entry( stts, stts_entry_number );
         if( !stts_data )
             return -1;
-        isom_increment_sample_number_in_entry( &sample_number_in_stts, stts_data->sample_count, &stts_entry );
+        isom_increment_sample_number_in_entry( &sample_number_in_stts, stts_data->sample_count, &stts_entry_number );
         /* Calculate bitrate description. */
         if( *bufferSizeDB < size )
             *bufferSizeDB = size;
@@ -3403,7 +3379,7 @@ static int isom_update_bitrate_description( isom_mdia_t *mdia )
     if( !stbl->stsd || !stbl->stsd->list
      || !stbl->stsz
      || !stbl->stsc || !stbl->stsc->list
-     || !stbl->stts || !stbl->stts->list )
+     || !stbl->stts || !stbl->stts->array )
         return -1;
     uint32_t sample_description_index = 0;
     for( lsmash_entry_t *entry = stbl->stsd->list->head; entry; entry = entry->next )
@@ -3536,7 +3512,7 @@ static int isom_update_bitrate_description( isom_mdia_t *mdia )
                 return -1;
             if( isom_calculate_bitrate_description( mdia, &bufferSizeDB, &maxBitrate, &avgBitrate, sample_description_index ) )
                 return -1;
-            if( !stbl->stsz->list )
+            if( !stbl->stsz->array )
                 maxBitrate = avgBitrate;
             uint8_t *exdata = ext->form.binary + 12;
             exdata[0] = (maxBitrate >> 24) & 0xff;
@@ -3557,7 +3533,7 @@ static int isom_update_bitrate_description( isom_mdia_t *mdia )
             if( !(ext && ext->format == EXTENSION_FORMAT_BINARY && ext->form.binary && ext->size >= 10) )
                 return -1;
             uint16_t bitrate;
-            if( stbl->stsz->list )
+            if( stbl->stsz->array )
             {
                 if( isom_calculate_bitrate_description( mdia, &bufferSizeDB, &maxBitrate, &avgBitrate, sample_description_index ) )
                     return -1;
@@ -3609,9 +3585,9 @@ static int isom_check_mandatory_boxes( lsmash_root_t *root )
             return -1;
         if( !root->fragment
          && (!stbl->stsd->list || !stbl->stsd->list->head
-         || !stbl->stts->list || !stbl->stts->list->head
+         || !stbl->stts->array || !stbl->stts->array->entry_count
          || !stbl->stsc->list || !stbl->stsc->list->head
-         || !stbl->stco->list || !stbl->stco->list->head) )
+         || !stbl->stco->array || !stbl->stco->array->entry_count) )
             return -1;
     }
     if( !root->fragment )
@@ -4284,18 +4260,18 @@ static uint64_t isom_update_stsd_size( isom_stsd_t *stsd )
 
 static uint64_t isom_update_stts_size( isom_stts_t *stts )
 {
-    if( !stts || !stts->list )
+    if( !stts || !stts->array )
         return 0;
-    stts->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)stts->list->entry_count * 8;
+    stts->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)stts->array->entry_count * 8;
     CHECK_LARGESIZE( stts );
     return stts->size;
 }
 
 static uint64_t isom_update_ctts_size( isom_ctts_t *ctts )
 {
-    if( !ctts || !ctts->list )
+    if( !ctts || !ctts->array )
         return 0;
-    ctts->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)ctts->list->entry_count * 8;
+    ctts->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)ctts->array->entry_count * 8;
     CHECK_LARGESIZE( ctts );
     return ctts->size;
 }
@@ -4313,7 +4289,7 @@ static uint64_t isom_update_stsz_size( isom_stsz_t *stsz )
 {
     if( !stsz )
         return 0;
-    stsz->size = ISOM_FULLBOX_COMMON_SIZE + 8 + ( stsz->list ? (uint64_t)stsz->list->entry_count * 4 : 0 );
+    stsz->size = ISOM_FULLBOX_COMMON_SIZE + 8 + ( stsz->array ? (uint64_t)stsz->array->entry_count * 4 : 0 );
     CHECK_LARGESIZE( stsz );
     return stsz->size;
 }
@@ -4338,9 +4314,9 @@ static uint64_t isom_update_stps_size( isom_stps_t *stps )
 
 static uint64_t isom_update_sdtp_size( isom_sdtp_t *sdtp )
 {
-    if( !sdtp || !sdtp->list )
+    if( !sdtp || !sdtp->array )
         return 0;
-    sdtp->size = ISOM_FULLBOX_COMMON_SIZE + (uint64_t)sdtp->list->entry_count;
+    sdtp->size = ISOM_FULLBOX_COMMON_SIZE + (uint64_t)sdtp->array->entry_count;
     CHECK_LARGESIZE( sdtp );
     return sdtp->size;
 }
@@ -4356,9 +4332,9 @@ static uint64_t isom_update_stsc_size( isom_stsc_t *stsc )
 
 static uint64_t isom_update_stco_size( isom_stco_t *stco )
 {
-    if( !stco || !stco->list )
+    if( !stco || !stco->array )
         return 0;
-    stco->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)stco->list->entry_count * (stco->large_presentation ? 8 : 4);
+    stco->size = ISOM_LIST_FULLBOX_COMMON_SIZE + (uint64_t)stco->array->entry_count * (stco->large_presentation ? 8 : 4);
     CHECK_LARGESIZE( stco );
     return stco->size;
 }
@@ -5080,20 +5056,20 @@ uint32_t lsmash_get_last_sample_delta( lsmash_root_t *root, uint32_t track_ID )
 {
     isom_trak_entry_t *trak = isom_get_trak( root, track_ID );
     if( !trak || !trak->mdia || !trak->mdia->minf || !trak->mdia->minf->stbl
-     || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->list
-     || !trak->mdia->minf->stbl->stts->list->tail || !trak->mdia->minf->stbl->stts->list->tail->data )
+     || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->array
+     || !trak->mdia->minf->stbl->stts->array->entry_count )
         return 0;
-    return ((isom_stts_entry_t *)trak->mdia->minf->stbl->stts->list->tail->data)->sample_delta;
+    return ((isom_stts_entry_t *)lsmash_get_array_tail( trak->mdia->minf->stbl->stts->array ))->sample_delta;
 }
 
 uint32_t lsmash_get_start_time_offset( lsmash_root_t *root, uint32_t track_ID )
 {
     isom_trak_entry_t *trak = isom_get_trak( root, track_ID );
     if( !trak || !trak->mdia || !trak->mdia->minf || !trak->mdia->minf->stbl
-     || !trak->mdia->minf->stbl->ctts || !trak->mdia->minf->stbl->ctts->list
-     || !trak->mdia->minf->stbl->ctts->list->head || !trak->mdia->minf->stbl->ctts->list->head->data )
+     || !trak->mdia->minf->stbl->ctts || !trak->mdia->minf->stbl->ctts->array
+     || !trak->mdia->minf->stbl->ctts->array->entry_count )
         return 0;
-    return ((isom_ctts_entry_t *)trak->mdia->minf->stbl->ctts->list->head->data)->sample_offset;
+    return ((isom_ctts_entry_t *)lsmash_get_array_entry( trak->mdia->minf->stbl->ctts->array, 1 ))->sample_offset;
 }
 
 uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t track_ID )
@@ -5105,13 +5081,13 @@ uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t t
     if( sample_count == 0 )
         return 0;
     isom_stbl_t *stbl = trak->mdia->minf->stbl;
-    if( !stbl->stts || !stbl->stts->list || !stbl->ctts || !stbl->ctts->list )
+    if( !stbl->stts || !stbl->stts->array || !stbl->ctts || !stbl->ctts->array )
         return 0;
     if( !(root->max_isom_version >= 4 && stbl->ctts->version == 1) && !root->qt_compatible )
         return 0;   /* This movie shall not have composition to decode timeline shift. */
-    lsmash_entry_t *stts_entry = stbl->stts->list->head;
-    lsmash_entry_t *ctts_entry = stbl->ctts->list->head;
-    if( !stts_entry || !ctts_entry )
+    uint32_t stts_entry_number = 1;
+    uint32_t ctts_entry_number = 1;
+    if( !stbl->stts->array->entry_count || !stbl->ctts->array->entry_count )
         return 0;
     uint64_t dts = 0;
     uint64_t cts = 0;
@@ -5120,8 +5096,8 @@ uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t t
     uint32_t j = 0;
     for( uint32_t k = 0; k < sample_count; i++ )
     {
-        isom_stts_entry_t *stts_data = (isom_stts_entry_t *)stts_entry->data;
-        isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)ctts_entry->data;
+        isom_stts_entry_t *stts_data = (isom_stts_entry_t *)lsmash_get_array_entry( stbl->stts->array, stts_entry_number );
+        isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)lsmash_get_array_entry( stbl->ctts->array, ctts_entry_number );
         if( !stts_data || !ctts_data )
             return 0;
         cts = dts + (int32_t)ctts_data->sample_offset;
@@ -5130,15 +5106,13 @@ uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t t
         dts += stts_data->sample_delta;
         if( ++i == stts_data->sample_count )
         {
-            stts_entry = stts_entry->next;
-            if( !stts_entry )
+            if( ++stts_entry_number > stbl->stts->array->entry_count )
                 return 0;
             i = 0;
         }
         if( ++j == ctts_data->sample_count )
         {
-            ctts_entry = ctts_entry->next;
-            if( !ctts_entry )
+            if( ++ctts_entry_number > stbl->ctts->array->entry_count )
                 return 0;
             j = 0;
         }
@@ -5719,6 +5693,100 @@ static int isom_write_fragment_random_access_info( lsmash_root_t *root )
     return isom_write_mfra( root->bs, root->mfra );
 }
 
+int lsmash_reserve_movie_space( lsmash_root_t *root, uint64_t size )
+{
+    /* The space has to be reserved before any sample is appended. */
+    if( !root || root->fragment || root->mdat
+     || size < ISOM_BASEBOX_COMMON_SIZE || size > UINT32_MAX )
+        return -1;
+    root->reserved_size = size;
+    return 0;
+}
+
+/* Write Movie Box and Metadata Box into the space reserved in front of Media Data Box.
+ * If the reserved space is too small, move the media data back by the shortfall and take over the space. */
+static int isom_write_moov_into_reserved_space( lsmash_root_t *root, lsmash_adhoc_remux_t *remux )
+{
+    isom_moov_t *moov = root->moov;
+    lsmash_bs_t *bs = root->bs;
+    uint64_t meta_size = root->meta ? root->meta->size : 0;
+    uint64_t mtf_size  = moov->size + meta_size;
+    uint64_t free_size;
+    uint64_t shift;
+    if( mtf_size > root->reserved_size )
+    {
+        shift     = mtf_size - root->reserved_size;
+        free_size = 0;
+    }
+    else if( mtf_size == root->reserved_size || root->reserved_size - mtf_size >= ISOM_BASEBOX_COMMON_SIZE )
+    {
+        shift     = 0;
+        free_size = root->reserved_size - mtf_size;
+    }
+    else
+    {
+        /* The remainder cannot hold even a box header. */
+        shift     = ISOM_BASEBOX_COMMON_SIZE - (root->reserved_size - mtf_size);
+        free_size = ISOM_BASEBOX_COMMON_SIZE;
+    }
+    if( shift && !remux )
+    {
+        /* We are not allowed to move the media data, so put Movie Box at the tail as usual. */
+        if( isom_write_moov( root )
+         || isom_write_meta( bs, root->meta ) )
+            return -1;
+        root->size += mtf_size;
+        return 0;
+    }
+    FILE *stream = bs->stream;
+    if( shift )
+    {
+        /* stco->co64 conversion, depending on last chunk's offset */
+        for( lsmash_entry_t *entry = moov->trak_list->head; entry; )
+        {
+            isom_stco_t *stco = ((isom_trak_entry_t *)entry->data)->mdia->minf->stbl->stco;
+            if( !stco->array->entry_count )
+                return -1;
+            if( stco->large_presentation
+             || (((isom_stco_entry_t *)lsmash_get_array_tail( stco->array ))->chunk_offset + shift) <= UINT32_MAX )
+            {
+                entry = entry->next;
+                continue;   /* no need to convert stco into co64 */
+            }
+            uint64_t moov_size = moov->size;
+            if( isom_convert_stco_to_co64( ((isom_trak_entry_t *)entry->data)->mdia->minf->stbl )
+             || isom_update_moov_size( moov ) )
+                return -1;
+            shift += moov->size - moov_size;
+            entry = moov->trak_list->head;  /* whenever any conversion, re-check all traks */
+        }
+        mtf_size = moov->size + meta_size;
+        for( lsmash_entry_t *entry = moov->trak_list->head; entry; entry = entry->next )
+            isom_add_chunk_offset_shift( ((isom_trak_entry_t *)entry->data)->mdia->minf->stbl->stco, shift );
+        if( isom_shift_file_tail( bs, root->reserved_pos + root->reserved_size, shift, remux ) )
+            return -1;
+        root->mdat->placeholder_pos += shift;
+        root->size += shift;
+    }
+    /* Overwrite the reserved space. */
+    if( lsmash_fseek( stream, root->reserved_pos, SEEK_SET )
+     || isom_write_moov( root )
+     || isom_write_meta( bs, root->meta ) )
+        return -1;
+    if( free_size )
+    {
+        lsmash_bs_put_be32( bs, free_size );
+        lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+        if( lsmash_bs_write_data( bs ) )
+            return -1;
+    }
+    if( lsmash_fseek( stream, 0, SEEK_END ) )
+        return -1;
+    if( remux && remux->func )
+        remux->func( remux->param, root->size, root->size );
+    return 0;
+}
+
 int lsmash_finish_movie( lsmash_root_t *root, lsmash_adhoc_remux_t* remux )
 {
     if( !root || !root->bs || !root->moov || !root->moov->trak_list )
@@ -5772,6 +5840,9 @@ int lsmash_finish_movie( lsmash_root_t *root, lsmash_adhoc_remux_t* remux )
      || isom_write_mdat_size( root ) )
         return -1;
 
+    if( root->reserved_size )
+        return isom_write_moov_into_reserved_space( root, remux );
+
     lsmash_bs_t *bs = root->bs;
     uint64_t meta_size = root->meta ? root->meta->size : 0;
     if( !remux )
@@ -5788,10 +5859,10 @@ int lsmash_finish_movie( lsmash_root_t *root, lsmash_adhoc_remux_t* remux )
     {
         isom_trak_entry_t* trak = (isom_trak_entry_t*)entry->data;
         isom_stco_t* stco = trak->mdia->minf->stbl->stco;
-        if( !stco->list->tail )
+        if( !stco->array->entry_count )
             return -1;
         if( stco->large_presentation
-         || (((isom_stco_entry_t*)stco->list->tail->data)->chunk_offset + moov->size + meta_size) <= UINT32_MAX )
+         || (((isom_stco_entry_t*)lsmash_get_array_tail( stco->array ))->chunk_offset + moov->size + meta_size) <= UINT32_MAX )
         {
             entry = entry->next;
             continue;   /* no need to convert stco into co64 */
@@ -5819,12 +5890,7 @@ int lsmash_finish_movie( lsmash_root_t *root, lsmash_adhoc_remux_t* remux )
     for( lsmash_entry_t* entry = moov->trak_list->head; entry; entry = entry->next )
     {
         isom_stco_t* stco = ((isom_trak_entry_t*)entry->data)->mdia->minf->stbl->stco;
-        if( stco->large_presentation )
-            for( lsmash_entry_t* co64_entry = stco->list->head ; co64_entry ; co64_entry = co64_entry->next )
-                ((isom_co64_entry_t*)co64_entry->data)->chunk_offset += mtf_size;
-        else
-            for( lsmash_entry_t* stco_entry = stco->list->head ; stco_entry ; stco_entry = stco_entry->next )
-                ((isom_stco_entry_t*)stco_entry->data)->chunk_offset += mtf_size;
+        isom_add_chunk_offset_shift( stco, mtf_size );
     }
 
     FILE *stream = bs->stream;
@@ -5893,9 +5959,7 @@ static int isom_create_fragment_overall_default_settings( lsmash_root_t *root )
         if( !trak || !trak->cache || !trak->tkhd || !trak->mdia || !trak->mdia->minf || !trak->mdia->minf->stbl )
             return -1;
         isom_stbl_t *stbl = trak->mdia->minf->stbl;
-        if( !stbl->stts || !stbl->stts->list || !stbl->stsz
-         || (stbl->stts->list->tail && !stbl->stts->list->tail->data)
-         || (stbl->stsz->list && stbl->stsz->list->head && !stbl->stsz->list->head->data) )
+        if( !stbl->stts || !stbl->stts->array || !stbl->stsz )
             return -1;
         isom_trex_entry_t *trex = isom_add_trex( root->moov->mvex );
         if( !trex )
@@ -5903,11 +5967,11 @@ static int isom_create_fragment_overall_default_settings( lsmash_root_t *root )
         trex->track_ID = trak->tkhd->track_ID;
         /* Set up defaults. */
         trex->default_sample_description_index = trak->cache->chunk.sample_description_index ? trak->cache->chunk.sample_description_index : 1;
-        trex->default_sample_duration = stbl->stts->list->tail ? ((isom_stts_entry_t *)stbl->stts->list->tail->data)->sample_delta : 1;
-        trex->default_sample_size = !stbl->stsz->list
-                                  ? stbl->stsz->sample_size : stbl->stsz->list->head
-                                  ? ((isom_stsz_entry_t *)stbl->stsz->list->head->data)->entry_size : 0;
-        if( stbl->sdtp && stbl->sdtp->list )
+        trex->default_sample_duration = stbl->stts->array->entry_count ? ((isom_stts_entry_t *)lsmash_get_array_tail( stbl->stts->array ))->sample_delta : 1;
+        trex->default_sample_size = !stbl->stsz->array
+                                  ? stbl->stsz->sample_size : stbl->stsz->array->entry_count
+                                  ? ((isom_stsz_entry_t *)lsmash_get_array_entry( stbl->stsz->array, 1 ))->entry_size : 0;
+        if( stbl->sdtp && stbl->sdtp->array )
         {
             struct sample_flags_stats_t
             {
@@ -5916,11 +5980,9 @@ static int isom_create_fragment_overall_default_settings( lsmash_root_t *root )
                 uint32_t sample_is_depended_on[4];
                 uint32_t sample_has_redundancy[4];
             } stats = { { 0 }, { 0 }, { 0 }, { 0 } };
-            for( lsmash_entry_t *sdtp_entry = stbl->sdtp->list->head; sdtp_entry; sdtp_entry = sdtp_entry->next )
+            for( uint32_t i = 1; i <= stbl->sdtp->array->entry_count; i++ )
             {
-                isom_sdtp_entry_t *data = (isom_sdtp_entry_t *)sdtp_entry->data;
-                if( !data )
-                    return -1;
+                isom_sdtp_entry_t *data = (isom_sdtp_entry_t *)lsmash_get_array_entry( stbl->sdtp->array, i );
                 ++ stats.is_leading           [ data->is_leading            ];
                 ++ stats.sample_depends_on    [ data->sample_depends_on     ];
                 ++ stats.sample_is_depended_on[ data->sample_is_depended_on ];
@@ -5956,7 +6018,7 @@ static int isom_output_fragment_media_data( lsmash_root_t *root )
     if( !fragment->pool->entry_count )
     {
         /* no need to write media data */
-        lsmash_remove_entries( fragment->pool, lsmash_delete_sample );
+        lsmash_remove_entries( fragment->pool, isom_remove_sample_pool );
         fragment->pool_size = 0;
         return 0;
     }
@@ -5967,9 +6029,9 @@ static int isom_output_fragment_media_data( lsmash_root_t *root )
     for( lsmash_entry_t* entry = fragment->pool->head; entry; entry = entry->next )
     {
         isom_sample_pool_t *pool = (isom_sample_pool_t *)entry->data;
-        if( !pool )
+        if( !pool || lsmash_bs_write_buffers( root->bs, pool->buffers, pool->sample_count ) )
             return -1;
-        lsmash_bs_put_bytes( root->bs, pool->size, pool->data );
+        isom_empty_sample_pool( pool );
     }
     if( lsmash_bs_write_data( root->bs ) )
         return -1;
@@ -6015,9 +6077,9 @@ static int isom_finish_fragment_initial_movie( lsmash_root_t *root )
     {
         isom_trak_entry_t* trak = (isom_trak_entry_t*)entry->data;
         isom_stco_t* stco = trak->mdia->minf->stbl->stco;
-        if( !stco->list->tail   /* no samples */
+        if( !stco->array->entry_count   /* no samples */
          || stco->large_presentation
-         || (((isom_stco_entry_t*)stco->list->tail->data)->chunk_offset + moov->size + meta_size) <= UINT32_MAX )
+         || (((isom_stco_entry_t*)lsmash_get_array_tail( stco->array ))->chunk_offset + moov->size + meta_size) <= UINT32_MAX )
         {
             entry = entry->next;
             continue;   /* no need to convert stco into co64 */
@@ -6033,12 +6095,7 @@ static int isom_finish_fragment_initial_movie( lsmash_root_t *root )
     for( lsmash_entry_t* entry = moov->trak_list->head; entry; entry = entry->next )
     {
         isom_stco_t* stco = ((isom_trak_entry_t*)entry->data)->mdia->minf->stbl->stco;
-        if( stco->large_presentation )
-            for( lsmash_entry_t* co64_entry = stco->list->head ; co64_entry ; co64_entry = co64_entry->next )
-                ((isom_co64_entry_t*)co64_entry->data)->chunk_offset += preceding_size;
-        else
-            for( lsmash_entry_t* stco_entry = stco->list->head ; stco_entry ; stco_entry = stco_entry->next )
-                ((isom_stco_entry_t*)stco_entry->data)->chunk_offset += preceding_size;
+        isom_add_chunk_offset_shift( stco, preceding_size );
     }
     /* Write File Type Box here if it was not written yet. */
     if( !root->file_type_written && isom_write_ftyp( root ) )
@@ -6350,12 +6407,12 @@ int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32
     }
     isom_trak_entry_t *trak = isom_get_trak( root, track_ID );
     if( !trak || !trak->mdia || !trak->mdia->mdhd || !trak->mdia->minf || !trak->mdia->minf->stbl
-     || !trak->mdia->minf->stbl->stsz || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->list )
+     || !trak->mdia->minf->stbl->stsz || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->array )
         return -1;
     isom_stbl_t *stbl = trak->mdia->minf->stbl;
     isom_stts_t *stts = stbl->stts;
     uint32_t sample_count = isom_get_sample_count( trak );
-    if( !stts->list->tail )
+    if( !stts->array->entry_count )
     {
         if( !sample_count )
             return 0;       /* no samples */
@@ -6366,11 +6423,11 @@ int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32
         return lsmash_update_track_duration( root, track_ID, 0 );
     }
     uint32_t i = 0;
-    for( lsmash_entry_t *entry = stts->list->head; entry; entry = entry->next )
-        i += ((isom_stts_entry_t *)entry->data)->sample_count;
+    for( uint32_t entry_number = 1; entry_number <= stts->array->entry_count; entry_number++ )
+        i += ((isom_stts_entry_t *)lsmash_get_array_entry( stts->array, entry_number ))->sample_count;
     if( sample_count < i )
         return -1;
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)stts->list->tail->data;
+    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)lsmash_get_array_tail( stts->array );
     if( !last_stts_data )
         return -1;
     if( sample_count > i )
@@ -6426,7 +6483,7 @@ void lsmash_destroy_root( lsmash_root_t *root )
     }
     if( root->fragment )
     {
-        lsmash_remove_list( root->fragment->pool, lsmash_delete_sample );
+        lsmash_remove_list( root->fragment->pool, isom_remove_sample_pool );
         free( root->fragment );
     }
     free( root );
@@ -6581,22 +6638,57 @@ lsmash_sample_t *lsmash_create_sample( uint32_t size )
     return sample;
 }
 
+/* Adopt the buffer 'data' without copying it.
+ * 'release' is called with 'opaque' and 'data' when the muxer has done with the buffer.
+ * If 'release' is NULL, the buffer shall be allocated by malloc() and is released by free(). */
+lsmash_sample_t *lsmash_create_sample_from_buffer( uint8_t *data, uint32_t length, lsmash_sample_release_func release, void *opaque )
+{
+    lsmash_sample_t *sample = lsmash_malloc_zero( sizeof(lsmash_sample_t) );
+    if( !sample )
+        return NULL;
+    sample->data    = data;
+    sample->length  = length;
+    sample->release = release;
+    sample->opaque  = opaque;
+    return sample;
+}
+
+static void isom_release_sample_data( lsmash_sample_t *sample )
+{
+    if( !sample->data )
+        return;
+    if( sample->release )
+        sample->release( sample->opaque, sample->data );
+    else
+        free( sample->data );
+    sample->data    = NULL;
+    sample->release = NULL;
+    sample->opaque  = NULL;
+}
+
 int lsmash_sample_alloc( lsmash_sample_t *sample, uint32_t size )
 {
     if( !sample )
         return -1;
     if( !size )
     {
-        if( sample->data )
-            free( sample->data );
-        sample->data = NULL;
+        isom_release_sample_data( sample );
         sample->length = 0;
         return 0;
     }
     if( size == sample->length )
         return 0;
     uint8_t *data;
-    if( !sample->data )
+    if( sample->release )
+    {
+        /* We can't resize a buffer owned by others. */
+        data = malloc( size );
+        if( !data )
+            return -1;
+        memcpy( data, sample->data, LSMASH_MIN( size, sample->length ) );
+        isom_release_sample_data( sample );
+    }
+    else if( !sample->data )
         data = malloc( size );
     else
         data = realloc( sample->data, size );
@@ -6611,34 +6703,47 @@ void lsmash_delete_sample( lsmash_sample_t *sample )
 {
     if( !sample )
         return;
-    if( sample->data )
-        free( sample->data );
+    isom_release_sample_data( sample );
     free( sample );
 }
 
-isom_sample_pool_t *isom_create_sample_pool( uint64_t size )
+/* The argument 'count' is the number of samples expected to be pooled. */
+isom_sample_pool_t *isom_create_sample_pool( uint32_t count )
 {
     isom_sample_pool_t *pool = lsmash_malloc_zero( sizeof(isom_sample_pool_t) );
     if( !pool )
         return NULL;
-    if( size == 0 )
+    if( count == 0 )
         return pool;
-    pool->data = malloc( size );
-    if( !pool->data )
+    pool->samples = malloc( count * sizeof(lsmash_sample_t *) );
+    pool->buffers = malloc( count * sizeof(lsmash_buffer_t) );
+    if( !pool->samples || !pool->buffers )
     {
+        free( pool->samples );
+        free( pool->buffers );
         free( pool );
         return NULL;
     }
-    pool->alloc = size;
+    pool->alloc = count;
     return pool;
 }
 
+/* Release all samples in the pool and make it empty. */
+static void isom_empty_sample_pool( isom_sample_pool_t *pool )
+{
+    for( uint32_t i = 0; i < pool->sample_count; i++ )
+        lsmash_delete_sample( pool->samples[i] );
+    pool->sample_count = 0;
+    pool->size         = 0;
+}
+
 static void isom_remove_sample_pool( isom_sample_pool_t *pool )
 {
     if( !pool )
         return;
-    if( pool->data )
-        free( pool->data );
+    isom_empty_sample_pool( pool );
+    free( pool->samples );
+    free( pool->buffers );
     free( pool );
 }
 
@@ -6652,7 +6757,7 @@ static uint32_t isom_add_size( isom_trak_entry_t *trak, uint32_t sample_size )
 static uint32_t isom_add_dts( isom_stbl_t *stbl, isom_timestamp_t *cache, uint64_t dts )
 {
     isom_stts_t *stts = stbl->stts;
-    if( !stts->list->entry_count )
+    if( !stts->array->entry_count )
     {
         if( isom_add_stts_entry( stbl, dts ) )
             return 0;
@@ -6662,7 +6767,7 @@ static uint32_t isom_add_dts( isom_stbl_t *stbl, isom_timestamp_t *cache, uint64
     if( dts <= cache->dts )
         return 0;
     uint32_t sample_delta = dts - cache->dts;
-    isom_stts_entry_t *data = (isom_stts_entry_t *)stts->list->tail->data;
+    isom_stts_entry_t *data = (isom_stts_entry_t *)lsmash_get_array_tail( stts->array );
     if( data->sample_delta == sample_delta )
         ++ data->sample_count;
     else if( isom_add_stts_entry( stbl, sample_delta ) )
@@ -6685,7 +6790,7 @@ static int isom_add_cts( isom_stbl_t *stbl, isom_timestamp_t *cache, uint64_t ct
         if( isom_add_ctts( stbl ) || isom_add_ctts_entry( stbl, 0 ) )
             return -1;
         ctts = stbl->ctts;
-        isom_ctts_entry_t *data = (isom_ctts_entry_t *)ctts->list->head->data;
+        isom_ctts_entry_t *data = (isom_ctts_entry_t *)lsmash_get_array_entry( ctts->array, 1 );
         uint32_t sample_count = stbl->stsz->sample_count;
         if( sample_count != 1 )
         {
@@ -6698,9 +6803,9 @@ static int isom_add_cts( isom_stbl_t *stbl, isom_timestamp_t *cache, uint64_t ct
         cache->cts = cts;
         return 0;
     }
-    if( !ctts->list )
+    if( !ctts->array )
         return -1;
-    isom_ctts_entry_t *data = (isom_ctts_entry_t *)ctts->list->tail->data;
+    isom_ctts_entry_t *data = (isom_ctts_entry_t *)lsmash_get_array_tail( ctts->array );
     uint32_t sample_offset = cts - cache->dts;
     if( data->sample_offset == sample_offset )
         ++ data->sample_count;
@@ -6712,7 +6817,7 @@ static int isom_add_cts( isom_stbl_t *stbl, isom_timestamp_t *cache, uint64_t ct
 
 static int isom_add_timestamp( isom_trak_entry_t *trak, uint64_t dts, uint64_t cts )
 {
-    if( !trak->cache || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->list )
+    if( !trak->cache || !trak->mdia->minf->stbl->stts || !trak->mdia->minf->stbl->stts->array )
         return -1;
     lsmash_root_t *root = trak->root;
     if( root->isom_compatible && root->qt_compatible && (cts - dts) > INT32_MAX )
@@ -7227,13 +7332,11 @@ static int isom_write_pooled_samples( lsmash_root_t *root, isom_sample_pool_t *p
 {
     if( !root || !root->mdat || !root->bs || !root->bs->stream )
         return -1;
-    lsmash_bs_put_bytes( root->bs, pool->size, pool->data );
-    if( lsmash_bs_write_data( root->bs ) )
+    if( lsmash_bs_write_buffers( root->bs, pool->buffers, pool->sample_count ) )
         return -1;
-    root->mdat->size  += pool->size;
-    root->size        += pool->size;
-    pool->sample_count = 0;
-    pool->size         = 0;
+    root->mdat->size += pool->size;
+    root->size       += pool->size;
+    isom_empty_sample_pool( pool );
     return 0;
 }
 
@@ -7276,7 +7379,7 @@ static int isom_append_fragment_track_run( lsmash_root_t *root, isom_chunk_t *ch
         return -1;
     fragment->pool->entry_count += chunk->pool->sample_count;
     fragment->pool_size         += chunk->pool->size;
-    chunk->pool = isom_create_sample_pool( chunk->pool->size );
+    chunk->pool = isom_create_sample_pool( chunk->pool->sample_count );
     return chunk->pool ? 0 : -1;
 }
 
@@ -7306,26 +7409,27 @@ static int isom_output_cached_chunk( isom_trak_entry_t *trak )
     return isom_write_pooled_samples( root, chunk->pool );
 }
 
+/* Pool the sample itself. Its data is not copied but written by reference when the pool is flushed. */
 static int isom_pool_sample( isom_sample_pool_t *pool, lsmash_sample_t *sample )
 {
-    uint64_t pool_size = pool->size + sample->length;
-    if( pool->alloc < pool_size )
+    if( pool->alloc <= pool->sample_count )
     {
-        uint8_t *data;
-        uint64_t alloc = pool_size + (1<<16);
-        if( !pool->data )
-            data = malloc( alloc );
-        else
-            data = realloc( pool->data, alloc );
-        if( !data )
+        uint32_t alloc = pool->alloc ? pool->alloc * 2 : 16;
+        lsmash_sample_t **samples = realloc( pool->samples, alloc * sizeof(lsmash_sample_t *) );
+        if( !samples )
             return -1;
-        pool->data = data;
-        pool->alloc = alloc;
+        pool->samples = samples;
+        lsmash_buffer_t *buffers = realloc( pool->buffers, alloc * sizeof(lsmash_buffer_t) );
+        if( !buffers )
+            return -1;
+        pool->buffers = buffers;
+        pool->alloc   = alloc;
     }
-    memcpy( pool->data + pool->size, sample->data, sample->length );
-    pool->size = pool_size;
+    pool->samples[ pool->sample_count ]      = sample;
+    pool->buffers[ pool->sample_count ].data = sample->data;
+    pool->buffers[ pool->sample_count ].size = sample->length;
+    pool->size         += sample->length;
     pool->sample_count += 1;
-    lsmash_delete_sample( sample );
     return 0;
 }
 
@@ -7385,6 +7489,10 @@ static int isom_append_sample( lsmash_root_t *root, uint32_t track_ID, lsmash_sa
     /* If there is no available Media Data Box to write samples, add and write a new one before any chunk offset is decided. */
     if( !root->mdat )
     {
+        /* Put the space reserved for Movie Box in front of the first Media Data Box. */
+        if( isom_write_reserved_space( root ) )
+            return -1;
+        root->size += root->reserved_size;
         if( isom_new_mdat( root, 0 ) )
             return -1;
         /* Add the size of the Media Data Box and the placeholder. */
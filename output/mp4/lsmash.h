@@ -776,6 +776,9 @@ typedef struct
     lsmash_pre_roll_t         pre_roll;
 } lsmash_sample_property_t;
 
+/* Called with 'opaque' and 'data' of a sample when the muxer has done with the buffer adopted by the sample. */
+typedef void (*lsmash_sample_release_func)( void *opaque, uint8_t *data );
+
 typedef struct
 {
     uint32_t length;
@@ -784,6 +787,8 @@ typedef struct
     uint64_t cts;
     uint32_t index;
     lsmash_sample_property_t prop;
+    lsmash_sample_release_func release;     /* If NULL, 'data' is released by free(). */
+    void *opaque;                           /* the first argument passed to 'release' */
 } lsmash_sample_t;
 
 typedef struct
@@ -1176,11 +1181,13 @@ void lsmash_initialize_media_parameters( lsmash_media_parameters_t *param );
 int lsmash_set_media_parameters( lsmash_root_t *root, uint32_t track_ID, lsmash_media_parameters_t *param );
 int lsmash_add_sample_entry( lsmash_root_t *root, uint32_t track_ID, void *summary );
 lsmash_sample_t *lsmash_create_sample( uint32_t size );
+lsmash_sample_t *lsmash_create_sample_from_buffer( uint8_t *data, uint32_t length, lsmash_sample_release_func release, void *opaque );
 int lsmash_sample_alloc( lsmash_sample_t *sample, uint32_t size );
 void lsmash_delete_sample( lsmash_sample_t *sample );
 int lsmash_append_sample( lsmash_root_t *root, uint32_t track_ID, lsmash_sample_t *sample );
 int lsmash_flush_pooled_samples( lsmash_root_t *root, uint32_t track_ID, uint32_t last_sample_delta );
 int lsmash_update_track_duration( lsmash_root_t *root, uint32_t track_ID, uint32_t last_sample_delta );
+int lsmash_reserve_movie_space( lsmash_root_t *root, uint64_t size );
 int lsmash_finish_movie( lsmash_root_t *root, lsmash_adhoc_remux_t* remux );
 void lsmash_destroy_root( lsmash_root_t *root );
 int lsmash_get_movie_parameters( lsmash_root_t *root, lsmash_movie_parameters_t *param );
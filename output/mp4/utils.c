@@ -25,6 +25,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#define LSMASH_IOV_MAX 64
+#endif
 
 #include "utils.h"
 
@@ -136,13 +140,89 @@ void lsmash_bs_put_be32_from_64( lsmash_bs_t *bs, uint64_t value )
     lsmash_bs_put_be32( bs, (uint32_t)(value&0xffffffff) );
 }
 
+/* Byte swapping for the bulk writers below: a single instruction per value with the builtins,
+ * instead of putting the values byte by byte. */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
+#define LSMASH_BSWAP32( x ) __builtin_bswap32( x )
+#define LSMASH_BSWAP64( x ) __builtin_bswap64( x )
+#else
+#define LSMASH_BSWAP32( x ) (((x) << 24) | (((x) << 8) & 0xff0000) | (((x) >> 8) & 0xff00) | ((x) >> 24))
+#define LSMASH_BSWAP64( x ) (((uint64_t)LSMASH_BSWAP32( (uint32_t)(x) ) << 32) | LSMASH_BSWAP32( (uint32_t)((x) >> 32) ))
+#endif
+
+static void lsmash_put_be32_block( uint8_t *dst, const uint32_t *src, uint32_t n )
+{
+#if WORDS_BIGENDIAN
+    memcpy( dst, src, n * 4 );
+#else
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        uint32_t value = LSMASH_BSWAP32( src[i] );
+        memcpy( dst + i * 4, &value, 4 );
+    }
+#endif
+}
+
+static void lsmash_put_be64_block( uint8_t *dst, const uint64_t *src, uint32_t n )
+{
+#if WORDS_BIGENDIAN
+    memcpy( dst, src, n * 8 );
+#else
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        uint64_t value = LSMASH_BSWAP64( src[i] );
+        memcpy( dst + i * 8, &value, 8 );
+    }
+#endif
+}
+
+void lsmash_bs_put_be32_array( lsmash_bs_t *bs, lsmash_entry_array_t *array )
+{
+    if( !array || !array->entry_count )
+        return;
+    uint64_t size = (uint64_t)array->entry_count * array->element_size;
+    lsmash_bs_alloc( bs, bs->store + size );
+    if( bs->error )
+        return;
+    uint8_t *p = bs->data + bs->store;
+    for( uint32_t i = 0; i < array->chunk_count; i++ )
+    {
+        uint32_t n = lsmash_get_array_chunk_length( array, i ) * (array->element_size / 4);
+        lsmash_put_be32_block( p, (uint32_t *)array->chunk[i], n );
+        p += n * 4;
+    }
+    bs->store += size;
+}
+
+void lsmash_bs_put_be64_array( lsmash_bs_t *bs, lsmash_entry_array_t *array )
+{
+    if( !array || !array->entry_count )
+        return;
+    uint64_t size = (uint64_t)array->entry_count * array->element_size;
+    lsmash_bs_alloc( bs, bs->store + size );
+    if( bs->error )
+        return;
+    uint8_t *p = bs->data + bs->store;
+    for( uint32_t i = 0; i < array->chunk_count; i++ )
+    {
+        uint32_t n = lsmash_get_array_chunk_length( array, i ) * (array->element_size / 8);
+        lsmash_put_be64_block( p, (uint64_t *)array->chunk[i], n );
+        p += n * 8;
+    }
+    bs->store += size;
+}
+
+/* A bytestream without any stream keeps the data on memory,
+ * so that boxes can be serialized into it and written later in one go. */
 int lsmash_bs_write_data( lsmash_bs_t *bs )
 {
     if( !bs )
         return -1;
     if( !bs->store || !bs->data )
         return 0;
-    if( bs->error || !bs->stream || fwrite( bs->data, 1, bs->store, bs->stream ) != bs->store )
+    if( !bs->stream && !bs->error )
+        return 0;
+    if( bs->error || fwrite( bs->data, 1, bs->store, bs->stream ) != bs->store )
     {
         lsmash_bs_free( bs );
         bs->error = 1;
@@ -153,6 +233,86 @@ int lsmash_bs_write_data( lsmash_bs_t *bs )
     return 0;
 }
 
+/* Write the buffers into the stream of 'bs' in order, without copying them into 'bs'.
+ * The data pending on 'bs' goes first. */
+int lsmash_bs_write_buffers( lsmash_bs_t *bs, lsmash_buffer_t *buffers, uint32_t count )
+{
+    if( !bs || !bs->stream || lsmash_bs_write_data( bs ) )
+        return -1;
+    uint64_t total = 0;
+    for( uint32_t i = 0; i < count; i++ )
+        total += buffers[i].size;
+#if HAVE_WRITEV
+    FILE *stream = bs->stream;
+    if( fflush( stream ) )
+        return -1;
+    int64_t pos = lsmash_ftell( stream );
+    int fd = fileno( stream );
+    struct iovec iov[LSMASH_IOV_MAX];
+    for( uint32_t i = 0; i < count; )
+    {
+        int n = 0;
+        for( ; i < count && n < LSMASH_IOV_MAX; i++ )
+            if( buffers[i].size )
+            {
+                iov[n].iov_base = buffers[i].data;
+                iov[n].iov_len  = buffers[i].size;
+                ++n;
+            }
+        struct iovec *v = iov;
+        while( n )
+        {
+            ssize_t ret = writev( fd, v, n );
+            if( ret < 0 )
+                return -1;
+            /* Skip the buffers written completely and continue on the rest of a partial write. */
+            while( n && (size_t)ret >= v->iov_len )
+            {
+                ret -= v->iov_len;
+                ++v;
+                --n;
+            }
+            if( n )
+            {
+                v->iov_base  = (uint8_t *)v->iov_base + ret;
+                v->iov_len  -= ret;
+            }
+        }
+    }
+    /* Let the stream know the position moved by the writes bypassing it. */
+    if( pos >= 0 && lsmash_fseek( stream, pos + total, SEEK_SET ) )
+        return -1;
+#else
+    for( uint32_t i = 0; i < count; i++ )
+        if( buffers[i].size && fwrite( buffers[i].data, 1, buffers[i].size, bs->stream ) != buffers[i].size )
+            return -1;
+#endif
+    bs->written += total;
+    return 0;
+}
+
+/* Write the data held on the on-memory bytestreams 'src' into the stream of 'bs' in order.
+ * The data pending on 'bs' goes first. */
+int lsmash_bs_write_vector( lsmash_bs_t *bs, lsmash_bs_t **src, int count )
+{
+    lsmash_buffer_t *buffers = malloc( count * sizeof(lsmash_buffer_t) );
+    if( !buffers )
+        return -1;
+    for( int i = 0; i < count; i++ )
+    {
+        if( src[i]->error )
+        {
+            free( buffers );
+            return -1;
+        }
+        buffers[i].data = src[i]->data;
+        buffers[i].size = src[i]->store;
+    }
+    int ret = lsmash_bs_write_buffers( bs, buffers, count );
+    free( buffers );
+    return ret;
+}
+
 lsmash_bs_t* lsmash_bs_create( char* filename )
 {
     lsmash_bs_t* bs = lsmash_malloc_zero( sizeof(lsmash_bs_t) );
@@ -656,6 +816,85 @@ void *lsmash_get_entry_data( lsmash_entry_list_t *list, uint32_t entry_number )
 }
 /*---- ----*/
 
+/*---- array ----*/
+void lsmash_init_entry_array( lsmash_entry_array_t *array, uint32_t element_size )
+{
+    array->chunk        = NULL;
+    array->chunk_count  = 0;
+    array->chunk_alloc  = 0;
+    array->element_size = element_size;
+    array->entry_count  = 0;
+}
+
+lsmash_entry_array_t *lsmash_create_entry_array( uint32_t element_size )
+{
+    if( !element_size )
+        return NULL;
+    lsmash_entry_array_t *array = malloc( sizeof(lsmash_entry_array_t) );
+    if( !array )
+        return NULL;
+    lsmash_init_entry_array( array, element_size );
+    return array;
+}
+
+void *lsmash_add_array_entry( lsmash_entry_array_t *array )
+{
+    if( !array || array->entry_count == UINT32_MAX )
+        return NULL;
+    uint32_t index       = array->entry_count;
+    uint32_t chunk_index = index >> LSMASH_ENTRY_ARRAY_CHUNK_SHIFT;
+    if( chunk_index >= array->chunk_count )
+    {
+        if( array->chunk_count == array->chunk_alloc )
+        {
+            /* Only the table of chunk pointers is reallocated. Elements never move. */
+            uint32_t chunk_alloc = array->chunk_alloc ? array->chunk_alloc * 2 : 16;
+            uint8_t **chunk = realloc( array->chunk, chunk_alloc * sizeof(uint8_t *) );
+            if( !chunk )
+                return NULL;
+            array->chunk       = chunk;
+            array->chunk_alloc = chunk_alloc;
+        }
+        uint8_t *data = malloc( (size_t)LSMASH_ENTRY_ARRAY_CHUNK_LENGTH * array->element_size );
+        if( !data )
+            return NULL;
+        array->chunk[ array->chunk_count ++ ] = data;
+    }
+    ++ array->entry_count;
+    void *entry = array->chunk[chunk_index] + (index & LSMASH_ENTRY_ARRAY_CHUNK_MASK) * array->element_size;
+    memset( entry, 0, array->element_size );
+    return entry;
+}
+
+int lsmash_remove_array_tail( lsmash_entry_array_t *array )
+{
+    if( !array || !array->entry_count )
+        return -1;
+    /* Keep the chunk even if it gets empty since it is likely to be reused soon. */
+    -- array->entry_count;
+    return 0;
+}
+
+void lsmash_remove_array_entries( lsmash_entry_array_t *array )
+{
+    if( !array )
+        return;
+    for( uint32_t i = 0; i < array->chunk_count; i++ )
+        free( array->chunk[i] );
+    if( array->chunk )
+        free( array->chunk );
+    lsmash_init_entry_array( array, array->element_size );
+}
+
+void lsmash_remove_array( lsmash_entry_array_t *array )
+{
+    if( !array )
+        return;
+    lsmash_remove_array_entries( array );
+    free( array );
+}
+/*---- ----*/
+
 /*---- type ----*/
 double lsmash_fixed2double( uint64_t value, int frac_width )
 {
@@ -736,12 +975,12 @@ lsmash_multiple_buffers_t *lsmash_resize_multiple_buffers( lsmash_multiple_buffe
         if( !temp )
             return NULL;
         for( uint32_t i = multiple_buffer->number_of_buffers - 1; i ; i-- )
-            memmove( temp + buffer_size, temp + i * multiple_buffer->buffer_size, multiple_buffer->buffer_size );
+            memmove( temp + i * buffer_size, temp + i * multiple_buffer->buffer_size, multiple_buffer->buffer_size );
     }
     else
     {
         for( uint32_t i = 1; i < multiple_buffer->number_of_buffers; i++ )
-            memmove( multiple_buffer->buffers + buffer_size, multiple_buffer->buffers + i * multiple_buffer->buffer_size, multiple_buffer->buffer_size );
+            memmove( multiple_buffer->buffers + i * buffer_size, multiple_buffer->buffers + i * multiple_buffer->buffer_size, multiple_buffer->buffer_size );
         temp = realloc( multiple_buffer->buffers, multiple_buffer->number_of_buffers * buffer_size );
         if( !temp )
             return NULL;
@@ -41,6 +41,13 @@ typedef struct
     uint64_t written; /* data size written into "stream" already */
 } lsmash_bs_t;
 
+/* A piece of data written by reference */
+typedef struct
+{
+    uint8_t *data;
+    uint64_t size;
+} lsmash_buffer_t;
+
 uint64_t lsmash_bs_get_pos( lsmash_bs_t *bs );
 void lsmash_bs_empty( lsmash_bs_t *bs );
 void lsmash_bs_free( lsmash_bs_t *bs );
@@ -60,6 +67,8 @@ void lsmash_bs_put_be16_from_64( lsmash_bs_t *bs, uint64_t value );
 void lsmash_bs_put_be24_from_64( lsmash_bs_t *bs, uint64_t value );
 void lsmash_bs_put_be32_from_64( lsmash_bs_t *bs, uint64_t value );
 int lsmash_bs_write_data( lsmash_bs_t *bs );
+int lsmash_bs_write_buffers( lsmash_bs_t *bs, lsmash_buffer_t *buffers, uint32_t count );
+int lsmash_bs_write_vector( lsmash_bs_t *bs, lsmash_bs_t **src, int count );
 void *lsmash_bs_export_data( lsmash_bs_t *bs, uint32_t* length );
 
 /*---- bytestream reader ----*/
@@ -132,6 +141,59 @@ void lsmash_remove_list( lsmash_entry_list_t *list, void* eliminator );
 lsmash_entry_t *lsmash_get_entry( lsmash_entry_list_t *list, uint32_t entry_number );
 void *lsmash_get_entry_data( lsmash_entry_list_t *list, uint32_t entry_number );
 
+/*---- array ----*/
+
+/* Growable table of fixed size elements.
+ * Elements are stored in contiguous chunks of LSMASH_ENTRY_ARRAY_CHUNK_LENGTH entries,
+ * so appending never moves existing elements and any entry can be accessed directly by its number.
+ * This is intended for sample tables which get one entry per sample. */
+#define LSMASH_ENTRY_ARRAY_CHUNK_SHIFT  12
+#define LSMASH_ENTRY_ARRAY_CHUNK_LENGTH (1 << LSMASH_ENTRY_ARRAY_CHUNK_SHIFT)
+#define LSMASH_ENTRY_ARRAY_CHUNK_MASK   (LSMASH_ENTRY_ARRAY_CHUNK_LENGTH - 1)
+
+typedef struct
+{
+    uint8_t **chunk;            /* chunks holding LSMASH_ENTRY_ARRAY_CHUNK_LENGTH elements each */
+    uint32_t  chunk_count;      /* the number of allocated chunks */
+    uint32_t  chunk_alloc;      /* the number of allocated chunk pointers */
+    uint32_t  element_size;     /* the size of an element in bytes */
+    uint32_t  entry_count;      /* the number of valid elements */
+} lsmash_entry_array_t;
+
+void lsmash_init_entry_array( lsmash_entry_array_t *array, uint32_t element_size );
+lsmash_entry_array_t *lsmash_create_entry_array( uint32_t element_size );
+void *lsmash_add_array_entry( lsmash_entry_array_t *array );
+int lsmash_remove_array_tail( lsmash_entry_array_t *array );
+void lsmash_remove_array_entries( lsmash_entry_array_t *array );
+void lsmash_remove_array( lsmash_entry_array_t *array );
+
+/* entry_number is 1-origin as well as lsmash_get_entry(). */
+static inline void *lsmash_get_array_entry( lsmash_entry_array_t *array, uint32_t entry_number )
+{
+    if( !array || !entry_number || entry_number > array->entry_count )
+        return NULL;
+    uint32_t index = entry_number - 1;
+    return array->chunk[index >> LSMASH_ENTRY_ARRAY_CHUNK_SHIFT] + (index & LSMASH_ENTRY_ARRAY_CHUNK_MASK) * array->element_size;
+}
+
+static inline void *lsmash_get_array_tail( lsmash_entry_array_t *array )
+{
+    return array ? lsmash_get_array_entry( array, array->entry_count ) : NULL;
+}
+
+/* Return the number of valid elements in the chunk specified by chunk_index (0-origin). */
+static inline uint32_t lsmash_get_array_chunk_length( lsmash_entry_array_t *array, uint32_t chunk_index )
+{
+    uint64_t first = (uint64_t)chunk_index << LSMASH_ENTRY_ARRAY_CHUNK_SHIFT;
+    if( first >= array->entry_count )
+        return 0;
+    return LSMASH_MIN( array->entry_count - first, LSMASH_ENTRY_ARRAY_CHUNK_LENGTH );
+}
+
+/* Bulk writers: put all elements regarding them as sequences of 32-bit or 64-bit words in big endian. */
+void lsmash_bs_put_be32_array( lsmash_bs_t *bs, lsmash_entry_array_t *array );
+void lsmash_bs_put_be64_array( lsmash_bs_t *bs, lsmash_entry_array_t *array );
+
 /*---- type ----*/
 double lsmash_fixed2double( uint64_t value, int frac_width );
 float lsmash_int2float32( uint32_t value );
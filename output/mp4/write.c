@@ -20,6 +20,7 @@
 
 /* This file is available under an ISC license. */
 
+#define _GNU_SOURCE /* for copy_file_range */
 #include "internal.h" /* must be placed first */
 
 #include <stdlib.h>
@@ -1052,18 +1053,12 @@ static int isom_write_stsd( lsmash_bs_t *bs, isom_trak_entry_t *trak )
 static int isom_write_stts( lsmash_bs_t *bs, isom_trak_entry_t *trak )
 {
     isom_stts_t *stts = trak->mdia->minf->stbl->stts;
-    if( !stts || !stts->list )
+    if( !stts || !stts->array )
         return -1;
     isom_bs_put_box_common( bs, stts );
-    lsmash_bs_put_be32( bs, stts->list->entry_count );
-    for( lsmash_entry_t *entry = stts->list->head; entry; entry = entry->next )
-    {
-        isom_stts_entry_t *data = (isom_stts_entry_t *)entry->data;
-        if( !data )
-            return -1;
-        lsmash_bs_put_be32( bs, data->sample_count );
-        lsmash_bs_put_be32( bs, data->sample_delta );
-    }
+    lsmash_bs_put_be32( bs, stts->array->entry_count );
+    /* isom_stts_entry_t is a pair of 32-bit fields: sample_count and sample_delta. */
+    lsmash_bs_put_be32_array( bs, stts->array );
     return lsmash_bs_write_data( bs );
 }
 
@@ -1072,18 +1067,12 @@ static int isom_write_ctts( lsmash_bs_t *bs, isom_trak_entry_t *trak )
     isom_ctts_t *ctts = trak->mdia->minf->stbl->ctts;
     if( !ctts )
         return 0;
-    if( !ctts->list )
+    if( !ctts->array )
         return -1;
     isom_bs_put_box_common( bs, ctts );
-    lsmash_bs_put_be32( bs, ctts->list->entry_count );
-    for( lsmash_entry_t *entry = ctts->list->head; entry; entry = entry->next )
-    {
-        isom_ctts_entry_t *data = (isom_ctts_entry_t *)entry->data;
-        if( !data )
-            return -1;
-        lsmash_bs_put_be32( bs, data->sample_count );
-        lsmash_bs_put_be32( bs, data->sample_offset );
-    }
+    lsmash_bs_put_be32( bs, ctts->array->entry_count );
+    /* isom_ctts_entry_t is a pair of 32-bit fields: sample_count and sample_offset. */
+    lsmash_bs_put_be32_array( bs, ctts->array );
     return lsmash_bs_write_data( bs );
 }
 
@@ -1109,14 +1098,8 @@ static int isom_write_stsz( lsmash_bs_t *bs, isom_trak_entry_t *trak )
     isom_bs_put_box_common( bs, stsz );
     lsmash_bs_put_be32( bs, stsz->sample_size );
     lsmash_bs_put_be32( bs, stsz->sample_count );
-    if( stsz->sample_size == 0 && stsz->list )
-        for( lsmash_entry_t *entry = stsz->list->head; entry; entry = entry->next )
-        {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            if( !data )
-                return -1;
-            lsmash_bs_put_be32( bs, data->entry_size );
-        }
+    if( stsz->sample_size == 0 && stsz->array )
+        lsmash_bs_put_be32_array( bs, stsz->array );
     return lsmash_bs_write_data( bs );
 }
 
@@ -1162,20 +1145,24 @@ static int isom_write_sdtp( lsmash_bs_t *bs, isom_sdtp_t *sdtp )
 {
     if( !sdtp )
         return 0;
-    if( !sdtp->list )
+    if( !sdtp->array )
         return -1;
     isom_bs_put_box_common( bs, sdtp );
-    for( lsmash_entry_t *entry = sdtp->list->head; entry; entry = entry->next )
+    lsmash_bs_alloc( bs, bs->store + sdtp->array->entry_count );
+    if( bs->error )
+        return -1;
+    uint8_t *p = bs->data + bs->store;
+    for( uint32_t i = 0; i < sdtp->array->chunk_count; i++ )
     {
-        isom_sdtp_entry_t *data = (isom_sdtp_entry_t *)entry->data;
-        if( !data )
-            return -1;
-        uint8_t temp = (data->is_leading            << 6)
-                     | (data->sample_depends_on     << 4)
-                     | (data->sample_is_depended_on << 2)
-                     |  data->sample_has_redundancy;
-        lsmash_bs_put_byte( bs, temp );
+        isom_sdtp_entry_t *data = (isom_sdtp_entry_t *)sdtp->array->chunk[i];
+        uint32_t length = lsmash_get_array_chunk_length( sdtp->array, i );
+        for( uint32_t j = 0; j < length; j++ )
+            *p++ = (data[j].is_leading            << 6)
+                 | (data[j].sample_depends_on     << 4)
+                 | (data[j].sample_is_depended_on << 2)
+                 |  data[j].sample_has_redundancy;
     }
+    bs->store += sdtp->array->entry_count;
     return lsmash_bs_write_data( bs );
 }
 
@@ -1201,36 +1188,24 @@ static int isom_write_stsc( lsmash_bs_t *bs, isom_trak_entry_t *trak )
 static int isom_write_co64( lsmash_bs_t *bs, isom_trak_entry_t *trak )
 {
     isom_stco_t *co64 = trak->mdia->minf->stbl->stco;
-    if( !co64 || !co64->list )
+    if( !co64 || !co64->array )
         return -1;
     isom_bs_put_box_common( bs, co64 );
-    lsmash_bs_put_be32( bs, co64->list->entry_count );
-    for( lsmash_entry_t *entry = co64->list->head; entry; entry = entry->next )
-    {
-        isom_co64_entry_t *data = (isom_co64_entry_t *)entry->data;
-        if( !data )
-            return -1;
-        lsmash_bs_put_be64( bs, data->chunk_offset );
-    }
+    lsmash_bs_put_be32( bs, co64->array->entry_count );
+    lsmash_bs_put_be64_array( bs, co64->array );
     return lsmash_bs_write_data( bs );
 }
 
 static int isom_write_stco( lsmash_bs_t *bs, isom_trak_entry_t *trak )
 {
     isom_stco_t *stco = trak->mdia->minf->stbl->stco;
-    if( !stco || !stco->list )
+    if( !stco || !stco->array )
         return -1;
     if( stco->large_presentation )
         return isom_write_co64( bs, trak );
     isom_bs_put_box_common( bs, stco );
-    lsmash_bs_put_be32( bs, stco->list->entry_count );
-    for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
-    {
-        isom_stco_entry_t *data = (isom_stco_entry_t *)entry->data;
-        if( !data )
-            return -1;
-        lsmash_bs_put_be32( bs, data->chunk_offset );
-    }
+    lsmash_bs_put_be32( bs, stco->array->entry_count );
+    lsmash_bs_put_be32_array( bs, stco->array );
     return lsmash_bs_write_data( bs );
 }
 
@@ -1863,6 +1838,103 @@ int isom_write_mdat_size( lsmash_root_t *root )
     return ret;
 }
 
+/* Write a Free Space Box occupying the space reserved for Movie Box.
+ * Its payload is filled with zeros and will be overwritten when finishing the movie. */
+int isom_write_reserved_space( lsmash_root_t *root )
+{
+    if( !root || !root->bs || !root->bs->stream )
+        return -1;
+    if( !root->reserved_size )
+        return 0;
+    lsmash_bs_t *bs = root->bs;
+    root->reserved_pos = lsmash_ftell( bs->stream ) + bs->store;
+    lsmash_bs_put_be32( bs, root->reserved_size );
+    lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+    if( lsmash_bs_write_data( bs ) )
+        return -1;
+    uint64_t rest = root->reserved_size - ISOM_BASEBOX_COMMON_SIZE;
+    while( rest )
+    {
+        uint64_t size = LSMASH_MIN( rest, 1<<16 );
+        lsmash_bs_alloc( bs, size );
+        if( bs->error )
+            return -1;
+        memset( bs->data, 0, size );
+        bs->store = size;
+        if( lsmash_bs_write_data( bs ) )
+            return -1;
+        rest -= size;
+    }
+    return 0;
+}
+
+/* Move the data from the position 'start' to the end of the stream toward the end by 'shift' bytes.
+ * The copy goes from the tail to the head so that the source range is never overwritten before it is read. */
+int isom_shift_file_tail( lsmash_bs_t *bs, uint64_t start, uint64_t shift, lsmash_adhoc_remux_t *remux )
+{
+    if( !bs || !bs->stream || !remux )
+        return -1;
+    FILE *stream = bs->stream;
+    if( fflush( stream ) || lsmash_fseek( stream, 0, SEEK_END ) )
+        return -1;
+    uint64_t end   = lsmash_ftell( stream );
+    uint64_t total = end - start;
+    uint64_t done  = 0;
+    uint64_t pos   = end;
+#if HAVE_COPY_FILE_RANGE
+    /* The kernel can copy ranges without bouncing through user space as long as they don't overlap. */
+    if( shift >= (1<<20) )
+    {
+        int fd = fileno( stream );
+        uint64_t block = LSMASH_MIN( shift, (uint64_t)1<<30 );
+        while( pos > start )
+        {
+            uint64_t size = LSMASH_MIN( block, pos - start );
+            uint64_t rest = size;
+            loff_t in  = pos - size;
+            loff_t out = in + shift;
+            while( rest )
+            {
+                ssize_t ret = copy_file_range( fd, &in, fd, &out, rest, 0 );
+                if( ret <= 0 )
+                    goto fallback;  /* e.g. unsupported by the filesystem, so copy the rest by ourselves */
+                rest -= ret;
+            }
+            pos  -= size;
+            done += size;
+            if( remux->func )
+                remux->func( remux->param, done, total );
+        }
+        return 0;
+    }
+fallback:
+#endif
+    {
+        uint64_t buffer_size = LSMASH_MAX( remux->buffer_size, 1<<16 );
+        uint8_t *buf = malloc( buffer_size );
+        if( !buf )
+            return -1;
+        while( pos > start )
+        {
+            uint64_t size = LSMASH_MIN( buffer_size, pos - start );
+            pos -= size;
+            if( lsmash_fseek( stream, pos, SEEK_SET )
+             || fread( buf, 1, size, stream ) != size
+             || lsmash_fseek( stream, pos + shift, SEEK_SET )
+             || fwrite( buf, 1, size, stream ) != size )
+            {
+                free( buf );
+                return -1;
+            }
+            done += size;
+            if( remux->func )
+                remux->func( remux->param, done, total );
+        }
+        free( buf );
+    }
+    return 0;
+}
+
 int isom_write_ftyp( lsmash_root_t *root )
 {
     isom_ftyp_t *ftyp = root->ftyp;
@@ -1881,6 +1953,83 @@ int isom_write_ftyp( lsmash_root_t *root )
     return 0;
 }
 
+typedef struct
+{
+    lsmash_bs_t       *bs;
+    isom_trak_entry_t *trak;
+    int                ret;
+} isom_trak_writer_t;
+
+static void *isom_write_trak_on_memory( void *arg )
+{
+    isom_trak_writer_t *writer = (isom_trak_writer_t *)arg;
+    lsmash_bs_alloc( writer->bs, writer->trak->size );
+    writer->ret = isom_write_trak( writer->bs, writer->trak );
+    return NULL;
+}
+
+/* Tracks whose tables are smaller than this are serialized faster than a thread starts. */
+#define ISOM_TRAK_THREAD_SIZE (1<<20)
+
+/* Serialize each track into its own on-memory bytestream and write all of them with a single vectored write.
+ * Tracks don't refer to each other while being written, so the large ones are serialized in parallel if possible.
+ * Edit List Boxes in movie fragments remember their positions in the stream, so the tracks are written directly there. */
+static int isom_write_traks( lsmash_root_t *root, lsmash_entry_list_t *trak_list )
+{
+    lsmash_bs_t *bs = root->bs;
+    uint32_t count = trak_list->entry_count;
+    if( root->fragment || count < 2 )
+    {
+        for( lsmash_entry_t *entry = trak_list->head; entry; entry = entry->next )
+            if( isom_write_trak( bs, (isom_trak_entry_t *)entry->data ) )
+                return -1;
+        return 0;
+    }
+    isom_trak_writer_t *writer = lsmash_malloc_zero( count * (sizeof(isom_trak_writer_t) + sizeof(lsmash_bs_t *)) );
+    if( !writer )
+        return -1;
+    lsmash_bs_t **buf = (lsmash_bs_t **)(writer + count);
+    int ret = -1;
+    uint32_t i = 0;
+    for( lsmash_entry_t *entry = trak_list->head; entry; entry = entry->next, i++ )
+    {
+        writer[i].trak = (isom_trak_entry_t *)entry->data;
+        writer[i].bs   = buf[i] = lsmash_bs_create( NULL );
+        if( !writer[i].trak || !writer[i].bs )
+            goto fail;
+    }
+#if HAVE_THREAD
+    x264_pthread_t *thread = malloc( count * sizeof(x264_pthread_t) );
+    uint8_t *running = lsmash_malloc_zero( count );
+    if( thread && running )
+        for( i = 1; i < count; i++ )
+            if( writer[i].trak->size >= ISOM_TRAK_THREAD_SIZE )
+                running[i] = !x264_pthread_create( &thread[i], NULL, isom_write_trak_on_memory, &writer[i] );
+    isom_write_trak_on_memory( &writer[0] );
+    for( i = 1; i < count; i++ )
+    {
+        if( running && running[i] )
+            x264_pthread_join( thread[i], NULL );
+        else
+            isom_write_trak_on_memory( &writer[i] );
+    }
+    free( running );
+    free( thread );
+#else
+    for( i = 0; i < count; i++ )
+        isom_write_trak_on_memory( &writer[i] );
+#endif
+    for( i = 0; i < count; i++ )
+        if( writer[i].ret )
+            goto fail;
+    ret = lsmash_bs_write_vector( bs, buf, count );
+fail:
+    for( i = 0; i < count; i++ )
+        lsmash_bs_cleanup( buf[i] );
+    free( writer );
+    return ret;
+}
+
 int isom_write_moov( lsmash_root_t *root )
 {
     if( !root || !root->moov )
@@ -1893,10 +2042,8 @@ int isom_write_moov( lsmash_root_t *root )
     if( isom_write_mvhd( root )
      || isom_write_iods( root ) )
         return -1;
-    if( moov->trak_list )
-        for( lsmash_entry_t *entry = moov->trak_list->head; entry; entry = entry->next )
-            if( isom_write_trak( bs, (isom_trak_entry_t *)entry->data ) )
-                return -1;
+    if( moov->trak_list && isom_write_traks( root, moov->trak_list ) )
+        return -1;
     if( isom_write_udta( bs, moov, NULL )
      || isom_write_ctab( bs, moov )
      || isom_write_meta( bs, moov->meta ) )
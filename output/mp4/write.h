@@ -33,6 +33,8 @@ int isom_write_moof( lsmash_bs_t *bs, isom_moof_entry_t *moof );
 int isom_write_mfra( lsmash_bs_t *bs, isom_mfra_t *mfra );
 int isom_write_mdat_header( lsmash_root_t *root, uint64_t media_size );
 int isom_write_mdat_size( lsmash_root_t *root );
+int isom_write_reserved_space( lsmash_root_t *root );
+int isom_shift_file_tail( lsmash_bs_t *bs, uint64_t start, uint64_t shift, lsmash_adhoc_remux_t *remux );
 int isom_write_ftyp( lsmash_root_t *root );
 int isom_write_moov( lsmash_root_t *root );
 
@@ -36,7 +36,9 @@ typedef struct
     int use_dts_compress;
     int no_sar;
     int no_remux;
+    int moov_reserve;
     int fragments;
+    int chunk_duration;     // in ms, 0 for the muxer's default
     int mux_mov;
     int mux_3gp;
     int mux_3g2;
@@ -46,13 +48,27 @@ typedef struct
     int no_progress;
 } cli_output_opt_t;
 
+#define MAX_AUDIO_TRACKS 8
+
+typedef struct
+{
+    hnd_t filters;      /* filter chain feeding the track, owned by the output once opened */
+    char *encoder;      /* encoder or codec name, "auto" or "copy" */
+    char *parameters;
+    char *language;     /* ISO639-2/T code, NULL to use cli_output_opt_t.language */
+} cli_audio_track_t;
+
 typedef struct
 {
-    int (*open_file)( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, hnd_t audio_filters, char *audio_encoder, char *audio_parameters );
+    /* audio holds audio_tracks tracks, which are interleaved by their dts */
+    int (*open_file)( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, cli_audio_track_t *audio, int audio_tracks );
     int (*set_param)( hnd_t handle, x264_param_t *p_param );
     int (*write_headers)( hnd_t handle, x264_nal_t *p_nal );
     int (*write_frame)( hnd_t handle, uint8_t *p_nal, int i_size, x264_picture_t *p_picture );
     int (*close_file)( hnd_t handle, int64_t largest_pts, int64_t second_largest_pts );
+    /* optional: returns a buffer of at least size bytes for the encoder to write the next frame into,
+     * which write_frame then takes over without copying */
+    uint8_t *(*get_buffer)( hnd_t handle, int size );
 } cli_output_t;
 
 extern const cli_output_t raw_output;
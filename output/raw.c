@@ -26,10 +26,11 @@
 
 #include "output.h"
 
-static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, hnd_t audio_filters, char *audio_enc, char *audio_params )
+static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt, cli_audio_track_t *audio, int audio_tracks )
 {
-    FAIL_IF_ERR( audio_enc && ( strcmp( audio_enc, "none" ) && strcmp( audio_enc, "auto" ) ), "raw",
-                 "audio is not supported on this muxer\n" );
+    for( int i = 0; i < audio_tracks; i++ )
+        FAIL_IF_ERR( strcmp( audio[i].encoder, "none" ) && strcmp( audio[i].encoder, "auto" ), "raw",
+                     "audio is not supported on this muxer\n" );
 
     if( !strcmp( psz_filename, "-" ) )
         *p_handle = stdout;
@@ -0,0 +1,249 @@
+/*****************************************************************************
+ * afcheck.c: check the audio filter kernels against their C versions
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "filters/audio/internal.h"
+#include <math.h>
+
+#define MAX_SAMPLES 1100
+#define MAX_OFFSET  3       // in samples, so the kernels get unaligned slices
+#define CANARY      0xa5
+
+static const char * const fmt_names[] = { "u8", "s16", "s32", "flt", "dbl" };
+static const int fmt_sizes[] = { 1, 2, 4, 4, 8 };
+/* odd lengths check the tails left to the C versions */
+static const int lengths[] = { 1, 3, 4, 7, 8, 15, 17, 33, 1001, MAX_SAMPLES };
+
+static float rand_float( void )
+{
+    /* mostly in range, with values past full scale and the ones lrintf and
+     * the saturation have to agree on */
+    static const float special[] = { NAN, -NAN, INFINITY, -INFINITY, 1.0f, -1.0f, 1.5f, -1.5f,
+                                     1e10f, -1e10f, 0.5f / 32768, 1.5f / 32768, 0.5f / 128, -0.5f / 128 };
+    if( rand() % 8 == 0 )
+        return special[rand() % (sizeof(special)/sizeof(special[0]))];
+    return (rand() / (float)RAND_MAX) * 2.2f - 1.1f;
+}
+
+static void fill( uint8_t *buf, int fmt, int n )
+{
+    for( int i = 0; i < n; i++ )
+    {
+        if( fmt == SMPFMT_FLT )
+            ((float*)buf)[i] = rand_float();
+        else if( fmt == SMPFMT_DBL )
+            ((double*)buf)[i] = rand_float();
+        else
+            for( int j = 0; j < fmt_sizes[fmt]; j++ )
+                buf[i*fmt_sizes[fmt]+j] = rand();
+    }
+}
+
+static int check_convert( x264_af_dsp_t *ref, x264_af_dsp_t *opt )
+{
+    static uint8_t src[(MAX_SAMPLES+MAX_OFFSET)*8];
+    static uint8_t dst_ref[(MAX_SAMPLES+2*MAX_OFFSET)*8], dst_opt[(MAX_SAMPLES+2*MAX_OFFSET)*8];
+    int ret = 0;
+    for( int in = 0; in <= SMPFMT_DBL; in++ )
+        for( int out = 0; out <= SMPFMT_DBL; out++ )
+        {
+            if( !opt->convert[in][out] || opt->convert[in][out] == ref->convert[in][out] )
+                continue;
+            int ok = 1;
+            for( int l = 0; l < sizeof(lengths)/sizeof(lengths[0]) && ok; l++ )
+            {
+                int n = lengths[l];
+                int src_off = rand() % (MAX_OFFSET+1), dst_off = rand() % (MAX_OFFSET+1);
+                fill( src + src_off * fmt_sizes[in], in, n );
+                /* the bytes around the output must stay untouched */
+                memset( dst_ref, CANARY, sizeof(dst_ref) );
+                memset( dst_opt, CANARY, sizeof(dst_opt) );
+                ref->convert[in][out]( dst_ref + dst_off * fmt_sizes[out], src + src_off * fmt_sizes[in], n );
+                opt->convert[in][out]( dst_opt + dst_off * fmt_sizes[out], src + src_off * fmt_sizes[in], n );
+                if( memcmp( dst_ref, dst_opt, sizeof(dst_ref) ) )
+                {
+                    ok = 0;
+                    for( int i = 0; i < n; i++ )
+                        if( memcmp( dst_ref + (dst_off+i) * fmt_sizes[out], dst_opt + (dst_off+i) * fmt_sizes[out], fmt_sizes[out] ) )
+                        {
+                            fprintf( stderr, "convert %s -> %s: mismatch at %d of %d\n", fmt_names[in], fmt_names[out], i, n );
+                            break;
+                        }
+                }
+            }
+            printf( "  convert %-3s -> %-3s: %s\n", fmt_names[in], fmt_names[out], ok ? "ok" : "FAILED" );
+            ret |= !ok;
+        }
+    return ret;
+}
+
+static int check_interleave( x264_af_dsp_t *ref, x264_af_dsp_t *opt )
+{
+    static float planes[X264_AF_DSP_CHANNELS][MAX_SAMPLES+MAX_OFFSET];
+    static float planes_ref[X264_AF_DSP_CHANNELS][MAX_SAMPLES+2*MAX_OFFSET];
+    static float planes_opt[X264_AF_DSP_CHANNELS][MAX_SAMPLES+2*MAX_OFFSET];
+    static float packed[(MAX_SAMPLES+MAX_OFFSET)*X264_AF_DSP_CHANNELS];
+    static float packed_ref[(MAX_SAMPLES+2*MAX_OFFSET)*X264_AF_DSP_CHANNELS];
+    static float packed_opt[(MAX_SAMPLES+2*MAX_OFFSET)*X264_AF_DSP_CHANNELS];
+    int ret = 0;
+    for( int ch = 1; ch <= X264_AF_DSP_CHANNELS; ch++ )
+    {
+        int check_il = opt->interleave[ch] != ref->interleave[ch];
+        int check_dl = opt->deinterleave[ch] != ref->deinterleave[ch];
+        if( !check_il && !check_dl )
+            continue;
+        int ok_il = 1, ok_dl = 1;
+        for( int l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++ )
+        {
+            int n = lengths[l];
+            float *src[X264_AF_DSP_CHANNELS], *dst_ref[X264_AF_DSP_CHANNELS], *dst_opt[X264_AF_DSP_CHANNELS];
+            int off = rand() % (MAX_OFFSET+1);
+            for( int c = 0; c < ch; c++ )
+            {
+                src[c] = planes[c] + rand() % (MAX_OFFSET+1);
+                fill( (uint8_t*)src[c], SMPFMT_FLT, n );
+                dst_ref[c] = planes_ref[c] + off;
+                dst_opt[c] = planes_opt[c] + off;
+            }
+            if( check_il )
+            {
+                memset( packed_ref, CANARY, sizeof(packed_ref) );
+                memset( packed_opt, CANARY, sizeof(packed_opt) );
+                ref->interleave[ch]( packed_ref + off, src, ch, n );
+                opt->interleave[ch]( packed_opt + off, src, ch, n );
+                ok_il &= !memcmp( packed_ref, packed_opt, sizeof(packed_ref) );
+            }
+            if( check_dl )
+            {
+                float *in = packed + rand() % (MAX_OFFSET+1);
+                fill( (uint8_t*)in, SMPFMT_FLT, n * ch );
+                memset( planes_ref, CANARY, sizeof(planes_ref) );
+                memset( planes_opt, CANARY, sizeof(planes_opt) );
+                ref->deinterleave[ch]( dst_ref, in, ch, n );
+                opt->deinterleave[ch]( dst_opt, in, ch, n );
+                ok_dl &= !memcmp( planes_ref, planes_opt, sizeof(planes_ref) );
+            }
+        }
+        if( check_il )
+            printf( "  interleave   %d ch: %s\n", ch, ok_il ? "ok" : "FAILED" );
+        if( check_dl )
+            printf( "  deinterleave %d ch: %s\n", ch, ok_dl ? "ok" : "FAILED" );
+        ret |= !ok_il || !ok_dl;
+    }
+    return ret;
+}
+
+static int check_float( x264_af_dsp_t *ref, x264_af_dsp_t *opt )
+{
+    static float a[MAX_SAMPLES+MAX_OFFSET], b[MAX_SAMPLES+MAX_OFFSET];
+    static float dst_ref[MAX_SAMPLES+2*MAX_OFFSET], dst_opt[MAX_SAMPLES+2*MAX_OFFSET];
+    int ret = 0;
+
+    if( opt->dot != ref->dot )
+    {
+        int ok = 1;
+        for( int l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++ )
+        {
+            int n = lengths[l];
+            float *pa = a + rand() % (MAX_OFFSET+1), *pb = b + rand() % (MAX_OFFSET+1);
+            double magnitude = 0;
+            for( int i = 0; i < n; i++ )
+            {
+                pa[i] = (rand() / (float)RAND_MAX) * 2 - 1;
+                pb[i] = (rand() / (float)RAND_MAX) * 2 - 1;
+                magnitude += fabs( pa[i] * pb[i] );
+            }
+            /* the sum is reordered, so only agrees within the rounding of its terms */
+            float diff = fabsf( ref->dot( pa, pb, n ) - opt->dot( pa, pb, n ) );
+            if( diff > magnitude * 1e-6 )
+            {
+                fprintf( stderr, "dot: off by %g over %d\n", diff, n );
+                ok = 0;
+            }
+        }
+        printf( "  dot: %s\n", ok ? "ok" : "FAILED" );
+        ret |= !ok;
+    }
+
+    for( int mac = 0; mac < 2; mac++ )
+    {
+        void (*f_ref)( float *, const float *, float, int ) = mac ? ref->mac : ref->scale;
+        void (*f_opt)( float *, const float *, float, int ) = mac ? opt->mac : opt->scale;
+        if( f_ref == f_opt )
+            continue;
+        int ok = 1;
+        for( int l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++ )
+        {
+            int n = lengths[l];
+            int off = rand() % (MAX_OFFSET+1);
+            float *src = a + rand() % (MAX_OFFSET+1);
+            float gain = rand_float();
+            fill( (uint8_t*)src, SMPFMT_FLT, n );
+            memset( dst_ref, CANARY, sizeof(dst_ref) );
+            fill( (uint8_t*)(dst_ref + off), SMPFMT_FLT, n );
+            memcpy( dst_opt, dst_ref, sizeof(dst_ref) );
+            f_ref( dst_ref + off, src, gain, n );
+            f_opt( dst_opt + off, src, gain, n );
+            ok &= !memcmp( dst_ref, dst_opt, sizeof(dst_ref) );
+            /* in place, as the gain filter does */
+            memcpy( dst_opt, dst_ref, sizeof(dst_ref) );
+            f_ref( dst_ref + off, dst_ref + off, gain, n );
+            f_opt( dst_opt + off, dst_opt + off, gain, n );
+            ok &= !memcmp( dst_ref, dst_opt, sizeof(dst_ref) );
+        }
+        printf( "  %s: %s\n", mac ? "mac" : "scale", ok ? "ok" : "FAILED" );
+        ret |= !ok;
+    }
+    return ret;
+}
+
+int main( int argc, char **argv )
+{
+    static const struct { const char *name; int flags; } cpus[] =
+    {
+        { "SSE2", X264_CPU_SSE2 },
+    };
+    int cpu = x264_cpu_detect();
+#ifdef __SSE2__
+    /* builds without asm detect nothing, but the compiler already assumes SSE2 */
+    cpu |= X264_CPU_SSE2;
+#endif
+    int ret = 0;
+
+    srand( argc > 1 ? atoi( argv[1] ) : 0 );
+    x264_af_dsp_t ref;
+    x264_af_dsp_init( 0, &ref );
+    for( int i = 0; i < sizeof(cpus)/sizeof(cpus[0]); i++ )
+    {
+        if( (cpu & cpus[i].flags) != cpus[i].flags )
+            continue;
+        x264_af_dsp_t opt;
+        x264_af_dsp_init( cpus[i].flags, &opt );
+        printf( "%s:\n", cpus[i].name );
+        ret |= check_convert( &ref, &opt );
+        ret |= check_interleave( &ref, &opt );
+        ret |= check_float( &ref, &opt );
+    }
+
+    printf( ret ? "afcheck: FAILED\n" : "afcheck: all tests passed\n" );
+    return !!ret;
+}
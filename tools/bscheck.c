@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * bscheck.c: check the bytestream writer of the mp4 muxer
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "output/mp4/lsmash.h"
+#include "output/mp4/utils.h"
+
+/* The moov of a file with several tracks is written with lsmash_bs_write_vector: a single
+ * buffer, empty ones, more than one writev takes, and data still pending on the destination
+ * must all end up in the file in order, with the stream position following them. */
+static int check_write_vector( void )
+{
+    static const int counts[] = { 1, 2, 3, 100 };
+    char name[] = "bscheck.XXXXXX";
+    int fd = mkstemp( name );
+    if( fd < 0 )
+        return -1;
+    close( fd );
+    int ret = 0;
+    for( int c = 0; c < sizeof(counts)/sizeof(counts[0]) && !ret; c++ )
+    {
+        int count = counts[c];
+        lsmash_bs_t *bs = lsmash_bs_create( name );
+        lsmash_bs_t *src[100];
+        uint8_t expect[100*64+8];
+        uint32_t length = 0;
+        if( !bs )
+        {
+            ret = -1;
+            break;
+        }
+        lsmash_bs_put_bytes( bs, 5, "head:" );
+        memcpy( expect, "head:", 5 );
+        length = 5;
+        for( int i = 0; i < count; i++ )
+        {
+            src[i] = lsmash_bs_create( NULL );
+            /* every third one empty, the rest of varying length */
+            for( int j = 0; i % 3 != 1 && j < (i * 7) % 64 + 1; j++ )
+            {
+                uint8_t byte = i + j;
+                lsmash_bs_put_byte( src[i], byte );
+                expect[length++] = byte;
+            }
+        }
+        ret = lsmash_bs_write_vector( bs, src, count );
+        lsmash_bs_put_bytes( bs, 3, "end" );
+        ret |= lsmash_bs_write_data( bs );
+        memcpy( expect + length, "end", 3 );
+        length += 3;
+        ret |= bs->written != length;
+        for( int i = 0; i < count; i++ )
+            lsmash_bs_cleanup( src[i] );
+        lsmash_bs_cleanup( bs );
+
+        uint8_t got[sizeof(expect)+1];
+        FILE *fh = fopen( name, "rb" );
+        if( !fh )
+        {
+            ret = -1;
+            break;
+        }
+        ret |= fread( got, 1, sizeof(got), fh ) != length || memcmp( got, expect, length );
+        fclose( fh );
+        if( ret )
+            fprintf( stderr, "bscheck: vectored write of %d buffers differs\n", count );
+    }
+    remove( name );
+    return ret;
+}
+
+int main( void )
+{
+    int ret = check_write_vector();
+    printf( ret ? "bscheck: FAILED (vectored write)\n" : "bscheck: all tests passed\n" );
+    return !!ret;
+}
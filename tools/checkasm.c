@@ -28,6 +28,10 @@
 #include <ctype.h>
 #include "common/common.h"
 #include "common/cpu.h"
+#include "encoder/analyse.h"
+#include "encoder/macroblock.h"
+#include "encoder/me.h"
+#include "encoder/ratecontrol.h"
 
 // GCC doesn't align stack variables on ARM, so use .bss
 #if ARCH_ARM
@@ -2484,6 +2488,269 @@ static int check_all_flags( void )
     return ret;
 }
 
+/****************************************************************************
+ * encoder stages: composite functions timed on a real encoder context,
+ * reported per macroblock
+ ****************************************************************************/
+#define STAGE_WIDTH  320
+#define STAGE_HEIGHT 176
+#define STAGE_FRAMES 4
+#define STAGE_RUNS   16
+
+typedef struct
+{
+    x264_t *h;
+    x264_frame_t *ref;       /* reconstructed reference, with hpel and integral planes */
+    x264_frame_t *lowres[2]; /* lookahead input, p0 and b */
+    int me_method;
+    ALIGNED_16( pixel fenc[16*FENC_STRIDE] );
+    ALIGNED_16( pixel fdec[16*FDEC_STRIDE] );
+    ALIGNED_16( dctcoef dct[16][16] );
+    ALIGNED_16( dctcoef dct4_src[16][16] );
+    ALIGNED_16( dctcoef dct8_src[4][64] );
+} stage_ctx_t;
+
+/* moving blocks over a noise texture, so that every stage has real work to do */
+static void stage_fill_picture( x264_picture_t *pic, int frame )
+{
+    for( int p = 0; p < 3; p++ )
+    {
+        int w = p ? STAGE_WIDTH>>1 : STAGE_WIDTH;
+        int h = p ? STAGE_HEIGHT>>1 : STAGE_HEIGHT;
+        for( int y = 0; y < h; y++ )
+        {
+            pixel *dst = (pixel*)(pic->img.plane[p] + y * pic->img.i_stride[p]);
+            for( int x = 0; x < w; x++ )
+            {
+                int sx = x + frame * 3 / (p+1);
+                int sy = y + frame * 2 / (p+1);
+                uint32_t noise = ((sx * 73856093u) ^ (sy * 19349663u) ^ (p * 83492791u)) * 2654435761u;
+                int v = ((sx + sy) & 127) + (noise >> 27) + 48;
+                if( ((sx >> 5) ^ (sy >> 5)) & 1 )
+                    v += 48;
+                dst[x] = x264_clip3( v, 0, 255 ) << (BIT_DEPTH-8);
+            }
+        }
+    }
+}
+
+static int stage_init( stage_ctx_t *s, int cpu )
+{
+    x264_param_t param;
+    x264_picture_t pic, pic_out;
+    x264_nal_t *nal;
+    int i_nal;
+
+    memset( s, 0, sizeof(stage_ctx_t) );
+    x264_param_default( &param );
+    param.cpu = cpu;
+    param.i_width = STAGE_WIDTH;
+    param.i_height = STAGE_HEIGHT;
+    param.i_threads = 1;
+    param.i_lookahead_threads = 1;
+    param.i_sync_lookahead = 0;
+    param.i_bframe = 0;
+    param.i_log_level = X264_LOG_NONE;
+    /* esa and tesa need the integral planes, which are only built for them */
+    param.analyse.i_me_method = X264_ME_TESA;
+    if( x264_picture_alloc( &pic, X264_CSP_I420 | (BIT_DEPTH > 8 ? X264_CSP_HIGH_DEPTH : 0), STAGE_WIDTH, STAGE_HEIGHT ) < 0 )
+        return -1;
+    x264_t *h = s->h = x264_encoder_open( &param );
+    if( !h )
+        goto fail;
+    for( int i = 0; i < STAGE_FRAMES; i++ )
+    {
+        stage_fill_picture( &pic, i );
+        pic.i_pts = i;
+        if( x264_encoder_encode( h, &nal, &i_nal, &pic, &pic_out ) < 0 )
+            goto fail;
+    }
+    while( x264_encoder_delayed_frames( h ) )
+        if( x264_encoder_encode( h, &nal, &i_nal, NULL, &pic_out ) < 0 )
+            goto fail;
+    /* the last frame is a P-frame whose reconstruction stays in h->fdec */
+    if( h->i_ref[0] < 1 )
+        goto fail;
+    s->ref = h->fref[0][0];
+
+    for( int i = 0; i < 2; i++ )
+    {
+        x264_frame_t *frame = s->lowres[i] = x264_frame_pop_unused( h, 0 );
+        if( !frame )
+            goto fail;
+        stage_fill_picture( &pic, i );
+        if( x264_frame_copy_picture( h, frame, &pic ) < 0 )
+            goto fail;
+        x264_frame_expand_border_mod16( h, frame );
+        x264_stack_align( x264_adaptive_quant_frame, h, frame, NULL );
+        x264_frame_init_lowres( h, frame );
+        frame->f_duration = (double)param.i_fps_den / param.i_fps_num;
+    }
+
+    /* residual of a co-located macroblock, as input to trellis */
+    int mb_x = h->mb.i_mb_width/2, mb_y = h->mb.i_mb_height/2;
+    h->mc.copy[PIXEL_16x16]( s->fenc, FENC_STRIDE, h->fdec->plane[0] + 16*(mb_x + mb_y*h->fdec->i_stride[0]), h->fdec->i_stride[0], 16 );
+    h->mc.copy[PIXEL_16x16]( s->fdec, FDEC_STRIDE, s->ref->plane[0] + 16*(mb_x + mb_y*s->ref->i_stride[0]) + 1, s->ref->i_stride[0], 16 );
+    h->dctf.sub16x16_dct( s->dct4_src, s->fenc, s->fdec );
+    h->dctf.sub16x16_dct8( s->dct8_src, s->fenc, s->fdec );
+    x264_picture_clean( &pic );
+    return 0;
+fail:
+    x264_picture_clean( &pic );
+    return -1;
+}
+
+static void stage_close( stage_ctx_t *s )
+{
+    if( !s->h )
+        return;
+    for( int i = 0; i < 2; i++ )
+        if( s->lowres[i] )
+            x264_frame_push_unused( s->h, s->lowres[i] );
+    x264_encoder_close( s->h );
+}
+
+/* same search window as x264_mb_analyse_init */
+static void stage_mv_range( x264_t *h )
+{
+    int i_fmv_range = 4 * h->param.analyse.i_mv_range;
+    h->mb.mv_min[0] = 4*( -16*h->mb.i_mb_x - 24 );
+    h->mb.mv_max[0] = 4*( 16*( h->mb.i_mb_width - h->mb.i_mb_x - 1 ) + 24 );
+    h->mb.mv_min[1] = 4*( -16*h->mb.i_mb_y - 24 );
+    h->mb.mv_max[1] = 4*( 16*( h->mb.i_mb_height - h->mb.i_mb_y - 1 ) + 24 );
+    for( int i = 0; i < 2; i++ )
+    {
+        h->mb.mv_min_spel[i] = x264_clip3( h->mb.mv_min[i], -i_fmv_range, i_fmv_range-1 );
+        h->mb.mv_max_spel[i] = x264_clip3( h->mb.mv_max[i], -i_fmv_range, i_fmv_range-1 );
+        h->mb.mv_min_fpel[i] = (h->mb.mv_min_spel[i]>>2) + 6;
+        h->mb.mv_max_fpel[i] = (h->mb.mv_max_spel[i]>>2) - 6;
+    }
+}
+
+/* a 16x16 search of every macroblock of the last frame in its reference */
+static void stage_me( stage_ctx_t *s )
+{
+    x264_t *h = s->h;
+    x264_frame_t *ref = s->ref;
+    x264_me_t m;
+    h->mb.i_me_method = s->me_method;
+    h->mb.b_chroma_me = 0;
+    for( h->mb.i_mb_y = 0; h->mb.i_mb_y < h->mb.i_mb_height; h->mb.i_mb_y++ )
+        for( h->mb.i_mb_x = 0; h->mb.i_mb_x < h->mb.i_mb_width; h->mb.i_mb_x++ )
+        {
+            int offset = 16*(h->mb.i_mb_x + h->mb.i_mb_y*ref->i_stride[0]);
+            stage_mv_range( h );
+            h->mc.copy[PIXEL_16x16]( s->fenc, FENC_STRIDE, h->fdec->plane[0] + offset, ref->i_stride[0], 16 );
+            m.i_pixel = PIXEL_16x16;
+            m.p_cost_mv = h->cost_mv[h->mb.i_qp];
+            m.i_ref_cost = 0;
+            m.i_ref = 0;
+            m.weight = x264_weight_none;
+            for( int i = 0; i < 3; i++ )
+            {
+                m.i_stride[i] = ref->i_stride[i];
+                m.p_fenc[i] = s->fenc;
+            }
+            for( int i = 0; i < 4; i++ )
+                m.p_fref[i] = ref->filtered[0][i] + offset;
+            m.p_fref_w = m.p_fref[0];
+            m.integral = ref->integral + offset;
+            M32( m.mvp ) = 0;
+            x264_me_search( h, &m, NULL, 0 );
+        }
+}
+
+static void stage_trellis_4x4( stage_ctx_t *s )
+{
+    memcpy( s->dct, s->dct4_src, sizeof(s->dct) );
+    for( int i = 0; i < 16; i++ )
+        x264_quant_4x4_trellis( s->h, s->dct[i], CQM_4PY, s->h->mb.i_qp, DCT_LUMA_4x4, 0, 0, i );
+}
+
+static void stage_trellis_8x8( stage_ctx_t *s )
+{
+    memcpy( s->dct, s->dct8_src, sizeof(s->dct) );
+    for( int i = 0; i < 4; i++ )
+        x264_quant_8x8_trellis( s->h, s->dct[4*i], CQM_8PY, s->h->mb.i_qp, DCT_LUMA_8x8, 0, 0, i );
+}
+
+static void stage_frame_cost( stage_ctx_t *s )
+{
+    x264_slicetype_bench_frame_cost( s->h, s->lowres, 0, 1, 1 );
+}
+
+static void stage_mbtree_propagate( stage_ctx_t *s )
+{
+    x264_slicetype_bench_propagate( s->h, s->lowres, 0, 1, 1 );
+}
+
+static void stage_deblock( stage_ctx_t *s )
+{
+    for( int mb_y = 0; mb_y < s->h->mb.i_mb_height; mb_y++ )
+        x264_frame_deblock_row( s->h, mb_y );
+}
+
+/* like call_bench, but each call covers mbs macroblocks and the result is
+ * stored per macroblock */
+static void bench_stage( const char *name, int cpu, void (*func)( stage_ctx_t* ), stage_ctx_t *s, int mbs )
+{
+    if( strncmp( name, bench_pattern, bench_pattern_len ) )
+        return;
+    uint64_t tsum = 0;
+    int tcount = 0;
+    func( s );
+    for( int ti = 0; ti < STAGE_RUNS; ti++ )
+    {
+        uint32_t t = read_time();
+        func( s );
+        t = read_time() - t;
+        if( (uint64_t)t*tcount <= tsum*4 && ti > 0 )
+        {
+            tsum += t;
+            tcount++;
+        }
+    }
+    bench_t *b = get_bench( name, cpu );
+    b->cycles += tsum*4/mbs;
+    b->den += tcount;
+    b->pointer = s->h;
+}
+
+static int bench_stages( void )
+{
+    static const char * const me_names[] = { "dia", "hex", "umh", "esa", "tesa" };
+    int cpus[2] = { 0, x264_cpu_detect() };
+    int ncpus = cpus[1] ? 2 : 1;
+    stage_ctx_t *ctx = x264_malloc( ncpus * sizeof(stage_ctx_t) );
+    if( !ctx )
+        return -1;
+    int ret = 0;
+    for( int i = 0; i < ncpus; i++ )
+        ret |= stage_init( &ctx[i], cpus[i] );
+    for( int i = 0; i < ncpus && !ret; i++ )
+    {
+        stage_ctx_t *s = &ctx[i];
+        int mbs = s->h->mb.i_mb_count;
+        for( s->me_method = X264_ME_DIA; s->me_method <= X264_ME_TESA; s->me_method++ )
+        {
+            set_func_name( "stage_me_search_%s", me_names[s->me_method] );
+            bench_stage( func_name, cpus[i], stage_me, s, mbs );
+        }
+        bench_stage( "stage_quant_trellis_4x4", cpus[i], stage_trellis_4x4, s, 1 );
+        bench_stage( "stage_quant_trellis_8x8", cpus[i], stage_trellis_8x8, s, 1 );
+        bench_stage( "stage_slicetype_frame_cost", cpus[i], stage_frame_cost, s, mbs );
+        bench_stage( "stage_mbtree_propagate", cpus[i], stage_mbtree_propagate, s, mbs );
+        /* last, since it modifies the frame the searches start from */
+        bench_stage( "stage_frame_deblock_row", cpus[i], stage_deblock, s, mbs );
+    }
+    for( int i = 0; i < ncpus; i++ )
+        stage_close( &ctx[i] );
+    x264_free( ctx );
+    if( ret )
+        fprintf( stderr, "x264: stage benchmark setup failed\n" );
+    return ret;
+}
+
 int main(int argc, char *argv[])
 {
     int ret = 0;
@@ -2544,6 +2811,9 @@ int main(int argc, char *argv[])
     else
         ret = check_all_flags();
 
+    if( do_bench && !ret )
+        ret = bench_stages();
+
     if( ret )
     {
         fprintf( stderr, "x264: at least one test has failed. Go and fix that Right Now!\n" );
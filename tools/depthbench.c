@@ -0,0 +1,228 @@
+/*****************************************************************************
+ * depthbench.c: check and benchmark the depth video filter
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+/* The filter is included directly to get at its static functions. */
+#include "filters/video/depth.c"
+
+void x264_cli_log( const char *name, int i_level, const char *fmt, ... )
+{
+    if( i_level > X264_LOG_WARNING )
+        return;
+    va_list arg;
+    va_start( arg, fmt );
+    fprintf( stderr, "%s: ", name );
+    vfprintf( stderr, fmt, arg );
+    va_end( arg );
+}
+
+/* straightforward implementations the filter is checked against */
+static void ref_dither_plane( pixel *dst, int dst_stride, uint16_t *src, int src_stride,
+                              int width, int height, int pitch, int16_t *errors )
+{
+    const int lshift = 16-BIT_DEPTH;
+    const int rshift = 16-BIT_DEPTH+2;
+    const int half = 1 << (16-BIT_DEPTH+1);
+    const int pixel_max = (1 << BIT_DEPTH)-1;
+    memset( errors, 0, (width+1) * sizeof(int16_t) );
+    for( int y = 0; y < height; y++, src += src_stride, dst += dst_stride )
+    {
+        int err = 0;
+        for( int x = 0; x < width; x++ )
+        {
+            err = err*2 + errors[x] + errors[x+1];
+            dst[x*pitch] = x264_clip3( ((src[x*pitch]<<2)+err+half) >> rshift, 0, pixel_max );
+            errors[x] = err = src[x*pitch] - (dst[x*pitch] << lshift);
+        }
+    }
+}
+
+static void ref_dither_image( cli_image_t *out, cli_image_t *img, int16_t *errors )
+{
+    int csp_mask = img->csp & X264_CSP_MASK;
+    for( int i = 0; i < img->planes; i++ )
+    {
+        int num_interleaved = csp_num_interleaved( img->csp, i );
+        int height = x264_cli_csps[csp_mask].height[i] * img->height;
+        int width = x264_cli_csps[csp_mask].width[i] * img->width / num_interleaved;
+        for( int off = 0; off < num_interleaved; off++ )
+            ref_dither_plane( ((pixel*)out->plane[i])+off, out->stride[i]/sizeof(pixel),
+                              ((uint16_t*)img->plane[i])+off, img->stride[i]/2, width, height, num_interleaved, errors );
+    }
+}
+
+static void ref_scale_image( cli_image_t *output, cli_image_t *img )
+{
+    int csp_mask = img->csp & X264_CSP_MASK;
+    for( int i = 0; i < img->planes; i++ )
+    {
+        uint8_t *src = img->plane[i];
+        uint16_t *dst = (uint16_t*)output->plane[i];
+        int height = x264_cli_csps[csp_mask].height[i] * img->height;
+        int width = x264_cli_csps[csp_mask].width[i] * img->width;
+        for( int j = 0; j < height; j++, src += img->stride[i], dst += output->stride[i]/2 )
+            for( int k = 0; k < width; k++ )
+                dst[k] = src[k] << (BIT_DEPTH - 8);
+    }
+}
+
+static int  dummy_get_frame( hnd_t handle, cli_pic_t *output, int frame ) { return -1; }
+static int  dummy_release_frame( hnd_t handle, cli_pic_t *pic, int frame ) { return 0; }
+static void dummy_free( hnd_t handle ) {}
+static cli_vid_filter_t dummy_filter = { "dummy", NULL, NULL, dummy_get_frame, dummy_release_frame, dummy_free, NULL };
+
+static void fill_random( cli_pic_t *pic, int csp, int width, int height )
+{
+    for( int i = 0; i < pic->img.planes; i++ )
+    {
+        uint64_t size = x264_cli_pic_plane_size( csp, width, height, i );
+        for( uint64_t j = 0; j < size; j++ )
+            pic->img.plane[i][j] = rand();
+    }
+}
+
+static int compare_images( cli_image_t *a, cli_image_t *b )
+{
+    int csp_mask = a->csp & X264_CSP_MASK;
+    int depth_factor = x264_cli_csp_depth_factor( a->csp );
+    for( int i = 0; i < a->planes; i++ )
+    {
+        int height = x264_cli_csps[csp_mask].height[i] * a->height;
+        int width = (int)(x264_cli_csps[csp_mask].width[i] * a->width) * depth_factor;
+        for( int y = 0; y < height; y++ )
+            if( memcmp( a->plane[i] + y * a->stride[i], b->plane[i] + y * b->stride[i], width ) )
+                return -1;
+    }
+    return 0;
+}
+
+/* returns 0 on success, -1 on mismatch */
+static int test_dither( const char *name, int csp, int width, int height, int threads, int iterations )
+{
+    /* the filter dithers 16-bit input down to the depth of the build */
+    int in_csp = csp | X264_CSP_HIGH_DEPTH;
+    video_info_t info = { .csp = in_csp, .width = width, .height = height };
+    x264_param_t param;
+    x264_param_default( &param );
+    param.i_csp = BIT_DEPTH > 8 ? csp | X264_CSP_HIGH_DEPTH : csp;
+
+    cli_vid_filter_t filter = dummy_filter;
+    hnd_t handle = NULL;
+    char opts[64];
+    sprintf( opts, "bit_depth=%d,threads=%d", BIT_DEPTH, threads );
+    if( init( &handle, &filter, &info, &param, opts ) || !handle )
+        return -1;
+    depth_hnd_t *h = handle;
+
+    cli_pic_t in, ref, out;
+    if( x264_cli_pic_alloc( &in, in_csp, width, height ) ||
+        x264_cli_pic_alloc( &ref, h->dst_csp, width, height ) ||
+        x264_cli_pic_pool_get( h->pic_pool, &out ) )
+        return -1;
+    fill_random( &in, in_csp, width, height );
+
+    int64_t ref_time = x264_mdate();
+    for( int i = 0; i < iterations; i++ )
+        ref_dither_image( &ref.img, &in.img, h->error_buf );
+    ref_time = x264_mdate() - ref_time;
+
+    int64_t time = x264_mdate();
+    for( int i = 0; i < iterations; i++ )
+        dither_image( h, &out.img, &in.img );
+    time = x264_mdate() - time;
+
+    int ret = compare_images( &out.img, &ref.img );
+    printf( "dither %-5s %4dx%-4d threads %d: %s  ref %7.2f ms  new %7.2f ms  (%.2fx)\n",
+            name, width, height, h->plane.threads, ret ? "FAILED" : "ok",
+            ref_time / 1000. / iterations, time / 1000. / iterations, (double)ref_time / X264_MAX( time, 1 ) );
+
+    x264_cli_pic_clean( &in );
+    x264_cli_pic_clean( &ref );
+    x264_cli_pic_unref( &out );
+    free_filter( handle );
+    return ret;
+}
+
+/* The filter only scales 8-bit input up in high bit depth builds, but scale_image is built
+ * for any depth, so it is called directly to be checked in every build.  Images narrower
+ * than their strides take the row by row path instead of whole planes. */
+static int test_scale( const char *name, int csp, int width, int height, int crop, int iterations )
+{
+    cli_pic_t in, ref, out;
+    if( x264_cli_pic_alloc( &in, csp, width, height ) ||
+        x264_cli_pic_alloc( &ref, csp | X264_CSP_HIGH_DEPTH, width, height ) ||
+        x264_cli_pic_alloc( &out, csp | X264_CSP_HIGH_DEPTH, width, height ) )
+        return -1;
+    fill_random( &in, csp, width, height );
+    in.img.width = ref.img.width = out.img.width = width - crop;
+
+    int64_t ref_time = x264_mdate();
+    for( int i = 0; i < iterations; i++ )
+        ref_scale_image( &ref.img, &in.img );
+    ref_time = x264_mdate() - ref_time;
+
+    int64_t time = x264_mdate();
+    for( int i = 0; i < iterations; i++ )
+        scale_image( &out.img, &in.img );
+    time = x264_mdate() - time;
+
+    int ret = compare_images( &out.img, &ref.img );
+    printf( "scale  %-5s %4dx%-4d stride %4d: %s  ref %7.2f ms  new %7.2f ms  (%.2fx)\n",
+            name, width - crop, height, width, ret ? "FAILED" : "ok",
+            ref_time / 1000. / iterations, time / 1000. / iterations, (double)ref_time / X264_MAX( time, 1 ) );
+
+    x264_cli_pic_clean( &in );
+    x264_cli_pic_clean( &ref );
+    x264_cli_pic_clean( &out );
+    return ret;
+}
+
+int main( int argc, char **argv )
+{
+    static const struct { const char *name; int csp; } csps[] =
+    {
+        { "i420", X264_CSP_I420 },
+        { "nv12", X264_CSP_NV12 },
+        { "i444", X264_CSP_I444 },
+        { "bgr",  X264_CSP_BGR },
+        { "bgra", X264_CSP_BGRA },
+    };
+    static const int threads[] = { 1, 2, 4 };
+    int iterations = argc > 1 ? atoi( argv[1] ) : 10;
+    int ret = 0;
+
+    srand( 0 );
+    /* odd sizes check the edges of the wavefront chunks and bands */
+    for( int i = 0; i < sizeof(csps)/sizeof(csps[0]); i++ )
+        for( int j = 0; j < sizeof(threads)/sizeof(threads[0]); j++ )
+            ret |= test_dither( csps[i].name, csps[i].csp, 2*DITHER_CHUNK+2, 4*DITHER_BAND+2, threads[j], 1 );
+    for( int j = 0; j < sizeof(threads)/sizeof(threads[0]); j++ )
+        ret |= test_dither( "i420", X264_CSP_I420, 1920, 1080, threads[j], iterations );
+    ret |= test_dither( "i420", X264_CSP_I420, 3840, 2160, 4, X264_MAX( iterations/4, 1 ) );
+
+    for( int i = 0; i < sizeof(csps)/sizeof(csps[0]); i++ )
+        ret |= test_scale( csps[i].name, csps[i].csp, 2*DITHER_CHUNK+2, 66, 2*(i&1)+1, 1 );
+    ret |= test_scale( "i420", X264_CSP_I420, 1920, 1080, 0, iterations );
+
+    printf( ret ? "depth: FAILED\n" : "depth: all tests passed\n" );
+    return !!ret;
+}
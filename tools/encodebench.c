@@ -0,0 +1,377 @@
+/*****************************************************************************
+ * encodebench.c: full encode benchmark over a matrix of presets and sizes
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/* Every configuration encodes the same synthetic clip, so no sample files are
+ * needed and results are comparable between builds.  Each one runs in its own
+ * process to measure its peak memory use. */
+
+static const char * const bench_presets[] = { "ultrafast", "veryfast", "medium", 0 };
+static const int bench_threads[] = { 1, 4 };
+static const struct { int width, height; } bench_sizes[] = { { 640, 360 }, { 1280, 720 } };
+
+#define STAGE_COUNT (X264_TRACE_ENCAPSULATE+1)
+#define TRACE_SLOTS (X264_THREAD_MAX+3)
+#define TRACE_DEPTH 16
+/* stage times below this are too noisy to flag as regressions */
+#define STAGE_MIN_MS 5.0
+
+typedef struct
+{
+    double  fps;
+    int64_t bytes;
+    int64_t rss;        /* peak resident set size in KiB, 0 if unknown */
+    double  stage_ms[STAGE_COUNT];  /* exclusive of the stages nested in them */
+} bench_result_t;
+
+typedef struct
+{
+    int     stage;
+    int64_t begin;
+    int64_t nested;     /* time spent in the stages nested in this one */
+} trace_level_t;
+
+typedef struct
+{
+    /* indexed by i_thread+2, each slot is only touched by the thread owning it */
+    trace_level_t stack[TRACE_SLOTS][TRACE_DEPTH];
+    int depth[TRACE_SLOTS];
+    int64_t self[TRACE_SLOTS][STAGE_COUNT];
+} bench_trace_t;
+
+/* Events of a thread are nested, e.g. rows and filtering within a frame, so each
+ * stage is charged only the time not spent in the stages it contains. */
+static void bench_trace( void *p_private, const x264_trace_event_t *event )
+{
+    bench_trace_t *trace = p_private;
+    int slot = event->i_thread + 2;
+    if( slot < 0 || slot >= TRACE_SLOTS || event->i_stage < 0 || event->i_stage >= STAGE_COUNT )
+        return;
+    int *depth = &trace->depth[slot];
+    if( !event->b_end )
+    {
+        if( *depth < TRACE_DEPTH )
+            trace->stack[slot][*depth] = (trace_level_t){ event->i_stage, event->i_time, 0 };
+        ++*depth;
+        return;
+    }
+    if( !*depth )
+        return;
+    if( --*depth >= TRACE_DEPTH )
+        return;
+    trace_level_t *level = &trace->stack[slot][*depth];
+    int64_t elapsed = event->i_time - level->begin;
+    trace->self[slot][level->stage] += elapsed - level->nested;
+    if( *depth )
+        trace->stack[slot][*depth-1].nested += elapsed;
+}
+
+/* moving gradients and blocks over a fixed noise texture */
+static void fill_picture( x264_picture_t *pic, int width, int height, int frame )
+{
+    const int shift = BIT_DEPTH-8;
+    for( int p = 0; p < 3; p++ )
+    {
+        int w = p ? width>>1 : width;
+        int h = p ? height>>1 : height;
+        for( int y = 0; y < h; y++ )
+        {
+            pixel *dst = (pixel*)(pic->img.plane[p] + y * pic->img.i_stride[p]);
+            for( int x = 0; x < w; x++ )
+            {
+                uint32_t noise = ((x * 73856093u) ^ (y * 19349663u) ^ (p * 83492791u)) * 2654435761u;
+                int v;
+                if( p )
+                    v = 128 + ((x + y + frame * p) & 63) - 32;
+                else
+                {
+                    int bx = (x + frame * 3) & 127;
+                    int by = (y + frame * 2) & 127;
+                    v = ((x + y + frame * 4) & 255) >> 1;
+                    if( bx < 48 && by < 48 )
+                        v += 64;
+                    v += (noise >> 27) - 16;
+                }
+                dst[x] = x264_clip3( v, 0, 255 ) << shift;
+            }
+        }
+    }
+}
+
+static int run_config( const char *preset, int threads, int width, int height, int frames, bench_result_t *res )
+{
+    x264_param_t param;
+    x264_picture_t pic, pic_out;
+    x264_nal_t *nal;
+    int i_nal;
+    static bench_trace_t trace;
+
+    memset( res, 0, sizeof(bench_result_t) );
+    memset( &trace, 0, sizeof(trace) );
+    if( x264_param_default_preset( &param, preset, NULL ) < 0 )
+        return -1;
+    param.i_width = width;
+    param.i_height = height;
+    param.i_threads = threads;
+    param.i_fps_num = 25;
+    param.i_fps_den = 1;
+    param.i_log_level = X264_LOG_NONE;
+    param.pf_trace = bench_trace;
+    param.p_trace_private = &trace;
+    if( x264_picture_alloc( &pic, X264_CSP_I420 | (BIT_DEPTH > 8 ? X264_CSP_HIGH_DEPTH : 0), width, height ) < 0 )
+        return -1;
+
+    int64_t time = x264_mdate();
+    x264_t *h = x264_encoder_open( &param );
+    if( !h )
+    {
+        x264_picture_clean( &pic );
+        return -1;
+    }
+    int ret = 0;
+    for( int i = 0; i < frames && !ret; i++ )
+    {
+        fill_picture( &pic, width, height, i );
+        pic.i_pts = i;
+        int size = x264_encoder_encode( h, &nal, &i_nal, &pic, &pic_out );
+        if( size < 0 )
+            ret = -1;
+        res->bytes += X264_MAX( size, 0 );
+    }
+    while( !ret && x264_encoder_delayed_frames( h ) )
+    {
+        int size = x264_encoder_encode( h, &nal, &i_nal, NULL, &pic_out );
+        if( size < 0 )
+            ret = -1;
+        res->bytes += X264_MAX( size, 0 );
+    }
+    x264_encoder_close( h );
+    time = x264_mdate() - time;
+    x264_picture_clean( &pic );
+
+    res->fps = frames * 1000000. / X264_MAX( time, 1 );
+    for( int i = 0; i < TRACE_SLOTS; i++ )
+        for( int j = 0; j < STAGE_COUNT; j++ )
+            res->stage_ms[j] += trace.self[i][j] / 1000.;
+    return ret;
+}
+
+static int run_config_process( const char *preset, int threads, int width, int height, int frames, bench_result_t *res )
+{
+#ifndef _WIN32
+    int fd[2];
+    if( pipe( fd ) )
+        return -1;
+    fflush( stdout );
+    pid_t pid = fork();
+    if( pid < 0 )
+        return -1;
+    if( !pid )
+    {
+        close( fd[0] );
+        int ret = run_config( preset, threads, width, height, frames, res );
+        if( !ret && write( fd[1], res, sizeof(bench_result_t) ) != sizeof(bench_result_t) )
+            ret = -1;
+        _exit( !!ret );
+    }
+    close( fd[1] );
+    int ret = read( fd[0], res, sizeof(bench_result_t) ) == sizeof(bench_result_t) ? 0 : -1;
+    close( fd[0] );
+    int status;
+    struct rusage usage;
+    if( wait4( pid, &status, 0, &usage ) != pid || !WIFEXITED( status ) || WEXITSTATUS( status ) )
+        return -1;
+    res->rss = usage.ru_maxrss;
+    return ret;
+#else
+    return run_config( preset, threads, width, height, frames, res );
+#endif
+}
+
+typedef struct
+{
+    char preset[16];
+    int threads, width, height;
+    double fps;
+    int64_t rss, bytes;
+    double stage_ms[STAGE_COUNT];
+} baseline_entry_t;
+
+/* The workload is stored along with the results: "frames <n> stages <n>", then one
+ * line per configuration.  Returns the number of entries, -1 if the file can't be read. */
+static int read_baseline( const char *name, baseline_entry_t *entries, int max_entries, int *frames, int *stages )
+{
+    FILE *fh = fopen( name, "r" );
+    if( !fh )
+        return -1;
+    int count = 0;
+    char line[512];
+    *frames = *stages = 0;
+    while( count < max_entries && fgets( line, sizeof(line), fh ) )
+    {
+        baseline_entry_t *e = &entries[count];
+        int pos;
+        if( line[0] == '#' || sscanf( line, "frames %d stages %d", frames, stages ) == 2 )
+            continue;
+        if( sscanf( line, "%15s %d %dx%d %lf %"SCNd64" %"SCNd64"%n", e->preset, &e->threads, &e->width, &e->height,
+                    &e->fps, &e->rss, &e->bytes, &pos ) != 7 )
+            continue;
+        int j = 0;
+        for( char *p = line + pos; j < STAGE_COUNT; j++ )
+        {
+            int len;
+            if( sscanf( p, "%lf%n", &e->stage_ms[j], &len ) != 1 )
+                break;
+            p += len;
+        }
+        if( j == STAGE_COUNT )
+            count++;
+    }
+    fclose( fh );
+    return count;
+}
+
+int main( int argc, char **argv )
+{
+    const char *baseline = NULL;
+    int update = 0, frames = 30;
+    double tolerance = 10;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( !strcmp( argv[i], "--baseline" ) && i+1 < argc )
+            baseline = argv[++i];
+        else if( !strcmp( argv[i], "--update" ) )
+            update = 1;
+        else if( !strcmp( argv[i], "--tolerance" ) && i+1 < argc )
+            tolerance = atof( argv[++i] );
+        else if( !strcmp( argv[i], "--frames" ) && i+1 < argc )
+            frames = atoi( argv[++i] );
+        else
+        {
+            fprintf( stderr, "usage: encodebench [--baseline <file> [--update]] [--tolerance <percent>] [--frames <integer>]\n"
+                             "  with a baseline file, results are compared against it, which is\n"
+                             "  created if missing and rewritten with --update\n" );
+            return 1;
+        }
+    }
+
+    frames = X264_MAX( frames, 1 );
+
+    baseline_entry_t entries[64];
+    int base_frames, base_stages;
+    int entry_count = baseline && !update ? read_baseline( baseline, entries, 64, &base_frames, &base_stages ) : -1;
+    if( entry_count >= 0 && (base_frames != frames || base_stages != STAGE_COUNT) )
+    {
+        fprintf( stderr, "encodebench: `%s' was measured over %d frames and %d stages, not %d and %d; "
+                 "rerun with --update to replace it\n", baseline, base_frames, base_stages, frames, STAGE_COUNT );
+        return 1;
+    }
+    FILE *out = NULL;
+    if( baseline && entry_count < 0 )
+    {
+        out = fopen( baseline, "w" );
+        if( !out )
+        {
+            fprintf( stderr, "encodebench: can't open `%s'\n", baseline );
+            return 1;
+        }
+        fprintf( out, "# preset threads size fps peak_rss_kib bytes, then the exclusive ms of" );
+        for( int j = 0; j < STAGE_COUNT; j++ )
+            fprintf( out, " %s", x264_trace_stage_names[j] );
+        fprintf( out, "\nframes %d stages %d\n", frames, STAGE_COUNT );
+    }
+
+    printf( "%-9s %-7s %-9s %8s %9s", "preset", "threads", "size", "fps", "rss KiB" );
+    for( int j = 0; j < STAGE_COUNT; j++ )
+        printf( " %11s", x264_trace_stage_names[j] );
+    printf( "\n(stage times exclude the stages nested in them, summed over threads)\n" );
+
+    int ret = 0;
+    for( int p = 0; bench_presets[p]; p++ )
+        for( int t = 0; t < sizeof(bench_threads)/sizeof(*bench_threads); t++ )
+            for( int s = 0; s < sizeof(bench_sizes)/sizeof(*bench_sizes); s++ )
+            {
+                int width = bench_sizes[s].width, height = bench_sizes[s].height;
+                bench_result_t res;
+                if( run_config_process( bench_presets[p], bench_threads[t], width, height, frames, &res ) )
+                {
+                    fprintf( stderr, "encodebench: %s threads %d %dx%d failed\n", bench_presets[p], bench_threads[t], width, height );
+                    ret = 1;
+                    continue;
+                }
+                printf( "%-9s %-7d %4dx%-4d %8.2f %9"PRId64, bench_presets[p], bench_threads[t], width, height, res.fps, res.rss );
+                for( int j = 0; j < STAGE_COUNT; j++ )
+                    printf( " %8.1f ms", res.stage_ms[j] );
+                printf( "\n" );
+
+                if( out )
+                {
+                    fprintf( out, "%s %d %dx%d %.2f %"PRId64" %"PRId64, bench_presets[p], bench_threads[t],
+                             width, height, res.fps, res.rss, res.bytes );
+                    for( int j = 0; j < STAGE_COUNT; j++ )
+                        fprintf( out, " %.1f", res.stage_ms[j] );
+                    fprintf( out, "\n" );
+                }
+                for( int i = 0; i < entry_count; i++ )
+                {
+                    baseline_entry_t *e = &entries[i];
+                    if( strcmp( e->preset, bench_presets[p] ) || e->threads != bench_threads[t] || e->width != width || e->height != height )
+                        continue;
+                    if( res.fps < e->fps * (1 - tolerance / 100) )
+                    {
+                        printf( "  regression: %.2f fps, baseline %.2f fps (%+.1f%%)\n", res.fps, e->fps, (res.fps / e->fps - 1) * 100 );
+                        ret = 1;
+                    }
+                    if( res.rss && e->rss && res.rss > e->rss * (1 + tolerance / 100) )
+                    {
+                        printf( "  regression: peak rss %"PRId64" KiB, baseline %"PRId64" KiB (%+.1f%%)\n",
+                                res.rss, e->rss, ((double)res.rss / e->rss - 1) * 100 );
+                        ret = 1;
+                    }
+                    for( int j = 0; j < STAGE_COUNT; j++ )
+                        if( res.stage_ms[j] > STAGE_MIN_MS && res.stage_ms[j] > e->stage_ms[j] * (1 + tolerance / 100) )
+                        {
+                            printf( "  regression: %s %.1f ms, baseline %.1f ms\n", x264_trace_stage_names[j], res.stage_ms[j], e->stage_ms[j] );
+                            ret = 1;
+                        }
+                    if( res.bytes != e->bytes )
+                        printf( "  note: output is %"PRId64" bytes, baseline %"PRId64" bytes\n", res.bytes, e->bytes );
+                }
+            }
+
+    if( out )
+    {
+        fclose( out );
+        printf( "bench: baseline written to %s\n", baseline );
+    }
+    else if( entry_count >= 0 )
+        printf( ret ? "bench: FAILED (regressions beyond %.0f%%)\n" : "bench: no regressions beyond %.0f%%\n", tolerance );
+    return ret;
+}
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * importbench.c: check and benchmark the H.264 importer
+ *****************************************************************************
+ * Copyright (C) 2013 x264 project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ * This program is also available under a commercial proprietary license.
+ * For more information, contact us at licensing@x264.com.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "output/mp4/lsmash.h"
+#include "output/mp4/importer.h"
+#include "output/mp4/utils.h"
+
+/* The importer maps regular files given by name, and reads stdin through stdio:
+ * the same file is imported both ways and the resulting samples must match. */
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t bytes;
+    uint64_t hash;
+    int64_t  time;
+} import_result_t;
+
+static uint64_t hash_bytes( uint64_t hash, const uint8_t *data, uint64_t length )
+{
+    /* FNV-1a */
+    for( uint64_t i = 0; i < length; i++ )
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static int import( const char *name, import_result_t *res )
+{
+    memset( res, 0, sizeof(import_result_t) );
+    res->hash = 0xcbf29ce484222325ULL;
+    res->time = x264_mdate();
+    mp4sys_importer_t *importer = mp4sys_importer_open( name, "H.264" );
+    if( !importer )
+        return -1;
+    lsmash_summary_t *summary = mp4sys_duplicate_summary( importer, 1 );
+    if( !summary )
+    {
+        mp4sys_importer_close( importer );
+        return -1;
+    }
+    uint32_t max_au_length = summary->max_au_length;
+    lsmash_cleanup_summary( summary );
+    lsmash_sample_t *sample = lsmash_create_sample( max_au_length );
+    int ret = sample ? 0 : -1;
+    while( !ret )
+    {
+        sample->length = max_au_length;
+        int status = mp4sys_importer_get_access_unit( importer, 1, sample );
+        if( status < 0 )
+            ret = -1;
+        else if( sample->length )
+        {
+            res->count++;
+            res->bytes += sample->length;
+            res->hash = hash_bytes( res->hash, sample->data, sample->length );
+            res->hash = hash_bytes( res->hash, (uint8_t*)&sample->dts, sizeof(sample->dts) );
+            res->hash = hash_bytes( res->hash, (uint8_t*)&sample->cts, sizeof(sample->cts) );
+        }
+        if( status == 2 /* end of stream */ || !sample->length )
+            break;
+    }
+    if( sample )
+        lsmash_delete_sample( sample );
+    mp4sys_importer_close( importer );
+    res->time = x264_mdate() - res->time;
+    return ret;
+}
+
+int main( int argc, char **argv )
+{
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: importbench <file.264> [iterations]\n" );
+        return 1;
+    }
+    int iterations = argc > 2 ? X264_MAX( atoi( argv[2] ), 1 ) : 3;
+    FILE *fh = fopen( argv[1], "rb" );
+    if( !fh )
+    {
+        fprintf( stderr, "importbench: can't open `%s'\n", argv[1] );
+        return 1;
+    }
+    fseeko( fh, 0, SEEK_END );
+    double size = ftello( fh );
+    fclose( fh );
+
+    static const char *modes[] = { "mapped", "stdio" };
+    import_result_t best[2], res;
+    for( int i = 0; i < iterations; i++ )
+        for( int m = 0; m < 2; m++ )
+        {
+            /* stdin is reopened on the file to get the stdio path */
+            if( m && !freopen( argv[1], "rb", stdin ) )
+                return 1;
+            if( import( m ? "-" : argv[1], &res ) )
+            {
+                fprintf( stderr, "importbench: %s import failed\n", modes[m] );
+                return 1;
+            }
+            if( !i || res.time < best[m].time )
+                best[m] = res;
+        }
+
+    int ret = best[0].count != best[1].count || best[0].bytes != best[1].bytes || best[0].hash != best[1].hash;
+    for( int m = 0; m < 2; m++ )
+        printf( "%-6s %8"PRIu32" access units %12"PRIu64" bytes  hash %016"PRIx64"  %8.2f ms  %8.2f MB/s\n", modes[m],
+                best[m].count, best[m].bytes, best[m].hash, best[m].time / 1000., size / X264_MAX( best[m].time, 1 ) );
+    printf( ret ? "import: FAILED (samples differ)\n" : "import: samples match\n" );
+    return ret;
+}
@@ -85,6 +85,15 @@ typedef struct {
     int i_pulldown;
 } cli_opt_t;
 
+/* trace events, written as Chrome trace JSON */
+typedef struct {
+    FILE *fh;
+    int b_started;
+    x264_pthread_mutex_t mutex;
+} cli_trace_t;
+
+static cli_trace_t trace;
+
 /* file i/o operation structs */
 cli_input_t cli_input;
 static cli_output_t cli_output;
@@ -328,6 +337,12 @@ int main( int argc, char **argv )
         cli_output.close_file( opt.hout, 0, 0 );
     if( opt.tcfile_out )
         fclose( opt.tcfile_out );
+    if( trace.fh )
+    {
+        fprintf( trace.fh, "\n]\n" );
+        fclose( trace.fh );
+        x264_pthread_mutex_destroy( &trace.mutex );
+    }
     if( opt.qpfile )
         fclose( opt.qpfile );
 
@@ -791,6 +806,8 @@ static void help( x264_param_t *defaults, int longhelp )
     H0( "\n" );
     H0( "      Audio options may be used if audio support is compiled in.\n" );
     H0( "      Audio is automatically opened from the input file if supported by the demuxer.\n" );
+    H1( "      Each further --audiofile adds a track, up to %d, which starts out with the\n"
+        "      settings of the previous one.  The options below apply to the last track.\n", MAX_AUDIO_TRACKS );
     H0( "\n" );
     H0( "      --audiofile <filename>  Uses audio from the specified file\n" );
     H1( "      --ademuxer <string>     Demux audio by the specified demuxer [%s]\n"
@@ -810,9 +827,18 @@ static void help( x264_param_t *defaults, int longhelp )
     H0( "      --abitrate <float>      Enables bitrate mode and set bitrate (kbits/s)\n" );
     H0( "      --aquality <float>      Quality-based VBR [codec-dependent default]\n" );
     H0( "      --asamplerate <integer> Audio samplerate (Hz) [keep source samplerate]\n" );
+    H1( "      --afilter <filter0>/<filter1>/... Filter the audio before encoding it\n"
+        "                              Filter options are given as for --vf:\n"
+        "                                  - resample:samplerate[,threads]\n"
+        "                                  - mix:layout=<mono,stereo,2.1,3.0,quad,5.0,5.1,7.1>\n"
+        "                                        or channels=<integer>[,normalize]\n"
+        "                                  - gain:db\n"
+        "                              --asamplerate resamples after them if needed\n" );
     H0( "      --acodec-quality <float> Codec's internal compression quality [codec specific]\n" );
     H1( "      --aextraopt <string>    Pass extra option to codec [codec specific]\n" );
     H1( "                              Should be comma separated \"name=value\" style\n" );
+    H1( "      --alanguage <string>    Set the track language by ISO639-2/T language code\n"
+        "                              [--language for mp4, undefined for mkv]\n" );
     H0( "\n" );
     x264_audio_encoder_show_help( longhelp );
     H0( "\n" );
@@ -852,6 +878,12 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --lookahead-threads <integer> Force a specific number of lookahead threads\n" );
     H2( "      --sliced-threads        Low-latency but lower-efficiency threading\n" );
     H2( "      --thread-input          Run Avisynth in its own thread\n" );
+    H2( "      --thread-affinity <string> Placement of the encoder's threads [\"none\"]\n"
+        "                                  - none: left to the OS\n"
+        "                                  - node: threads and frames are kept on the NUMA\n"
+        "                                          node holding most of the allowed cpus\n" );
+    H2( "      --cpuset <string>       Only run the encoder's threads on these cpus,\n"
+        "                                  e.g. \"0-7,16-23\"\n" );
     H2( "      --sync-lookahead <integer> Number of buffer frames for threaded lookahead\n" );
     H2( "      --non-deterministic     Slightly improve quality of SMP, at the cost of repeatability\n" );
     H2( "      --cpu-independent       Ensure exact reproducibility across different cpus,\n"
@@ -865,6 +897,7 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --force-cfr             Force constant framerate timestamp generation\n" );
     H2( "      --tcfile-in <string>    Force timestamp generation with timecode file\n" );
     H2( "      --tcfile-out <string>   Output timecode v2 file from input timestamps\n" );
+    H2( "      --trace <string>        Save per-stage encoder timings as Chrome trace JSON\n" );
     H2( "      --timebase <int/int>    Specify timebase numerator and denominator\n"
         "                 <integer>    Specify timebase numerator for input timecode file\n"
         "                              or specify timebase denominator for other input\n" );
@@ -876,8 +909,13 @@ static void help( x264_param_t *defaults, int longhelp )
     H2( "      --language <string>     Set the language by ISO639-2/T language codes\n" );
     H2( "      --no-container-sar      Disable sample aspect ratio within the container\n" );
     H2( "      --no-remux              Inhibit auto-remuxing for progressive download\n" );
+    H2( "      --moov-reserve          Reserve space for the movie header in front of the media data\n"
+        "                                  to avoid rewriting the whole file when remuxing\n" );
     H2( "      --force-display-size    Force display region size for video\n" );
     H2( "      --fragments             Enable movie fragments structure\n" );
+    H2( "      --chunk-duration <integer> Interleave the tracks in chunks of up to this many ms [500]\n"
+        "                                  Longer chunks mean smaller sample tables and fewer\n"
+        "                                  seeks when the file is read progressively\n" );
     H2( "      --priming <integer>     Specify the number of priming samples for the copied audio\n" );
     H0( "\n" );
     H0( "Filtering:\n" );
@@ -914,6 +952,7 @@ typedef enum
     OPT_INTERLACED,
     OPT_TCFILE_IN,
     OPT_TCFILE_OUT,
+    OPT_TRACE,
     OPT_TIMEBASE,
     OPT_PULLDOWN,
     OPT_LOG_LEVEL,
@@ -935,12 +974,16 @@ typedef enum
     OPT_AUDIOSAMPLERATE,
     OPT_AUDIOCODECQUALITY,
     OPT_AUDIOEXTRAOPT,
+    OPT_AUDIOLANGUAGE,
+    OPT_AUDIOFILTER,
     OPT_CHAPTER,
     OPT_LANGUAGE,
     OPT_NO_CONTAINER_SAR,
     OPT_NO_REMUX,
+    OPT_MOOV_RESERVE,
     OPT_FORCE_DISPLAY_SIZE,
     OPT_FRAGMENTS,
+    OPT_CHUNK_DURATION,
     OPT_PRIMING
 } OptionsOPT;
 
@@ -1045,6 +1088,8 @@ static struct option long_options[] =
     { "qpfile",      required_argument, NULL, OPT_QPFILE },
     { "threads",     required_argument, NULL, 0 },
     { "lookahead-threads", required_argument, NULL, 0 },
+    { "thread-affinity", required_argument, NULL, 0 },
+    { "cpuset",      required_argument, NULL, 0 },
     { "sliced-threads",    no_argument, NULL, 0 },
     { "no-sliced-threads", no_argument, NULL, 0 },
     { "slice-max-size",    required_argument, NULL, 0 },
@@ -1087,6 +1132,7 @@ static struct option long_options[] =
     { "force-cfr",         no_argument, NULL, 0 },
     { "tcfile-in",   required_argument, NULL, OPT_TCFILE_IN },
     { "tcfile-out",  required_argument, NULL, OPT_TCFILE_OUT },
+    { "trace",       required_argument, NULL, OPT_TRACE },
     { "timebase",    required_argument, NULL, OPT_TIMEBASE },
     { "pic-struct",        no_argument, NULL, 0 },
     { "crop-rect",   required_argument, NULL, 0 },
@@ -1112,12 +1158,16 @@ static struct option long_options[] =
     { "asamplerate", required_argument, NULL, OPT_AUDIOSAMPLERATE },
     { "acodec-quality",    required_argument, NULL, OPT_AUDIOCODECQUALITY },
     { "aextraopt",   required_argument, NULL, OPT_AUDIOEXTRAOPT },
+    { "alanguage",   required_argument, NULL, OPT_AUDIOLANGUAGE },
+    { "afilter",     required_argument, NULL, OPT_AUDIOFILTER },
     { "chapter",     required_argument, NULL, OPT_CHAPTER },
     { "language",    required_argument, NULL, OPT_LANGUAGE },
     { "no-container-sar",  no_argument, NULL, OPT_NO_CONTAINER_SAR },
     { "no-remux",    no_argument, NULL, OPT_NO_REMUX },
+    { "moov-reserve",      no_argument, NULL, OPT_MOOV_RESERVE },
     { "force-display-size", required_argument, NULL, OPT_FORCE_DISPLAY_SIZE },
     { "fragments",         no_argument, NULL, OPT_FRAGMENTS },
+    { "chunk-duration", required_argument, NULL, OPT_CHUNK_DURATION },
     { "priming",     required_argument, NULL, OPT_PRIMING },
     {0, 0, 0, 0}
 };
@@ -1240,14 +1290,32 @@ static int select_input( const char *demuxer, char *used_demuxer, char *filename
     return 0;
 }
 
+/* Initialize a filter, and put a pipeline stage after it if it's one of the heavy ones and was actually added,
+ * so that it runs on its own thread in parallel to the following filters and the encoder. */
+static int init_vid_filter_stage( const char *name, hnd_t *handle, video_info_t *info, x264_param_t *param, char *opt_string, int b_pipeline )
+{
+    hnd_t prev_hnd = *handle;
+    if( x264_init_vid_filter( name, handle, &filter, info, param, opt_string ) )
+        return -1;
+    if( b_pipeline && *handle != prev_hnd && (!strcasecmp( name, "resize" ) || !strcasecmp( name, "depth" )) )
+        return x264_init_vid_filter( "pipeline", handle, &filter, info, param, NULL );
+    return 0;
+}
+
 static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info, x264_param_t *param, int output_csp )
 {
     x264_register_vid_filters();
 
+    int b_pipeline = 0;
+#if HAVE_THREAD
+    b_pipeline = info->thread_safe && (param->i_threads > 1
+                 || (param->i_threads == X264_THREADS_AUTO && x264_cpu_num_processors() > 1));
+#endif
+
     /* intialize baseline filters */
     if( x264_init_vid_filter( "source", handle, &filter, info, param, NULL ) ) /* wrap demuxer into a filter */
         return -1;
-    if( x264_init_vid_filter( "resize", handle, &filter, info, param, "normcsp" ) ) /* normalize csps to be of a known/supported format */
+    if( init_vid_filter_stage( "resize", handle, info, param, "normcsp", b_pipeline ) ) /* normalize csps to be of a known/supported format */
         return -1;
     if( x264_init_vid_filter( "fix_vfr_pts", handle, &filter, info, param, NULL ) ) /* fix vfr pts */
         return -1;
@@ -1261,7 +1329,7 @@ static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info,
         int name_len = strcspn( p, ":" );
         p[name_len] = 0;
         name_len += name_len != tok_len;
-        if( x264_init_vid_filter( p, handle, &filter, info, param, p + name_len ) )
+        if( init_vid_filter_stage( p, handle, info, param, p + name_len, b_pipeline ) )
             return -1;
         p += X264_MIN( tok_len+1, p_len );
     }
@@ -1288,13 +1356,13 @@ static int init_vid_filters( char *sequence, hnd_t *handle, video_info_t *info,
     if( param->vui.b_fullrange == RANGE_AUTO )
         param->vui.b_fullrange = info->fullrange;
 
-    if( x264_init_vid_filter( "resize", handle, &filter, info, param, NULL ) )
+    if( init_vid_filter_stage( "resize", handle, info, param, NULL, b_pipeline ) )
         return -1;
 
     char args[20];
     sprintf( args, "bit_depth=%d", x264_bit_depth );
 
-    if( x264_init_vid_filter( "depth", handle, &filter, info, param, args ) )
+    if( init_vid_filter_stage( "depth", handle, info, param, args, b_pipeline ) )
         return -1;
 
     return 0;
@@ -1334,6 +1402,40 @@ static int select_audio_demuxer( const char *demuxer, char *used_demuxer, char *
     return 0;
 }
 
+typedef struct
+{
+    char *enc;
+    char *filename;
+    const char *demuxer;
+    int track;
+    float bitrate;
+    float quality;
+    float codec_quality;
+    int samplerate;
+    char *extraopt;
+    char *language;
+    char *filters;
+} cli_audio_opt_t;
+
+static void audio_parameters( char *arg, cli_audio_opt_t *aopt )
+{
+    int len = 0;
+    arg[0] = 0;
+    if( aopt->bitrate > 0 )
+        len += snprintf( &arg[len], MAX_ARGS, "is_vbr=0,bitrate=%f", aopt->bitrate );
+    else if( isfinite( aopt->quality ) )
+        len += snprintf( &arg[len], MAX_ARGS, "is_vbr=1,bitrate=%f", aopt->quality );
+
+    if( isfinite( aopt->codec_quality ) )
+        len += snprintf( &arg[len], MAX_ARGS - len, "%squality=%f", len ? "," : "", aopt->codec_quality );
+
+    if( aopt->samplerate > 0 )
+        len += snprintf( &arg[len], MAX_ARGS - len, "%ssamplerate=%d", len ? "," : "", aopt->samplerate );
+
+    if( aopt->extraopt )
+        len += snprintf( &arg[len], MAX_ARGS - len, "%s%s", len ? "," : "", aopt->extraopt );
+}
+
 static int parse_enum_name( const char *arg, const char * const *names, const char **dst )
 {
     for( int i = 0; names[i]; i++ )
@@ -1376,17 +1478,11 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
     char *preset = NULL;
     char *tune = NULL;
 
-    char *audio_enc      = "auto";
-    char *audio_filename = NULL;
-    const char *audio_demuxer = "auto";
-    int audio_track      = TRACK_ANY;
-    float audio_bitrate  = -1;
-    float audio_quality  = NAN;
-    float acodec_quality = NAN;
-    int audio_samplerate = -1;
+    cli_audio_opt_t audio_opt[MAX_AUDIO_TRACKS] = {{ .enc = "auto", .demuxer = "auto", .track = TRACK_ANY,
+                                                     .bitrate = -1, .quality = NAN, .codec_quality = NAN, .samplerate = -1 }};
+    cli_audio_opt_t *aopt = &audio_opt[0];
+    int audio_opt_count  = 1;
     int audio_enable     = 1;
-    hnd_t haud           = NULL;
-    char *audio_extraopt = NULL;
 
 #if !HAVE_AUDIO
     audio_enable = 0;
@@ -1531,6 +1627,13 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
                 opt->tcfile_out = fopen( optarg, "wb" );
                 FAIL_IF_ERROR( !opt->tcfile_out, "can't open `%s'\n", optarg )
                 break;
+            case OPT_TRACE:
+                FAIL_IF_ERROR( trace.fh, "only one trace file can be written\n" )
+                trace.fh = fopen( optarg, "wb" );
+                FAIL_IF_ERROR( !trace.fh, "can't open `%s'\n", optarg )
+                FAIL_IF_ERROR( x264_pthread_mutex_init( &trace.mutex, NULL ), "can't initialize trace mutex\n" )
+                fprintf( trace.fh, "[" );
+                break;
             case OPT_TIMEBASE:
                 input_opt.timebase = optarg;
                 break;
@@ -1574,45 +1677,55 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
                 input_opt.output_range = param->vui.b_fullrange += RANGE_AUTO;
                 break;
             case OPT_AUDIOCODEC:
-                audio_enc = optarg;
-                if( !strcmp( audio_enc, "none" ) )
-                    audio_enable = 0;
-                else
+                aopt->enc = optarg;
+                if( strcmp( aopt->enc, "none" ) )
                 {
-                    FAIL_IF_ERROR( strcmp( audio_enc, "auto" ) && strcmp( audio_enc, "copy" ) &&
-                                   !x264_audio_encoder_by_name( audio_enc, QUERY_CODEC, NULL ) && !x264_audio_encoder_by_name( audio_enc, QUERY_ENCODER, NULL ),
-                                   "audio codec '%s' not supported or not compiled in\n", audio_enc );
-#if HAVE_AUDIO
-                    audio_enable = 1;
-#else
+                    FAIL_IF_ERROR( strcmp( aopt->enc, "auto" ) && strcmp( aopt->enc, "copy" ) &&
+                                   !x264_audio_encoder_by_name( aopt->enc, QUERY_CODEC, NULL ) && !x264_audio_encoder_by_name( aopt->enc, QUERY_ENCODER, NULL ),
+                                   "audio codec '%s' not supported or not compiled in\n", aopt->enc );
+#if !HAVE_AUDIO
                     x264_cli_log( "x264", X264_LOG_WARNING, "audio not compiled in, --acodec ignored.\n" );
 #endif
                 }
                 break;
             case OPT_AUDIOFILE:
-                audio_filename = optarg;
+                if( aopt->filename )
+                {
+                    FAIL_IF_ERROR( audio_opt_count == MAX_AUDIO_TRACKS, "at most %d audio tracks are supported\n", MAX_AUDIO_TRACKS );
+                    audio_opt[audio_opt_count] = *aopt;
+                    aopt = &audio_opt[audio_opt_count++];
+                    aopt->track = TRACK_ANY;
+                    aopt->language = NULL;
+                }
+                aopt->filename = optarg;
                 break;
             case OPT_AUDIODEMUXER:
-                FAIL_IF_ERROR( parse_enum_name( optarg, audio_demuxers, &audio_demuxer ), "Unknown audio demuxer `%s'\n", optarg )
+                FAIL_IF_ERROR( parse_enum_name( optarg, audio_demuxers, &aopt->demuxer ), "Unknown audio demuxer `%s'\n", optarg )
                 break;
             case OPT_AUDIOTRACK:
-                audio_track = atoi( optarg );
+                aopt->track = atoi( optarg );
                 break;
             case OPT_AUDIOBITRATE:
-                audio_bitrate = atof( optarg );
-                FAIL_IF_ERROR( audio_bitrate <= 0, "bitrate must be > 0.\n" );
+                aopt->bitrate = atof( optarg );
+                FAIL_IF_ERROR( aopt->bitrate <= 0, "bitrate must be > 0.\n" );
                 break;
             case OPT_AUDIOQUALITY:
-                audio_quality = (float) atof( optarg );
+                aopt->quality = (float) atof( optarg );
                 break;
             case OPT_AUDIOCODECQUALITY:
-                acodec_quality = (float) atof( optarg );
+                aopt->codec_quality = (float) atof( optarg );
                 break;
             case OPT_AUDIOSAMPLERATE:
-                audio_samplerate = atoi( optarg );
+                aopt->samplerate = atoi( optarg );
                 break;
             case OPT_AUDIOEXTRAOPT:
-                audio_extraopt = optarg;
+                aopt->extraopt = optarg;
+                break;
+            case OPT_AUDIOLANGUAGE:
+                aopt->language = optarg;
+                break;
+            case OPT_AUDIOFILTER:
+                aopt->filters = optarg;
                 break;
             case OPT_CHAPTER:
                 output_opt.chapter = optarg;
@@ -1626,6 +1739,9 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
             case OPT_NO_REMUX:
                 output_opt.no_remux = 1;
                 break;
+            case OPT_MOOV_RESERVE:
+                output_opt.moov_reserve = 1;
+                break;
             case OPT_FORCE_DISPLAY_SIZE:
                 FAIL_IF_ERROR( 2 != sscanf( optarg, "%lfx%lf", &output_opt.display_width, &output_opt.display_height ),
                                "invalid syntax for specifying display size: %s", optarg );
@@ -1634,6 +1750,10 @@ static int parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt )
             case OPT_FRAGMENTS:
                 output_opt.fragments = 1;
                 break;
+            case OPT_CHUNK_DURATION:
+                output_opt.chunk_duration = atoi( optarg );
+                FAIL_IF_ERROR( output_opt.chunk_duration <= 0, "chunk duration must be positive.\n" );
+                break;
             case OPT_PRIMING:
                 output_opt.priming = atoi( optarg );
                 break;
@@ -1707,21 +1827,54 @@ generic_option:
     FAIL_IF_ERROR( !opt->hin && cli_input.open_file( input_filename, &opt->hin, &info, &input_opt ),
                    "could not open input file `%s'\n", input_filename )
 
+    /* only the first track can come from the input file, the others have an --audiofile */
+    cli_audio_track_t audio[MAX_AUDIO_TRACKS];
+    char audio_args[MAX_AUDIO_TRACKS][MAX_ARGS];
+    int audio_tracks = 0;
     if( audio_enable )
     {
-        if( audio_filename )
+        x264_af_set_cpu( param->cpu );
+        for( int i = 0; i < audio_opt_count; i++ )
         {
-            char used_demuxer[8];
-            FAIL_IF_ERROR( select_audio_demuxer( audio_demuxer, used_demuxer, &audio_enc, audio_filename ), "no audio demuxer was found for --audiofile.\n" )
-            haud = x264_audio_open_from_file( used_demuxer, audio_filename, audio_track );
+            cli_audio_opt_t *a = &audio_opt[i];
+            hnd_t haud = NULL;
+            if( !strcmp( a->enc, "none" ) )
+                continue;
+            if( a->filename )
+            {
+                char used_demuxer[8];
+                FAIL_IF_ERROR( select_audio_demuxer( a->demuxer, used_demuxer, &a->enc, a->filename ), "no audio demuxer was found for --audiofile.\n" )
+                haud = x264_audio_open_from_file( used_demuxer, a->filename, a->track );
+                if( !haud )
+                    return -1;
+            }
+            else if( cli_input.open_audio )
+                haud = cli_input.open_audio( opt->hin, a->track );
+            if( !haud )
+                continue;
+            if( strcmp( a->enc, "copy" ) )
+            {
+                /* the samplerate is converted here rather than by each encoder */
+                char rate[16];
+                snprintf( rate, sizeof(rate), "%d", a->samplerate );
+                if( (a->filters && x264_audio_add_filters( &haud, a->filters )) ||
+                    (a->samplerate > 0 && x264_af_get_info( haud )->samplerate != a->samplerate &&
+                     x264_audio_add_filter( &haud, "resample", rate )) )
+                {
+                    x264_af_close( haud );
+                    return -1;
+                }
+            }
+            else
+                FAIL_IF_ERROR( a->filters, "audio can't be filtered when copied\n" );
+
+            audio_parameters( audio_args[audio_tracks], a );
+            audio[audio_tracks].filters    = haud;
+            audio[audio_tracks].encoder    = a->enc;
+            audio[audio_tracks].parameters = audio_args[audio_tracks];
+            audio[audio_tracks].language   = a->language;
+            audio_tracks++;
         }
-        else if( cli_input.open_audio )
-            haud = cli_input.open_audio( opt->hin, audio_track );
-        else
-            audio_enable = 0;
-
-        if( audio_filename && ( audio_enable && !haud ) )
-            return -1;
     }
 
     x264_reduce_fraction( &info.sar_width, &info.sar_height );
@@ -1730,26 +1883,7 @@ generic_option:
                   info.height, info.interlaced ? 'i' : 'p', info.sar_width, info.sar_height,
                   info.fps_num, info.fps_den, info.vfr ? 'v' : 'c' );
 
-    char arg[MAX_ARGS] = { 0 };
-    int len = 0;
-    if( audio_enable )
-    {
-        if( audio_bitrate > 0 )
-            len += snprintf( &arg[len], MAX_ARGS, "is_vbr=0,bitrate=%f", audio_bitrate );
-        else if( isfinite( audio_quality ) )
-            len += snprintf( &arg[len], MAX_ARGS, "is_vbr=1,bitrate=%f", audio_quality );
-
-        if( isfinite( acodec_quality ) )
-            len += snprintf( &arg[len], MAX_ARGS - len, "%squality=%f", len ? "," : "", acodec_quality );
-
-        if( audio_samplerate > 0 )
-            len += snprintf( &arg[len], MAX_ARGS - len, "%ssamplerate=%d", len ? "," : "", audio_samplerate );
-
-        if( audio_extraopt )
-            len += snprintf( &arg[len], MAX_ARGS - len, "%s%s", len ? "," : "", audio_extraopt );
-    }
-
-    FAIL_IF_ERROR( cli_output.open_file( output_filename, &opt->hout, &output_opt, haud, audio_enc, arg ) < 0, "could not open output file `%s'\n", output_filename )
+    FAIL_IF_ERROR( cli_output.open_file( output_filename, &opt->hout, &output_opt, audio, audio_tracks ) < 0, "could not open output file `%s'\n", output_filename )
 
     if( tcfile_name )
     {
@@ -1912,6 +2046,41 @@ static void parse_qpfile( cli_opt_t *opt, x264_picture_t *pic, int i_frame )
     }
 }
 
+/* Events are written as duration begin/end pairs; the lookahead and the calling
+ * thread get their own rows in the viewer, followed by one per encoder thread. */
+static void write_trace( const char *name, int b_end, int i_thread, int64_t i_time, int i_frame, int i_row )
+{
+    x264_pthread_mutex_lock( &trace.mutex );
+    fprintf( trace.fh, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%"PRId64",\"pid\":1,\"tid\":%d",
+             trace.b_started ? "," : "", name, b_end ? 'E' : 'B', i_time, i_thread + 2 );
+    if( i_frame >= 0 && i_row >= 0 )
+        fprintf( trace.fh, ",\"args\":{\"frame\":%d,\"row\":%d}", i_frame, i_row );
+    else if( i_frame >= 0 )
+        fprintf( trace.fh, ",\"args\":{\"frame\":%d}", i_frame );
+    fprintf( trace.fh, "}" );
+    trace.b_started = 1;
+    x264_pthread_mutex_unlock( &trace.mutex );
+}
+
+static void write_trace_thread_name( int i_thread, const char *name )
+{
+    fprintf( trace.fh, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+             trace.b_started ? "," : "", i_thread + 2, name );
+    trace.b_started = 1;
+}
+
+static void trace_event( void *p_private, const x264_trace_event_t *event )
+{
+    write_trace( x264_trace_stage_names[event->i_stage], event->b_end, event->i_thread,
+                 event->i_time, event->i_frame, event->i_row );
+}
+
+static uint8_t *get_output_buffer( x264_t *h, int size, void *opaque )
+{
+    /* opaque is the output handle of the frame, NULL for headers */
+    return opaque ? cli_output.get_buffer( opaque, size ) : NULL;
+}
+
 static int encode_frame( x264_t *h, hnd_t hout, x264_picture_t *pic, int64_t *last_dts )
 {
     x264_picture_t pic_out;
@@ -1925,7 +2094,11 @@ static int encode_frame( x264_t *h, hnd_t hout, x264_picture_t *pic, int64_t *la
 
     if( i_frame_size )
     {
+        if( trace.fh )
+            write_trace( "mux", 0, X264_TRACE_THREAD_API, x264_mdate(), -1, -1 );
         i_frame_size = cli_output.write_frame( hout, nal[0].p_payload, i_frame_size, &pic_out );
+        if( trace.fh )
+            write_trace( "mux", 1, X264_TRACE_THREAD_API, x264_mdate(), -1, -1 );
         *last_dts = pic_out.i_dts;
     }
 
@@ -2017,11 +2190,34 @@ static int encode( x264_param_t *param, cli_opt_t *opt )
         param->i_timebase_den = param->i_fps_num * pulldown->fps_factor;
     }
 
+    /* let the muxer supply the buffers frames are encoded into so they aren't copied again;
+     * CBR filler is written separately and would not be contiguous with the frame */
+    if( cli_output.get_buffer && !param->nalu_process && param->i_nal_hrd != X264_NAL_HRD_CBR )
+        param->nal_buffer_get = get_output_buffer;
+
+    if( trace.fh )
+    {
+        param->pf_trace = trace_event;
+        param->p_trace_private = NULL;
+    }
+
     h = x264_encoder_open( param );
     FAIL_IF_ERROR2( !h, "x264_encoder_open failed\n" );
 
     x264_encoder_parameters( h, param );
 
+    if( trace.fh )
+    {
+        char name[32];
+        write_trace_thread_name( X264_TRACE_THREAD_LOOKAHEAD, "lookahead" );
+        write_trace_thread_name( X264_TRACE_THREAD_API, "main" );
+        for( int i = 0; i < param->i_threads; i++ )
+        {
+            sprintf( name, "encoder thread %d", i );
+            write_trace_thread_name( i, name );
+        }
+    }
+
     FAIL_IF_ERROR2( cli_output.set_param( opt->hout, param ), "can't set outfile param\n" );
 
     i_start = x264_mdate();
@@ -2083,6 +2279,7 @@ static int encode( x264_param_t *param, cli_opt_t *opt )
         if( opt->qpfile )
             parse_qpfile( opt, &pic, i_frame + opt->i_seek );
 
+        pic.opaque = opt->hout;
         prev_dts = last_dts;
         i_frame_size = encode_frame( h, opt->hout, &pic, &last_dts );
         if( i_frame_size < 0 )
@@ -41,7 +41,7 @@
 
 #include "x264_config.h"
 
-#define X264_BUILD 129
+#define X264_BUILD 130
 
 /* Application developers planning to link against a shared library version of
  * libx264 from a Microsoft Visual Studio or similar development environment
@@ -232,12 +232,38 @@ static const char * const x264_nal_hrd_names[] = { "none", "vbr", "cbr", 0 };
 /* Threading */
 #define X264_THREADS_AUTO 0 /* Automatically select optimal number of threads */
 #define X264_SYNC_LOOKAHEAD_AUTO (-1) /* Automatically select optimal lookahead thread buffer size */
+#define X264_AFFINITY_NONE 0 /* Leave thread placement to the OS */
+#define X264_AFFINITY_NODE 1 /* Keep threads and frames on the NUMA node holding most of the allowed cpus */
+static const char * const x264_affinity_names[] = { "none", "node", 0 };
 
 /* HRD */
 #define X264_NAL_HRD_NONE            0
 #define X264_NAL_HRD_VBR             1
 #define X264_NAL_HRD_CBR             2
 
+/* Tracing: stages reported to pf_trace */
+#define X264_TRACE_INPUT             0 /* copying an input picture into the encoder */
+#define X264_TRACE_SLICETYPE         1 /* lookahead frame type decision */
+#define X264_TRACE_MBTREE            2 /* macroblock-tree propagation */
+#define X264_TRACE_FRAME             3 /* encoding of a frame (or slice) on an encoder thread */
+#define X264_TRACE_ROW               4 /* analysis and coding of one macroblock row */
+#define X264_TRACE_FILTER            5 /* deblocking and hpel filtering of one macroblock row */
+#define X264_TRACE_ENCAPSULATE       6 /* writing the output NAL units */
+static const char * const x264_trace_stage_names[] = { "input", "slicetype", "mbtree", "frame", "row", "filter", "encapsulate", 0 };
+
+#define X264_TRACE_THREAD_API      (-1) /* the thread calling x264_encoder_encode */
+#define X264_TRACE_THREAD_LOOKAHEAD (-2)
+
+typedef struct
+{
+    int     i_stage;    /* X264_TRACE_* */
+    int     b_end;      /* 0 when the stage begins, 1 when it ends */
+    int     i_frame;    /* input frame number */
+    int     i_row;      /* macroblock row for the row and filter stages, -1 otherwise */
+    int     i_thread;   /* index of the encoder thread, or X264_TRACE_THREAD_* */
+    int64_t i_time;     /* time in microseconds */
+} x264_trace_event_t;
+
 /* Zones: override ratecontrol or other options for specific sections of the video.
  * See x264_encoder_reconfig() for which options can be changed.
  * If zones overlap, whichever comes later in the list takes precedence. */
@@ -510,6 +536,30 @@ typedef struct x264_param_t
      * e.g. if doing multiple encodes in one process.
      */
     void (*nalu_process) ( x264_t *h, x264_nal_t *nal, void *opaque );
+
+    /* Optional callback for supplying the buffer that output NALs are encapsulated into.
+     * If used, x264 calls it once per x264_encoder_encode that outputs a frame, and once
+     * per x264_encoder_headers, with the worst-case size of the escaped NAL units and
+     * writes them, contiguously and in order, directly into the returned buffer instead
+     * of its internal one, so the caller can keep the data without copying it.  The
+     * p_payload pointers of the returned NALs point into this buffer.
+     *
+     * The opaque pointer is the opaque pointer from the input frame being output.  For
+     * x264_encoder_headers it is NULL, since the headers belong to no frame.  Whenever the
+     * callback returns NULL, as it may for the headers, x264 uses its internal buffer for
+     * that call, just as without the callback.  It is disabled with nalu_process and with
+     * CBR HRD, whose filler NAL units could not be written contiguously with the frame. */
+    uint8_t *(*nal_buffer_get)( x264_t *h, int size, void *opaque );
+
+    /* Trace: if set, called with the begin and end of each encoder stage.
+     * Events for the same i_thread are properly nested, but the callback
+     * is called from several threads at once and has to be thread-safe. */
+    void        (*pf_trace)( void *, const x264_trace_event_t *event );
+    void        *p_trace_private;
+
+    /* Thread placement */
+    int         i_thread_affinity; /* X264_AFFINITY_* */
+    char        *psz_cpuset;       /* cpus the encoder's threads may run on, e.g. "0-7,16-23"; NULL for no restriction */
 } x264_param_t;
 
 void x264_nal_encode( x264_t *h, uint8_t *dst, x264_nal_t *nal );